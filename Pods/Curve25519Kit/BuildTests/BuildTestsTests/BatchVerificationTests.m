@@ -0,0 +1,184 @@
+//
+//  Copyright (c) 2018 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import "Ed25519.h"
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+extern void curve25519_keygen(unsigned char *curve25519_pubkey_out, const unsigned char *curve25519_privkey_in);
+extern int curve25519_verify(const unsigned char *signature,
+                             const unsigned char *curve25519_pubkey,
+                             const unsigned char *msg,
+                             const unsigned long msg_len);
+extern int crypto_hash_sha512(unsigned char *out, const unsigned char *in, unsigned long long inlen);
+extern void crypto_sign_ed25519_ref10_sc_reduce(unsigned char *s);
+extern void crypto_sign_ed25519_ref10_sc_muladd(unsigned char *s,
+                                                const unsigned char *a,
+                                                const unsigned char *b,
+                                                const unsigned char *c);
+// The point is only passed around: 4 field elements of 40 bytes with either field backend.
+extern void crypto_sign_ed25519_ref10_ge_scalarmult_base(uint64_t point[20], const unsigned char *a);
+extern void crypto_sign_ed25519_ref10_ge_p3_tobytes(unsigned char *s, const uint64_t point[20]);
+
+// Signs like curve25519_sign(), but with the order-2 point (0, -1) added to R: (x, y) + (0, -1) = (-x, -y).
+static void SignWithTorsionedR(unsigned char *signature,
+                               const unsigned char *privateKey,
+                               const unsigned char *message,
+                               size_t length)
+{
+    static const unsigned char p[32] = { 0xed, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0x7f };
+    unsigned char nonce[64];
+    unsigned char edPublicKey[32];
+    unsigned char hram[64];
+    uint64_t point[20];
+    int borrow = 0;
+
+    memcpy(nonce, [Randomness generateRandomBytes:64].bytes, 64);
+    crypto_sign_ed25519_ref10_sc_reduce(nonce);
+    crypto_sign_ed25519_ref10_ge_scalarmult_base(point, nonce);
+    crypto_sign_ed25519_ref10_ge_p3_tobytes(signature, point);
+
+    unsigned char xSign = signature[31] & 0x80;
+    signature[31] &= 0x7f;
+    for (int i = 0; i < 32; i++) {
+        int digit = p[i] - signature[i] - borrow;
+        borrow = digit < 0;
+        signature[i] = digit & 0xff;
+    }
+    signature[31] |= xSign ^ 0x80;
+
+    crypto_sign_ed25519_ref10_ge_scalarmult_base(point, privateKey);
+    crypto_sign_ed25519_ref10_ge_p3_tobytes(edPublicKey, point);
+
+    NSMutableData *hashInput = [NSMutableData dataWithBytes:signature length:32];
+    [hashInput appendBytes:edPublicKey length:32];
+    [hashInput appendBytes:message length:length];
+    crypto_hash_sha512(hram, hashInput.bytes, hashInput.length);
+    crypto_sign_ed25519_ref10_sc_reduce(hram);
+    crypto_sign_ed25519_ref10_sc_muladd(signature + 32, hram, privateKey, nonce);
+    signature[63] |= edPublicKey[31] & 0x80;
+}
+
+@interface BatchVerificationTests : XCTestCase
+
+@property (nonatomic) NSMutableArray<NSData *> *signatures;
+@property (nonatomic) NSMutableArray<NSData *> *publicKeys;
+@property (nonatomic) NSMutableArray<NSData *> *messages;
+
+@end
+
+@implementation BatchVerificationTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.signatures = [NSMutableArray new];
+    self.publicKeys = [NSMutableArray new];
+    self.messages = [NSMutableArray new];
+
+    for (int i = 1; i <= 64; i++) {
+        ECKeyPair *key = [Curve25519 generateKeyPair];
+        NSData *data = [Randomness generateRandomBytes:i];
+
+        [self.signatures addObject:[Ed25519 throws_sign:data withKeyPair:key]];
+        [self.publicKeys addObject:[key publicKey]];
+        [self.messages addObject:data];
+    }
+}
+
+- (void)tearDown
+{
+    [super tearDown];
+}
+
+- (void)testValidBatch
+{
+    for (NSUInteger count = 0; count <= self.signatures.count; count++) {
+        NSRange range = NSMakeRange(0, count);
+        NSArray<NSNumber *> *verified =
+            [Ed25519 throws_verifySignatures:[self.signatures subarrayWithRange:range]
+                                  publicKeys:[self.publicKeys subarrayWithRange:range]
+                                        data:[self.messages subarrayWithRange:range]];
+
+        XCTAssertEqual(verified.count, count);
+        for (NSNumber *didVerify in verified) {
+            XCTAssertTrue(didVerify.boolValue, @"Failed to verify a valid batch of %lu", (unsigned long)count);
+        }
+    }
+}
+
+- (void)testInvalidSignatureInBatch
+{
+    for (NSUInteger bad = 0; bad < self.signatures.count; bad += 7) {
+        NSMutableArray<NSData *> *signatures = [self.signatures mutableCopy];
+        NSMutableData *corrupted = [signatures[bad] mutableCopy];
+        ((unsigned char *)corrupted.mutableBytes)[bad % 64] ^= 0x01;
+        signatures[bad] = corrupted;
+
+        NSArray<NSNumber *> *verified = [Ed25519 throws_verifySignatures:signatures
+                                                              publicKeys:self.publicKeys
+                                                                    data:self.messages];
+
+        for (NSUInteger i = 0; i < verified.count; i++) {
+            XCTAssertEqual(verified[i].boolValue, i != bad, @"Wrong result for signature %lu", (unsigned long)i);
+        }
+    }
+}
+
+- (void)testMismatchedPublicKeyInBatch
+{
+    NSMutableArray<NSData *> *publicKeys = [self.publicKeys mutableCopy];
+    [publicKeys exchangeObjectAtIndex:3 withObjectAtIndex:40];
+
+    NSArray<NSNumber *> *verified = [Ed25519 throws_verifySignatures:self.signatures
+                                                          publicKeys:publicKeys
+                                                                data:self.messages];
+
+    for (NSUInteger i = 0; i < verified.count; i++) {
+        XCTAssertEqual(verified[i].boolValue, i != 3 && i != 40, @"Wrong result for signature %lu", (unsigned long)i);
+    }
+}
+
+- (void)testTorsionedSignaturesInBatch
+{
+    // Two signatures whose R carries the order-2 point.  The combined equation accepts them, single verification does not.
+    NSMutableArray<NSData *> *signatures = [self.signatures mutableCopy];
+    NSMutableArray<NSData *> *publicKeys = [self.publicKeys mutableCopy];
+    const NSUInteger torsioned[2] = { 5, 20 };
+
+    for (int t = 0; t < 2; t++) {
+        NSUInteger index = torsioned[t];
+        NSMutableData *privateKey = [[Randomness generateRandomBytes:32] mutableCopy];
+        unsigned char *scalar = privateKey.mutableBytes;
+        scalar[0] &= 248;
+        scalar[31] &= 127;
+        scalar[31] |= 64;
+
+        unsigned char publicKey[32];
+        unsigned char signature[64];
+        curve25519_keygen(publicKey, scalar);
+        SignWithTorsionedR(signature, scalar, self.messages[index].bytes, self.messages[index].length);
+        signatures[index] = [NSData dataWithBytes:signature length:64];
+        publicKeys[index] = [NSData dataWithBytes:publicKey length:32];
+    }
+
+    NSArray<NSNumber *> *verified = [Ed25519 throws_verifySignatures:signatures
+                                                          publicKeys:publicKeys
+                                                                data:self.messages];
+
+    XCTAssertEqual(verified.count, signatures.count);
+    for (NSUInteger i = 0; i < verified.count; i++) {
+        NSData *message = self.messages[i];
+        BOOL single = curve25519_verify(signatures[i].bytes, publicKeys[i].bytes, message.bytes, message.length) == 0;
+        XCTAssertEqual(verified[i].boolValue, single, @"Batch and single verification differ for signature %lu", (unsigned long)i);
+        BOOL isTorsioned = i == torsioned[0] || i == torsioned[1];
+        XCTAssertEqual(single, !isTorsioned, @"Wrong single verification result for signature %lu", (unsigned long)i);
+    }
+}
+
+@end
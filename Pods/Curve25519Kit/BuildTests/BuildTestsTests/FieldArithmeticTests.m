@@ -0,0 +1,204 @@
+//
+//  Copyright (c) 2018 Open Whisper Systems. All rights reserved.
+//
+
+#import <SignalCoreKit/Randomness.h>
+#import <XCTest/XCTest.h>
+
+// The 64-bit field backend is built alongside ref10 wherever unsigned __int128 is available;
+// check that both produce the same encodings for the same operations.
+#if defined(__SIZEOF_INT128__) && (defined(__x86_64__) || defined(__aarch64__))
+#define HAS_FE51 1
+#endif
+
+#ifdef HAS_FE51
+
+typedef int32_t fe10[10];
+typedef uint64_t fe51[5];
+
+extern void crypto_sign_ed25519_ref10_fe_frombytes(fe10 h, const unsigned char *s);
+extern void crypto_sign_ed25519_ref10_fe_tobytes(unsigned char *s, const fe10 h);
+extern int crypto_sign_ed25519_ref10_fe_isnonzero(const fe10 f);
+extern int crypto_sign_ed25519_ref10_fe_isnegative(const fe10 f);
+extern void crypto_sign_ed25519_ref10_fe_cmov(fe10 f, const fe10 g, unsigned int b);
+extern void crypto_sign_ed25519_ref10_fe_add(fe10 h, const fe10 f, const fe10 g);
+extern void crypto_sign_ed25519_ref10_fe_sub(fe10 h, const fe10 f, const fe10 g);
+extern void crypto_sign_ed25519_ref10_fe_neg(fe10 h, const fe10 f);
+extern void crypto_sign_ed25519_ref10_fe_mul(fe10 h, const fe10 f, const fe10 g);
+extern void crypto_sign_ed25519_ref10_fe_sq(fe10 h, const fe10 f);
+extern void crypto_sign_ed25519_ref10_fe_sq2(fe10 h, const fe10 f);
+extern void crypto_sign_ed25519_ref10_fe_invert(fe10 out, const fe10 z);
+extern void crypto_sign_ed25519_ref10_fe_pow22523(fe10 out, const fe10 z);
+
+extern void crypto_sign_ed25519_fe51_frombytes(fe51 h, const unsigned char *s);
+extern void crypto_sign_ed25519_fe51_tobytes(unsigned char *s, const fe51 h);
+extern int crypto_sign_ed25519_fe51_isnonzero(const fe51 f);
+extern int crypto_sign_ed25519_fe51_isnegative(const fe51 f);
+extern void crypto_sign_ed25519_fe51_cmov(fe51 f, const fe51 g, unsigned int b);
+extern void crypto_sign_ed25519_fe51_add(fe51 h, const fe51 f, const fe51 g);
+extern void crypto_sign_ed25519_fe51_sub(fe51 h, const fe51 f, const fe51 g);
+extern void crypto_sign_ed25519_fe51_neg(fe51 h, const fe51 f);
+extern void crypto_sign_ed25519_fe51_mul(fe51 h, const fe51 f, const fe51 g);
+extern void crypto_sign_ed25519_fe51_sq(fe51 h, const fe51 f);
+extern void crypto_sign_ed25519_fe51_sq2(fe51 h, const fe51 f);
+extern void crypto_sign_ed25519_fe51_invert(fe51 out, const fe51 z);
+extern void crypto_sign_ed25519_fe51_pow22523(fe51 out, const fe51 z);
+
+// The same value in both representations.
+typedef struct {
+    fe10 ref10;
+    fe51 fe51;
+} FieldPair;
+
+static void FieldPairFromBytes(FieldPair *pair, const unsigned char *bytes)
+{
+    crypto_sign_ed25519_ref10_fe_frombytes(pair->ref10, bytes);
+    crypto_sign_ed25519_fe51_frombytes(pair->fe51, bytes);
+}
+
+static BOOL FieldPairMatches(const FieldPair *pair)
+{
+    unsigned char ref10Bytes[32];
+    unsigned char fe51Bytes[32];
+    crypto_sign_ed25519_ref10_fe_tobytes(ref10Bytes, pair->ref10);
+    crypto_sign_ed25519_fe51_tobytes(fe51Bytes, pair->fe51);
+    return memcmp(ref10Bytes, fe51Bytes, 32) == 0;
+}
+
+#endif
+
+@interface FieldArithmeticTests : XCTestCase
+
+@end
+
+@implementation FieldArithmeticTests
+
+#ifdef HAS_FE51
+
+- (void)randomPair:(FieldPair *)pair
+{
+    NSData *bytes = [Randomness generateRandomBytes:32];
+    FieldPairFromBytes(pair, bytes.bytes);
+}
+
+- (void)testEncodingEdgeCases
+{
+    // 0, 1, p - 1, p, p + 1 and 2^255 - 1, the last three of which are non-canonical.
+    unsigned char values[6][32] = { { 0 }, { 1 } };
+    for (int i = 2; i < 6; i++) {
+        memset(values[i], 0xff, 32);
+        values[i][31] = 0x7f;
+    }
+    values[2][0] = 0xec;
+    values[3][0] = 0xed;
+    values[4][0] = 0xee;
+
+    for (int i = 0; i < 6; i++) {
+        FieldPair pair;
+        FieldPairFromBytes(&pair, values[i]);
+        XCTAssertTrue(FieldPairMatches(&pair), @"Encoding mismatch for value %d", i);
+        XCTAssertEqual(crypto_sign_ed25519_ref10_fe_isnonzero(pair.ref10),
+            crypto_sign_ed25519_fe51_isnonzero(pair.fe51));
+        XCTAssertEqual(crypto_sign_ed25519_ref10_fe_isnegative(pair.ref10),
+            crypto_sign_ed25519_fe51_isnegative(pair.fe51));
+    }
+}
+
+- (void)testRandomOperations
+{
+    for (int i = 0; i < 10000; i++) {
+        FieldPair f, g, h;
+        [self randomPair:&f];
+        [self randomPair:&g];
+        XCTAssertTrue(FieldPairMatches(&f));
+
+        crypto_sign_ed25519_ref10_fe_add(h.ref10, f.ref10, g.ref10);
+        crypto_sign_ed25519_fe51_add(h.fe51, f.fe51, g.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_add mismatch");
+
+        crypto_sign_ed25519_ref10_fe_sub(h.ref10, f.ref10, g.ref10);
+        crypto_sign_ed25519_fe51_sub(h.fe51, f.fe51, g.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_sub mismatch");
+
+        crypto_sign_ed25519_ref10_fe_neg(h.ref10, f.ref10);
+        crypto_sign_ed25519_fe51_neg(h.fe51, f.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_neg mismatch");
+
+        crypto_sign_ed25519_ref10_fe_mul(h.ref10, f.ref10, g.ref10);
+        crypto_sign_ed25519_fe51_mul(h.fe51, f.fe51, g.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_mul mismatch");
+
+        crypto_sign_ed25519_ref10_fe_sq(h.ref10, f.ref10);
+        crypto_sign_ed25519_fe51_sq(h.fe51, f.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_sq mismatch");
+
+        crypto_sign_ed25519_ref10_fe_sq2(h.ref10, f.ref10);
+        crypto_sign_ed25519_fe51_sq2(h.fe51, f.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_sq2 mismatch");
+
+        crypto_sign_ed25519_ref10_fe_cmov(h.ref10, g.ref10, i & 1);
+        crypto_sign_ed25519_fe51_cmov(h.fe51, g.fe51, i & 1);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_cmov mismatch");
+
+        XCTAssertEqual(crypto_sign_ed25519_ref10_fe_isnegative(f.ref10),
+            crypto_sign_ed25519_fe51_isnegative(f.fe51));
+    }
+}
+
+- (void)testRandomExponentiations
+{
+    for (int i = 0; i < 1000; i++) {
+        FieldPair f, h;
+        [self randomPair:&f];
+
+        crypto_sign_ed25519_ref10_fe_invert(h.ref10, f.ref10);
+        crypto_sign_ed25519_fe51_invert(h.fe51, f.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_invert mismatch");
+
+        crypto_sign_ed25519_ref10_fe_pow22523(h.ref10, f.ref10);
+        crypto_sign_ed25519_fe51_pow22523(h.fe51, f.fe51);
+        XCTAssertTrue(FieldPairMatches(&h), @"fe_pow22523 mismatch");
+    }
+}
+
+// Chains unreduced sums into products the way the ge_* formulas do,
+// so limbs reach the top of each backend's documented bounds.
+- (void)testRandomChains
+{
+    for (int i = 0; i < 1000; i++) {
+        FieldPair x, y, z, t0, t1;
+        [self randomPair:&x];
+        [self randomPair:&y];
+        [self randomPair:&z];
+
+        for (int round = 0; round < 50; round++) {
+            // As in ge_add: x = (2x + y)(2x - y)
+            crypto_sign_ed25519_ref10_fe_add(t0.ref10, x.ref10, x.ref10);
+            crypto_sign_ed25519_fe51_add(t0.fe51, x.fe51, x.fe51);
+            crypto_sign_ed25519_ref10_fe_add(t1.ref10, t0.ref10, y.ref10);
+            crypto_sign_ed25519_fe51_add(t1.fe51, t0.fe51, y.fe51);
+            crypto_sign_ed25519_ref10_fe_sub(t0.ref10, t0.ref10, y.ref10);
+            crypto_sign_ed25519_fe51_sub(t0.fe51, t0.fe51, y.fe51);
+            crypto_sign_ed25519_ref10_fe_mul(x.ref10, t1.ref10, t0.ref10);
+            crypto_sign_ed25519_fe51_mul(x.fe51, t1.fe51, t0.fe51);
+
+            // As in ge_p2_dbl: y = (x + z)^2, z = 2z^2 - y
+            crypto_sign_ed25519_ref10_fe_add(t0.ref10, x.ref10, z.ref10);
+            crypto_sign_ed25519_fe51_add(t0.fe51, x.fe51, z.fe51);
+            crypto_sign_ed25519_ref10_fe_sq(y.ref10, t0.ref10);
+            crypto_sign_ed25519_fe51_sq(y.fe51, t0.fe51);
+            crypto_sign_ed25519_ref10_fe_sq2(t1.ref10, z.ref10);
+            crypto_sign_ed25519_fe51_sq2(t1.fe51, z.fe51);
+            crypto_sign_ed25519_ref10_fe_sub(z.ref10, t1.ref10, y.ref10);
+            crypto_sign_ed25519_fe51_sub(z.fe51, t1.fe51, y.fe51);
+        }
+
+        XCTAssertTrue(FieldPairMatches(&x), @"Chain mismatch in x");
+        XCTAssertTrue(FieldPairMatches(&y), @"Chain mismatch in y");
+        XCTAssertTrue(FieldPairMatches(&z), @"Chain mismatch in z");
+    }
+}
+
+#endif
+
+@end
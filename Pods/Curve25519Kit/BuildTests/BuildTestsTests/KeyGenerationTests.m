@@ -0,0 +1,34 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "Curve25519.h"
+#import <XCTest/XCTest.h>
+
+extern void curve25519_donna(unsigned char *output, const unsigned char *a, const unsigned char *b);
+
+static const unsigned char basepoint[32] = { 9 };
+
+@interface KeyGenerationTests : XCTestCase
+
+@end
+
+@implementation KeyGenerationTests
+
+- (void)testGeneratedKeyPairs
+{
+    for (int i = 0; i < 100; i++) {
+        ECKeyPair *alice = [Curve25519 generateKeyPair];
+        ECKeyPair *bob = [Curve25519 generateKeyPair];
+
+        unsigned char publicKey[32];
+        curve25519_donna(publicKey, alice.privateKey.bytes, basepoint);
+        XCTAssertEqualObjects(alice.publicKey, [NSData dataWithBytes:publicKey length:32]);
+
+        NSData *aliceSecret = [Curve25519 throws_generateSharedSecretFromPublicKey:bob.publicKey andKeyPair:alice];
+        NSData *bobSecret = [Curve25519 throws_generateSharedSecretFromPublicKey:alice.publicKey andKeyPair:bob];
+        XCTAssertEqualObjects(aliceSecret, bobSecret);
+    }
+}
+
+@end
@@ -55,6 +55,25 @@
               didVerify:(BOOL *)didVerify
                   error:(NSError **)outError NS_REFINED_FOR_SWIFT;
 
+/**
+ *  Verify a batch of ed25519 signatures with 32-bytes Curve25519 public keys. The whole batch is checked in
+ *  one multi-scalar multiplication, which is roughly twice as fast per signature as verifying each one for
+ *  batches of 64 or more; if the batch check fails, each signature is verified on its own.
+ *
+ *  @param signatures ed25519 64-byte signatures.
+ *  @param publicKeys public keys of the signers, one per signature.
+ *  @param data       data to be checked against each signature, one per signature.
+ *
+ *  @return Returns one boolean NSNumber per signature, YES if that signature is valid.
+ */
++ (NSArray<NSNumber *> *)throws_verifySignatures:(NSArray<NSData *> *)signatures
+                                      publicKeys:(NSArray<NSData *> *)publicKeys
+                                            data:(NSArray<NSData *> *)data NS_SWIFT_UNAVAILABLE("throws objc exceptions");
++ (nullable NSArray<NSNumber *> *)verifySignatures:(NSArray<NSData *> *)signatures
+                                        publicKeys:(NSArray<NSData *> *)publicKeys
+                                              data:(NSArray<NSData *> *)data
+                                             error:(NSError **)outError NS_REFINED_FOR_SWIFT;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -5,6 +5,7 @@
 #import "Ed25519.h"
 #import "Curve25519.h"
 #import <SignalCoreKit/OWSAsserts.h>
+#import <SignalCoreKit/Randomness.h>
 #import <SignalCoreKit/SCKExceptionWrapper.h>
 
 NS_ASSUME_NONNULL_BEGIN
@@ -14,6 +15,14 @@ extern int curve25519_verify(const unsigned char *signature, /* 64 bytes */
     const unsigned char *msg,
     const unsigned long msg_len);
 
+extern int curve25519_verify_batch(int *results, /* count ints */
+    const unsigned char *const *signatures, /* 64 bytes each */
+    const unsigned char *const *curve25519_pubkeys, /* 32 bytes each */
+    const unsigned char *const *msgs,
+    const unsigned long *msg_lens,
+    const unsigned long count,
+    const unsigned char *random); /* 64 bytes */
+
 @interface ECKeyPair ()
 
 - (NSData *)throws_sign:(NSData *)data;
@@ -87,6 +96,70 @@ extern int curve25519_verify(const unsigned char *signature, /* 64 bytes */
     return success;
 }
 
++ (nullable NSArray<NSNumber *> *)verifySignatures:(NSArray<NSData *> *)signatures
+                                        publicKeys:(NSArray<NSData *> *)publicKeys
+                                              data:(NSArray<NSData *> *)data
+                                             error:(NSError **)outError
+{
+    @try {
+        return [self throws_verifySignatures:signatures publicKeys:publicKeys data:data];
+    } @catch (NSException *exception) {
+        *outError = SCKExceptionWrapperErrorMake(exception);
+        return nil;
+    }
+}
+
++ (NSArray<NSNumber *> *)throws_verifySignatures:(NSArray<NSData *> *)signatures
+                                      publicKeys:(NSArray<NSData *> *)publicKeys
+                                            data:(NSArray<NSData *> *)data
+{
+    NSUInteger count = signatures.count;
+    if (publicKeys.count != count || data.count != count) {
+        OWSRaiseException(NSInvalidArgumentException, @"Mismatched batch sizes");
+    }
+
+    NSMutableArray<NSNumber *> *verified = [NSMutableArray arrayWithCapacity:count];
+    if (count == 0) {
+        return verified;
+    }
+
+    NSMutableData *signaturePointers = [NSMutableData dataWithLength:count * sizeof(unsigned char *)];
+    NSMutableData *publicKeyPointers = [NSMutableData dataWithLength:count * sizeof(unsigned char *)];
+    NSMutableData *messagePointers = [NSMutableData dataWithLength:count * sizeof(unsigned char *)];
+    NSMutableData *messageLengths = [NSMutableData dataWithLength:count * sizeof(unsigned long)];
+    NSMutableData *results = [NSMutableData dataWithLength:count * sizeof(int)];
+    const unsigned char **sigs = signaturePointers.mutableBytes;
+    const unsigned char **keys = publicKeyPointers.mutableBytes;
+    const unsigned char **msgs = messagePointers.mutableBytes;
+    unsigned long *msgLens = messageLengths.mutableBytes;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (publicKeys[i].length != ECCKeyLength) {
+            OWSRaiseException(NSInvalidArgumentException,
+                @"Public Key has unexpected length: %lu",
+                (unsigned long)publicKeys[i].length);
+        }
+        if (signatures[i].length != ECCSignatureLength) {
+            OWSRaiseException(NSInvalidArgumentException,
+                @"Signature has unexpected length: %lu",
+                (unsigned long)signatures[i].length);
+        }
+        sigs[i] = signatures[i].bytes;
+        keys[i] = publicKeys[i].bytes;
+        msgs[i] = data[i].bytes;
+        msgLens[i] = data[i].length;
+    }
+
+    NSData *random = [Randomness generateRandomBytes:64];
+    curve25519_verify_batch(results.mutableBytes, sigs, keys, msgs, msgLens, count, random.bytes);
+
+    const int *resultValues = results.bytes;
+    for (NSUInteger i = 0; i < count; i++) {
+        [verified addObject:@(resultValues[i] == 0)];
+    }
+    return verified;
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
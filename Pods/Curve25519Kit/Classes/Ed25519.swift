@@ -11,4 +11,8 @@ public extension Ed25519 {
 
         return didVerify.boolValue
     }
+
+    class func verifySignatures(_ signatures: [Data], publicKeys: [Data], data: [Data]) throws -> [Bool] {
+        return try __verifySignatures(signatures, publicKeys: publicKeys, data: data).map { $0.boolValue }
+    }
 }
@@ -3,6 +3,8 @@
 #include "ge.h"
 #include "curve_sigs.h"
 #include "crypto_sign.h"
+#include "crypto_hash_sha512.h"
+#include "sc.h"
 
 void curve25519_keygen(unsigned char* curve25519_pubkey_out,
                        const unsigned char* curve25519_privkey_in)
@@ -136,3 +138,272 @@ int curve25519_verify(const unsigned char* signature,
 
   return result;
 }
+
+/* Decodes -R from the first half of a signature.  R must be a canonical
+   encoding: y < p, and no sign bit on x = 0. */
+static int r_frombytes_negate_vartime(ge_p3* neg_r,
+                                      const unsigned char* signature)
+{
+  int j;
+
+  if (ge_frombytes_negate_vartime(neg_r, signature) != 0)
+    return -1;
+  if (!fe_isnonzero(neg_r->X) && (signature[31] & 0x80))
+    return -1;
+  if ((signature[31] & 0x7F) == 0x7F && signature[0] >= 0xED) {
+    for (j = 1; j < 31 && signature[j] == 0xFF; j++);
+    if (j == 31)
+      return -1;
+  }
+  return 0;
+}
+
+/* Returns 1 if 8 * p is the neutral element, that is if p is zero or only
+   made of a small-order component. */
+static int ge_p2_is_small_order(const ge_p2* p)
+{
+  ge_p1p1 t;
+  ge_p2 q;
+  fe y_minus_z;
+  int i;
+
+  q = *p;
+  for (i = 0; i < 3; i++) {
+    ge_p2_dbl(&t, &q);
+    ge_p1p1_to_p2(&q, &t);
+  }
+  fe_sub(y_minus_z, q.Y, q.Z);
+  return !fe_isnonzero(q.X) && !fe_isnonzero(y_minus_z);
+}
+
+/* Returns 1 if p has a small-order component, that is if q * p is not the
+   neutral element. */
+static int ge_p3_has_torsion(const ge_p3* p)
+{
+  static const unsigned char order[32] = {
+    0xED, 0xD3, 0xF5, 0x5C, 0x1A, 0x63, 0x12, 0x58,
+    0xD6, 0x9C, 0xF7, 0xA2, 0xDE, 0xF9, 0xDE, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+  };
+  static const unsigned char zero[32] = {0};
+  ge_p2 q_p;
+  fe y_minus_z;
+
+  ge_double_scalarmult_vartime(&q_p, order, p, zero);
+  fe_sub(y_minus_z, q_p.Y, q_p.Z);
+  return fe_isnonzero(q_p.X) || fe_isnonzero(y_minus_z);
+}
+
+/* Below this many signatures the per-batch setup costs more than it saves */
+#define BATCH_VERIFY_MIN 8
+
+static void verify_each(int* results,
+                        const unsigned char* const* signatures,
+                        const unsigned char* const* curve25519_pubkeys,
+                        const unsigned char* const* msgs,
+                        const unsigned long* msg_lens,
+                        const unsigned long count,
+                        const unsigned char* skip)
+{
+  unsigned long i;
+
+  for (i = 0; i < count; i++) {
+    if (skip != NULL && skip[i])
+      continue;
+    results[i] = curve25519_verify(signatures[i], curve25519_pubkeys[i],
+                                   msgs[i], msg_lens[i]) == 0 ? 0 : -1;
+  }
+}
+
+int curve25519_verify_batch(int* results,
+                            const unsigned char* const* signatures,
+                            const unsigned char* const* curve25519_pubkeys,
+                            const unsigned char* const* msgs,
+                            const unsigned long* msg_lens,
+                            const unsigned long count,
+                            const unsigned char* random)
+{
+  static const unsigned char base_point[32] = {
+    0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+  };
+  static const unsigned char zero[32] = {0};
+  fe one;
+  fe acc;
+  fe inv;
+  fe ed_y;
+  fe tmp;
+  fe *mont_x = NULL; /* per signature: mont_x, then inverse of mont_x + 1 */
+  fe *prefix = NULL; /* running products for the batch inversion */
+  unsigned char *scalars = NULL; /* S sum, then z_i * h_i and z_i pairs */
+  ge_cached *points = NULL; /* B, then -A_i and -R_i pairs */
+  unsigned char *hashbuf = NULL; /* R || ed_pubkey || msg */
+  unsigned char *failed = NULL; /* rejected before the combined check */
+  unsigned char *torsion = NULL; /* small-order component in A_i or R_i */
+  unsigned char last_ed_pubkey[32];
+  int last_a_torsion = -1;
+  unsigned long max_msg_len = 0;
+  unsigned long i;
+  int all_valid = 1;
+  ge_p3 point;
+  ge_p3 check;
+  ge_p2 check_p2;
+
+  if (count == 0)
+    return 0;
+
+  for (i = 0; i < count; i++) {
+    if (msg_lens[i] > max_msg_len)
+      max_msg_len = msg_lens[i];
+  }
+
+  if (count < BATCH_VERIFY_MIN ||
+      (mont_x = malloc(count * sizeof(fe))) == 0 ||
+      (prefix = malloc(count * sizeof(fe))) == 0 ||
+      (scalars = calloc(2 * count + 1, 32)) == 0 ||
+      (points = malloc((2 * count + 1) * sizeof(ge_cached))) == 0 ||
+      (hashbuf = malloc(max_msg_len + 64)) == 0 ||
+      (failed = calloc(count, 1)) == 0 ||
+      (torsion = calloc(count, 1)) == 0) {
+    verify_each(results, signatures, curve25519_pubkeys, msgs, msg_lens,
+                count, NULL);
+    goto done;
+  }
+
+  /* 1. Invert every mont_x + 1 with a single fe_invert (Montgomery's trick).
+        mont_x = -1 maps to 0 like fe_invert does in curve25519_verify(). */
+  fe_1(one);
+  fe_1(acc);
+  for (i = 0; i < count; i++) {
+    fe_frombytes(mont_x[i], curve25519_pubkeys[i]);
+    fe_add(tmp, mont_x[i], one);
+    fe_copy(prefix[i], acc);
+    if (fe_isnonzero(tmp))
+      fe_mul(acc, acc, tmp);
+  }
+  fe_invert(inv, acc);
+
+  for (i = count; i-- > 0; ) {
+    fe x_minus_one;
+    unsigned char ed_pubkey[32];
+    unsigned char hram[64];
+    unsigned char z[32];
+    unsigned char s[32];
+    unsigned char seed[72];
+    int j;
+
+    fe_add(tmp, mont_x[i], one);
+    fe_sub(x_minus_one, mont_x[i], one);
+    if (fe_isnonzero(tmp)) {
+      fe_mul(ed_y, inv, prefix[i]); /* 1 / (mont_x + 1) */
+      fe_mul(inv, inv, tmp);
+      fe_mul(ed_y, x_minus_one, ed_y);
+    } else {
+      fe_0(ed_y);
+    }
+
+    /* 2. Same pubkey conversion and checks as curve25519_verify() */
+    fe_tobytes(ed_pubkey, ed_y);
+    ed_pubkey[31] &= 0x7F;
+    ed_pubkey[31] |= (signatures[i][63] & 0x80);
+
+    /* Failed signatures keep zero scalars, so their points are never read */
+    if (signatures[i][63] & 0x60) {
+      failed[i] = 1;
+      continue;
+    }
+    if (ge_frombytes_negate_vartime(&point, ed_pubkey) != 0) {
+      failed[i] = 1;
+      continue;
+    }
+    ge_p3_to_cached(&points[1 + 2 * i], &point);
+    if (last_a_torsion < 0 || memcmp(ed_pubkey, last_ed_pubkey, 32) != 0) {
+      memmove(last_ed_pubkey, ed_pubkey, 32);
+      last_a_torsion = ge_p3_has_torsion(&point);
+    }
+    torsion[i] = (unsigned char)last_a_torsion;
+
+    if (r_frombytes_negate_vartime(&point, signatures[i]) != 0) {
+      failed[i] = 1;
+      continue;
+    }
+    ge_p3_to_cached(&points[2 + 2 * i], &point);
+    if (!torsion[i])
+      torsion[i] = (unsigned char)ge_p3_has_torsion(&point);
+
+    /* 3. h_i = SHA512(R || A || M) and z_i = SHA512(random || i)[0..15] */
+    memmove(hashbuf, signatures[i], 32);
+    memmove(hashbuf + 32, ed_pubkey, 32);
+    memmove(hashbuf + 64, msgs[i], msg_lens[i]);
+    crypto_hash_sha512(hram, hashbuf, 64 + msg_lens[i]);
+    sc_reduce(hram);
+
+    memmove(seed, random, 64);
+    for (j = 0; j < 8; j++)
+      seed[64 + j] = (unsigned char)((unsigned long long)i >> (8 * j));
+    crypto_hash_sha512(hashbuf, seed, sizeof(seed));
+    memset(z, 0, 32);
+    memmove(z, hashbuf, 16);
+
+    /* 4. Scalars for -A_i, -R_i and the accumulated S for B.  Reducing
+          z_i * h_i mod q only changes the small-order part of the sum,
+          which the cofactor removes below. */
+    sc_muladd(scalars + 32 * (1 + 2 * i), z, hram, zero);
+    memmove(scalars + 32 * (2 + 2 * i), z, 32);
+    memmove(s, signatures[i] + 32, 32);
+    s[31] &= 0x7F; /* the pubkey sign bit, not part of S */
+    sc_muladd(scalars, z, s, scalars);
+  }
+
+  for (i = 0; i < count; i++) {
+    if (failed[i])
+      all_valid = 0;
+  }
+
+  /* 5. check = (sum z_i S_i) B + sum (z_i h_i)(-A_i) + sum z_i (-R_i),
+        which must vanish once multiplied by the cofactor */
+  ge_frombytes_negate_vartime(&point, base_point);
+  fe_neg(point.X, point.X);
+  fe_neg(point.T, point.T);
+  ge_p3_to_cached(&points[0], &point);
+  ge_multi_scalarmult_vartime(&check, scalars, points, 2 * count + 1);
+  ge_p3_to_p2(&check_p2, &check);
+
+  if (ge_p2_is_small_order(&check_p2)) {
+    /* Every decoded signature passes the cofactored equation, so
+       S_i * B - h_i * A_i - R_i is at most a small-order point.  It is zero,
+       as curve25519_verify() requires, unless A_i or R_i has a small-order
+       component; those signatures are checked again on their own. */
+    for (i = 0; i < count; i++) {
+      results[i] = failed[i] ? -1 : 0;
+      if (!torsion[i])
+        failed[i] = 1;
+    }
+    verify_each(results, signatures, curve25519_pubkeys, msgs, msg_lens,
+                count, failed);
+  } else {
+    for (i = 0; i < count; i++)
+      results[i] = -1;
+    verify_each(results, signatures, curve25519_pubkeys, msgs, msg_lens,
+                count, failed);
+  }
+
+done:
+  for (i = 0; i < count; i++) {
+    if (results[i] != 0)
+      all_valid = 0;
+  }
+
+  free(mont_x);
+  free(prefix);
+  free(scalars);
+  free(points);
+  free(hashbuf);
+  free(failed);
+  free(torsion);
+
+  return all_valid ? 0 : -1;
+}
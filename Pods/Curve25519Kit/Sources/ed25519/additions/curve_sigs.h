@@ -16,6 +16,30 @@ int curve25519_verify(const unsigned char* signature, /* 64 bytes */
                       const unsigned char* curve25519_pubkey, /* 32 bytes */
                       const unsigned char* msg, const unsigned long msg_len);
 
+/* Verifies count signatures at once, with the same results as
+   curve25519_verify() on each.  The signatures are first checked with a
+   random linear combination of the cofactored verification equations,
+
+     8 * sum(z_i * (S_i * B - h_i * A_i - R_i)) == 0
+
+   evaluated as a single multi-scalar multiplication, where the 128-bit
+   z_i are derived from random.  curve25519_verify() does not ignore
+   small-order components, so a signature whose A_i or R_i has one is still
+   verified on its own.  If the combined check fails, every signature is
+   verified with curve25519_verify() so results identifies the bad ones.
+
+   results : count ints, set to 0 for a valid signature, -1 otherwise
+   random  : 64 bytes random; must not be predictable by the signers
+
+   returns 0 if all signatures are valid */
+int curve25519_verify_batch(int* results, /* count ints */
+                            const unsigned char* const* signatures, /* 64 bytes each */
+                            const unsigned char* const* curve25519_pubkeys, /* 32 bytes each */
+                            const unsigned char* const* msgs,
+                            const unsigned long* msg_lens,
+                            const unsigned long count,
+                            const unsigned char* random); /* 64 bytes */
+
 /* helper function - modified version of crypto_sign() to use 
    explicit private key.  In particular:
 
@@ -1,6 +1,28 @@
 #ifndef FE_H
 #define FE_H
 
+/*
+Field arithmetic backend, chosen at compile time:
+
+ED25519_FE51:    5 limbs of 51 bits with 128-bit products,
+                 the default on 64-bit targets with unsigned __int128.
+ED25519_FE_REF10: the original 10 limbs of 25.5 bits, for 32-bit targets.
+                 Define it to force this backend everywhere.
+
+The ref10 fe_*.c files define FE_REF10 before including this header,
+so both backends are always built where the 64-bit one is available.
+*/
+#if !defined(ED25519_FE51) && !defined(ED25519_FE_REF10) && \
+    defined(__SIZEOF_INT128__) && (defined(__x86_64__) || defined(__aarch64__))
+#define ED25519_FE51
+#endif
+
+#if defined(ED25519_FE51) && !defined(FE_REF10)
+
+#include "fe51.h"
+
+#else
+
 #include "crypto_int32.h"
 
 typedef crypto_int32 fe[10];
@@ -54,3 +76,5 @@ extern void fe_invert(fe,const fe);
 extern void fe_pow22523(fe,const fe);
 
 #endif
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef FE51_H
+#define FE51_H
+
+#include "crypto_uint64.h"
+
+typedef crypto_uint64 fe[5];
+
+/*
+fe means field element.
+Here the field is \Z/(2^255-19).
+An element t, entries t[0]...t[4], represents the integer
+t[0]+2^51 t[1]+2^102 t[2]+2^153 t[3]+2^204 t[4].
+Entries are unsigned; each is below 2^52 after fe_mul, fe_sq, fe_sq2,
+fe_sub, fe_neg and fe_frombytes, and below 2^53 after fe_add.
+*/
+
+typedef unsigned __int128 crypto_uint128;
+
+#define fe_frombytes crypto_sign_ed25519_fe51_frombytes
+#define fe_tobytes crypto_sign_ed25519_fe51_tobytes
+#define fe_copy crypto_sign_ed25519_fe51_copy
+#define fe_isnonzero crypto_sign_ed25519_fe51_isnonzero
+#define fe_isnegative crypto_sign_ed25519_fe51_isnegative
+#define fe_0 crypto_sign_ed25519_fe51_0
+#define fe_1 crypto_sign_ed25519_fe51_1
+#define fe_cmov crypto_sign_ed25519_fe51_cmov
+#define fe_add crypto_sign_ed25519_fe51_add
+#define fe_sub crypto_sign_ed25519_fe51_sub
+#define fe_neg crypto_sign_ed25519_fe51_neg
+#define fe_mul crypto_sign_ed25519_fe51_mul
+#define fe_sq crypto_sign_ed25519_fe51_sq
+#define fe_sq2 crypto_sign_ed25519_fe51_sq2
+#define fe_invert crypto_sign_ed25519_fe51_invert
+#define fe_pow22523 crypto_sign_ed25519_fe51_pow22523
+
+extern void fe_frombytes(fe,const unsigned char *);
+extern void fe_tobytes(unsigned char *,const fe);
+
+extern void fe_copy(fe,const fe);
+extern int fe_isnonzero(const fe);
+extern int fe_isnegative(const fe);
+extern void fe_0(fe);
+extern void fe_1(fe);
+extern void fe_cmov(fe,const fe,unsigned int);
+
+extern void fe_add(fe,const fe,const fe);
+extern void fe_sub(fe,const fe,const fe);
+extern void fe_neg(fe,const fe);
+extern void fe_mul(fe,const fe,const fe);
+extern void fe_sq(fe,const fe);
+extern void fe_sq2(fe,const fe);
+extern void fe_invert(fe,const fe);
+extern void fe_pow22523(fe,const fe);
+
+#endif
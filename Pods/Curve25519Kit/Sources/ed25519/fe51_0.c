@@ -0,0 +1,18 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = 0
+*/
+
+void fe_0(fe h)
+{
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+#endif
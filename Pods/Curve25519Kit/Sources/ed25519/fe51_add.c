@@ -0,0 +1,25 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = f + g
+Can overlap h with f or g.
+
+Preconditions:
+   f[i], g[i] bounded by 2^52.
+
+Postconditions:
+   h[i] bounded by 2^53.
+*/
+
+void fe_add(fe h,const fe f,const fe g)
+{
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+#endif
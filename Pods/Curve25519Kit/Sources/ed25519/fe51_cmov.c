@@ -0,0 +1,23 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+Replace (f,g) with (g,g) if b == 1;
+replace (f,g) with (f,g) if b == 0.
+
+Preconditions: b in {0,1}.
+*/
+
+void fe_cmov(fe f,const fe g,unsigned int b)
+{
+  crypto_uint64 mask = - (crypto_uint64) b;
+
+  f[0] ^= (f[0] ^ g[0]) & mask;
+  f[1] ^= (f[1] ^ g[1]) & mask;
+  f[2] ^= (f[2] ^ g[2]) & mask;
+  f[3] ^= (f[3] ^ g[3]) & mask;
+  f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = f
+*/
+
+void fe_copy(fe h,const fe f)
+{
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+#endif
@@ -0,0 +1,18 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+void fe_invert(fe out,const fe z)
+{
+  fe t0;
+  fe t1;
+  fe t2;
+  fe t3;
+  int i;
+
+#include "pow225521.h"
+
+  return;
+}
+
+#endif
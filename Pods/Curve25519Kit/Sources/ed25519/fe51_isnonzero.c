@@ -0,0 +1,23 @@
+#include "fe.h"
+#include "crypto_verify_32.h"
+
+#ifdef ED25519_FE51
+
+/*
+return 1 if f == 0
+return 0 if f != 0
+
+Preconditions:
+   f[i] bounded by 2^54.
+*/
+
+static const unsigned char zero[32];
+
+int fe_isnonzero(const fe f)
+{
+  unsigned char s[32];
+  fe_tobytes(s,f);
+  return crypto_verify_32(s,zero);
+}
+
+#endif
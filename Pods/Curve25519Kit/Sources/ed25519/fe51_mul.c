@@ -0,0 +1,83 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = f * g
+Can overlap h with f or g.
+
+Preconditions:
+   f[i], g[i] bounded by 2^54.
+
+Postconditions:
+   h[i] bounded by 2^52.
+*/
+
+/*
+Notes on implementation strategy:
+
+Using schoolbook multiplication with 64x64->128-bit products.
+Limbs above 2^255 wrap around as 19 times the low limbs,
+so g1..g4 are premultiplied by 19 (still below 2^59).
+
+Each column sum is below 5 * 2^54 * 2^59 < 2^116, so the carry out
+of the top limb can exceed 64 bits; the whole chain stays in 128 bits.
+*/
+
+void fe_mul(fe h,const fe f,const fe g)
+{
+  const crypto_uint64 mask = (((crypto_uint64) 1) << 51) - 1;
+  crypto_uint64 f0 = f[0];
+  crypto_uint64 f1 = f[1];
+  crypto_uint64 f2 = f[2];
+  crypto_uint64 f3 = f[3];
+  crypto_uint64 f4 = f[4];
+  crypto_uint64 g0 = g[0];
+  crypto_uint64 g1 = g[1];
+  crypto_uint64 g2 = g[2];
+  crypto_uint64 g3 = g[3];
+  crypto_uint64 g4 = g[4];
+  crypto_uint64 g1_19 = 19 * g1;
+  crypto_uint64 g2_19 = 19 * g2;
+  crypto_uint64 g3_19 = 19 * g3;
+  crypto_uint64 g4_19 = 19 * g4;
+  crypto_uint128 h0;
+  crypto_uint128 h1;
+  crypto_uint128 h2;
+  crypto_uint128 h3;
+  crypto_uint128 h4;
+  crypto_uint64 r0;
+  crypto_uint64 r1;
+  crypto_uint64 r2;
+  crypto_uint64 r3;
+  crypto_uint64 r4;
+
+  h0 = (crypto_uint128) f0 * g0 + (crypto_uint128) f1 * g4_19 + (crypto_uint128) f2 * g3_19
+     + (crypto_uint128) f3 * g2_19 + (crypto_uint128) f4 * g1_19;
+  h1 = (crypto_uint128) f0 * g1 + (crypto_uint128) f1 * g0 + (crypto_uint128) f2 * g4_19
+     + (crypto_uint128) f3 * g3_19 + (crypto_uint128) f4 * g2_19;
+  h2 = (crypto_uint128) f0 * g2 + (crypto_uint128) f1 * g1 + (crypto_uint128) f2 * g0
+     + (crypto_uint128) f3 * g4_19 + (crypto_uint128) f4 * g3_19;
+  h3 = (crypto_uint128) f0 * g3 + (crypto_uint128) f1 * g2 + (crypto_uint128) f2 * g1
+     + (crypto_uint128) f3 * g0 + (crypto_uint128) f4 * g4_19;
+  h4 = (crypto_uint128) f0 * g4 + (crypto_uint128) f1 * g3 + (crypto_uint128) f2 * g2
+     + (crypto_uint128) f3 * g1 + (crypto_uint128) f4 * g0;
+
+  r0 = (crypto_uint64) h0 & mask; h1 += h0 >> 51;
+  r1 = (crypto_uint64) h1 & mask; h2 += h1 >> 51;
+  r2 = (crypto_uint64) h2 & mask; h3 += h2 >> 51;
+  r3 = (crypto_uint64) h3 & mask; h4 += h3 >> 51;
+  r4 = (crypto_uint64) h4 & mask;
+
+  h0 = r0 + (h4 >> 51) * 19;
+  r0 = (crypto_uint64) h0 & mask;
+  r1 += (crypto_uint64) (h0 >> 51);
+
+  h[0] = r0;
+  h[1] = r1;
+  h[2] = r2;
+  h[3] = r3;
+  h[4] = r4;
+}
+
+#endif
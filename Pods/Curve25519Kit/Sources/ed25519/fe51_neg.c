@@ -0,0 +1,23 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = -f
+
+Preconditions:
+   f[i] bounded by 2^53.
+
+Postconditions:
+   h[i] bounded by 2^52.
+*/
+
+void fe_neg(fe h,const fe f)
+{
+  fe zero;
+
+  fe_0(zero);
+  fe_sub(h,zero,f);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+void fe_pow22523(fe out,const fe z)
+{
+  fe t0;
+  fe t1;
+  fe t2;
+  int i;
+
+#include "pow22523.h"
+
+  return;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = 2 * f * f
+Can overlap h with f.
+
+Preconditions:
+   f[i] bounded by 2^54.
+
+Postconditions:
+   h[i] bounded by 2^52.
+*/
+
+/*
+See fe51_mul.c for discussion of implementation strategy.
+*/
+
+void fe_sq2(fe h,const fe f)
+{
+  const crypto_uint64 mask = (((crypto_uint64) 1) << 51) - 1;
+  crypto_uint64 f0 = f[0];
+  crypto_uint64 f1 = f[1];
+  crypto_uint64 f2 = f[2];
+  crypto_uint64 f3 = f[3];
+  crypto_uint64 f4 = f[4];
+  crypto_uint64 f0_2 = 2 * f0;
+  crypto_uint64 f1_2 = 2 * f1;
+  crypto_uint64 f1_38 = 38 * f1;
+  crypto_uint64 f2_38 = 38 * f2;
+  crypto_uint64 f3_19 = 19 * f3;
+  crypto_uint64 f3_38 = 38 * f3;
+  crypto_uint64 f4_19 = 19 * f4;
+  crypto_uint128 h0;
+  crypto_uint128 h1;
+  crypto_uint128 h2;
+  crypto_uint128 h3;
+  crypto_uint128 h4;
+  crypto_uint64 r0;
+  crypto_uint64 r1;
+  crypto_uint64 r2;
+  crypto_uint64 r3;
+  crypto_uint64 r4;
+
+  h0 = (crypto_uint128) f0 * f0 + (crypto_uint128) f1_38 * f4 + (crypto_uint128) f2_38 * f3;
+  h1 = (crypto_uint128) f0_2 * f1 + (crypto_uint128) f2_38 * f4 + (crypto_uint128) f3_19 * f3;
+  h2 = (crypto_uint128) f0_2 * f2 + (crypto_uint128) f1 * f1 + (crypto_uint128) f3_38 * f4;
+  h3 = (crypto_uint128) f0_2 * f3 + (crypto_uint128) f1_2 * f2 + (crypto_uint128) f4_19 * f4;
+  h4 = (crypto_uint128) f0_2 * f4 + (crypto_uint128) f1_2 * f3 + (crypto_uint128) f2 * f2;
+
+  h0 += h0;
+  h1 += h1;
+  h2 += h2;
+  h3 += h3;
+  h4 += h4;
+
+  r0 = (crypto_uint64) h0 & mask; h1 += h0 >> 51;
+  r1 = (crypto_uint64) h1 & mask; h2 += h1 >> 51;
+  r2 = (crypto_uint64) h2 & mask; h3 += h2 >> 51;
+  r3 = (crypto_uint64) h3 & mask; h4 += h3 >> 51;
+  r4 = (crypto_uint64) h4 & mask;
+
+  h0 = r0 + (h4 >> 51) * 19;
+  r0 = (crypto_uint64) h0 & mask;
+  r1 += (crypto_uint64) (h0 >> 51);
+
+  h[0] = r0;
+  h[1] = r1;
+  h[2] = r2;
+  h[3] = r3;
+  h[4] = r4;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+h = f - g
+Can overlap h with f or g.
+
+Preconditions:
+   f[i], g[i] bounded by 2^53.
+
+Postconditions:
+   h[i] bounded by 2^52.
+*/
+
+/*
+g is carried first so every limb is below 2^51 + 4 * 19,
+then subtracted from f + 4p so that no limb goes negative.
+*/
+
+void fe_sub(fe h,const fe f,const fe g)
+{
+  const crypto_uint64 mask = (((crypto_uint64) 1) << 51) - 1;
+  crypto_uint64 g0 = g[0];
+  crypto_uint64 g1 = g[1];
+  crypto_uint64 g2 = g[2];
+  crypto_uint64 g3 = g[3];
+  crypto_uint64 g4 = g[4];
+  crypto_uint64 h0;
+  crypto_uint64 h1;
+  crypto_uint64 h2;
+  crypto_uint64 h3;
+  crypto_uint64 h4;
+
+  g1 += g0 >> 51; g0 &= mask;
+  g2 += g1 >> 51; g1 &= mask;
+  g3 += g2 >> 51; g2 &= mask;
+  g4 += g3 >> 51; g3 &= mask;
+  g0 += (g4 >> 51) * 19; g4 &= mask;
+
+  h0 = f[0] + 0x1fffffffffffb4ULL - g0;
+  h1 = f[1] + 0x1ffffffffffffcULL - g1;
+  h2 = f[2] + 0x1ffffffffffffcULL - g2;
+  h3 = f[3] + 0x1ffffffffffffcULL - g3;
+  h4 = f[4] + 0x1ffffffffffffcULL - g4;
+
+  h1 += h0 >> 51; h0 &= mask;
+  h2 += h1 >> 51; h1 &= mask;
+  h3 += h2 >> 51; h2 &= mask;
+  h4 += h3 >> 51; h3 &= mask;
+  h0 += (h4 >> 51) * 19; h4 &= mask;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+#endif
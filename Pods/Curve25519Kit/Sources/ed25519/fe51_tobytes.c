@@ -0,0 +1,85 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+Preconditions:
+  h[i] bounded by 2^54.
+
+Carry h down to limbs below 2^51, which leaves 0 <= h < 2p.
+Then q = 1 exactly when h + 19 >= 2^255, i.e. h >= p,
+and h + 19q - 2^255 q is the canonical representative.
+*/
+
+void fe_tobytes(unsigned char *s,const fe h)
+{
+  const crypto_uint64 mask = (((crypto_uint64) 1) << 51) - 1;
+  crypto_uint64 h0 = h[0];
+  crypto_uint64 h1 = h[1];
+  crypto_uint64 h2 = h[2];
+  crypto_uint64 h3 = h[3];
+  crypto_uint64 h4 = h[4];
+  crypto_uint64 q;
+
+  h1 += h0 >> 51; h0 &= mask;
+  h2 += h1 >> 51; h1 &= mask;
+  h3 += h2 >> 51; h2 &= mask;
+  h4 += h3 >> 51; h3 &= mask;
+  h0 += (h4 >> 51) * 19; h4 &= mask;
+
+  h1 += h0 >> 51; h0 &= mask;
+  h2 += h1 >> 51; h1 &= mask;
+  h3 += h2 >> 51; h2 &= mask;
+  h4 += h3 >> 51; h3 &= mask;
+  h0 += (h4 >> 51) * 19; h4 &= mask;
+
+  q = (h0 + 19) >> 51;
+  q = (h1 + q) >> 51;
+  q = (h2 + q) >> 51;
+  q = (h3 + q) >> 51;
+  q = (h4 + q) >> 51;
+
+  h0 += 19 * q;
+
+  h1 += h0 >> 51; h0 &= mask;
+  h2 += h1 >> 51; h1 &= mask;
+  h3 += h2 >> 51; h2 &= mask;
+  h4 += h3 >> 51; h3 &= mask;
+  /* Goal: Output h0+...+2^204 h4-2^255 q, which is between 0 and 2^255-20. */
+  h4 &= mask;
+
+  s[0] = h0 >> 0;
+  s[1] = h0 >> 8;
+  s[2] = h0 >> 16;
+  s[3] = h0 >> 24;
+  s[4] = h0 >> 32;
+  s[5] = h0 >> 40;
+  s[6] = (h0 >> 48) | (h1 << 3);
+  s[7] = h1 >> 5;
+  s[8] = h1 >> 13;
+  s[9] = h1 >> 21;
+  s[10] = h1 >> 29;
+  s[11] = h1 >> 37;
+  s[12] = (h1 >> 45) | (h2 << 6);
+  s[13] = h2 >> 2;
+  s[14] = h2 >> 10;
+  s[15] = h2 >> 18;
+  s[16] = h2 >> 26;
+  s[17] = h2 >> 34;
+  s[18] = h2 >> 42;
+  s[19] = (h2 >> 50) | (h3 << 1);
+  s[20] = h3 >> 7;
+  s[21] = h3 >> 15;
+  s[22] = h3 >> 23;
+  s[23] = h3 >> 31;
+  s[24] = h3 >> 39;
+  s[25] = (h3 >> 47) | (h4 << 4);
+  s[26] = h4 >> 4;
+  s[27] = h4 >> 12;
+  s[28] = h4 >> 20;
+  s[29] = h4 >> 28;
+  s[30] = h4 >> 36;
+  s[31] = h4 >> 44;
+}
+
+#endif
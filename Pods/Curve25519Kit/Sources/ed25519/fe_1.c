@@ -1,3 +1,4 @@
+#define FE_REF10
 #include "fe.h"
 
 /*
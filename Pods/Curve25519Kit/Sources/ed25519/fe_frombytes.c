@@ -1,3 +1,4 @@
+#define FE_REF10
 #include "fe.h"
 #include "crypto_int64.h"
 #include "crypto_uint64.h"
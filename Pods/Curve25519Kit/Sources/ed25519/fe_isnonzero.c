@@ -1,3 +1,4 @@
+#define FE_REF10
 #include "fe.h"
 #include "crypto_verify_32.h"
 
@@ -1,3 +1,4 @@
+#define FE_REF10
 #include "fe.h"
 
 void fe_pow22523(fe out,const fe z)
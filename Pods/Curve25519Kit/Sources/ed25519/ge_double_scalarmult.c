@@ -33,7 +33,11 @@ static void slide(signed char *r,const unsigned char *a)
 }
 
 static ge_precomp Bi[8] = {
+#ifdef ED25519_FE51
+#include "base2_51.h"
+#else
 #include "base2.h"
+#endif
 } ;
 
 /*
@@ -0,0 +1,123 @@
+#include "ge.h"
+
+/* Largest bucket window; 2^6 ge_p3 buckets keep the stack frame near 10 KB */
+#define MAX_WINDOW_BITS 6
+
+/*
+Picks the window width c minimising the Pippenger cost estimate
+ceil(256/c) * (n + 2^(c+1)) point additions.
+*/
+
+static int window_bits(unsigned long n)
+{
+  int c;
+  int best = 1;
+  unsigned long best_cost = (unsigned long) -1;
+
+  for (c = 1;c <= MAX_WINDOW_BITS;++c) {
+    unsigned long windows = (256 + c - 1) / c;
+    unsigned long cost = windows * (n + (2UL << c));
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = c;
+    }
+  }
+  return best;
+}
+
+/* bits [bit, bit + c) of the little-endian 256-bit scalar s */
+
+static int scalar_window(const unsigned char *s,int bit,int c)
+{
+  int i = bit >> 3;
+  unsigned int w = s[i];
+  if (i + 1 < 32) w |= ((unsigned int) s[i + 1]) << 8;
+  return (w >> (bit & 7)) & ((1 << c) - 1);
+}
+
+static void add_p3(ge_p3 *r,const ge_p3 *q)
+{
+  ge_cached c;
+  ge_p1p1 t;
+
+  ge_p3_to_cached(&c,q);
+  ge_add(&t,r,&c);
+  ge_p1p1_to_p3(r,&t);
+}
+
+/*
+r = scalars[0] * points[0] + ... + scalars[n-1] * points[n-1]
+where scalars[i] is the 32-byte little-endian integer at scalars + 32 * i.
+
+Pippenger's bucket method: every c-bit window costs one addition per point
+plus about 2^(c+1) additions to sum the buckets, instead of a full
+double-and-add ladder per point. Not constant time; only for public inputs
+such as signature verification.
+*/
+
+void ge_multi_scalarmult_vartime(ge_p3 *r,const unsigned char *scalars,const ge_cached *points,unsigned long n)
+{
+  ge_p3 buckets[1 << MAX_WINDOW_BITS];
+  unsigned char used[1 << MAX_WINDOW_BITS];
+  ge_p3 running;
+  ge_p3 window_sum;
+  ge_p2 p2;
+  ge_p1p1 t;
+  unsigned long i;
+  int c = window_bits(n);
+  int nbuckets = 1 << c;
+  int w;
+  int b;
+  int k;
+  int started = 0;
+
+  ge_p3_0(r);
+
+  for (w = ((256 + c - 1) / c - 1) * c;w >= 0;w -= c) {
+    int any = 0;
+
+    if (started) {
+      ge_p3_to_p2(&p2,r);
+      for (k = 1;k < c;++k) {
+        ge_p2_dbl(&t,&p2);
+        ge_p1p1_to_p2(&p2,&t);
+      }
+      ge_p2_dbl(&t,&p2);
+      ge_p1p1_to_p3(r,&t);
+    }
+
+    for (b = 1;b < nbuckets;++b) used[b] = 0;
+
+    for (i = 0;i < n;++i) {
+      int d = scalar_window(scalars + 32 * i,w,c);
+      if (!d) continue;
+      if (!used[d]) {
+        ge_p3_0(&buckets[d]);
+        used[d] = 1;
+        any = 1;
+      }
+      ge_add(&t,&buckets[d],&points[i]);
+      ge_p1p1_to_p3(&buckets[d],&t);
+    }
+
+    if (!any) continue;
+
+    /* window_sum = sum of b * buckets[b], as a running sum from the top */
+    k = 0;
+    for (b = nbuckets - 1;b >= 1;--b) {
+      if (used[b]) {
+        if (k) add_p3(&running,&buckets[b]);
+        else running = buckets[b];
+      }
+      if (k) add_p3(&window_sum,&running);
+      else if (used[b]) {
+        window_sum = running;
+        k = 1;
+      }
+    }
+
+    if (started) add_p3(r,&window_sum);
+    else *r = window_sum;
+    started = 1;
+  }
+}
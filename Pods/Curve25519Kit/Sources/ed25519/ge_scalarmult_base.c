@@ -28,7 +28,11 @@ static void cmov(ge_precomp *t,ge_precomp *u,unsigned char b)
 
 /* base[i][j] = (j+1)*256^i*B */
 static ge_precomp base[32][8] = {
+#ifdef ED25519_FE51
+#include "base_51.h"
+#else
 #include "base.h"
+#endif
 } ;
 
 static void select(ge_precomp *t,int pos,signed char b)
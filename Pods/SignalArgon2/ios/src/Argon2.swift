@@ -139,6 +139,24 @@ public enum Argon2 {
         public static let latest = Version(rawValue: ARGON2_VERSION_NUMBER.rawValue)!
     }
 
+    /// A set of worker threads that stays alive across hashes, so that hashing
+    /// with multiple lanes does not create and join threads for every segment.
+    public final class WorkerPool {
+        fileprivate let pool: OpaquePointer
+
+        /// Creates a pool of `threads` workers, including the calling thread.
+        ///
+        /// - Returns: `nil` if the threads could not be created.
+        public init?(threads: UInt32) {
+            guard let pool = argon2_pool_create(threads) else { return nil }
+            self.pool = pool
+        }
+
+        deinit {
+            argon2_pool_destroy(pool)
+        }
+    }
+
     /// Hashes a password with Argon2
     ///
     /// - Parameters:
@@ -150,6 +168,7 @@ public enum Argon2 {
     ///     - desiredLength: The desired length of the resulting hash
     ///     - variant: The argon2 variant to use
     ///     - version: The argon2 version to use
+    ///     - pool: Optional worker pool to run the lanes on instead of spawning threads
     ///
     /// - Returns: A tuple containing the raw hash value and encoded hash for the given input parameters.
     /// - Throws: `Argon2.Error` if the input parameters are invalid or hashing fails.
@@ -161,7 +180,8 @@ public enum Argon2 {
         salt: Data,
         desiredLength: Int,
         variant: Variant,
-        version: Version
+        version: Version,
+        pool: WorkerPool? = nil
     ) throws -> (raw: Data, encoded: String) {
         return try password.withUnsafeBytes { passwordBytes in
             return try salt.withUnsafeBytes { saltBytes in
@@ -178,7 +198,7 @@ public enum Argon2 {
                 var encodedBytes = [Int8](repeating: 0, count: encodedLength)
 
                 let result = hashData.withUnsafeMutableBytes { hashBytes in
-                    argon2_hash(
+                    argon2_hash_pool(
                         iterations, memoryInKiB,
                         threads,
                         passwordBytes.baseAddress,
@@ -190,7 +210,8 @@ public enum Argon2 {
                         &encodedBytes,
                         encodedBytes.count,
                         variant.argon2type,
-                        version.rawValue
+                        version.rawValue,
+                        pool?.pool
                     )
                 }
 
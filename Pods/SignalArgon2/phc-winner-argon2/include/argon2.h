@@ -217,6 +217,12 @@ typedef struct Argon2_Context {
     uint32_t flags; /* array of bool options */
 } argon2_context;
 
+/*
+ * Opaque handle to a persistent set of worker threads that can be shared by
+ * successive calls to argon2_ctx_pool and argon2_hash_pool.
+ */
+typedef struct Argon2_pool argon2_pool;
+
 /* Argon2 primitive type */
 typedef enum Argon2_type {
   Argon2_d = 0,
@@ -246,6 +252,34 @@ ARGON2_PUBLIC const char *argon2_type2string(argon2_type type, int uppercase);
  */
 ARGON2_PUBLIC int argon2_ctx(argon2_context *context, argon2_type type);
 
+/*
+ * Creates a worker pool whose threads live until argon2_pool_destroy. The
+ * thread calling argon2_ctx_pool counts as one of the @threads workers.
+ * @param threads Number of threads to run lanes on, including the caller
+ * @return The pool, or NULL if @threads is out of range, allocation or thread
+ * creation failed, or the library was built with ARGON2_NO_THREADS
+ */
+ARGON2_PUBLIC argon2_pool *argon2_pool_create(uint32_t threads);
+
+/*
+ * Stops and joins the pool threads. The pool must not be in use.
+ * @param pool Pool created with argon2_pool_create. May be NULL.
+ */
+ARGON2_PUBLIC void argon2_pool_destroy(argon2_pool *pool);
+
+/*
+ * Same as argon2_ctx, but fills the lanes of each slice on @pool instead of
+ * creating and joining threads for every segment. The pool size replaces
+ * @context->threads as the concurrency limit. Calls sharing one pool from
+ * several threads are serialised per sync point.
+ * @param  context  Pointer to the Argon2 internal structure
+ * @param  pool  Pool created with argon2_pool_create. If NULL this behaves
+ * exactly like argon2_ctx
+ * @return Error code if smth is wrong, ARGON2_OK otherwise
+ */
+ARGON2_PUBLIC int argon2_ctx_pool(argon2_context *context, argon2_type type,
+                                  argon2_pool *pool);
+
 /**
  * Hashes a password with Argon2i, producing an encoded hash
  * @param t_cost Number of iterations
@@ -327,6 +361,15 @@ ARGON2_PUBLIC int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
                               const size_t encodedlen, argon2_type type,
                               const uint32_t version);
 
+/* argon2_hash running the lanes on @pool, see argon2_ctx_pool */
+ARGON2_PUBLIC int argon2_hash_pool(const uint32_t t_cost, const uint32_t m_cost,
+                                   const uint32_t parallelism, const void *pwd,
+                                   const size_t pwdlen, const void *salt,
+                                   const size_t saltlen, void *hash,
+                                   const size_t hashlen, char *encoded,
+                                   const size_t encodedlen, argon2_type type,
+                                   const uint32_t version, argon2_pool *pool);
+
 /**
  * Verifies a password against an encoded string
  * Encoded string is restricted as in validate_inputs()
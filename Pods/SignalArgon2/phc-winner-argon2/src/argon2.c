@@ -37,6 +37,11 @@ const char *argon2_type2string(argon2_type type, int uppercase) {
 }
 
 int argon2_ctx(argon2_context *context, argon2_type type) {
+    return argon2_ctx_pool(context, type, NULL);
+}
+
+int argon2_ctx_pool(argon2_context *context, argon2_type type,
+                    argon2_pool *pool) {
     /* 1. Validate all inputs */
     int result = validate_inputs(context);
     uint32_t memory_blocks, segment_length;
@@ -71,6 +76,7 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     instance.lanes = context->lanes;
     instance.threads = context->threads;
     instance.type = type;
+    instance.pool = pool;
 
     if (instance.threads > instance.lanes) {
         instance.threads = instance.lanes;
@@ -104,6 +110,18 @@ int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
                 const size_t encodedlen, argon2_type type,
                 const uint32_t version){
 
+    return argon2_hash_pool(t_cost, m_cost, parallelism, pwd, pwdlen, salt,
+                            saltlen, hash, hashlen, encoded, encodedlen, type,
+                            version, NULL);
+}
+
+int argon2_hash_pool(const uint32_t t_cost, const uint32_t m_cost,
+                     const uint32_t parallelism, const void *pwd,
+                     const size_t pwdlen, const void *salt,
+                     const size_t saltlen, void *hash, const size_t hashlen,
+                     char *encoded, const size_t encodedlen, argon2_type type,
+                     const uint32_t version, argon2_pool *pool){
+
     argon2_context context;
     int result;
     uint8_t *out;
@@ -148,7 +166,7 @@ int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
     context.flags = ARGON2_DEFAULT_FLAGS;
     context.version = version;
 
-    result = argon2_ctx(&context, type);
+    result = argon2_ctx_pool(&context, type, pool);
 
     if (result != ARGON2_OK) {
         clear_internal_memory(out, hashlen);
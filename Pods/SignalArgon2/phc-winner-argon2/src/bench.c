@@ -0,0 +1,143 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : http://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+/*
+ * Compares argon2_hash, which creates and joins threads for every segment,
+ * with argon2_hash_pool on a persistent worker pool. Not part of the pod;
+ * build it on its own, e.g.
+ *
+ *   cc -O2 -Iinclude src/bench.c src/argon2.c src/core.c src/encoding.c \
+ *      src/thread.c src/opt.c src/ref.c src/blake2/blake2b.c -lpthread -o bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "argon2.h"
+
+#define BENCH_OUTLEN 32
+#define BENCH_PWD "password"
+#define BENCH_SALT "somesaltsomesalt"
+#define BENCH_SECONDS 1.0
+
+static double now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int hash(uint32_t t_cost, uint32_t m_cost, uint32_t lanes,
+                argon2_type type, argon2_pool *pool, uint8_t *out) {
+    if (pool == NULL) {
+        return argon2_hash(t_cost, m_cost, lanes, BENCH_PWD,
+                           strlen(BENCH_PWD), BENCH_SALT, strlen(BENCH_SALT),
+                           out, BENCH_OUTLEN, NULL, 0, type,
+                           ARGON2_VERSION_NUMBER);
+    }
+    return argon2_hash_pool(t_cost, m_cost, lanes, BENCH_PWD,
+                            strlen(BENCH_PWD), BENCH_SALT, strlen(BENCH_SALT),
+                            out, BENCH_OUTLEN, NULL, 0, type,
+                            ARGON2_VERSION_NUMBER, pool);
+}
+
+/* Hashes per second over BENCH_SECONDS of back-to-back calls */
+static double rate(uint32_t t_cost, uint32_t m_cost, uint32_t lanes,
+                   argon2_pool *pool) {
+    uint8_t out[BENCH_OUTLEN];
+    unsigned count = 0;
+    double start = now(), elapsed;
+
+    do {
+        if (hash(t_cost, m_cost, lanes, Argon2_id, pool, out) != ARGON2_OK) {
+            fprintf(stderr, "hashing failed\n");
+            exit(1);
+        }
+        count++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECONDS);
+
+    return count / elapsed;
+}
+
+/* The pool must not change the output */
+static int check_outputs(argon2_pool *pool) {
+    uint8_t expected[BENCH_OUTLEN], actual[BENCH_OUTLEN];
+    argon2_type type;
+    uint32_t lanes;
+
+    for (type = Argon2_d; type <= Argon2_id; type++) {
+        for (lanes = 1; lanes <= 8; lanes *= 2) {
+            if (hash(3, 1024, lanes, type, NULL, expected) != ARGON2_OK ||
+                hash(3, 1024, lanes, type, pool, actual) != ARGON2_OK ||
+                memcmp(expected, actual, BENCH_OUTLEN) != 0) {
+                printf("%s p=%u: pool output differs\n",
+                       argon2_type2string(type, 1), lanes);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    const uint32_t t_cost = 3;
+    const uint32_t m_costs[] = {64, 1024, 16384};
+    uint32_t threads = 4;
+    argon2_pool *pool;
+    size_t i;
+
+    if (argc > 1) {
+        threads = (uint32_t)strtoul(argv[1], NULL, 10);
+    }
+
+    pool = argon2_pool_create(threads);
+    if (pool == NULL) {
+        fprintf(stderr, "cannot create a pool of %u threads\n", threads);
+        return 1;
+    }
+
+    if (!check_outputs(pool)) {
+        argon2_pool_destroy(pool);
+        return 1;
+    }
+
+    printf("Argon2id t=%u p=%u, pool of %u threads (hashes/s)\n", t_cost,
+           threads, threads);
+    for (i = 0; i < sizeof(m_costs) / sizeof(m_costs[0]); i++) {
+        double spawn = rate(t_cost, m_costs[i], threads, NULL);
+        double pooled = rate(t_cost, m_costs[i], threads, pool);
+        printf("m=%5u KiB: argon2_hash %8.1f  argon2_hash_pool %8.1f\n",
+               m_costs[i], spawn, pooled);
+    }
+
+    argon2_pool_destroy(pool);
+    return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : http://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#ifndef BLAKE_ROUND_MKA_OPT_H
+#define BLAKE_ROUND_MKA_OPT_H
+
+/*
+ * SIMD versions of the BlaMka round from blamka-round-ref.h. Everything is a
+ * macro so that it expands inside the caller, which opt.c compiles with the
+ * matching target attribute; no instruction beyond SSE2 runs unless the CPU
+ * was checked first.
+ */
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+/* x + y + 2 * lo32(x) * lo32(y) on each 64-bit lane */
+#define fBlaMka_128(x, y)                                                      \
+    _mm_add_epi64(_mm_add_epi64((x), (y)),                                     \
+                  _mm_add_epi64(_mm_mul_epu32((x), (y)),                       \
+                                _mm_mul_epu32((x), (y))))
+
+/* Right rotations of each 64-bit lane, SSE2 only */
+#define rotr32_sse2(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_sse2(x)                                                         \
+    _mm_xor_si128(_mm_srli_epi64((x), 24), _mm_slli_epi64((x), 40))
+#define rotr16_sse2(x)                                                         \
+    _mm_shufflehi_epi16(_mm_shufflelo_epi16((x), _MM_SHUFFLE(0, 3, 2, 1)),    \
+                        _MM_SHUFFLE(0, 3, 2, 1))
+#define rotr63_sse2(x)                                                         \
+    _mm_xor_si128(_mm_srli_epi64((x), 63), _mm_add_epi64((x), (x)))
+
+/* Byte-shuffle rotations, SSSE3 */
+#define rotr32_ssse3(x) rotr32_sse2(x)
+#define rotr24_ssse3(x)                                                        \
+    _mm_shuffle_epi8((x), _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13,   \
+                                        14, 15, 8, 9, 10))
+#define rotr16_ssse3(x)                                                        \
+    _mm_shuffle_epi8((x), _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12,   \
+                                        13, 14, 15, 8, 9))
+#define rotr63_ssse3(x) rotr63_sse2(x)
+
+/*
+ * One 16-word BlaMka state is held in eight 128-bit registers:
+ * A0 = (v0, v1), A1 = (v2, v3), B0 = (v4, v5), ... D1 = (v14, v15).
+ * ISA is either sse2 or ssse3 and picks the rotations above.
+ */
+#define G1_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1)                            \
+    do {                                                                       \
+        A0 = fBlaMka_128(A0, B0);                                              \
+        A1 = fBlaMka_128(A1, B1);                                              \
+        D0 = rotr32_##ISA(_mm_xor_si128(D0, A0));                              \
+        D1 = rotr32_##ISA(_mm_xor_si128(D1, A1));                              \
+        C0 = fBlaMka_128(C0, D0);                                              \
+        C1 = fBlaMka_128(C1, D1);                                              \
+        B0 = rotr24_##ISA(_mm_xor_si128(B0, C0));                              \
+        B1 = rotr24_##ISA(_mm_xor_si128(B1, C1));                              \
+    } while ((void)0, 0)
+
+#define G2_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1)                            \
+    do {                                                                       \
+        A0 = fBlaMka_128(A0, B0);                                              \
+        A1 = fBlaMka_128(A1, B1);                                              \
+        D0 = rotr16_##ISA(_mm_xor_si128(D0, A0));                              \
+        D1 = rotr16_##ISA(_mm_xor_si128(D1, A1));                              \
+        C0 = fBlaMka_128(C0, D0);                                              \
+        C1 = fBlaMka_128(C1, D1);                                              \
+        B0 = rotr63_##ISA(_mm_xor_si128(B0, C0));                              \
+        B1 = rotr63_##ISA(_mm_xor_si128(B1, C1));                              \
+    } while ((void)0, 0)
+
+/* Moves the diagonals (v0, v5, v10, v15) ... into columns and back */
+#define DIAGONALIZE_sse2(A0, B0, C0, D0, A1, B1, C1, D1)                       \
+    do {                                                                       \
+        __m128i t0 = B0, t1 = D0;                                              \
+        B0 = _mm_unpackhi_epi64(B0, _mm_unpacklo_epi64(B1, B1));               \
+        B1 = _mm_unpackhi_epi64(B1, _mm_unpacklo_epi64(t0, t0));               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        D0 = _mm_unpackhi_epi64(D1, _mm_unpacklo_epi64(t1, t1));               \
+        D1 = _mm_unpackhi_epi64(t1, _mm_unpacklo_epi64(D1, D1));               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_sse2(A0, B0, C0, D0, A1, B1, C1, D1)                     \
+    do {                                                                       \
+        __m128i t0 = B0, t1 = D0;                                              \
+        B0 = _mm_unpackhi_epi64(B1, _mm_unpacklo_epi64(B0, B0));               \
+        B1 = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(B1, B1));               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        D0 = _mm_unpackhi_epi64(D0, _mm_unpacklo_epi64(D1, D1));               \
+        D1 = _mm_unpackhi_epi64(D1, _mm_unpacklo_epi64(t1, t1));               \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_ssse3(A0, B0, C0, D0, A1, B1, C1, D1)                      \
+    do {                                                                       \
+        __m128i t0 = _mm_alignr_epi8(B1, B0, 8);                               \
+        __m128i t1 = _mm_alignr_epi8(B0, B1, 8);                               \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm_alignr_epi8(D1, D0, 8);                                       \
+        t1 = _mm_alignr_epi8(D0, D1, 8);                                       \
+        D0 = t1;                                                               \
+        D1 = t0;                                                               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_ssse3(A0, B0, C0, D0, A1, B1, C1, D1)                    \
+    do {                                                                       \
+        __m128i t0 = _mm_alignr_epi8(B0, B1, 8);                               \
+        __m128i t1 = _mm_alignr_epi8(B1, B0, 8);                               \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm_alignr_epi8(D0, D1, 8);                                       \
+        t1 = _mm_alignr_epi8(D1, D0, 8);                                       \
+        D0 = t1;                                                               \
+        D1 = t0;                                                               \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_128(ISA, A0, A1, B0, B1, C0, C1, D0, D1)                  \
+    do {                                                                       \
+        G1_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1);                           \
+        G2_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1);                           \
+        DIAGONALIZE_##ISA(A0, B0, C0, D0, A1, B1, C1, D1);                     \
+        G1_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1);                           \
+        G2_128(ISA, A0, B0, C0, D0, A1, B1, C1, D1);                           \
+        UNDIAGONALIZE_##ISA(A0, B0, C0, D0, A1, B1, C1, D1);                   \
+    } while ((void)0, 0)
+
+/* AVX2: each 256-bit register holds four 64-bit words */
+#define fBlaMka_256(x, y)                                                      \
+    _mm256_add_epi64(_mm256_add_epi64((x), (y)),                               \
+                     _mm256_add_epi64(_mm256_mul_epu32((x), (y)),              \
+                                      _mm256_mul_epu32((x), (y))))
+
+#define rotr32_avx2(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_avx2(x)                                                         \
+    _mm256_shuffle_epi8((x), _mm256_setr_epi8(                                 \
+                                 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15,   \
+                                 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12,     \
+                                 13, 14, 15, 8, 9, 10))
+#define rotr16_avx2(x)                                                         \
+    _mm256_shuffle_epi8((x), _mm256_setr_epi8(                                 \
+                                 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14,   \
+                                 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11,     \
+                                 12, 13, 14, 15, 8, 9))
+#define rotr63_avx2(x)                                                         \
+    _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define G1_256(A0, B0, C0, D0, A1, B1, C1, D1)                                 \
+    do {                                                                       \
+        A0 = fBlaMka_256(A0, B0);                                              \
+        A1 = fBlaMka_256(A1, B1);                                              \
+        D0 = rotr32_avx2(_mm256_xor_si256(D0, A0));                            \
+        D1 = rotr32_avx2(_mm256_xor_si256(D1, A1));                            \
+        C0 = fBlaMka_256(C0, D0);                                              \
+        C1 = fBlaMka_256(C1, D1);                                              \
+        B0 = rotr24_avx2(_mm256_xor_si256(B0, C0));                            \
+        B1 = rotr24_avx2(_mm256_xor_si256(B1, C1));                            \
+    } while ((void)0, 0)
+
+#define G2_256(A0, B0, C0, D0, A1, B1, C1, D1)                                 \
+    do {                                                                       \
+        A0 = fBlaMka_256(A0, B0);                                              \
+        A1 = fBlaMka_256(A1, B1);                                              \
+        D0 = rotr16_avx2(_mm256_xor_si256(D0, A0));                            \
+        D1 = rotr16_avx2(_mm256_xor_si256(D1, A1));                            \
+        C0 = fBlaMka_256(C0, D0);                                              \
+        C1 = fBlaMka_256(C1, D1);                                              \
+        B0 = rotr63_avx2(_mm256_xor_si256(B0, C0));                            \
+        B1 = rotr63_avx2(_mm256_xor_si256(B1, C1));                            \
+    } while ((void)0, 0)
+
+/*
+ * Row rounds: A0..D0 hold a whole 16-word state (A0 = v0..v3, B0 = v4..v7,
+ * ...) and A1..D1 hold a second, independent one. Diagonalizing is a lane
+ * rotation within each register.
+ */
+#define DIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3));            \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3));            \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1)                 \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1));            \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1));            \
+    } while ((void)0, 0)
+
+/*
+ * Column rounds: each register holds two words of two states, e.g.
+ * A0 = (v0, v1, v0', v1') and A1 = (v2, v3, v2', v3'), so diagonalizing
+ * exchanges 64-bit lanes between the two halves.
+ */
+#define DIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        __m256i t0 = _mm256_blend_epi32(B0, B1, 0xCC);                         \
+        __m256i t1 = _mm256_blend_epi32(B0, B1, 0x33);                         \
+        B1 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        B0 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm256_blend_epi32(D0, D1, 0xCC);                                 \
+        t1 = _mm256_blend_epi32(D0, D1, 0x33);                                 \
+        D0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        D1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1)                 \
+    do {                                                                       \
+        __m256i t0 = _mm256_blend_epi32(B0, B1, 0xCC);                         \
+        __m256i t1 = _mm256_blend_epi32(B0, B1, 0x33);                         \
+        B0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        B1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+        t0 = _mm256_blend_epi32(D0, D1, 0x33);                                 \
+        t1 = _mm256_blend_epi32(D0, D1, 0xCC);                                 \
+        D0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));            \
+        D1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));            \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_256(LAYOUT, A0, A1, B0, B1, C0, C1, D0, D1)               \
+    do {                                                                       \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        DIAGONALIZE_##LAYOUT##_256(A0, B0, C0, D0, A1, B1, C1, D1);            \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        UNDIAGONALIZE_##LAYOUT##_256(A0, B0, C0, D0, A1, B1, C1, D1);          \
+    } while ((void)0, 0)
+
+#endif
@@ -371,6 +371,39 @@ fail:
     return rc;
 }
 
+static void fill_segment_task(void *task_data, uint32_t lane) {
+    argon2_thread_data *slice_data = task_data;
+    argon2_position_t position = slice_data->pos;
+    position.lane = lane;
+    fill_segment(slice_data->instance_ptr, position);
+}
+
+/* Multi-threaded version running on a persistent worker pool. Each slice is
+ * one pool batch, so argon2_pool_run returning is the sync point barrier. */
+static int fill_memory_blocks_pool(argon2_instance_t *instance) {
+    uint32_t r, s;
+    argon2_thread_data slice_data;
+
+    slice_data.instance_ptr = instance;
+    for (r = 0; r < instance->passes; ++r) {
+        for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+            slice_data.pos.pass = r;
+            slice_data.pos.lane = 0;
+            slice_data.pos.slice = (uint8_t)s;
+            slice_data.pos.index = 0;
+            if (argon2_pool_run(instance->pool, &fill_segment_task,
+                                &slice_data, instance->lanes)) {
+                return ARGON2_THREAD_FAIL;
+            }
+        }
+
+#ifdef GENKAT
+        internal_kat(instance, r); /* Print all memory blocks */
+#endif
+    }
+    return ARGON2_OK;
+}
+
 #endif /* ARGON2_NO_THREADS */
 
 int fill_memory_blocks(argon2_instance_t *instance) {
@@ -380,6 +413,10 @@ int fill_memory_blocks(argon2_instance_t *instance) {
 #if defined(ARGON2_NO_THREADS)
     return fill_memory_blocks_st(instance);
 #else
+    if (instance->pool != NULL) {
+        return instance->lanes == 1 || instance->pool->threads == 1 ?
+			fill_memory_blocks_st(instance) : fill_memory_blocks_pool(instance);
+    }
     return instance->threads == 1 ?
 			fill_memory_blocks_st(instance) : fill_memory_blocks_mt(instance);
 #endif
@@ -80,6 +80,7 @@ typedef struct Argon2_instance_t {
     argon2_type type;
     int print_internals; /* whether to print the memory blocks */
     argon2_context *context_ptr; /* points back to original context */
+    argon2_pool *pool; /* persistent workers, or NULL to spawn threads */
 } argon2_instance_t;
 
 /*
@@ -217,6 +218,17 @@ void finalize(const argon2_context *context, argon2_instance_t *instance);
 void fill_segment(const argon2_instance_t *instance,
                   argon2_position_t position);
 
+/*
+ * Portable fill_segment from ref.c. fill_segment in opt.c dispatches to the
+ * SSE2, SSSE3 or AVX2 version according to CPUID and falls back to this one
+ * on other CPUs.
+ * @param instance Pointer to the current instance
+ * @param position Current position
+ * @pre all block pointers must be valid
+ */
+void fill_segment_ref(const argon2_instance_t *instance,
+                      argon2_position_t position);
+
 /*
  * Function that fills the entire memory t_cost times based on the first two
  * blocks in each lane
@@ -0,0 +1,359 @@
+/*
+ * Argon2 reference source code package - reference C implementations
+ *
+ * Copyright 2015
+ * Daniel Dinu, Dmitry Khovratovich, Jean-Philippe Aumasson, and Samuel Neves
+ *
+ * You may use this work under the terms of a Creative Commons CC0 1.0
+ * License/Waiver or the Apache Public License 2.0, at your option. The terms of
+ * these licenses can be found at:
+ *
+ * - CC0 1.0 Universal : http://creativecommons.org/publicdomain/zero/1.0
+ * - Apache 2.0        : http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * You should have received a copy of both of these licenses along with this
+ * software. If not, they may be obtained at the above URLs.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "argon2.h"
+#include "core.h"
+#include "thread.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+#define ARGON2_OPT_X86
+#endif
+
+#if defined(ARGON2_OPT_X86)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
+
+#include "blake2/blamka-round-opt.h"
+#include "blake2/blake2-impl.h"
+#include "blake2/blake2.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ARGON2_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ARGON2_TARGET(isa)
+#endif
+
+/*
+ * Function fills a new memory block and optionally XORs the old block over
+ * the new one. Unlike ref.c the previous block is not re-read from memory: it
+ * is kept in @state, which is updated to the new block.
+ * @param state The previous block, 32-byte aligned
+ * @param ref_block Pointer to the reference block
+ * @param next_block Pointer to the block to be constructed
+ * @param with_xor Whether to XOR into the new block (1) or just overwrite (0)
+ * @pre all block pointers must be valid
+ */
+typedef void (*fill_block_fn)(void *state, const block *ref_block,
+                              block *next_block, int with_xor);
+
+#define FILL_BLOCK_128(ISA)                                                    \
+    static void ARGON2_TARGET(#ISA)                                            \
+    fill_block_##ISA(void *state_ptr, const block *ref_block,                  \
+                     block *next_block, int with_xor) {                        \
+        __m128i *state = state_ptr;                                            \
+        __m128i block_XY[ARGON2_OWORDS_IN_BLOCK];                              \
+        unsigned i;                                                            \
+                                                                               \
+        if (with_xor) {                                                        \
+            for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {                     \
+                state[i] = _mm_xor_si128(                                      \
+                    state[i], _mm_loadu_si128((const __m128i *)ref_block->v + i)); \
+                block_XY[i] = _mm_xor_si128(                                   \
+                    state[i], _mm_loadu_si128((const __m128i *)next_block->v + i)); \
+            }                                                                  \
+        } else {                                                               \
+            for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {                     \
+                block_XY[i] = state[i] = _mm_xor_si128(                        \
+                    state[i], _mm_loadu_si128((const __m128i *)ref_block->v + i)); \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        for (i = 0; i < 8; ++i) {                                              \
+            BLAKE2_ROUND_128(ISA, state[8 * i + 0], state[8 * i + 1],          \
+                             state[8 * i + 2], state[8 * i + 3],               \
+                             state[8 * i + 4], state[8 * i + 5],               \
+                             state[8 * i + 6], state[8 * i + 7]);              \
+        }                                                                      \
+                                                                               \
+        for (i = 0; i < 8; ++i) {                                              \
+            BLAKE2_ROUND_128(ISA, state[8 * 0 + i], state[8 * 1 + i],          \
+                             state[8 * 2 + i], state[8 * 3 + i],               \
+                             state[8 * 4 + i], state[8 * 5 + i],               \
+                             state[8 * 6 + i], state[8 * 7 + i]);              \
+        }                                                                      \
+                                                                               \
+        for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {                         \
+            state[i] = _mm_xor_si128(state[i], block_XY[i]);                   \
+            _mm_storeu_si128((__m128i *)next_block->v + i, state[i]);          \
+        }                                                                      \
+    }
+
+FILL_BLOCK_128(sse2)
+FILL_BLOCK_128(ssse3)
+
+static void ARGON2_TARGET("avx2")
+fill_block_avx2(void *state_ptr, const block *ref_block, block *next_block,
+                int with_xor) {
+    __m256i *state = state_ptr;
+    __m256i block_XY[ARGON2_HWORDS_IN_BLOCK];
+    unsigned i;
+
+    if (with_xor) {
+        for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
+            state[i] = _mm256_xor_si256(
+                state[i], _mm256_loadu_si256((const __m256i *)ref_block->v + i));
+            block_XY[i] = _mm256_xor_si256(
+                state[i], _mm256_loadu_si256((const __m256i *)next_block->v + i));
+        }
+    } else {
+        for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
+            block_XY[i] = state[i] = _mm256_xor_si256(
+                state[i], _mm256_loadu_si256((const __m256i *)ref_block->v + i));
+        }
+    }
+
+    /* Two 16-word rows per iteration: words 32i..32i+15 and 32i+16..32i+31 */
+    for (i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_256(ROWS, state[8 * i + 0], state[8 * i + 4],
+                         state[8 * i + 1], state[8 * i + 5],
+                         state[8 * i + 2], state[8 * i + 6],
+                         state[8 * i + 3], state[8 * i + 7]);
+    }
+
+    /* Two columns of word pairs per iteration */
+    for (i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_256(COLS, state[0 + i], state[4 + i], state[8 + i],
+                         state[12 + i], state[16 + i], state[20 + i],
+                         state[24 + i], state[28 + i]);
+    }
+
+    for (i = 0; i < ARGON2_HWORDS_IN_BLOCK; i++) {
+        state[i] = _mm256_xor_si256(state[i], block_XY[i]);
+        _mm256_storeu_si256((__m256i *)next_block->v + i, state[i]);
+    }
+}
+
+static void next_addresses(fill_block_fn fill_block, block *address_block,
+                           block *input_block) {
+    /*Temporary zero-initialized blocks*/
+    __m256i zero_block[ARGON2_HWORDS_IN_BLOCK];
+    __m256i zero2_block[ARGON2_HWORDS_IN_BLOCK];
+
+    memset(zero_block, 0, sizeof(zero_block));
+    memset(zero2_block, 0, sizeof(zero2_block));
+
+    /*Increasing index counter*/
+    input_block->v[6]++;
+
+    /*First iteration of G*/
+    fill_block(zero_block, input_block, address_block, 0);
+
+    /*Second iteration of G*/
+    fill_block(zero2_block, address_block, address_block, 0);
+}
+
+/* Same walk as fill_segment in ref.c, with the previous block carried in
+ * registers-sized state instead of being reloaded for every block */
+static void fill_segment_opt(fill_block_fn fill_block,
+                             const argon2_instance_t *instance,
+                             argon2_position_t position) {
+    block *ref_block = NULL, *curr_block = NULL;
+    block address_block, input_block;
+    uint64_t pseudo_rand, ref_index, ref_lane;
+    uint32_t prev_offset, curr_offset;
+    uint32_t starting_index, i;
+    __m256i state[ARGON2_HWORDS_IN_BLOCK];
+    int data_independent_addressing;
+
+    data_independent_addressing =
+        (instance->type == Argon2_i) ||
+        (instance->type == Argon2_id && (position.pass == 0) &&
+         (position.slice < ARGON2_SYNC_POINTS / 2));
+
+    if (data_independent_addressing) {
+        init_block_value(&input_block, 0);
+
+        input_block.v[0] = position.pass;
+        input_block.v[1] = position.lane;
+        input_block.v[2] = position.slice;
+        input_block.v[3] = instance->memory_blocks;
+        input_block.v[4] = instance->passes;
+        input_block.v[5] = instance->type;
+    }
+
+    starting_index = 0;
+
+    if ((0 == position.pass) && (0 == position.slice)) {
+        starting_index = 2; /* we have already generated the first two blocks */
+
+        /* Don't forget to generate the first block of addresses: */
+        if (data_independent_addressing) {
+            next_addresses(fill_block, &address_block, &input_block);
+        }
+    }
+
+    /* Offset of the current block */
+    curr_offset = position.lane * instance->lane_length +
+                  position.slice * instance->segment_length + starting_index;
+
+    if (0 == curr_offset % instance->lane_length) {
+        /* Last block in this lane */
+        prev_offset = curr_offset + instance->lane_length - 1;
+    } else {
+        /* Previous block */
+        prev_offset = curr_offset - 1;
+    }
+
+    memcpy(state, ((instance->memory + prev_offset)->v), ARGON2_BLOCK_SIZE);
+
+    for (i = starting_index; i < instance->segment_length;
+         ++i, ++curr_offset, ++prev_offset) {
+        /*1.1 Rotating prev_offset if needed */
+        if (curr_offset % instance->lane_length == 1) {
+            prev_offset = curr_offset - 1;
+        }
+
+        /* 1.2 Computing the index of the reference block */
+        /* 1.2.1 Taking pseudo-random value from the previous block */
+        if (data_independent_addressing) {
+            if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
+                next_addresses(fill_block, &address_block, &input_block);
+            }
+            pseudo_rand = address_block.v[i % ARGON2_ADDRESSES_IN_BLOCK];
+        } else {
+            pseudo_rand = instance->memory[prev_offset].v[0];
+        }
+
+        /* 1.2.2 Computing the lane of the reference block */
+        ref_lane = ((pseudo_rand >> 32)) % instance->lanes;
+
+        if ((position.pass == 0) && (position.slice == 0)) {
+            /* Can not reference other lanes yet */
+            ref_lane = position.lane;
+        }
+
+        /* 1.2.3 Computing the number of possible reference block within the
+         * lane.
+         */
+        position.index = i;
+        ref_index = index_alpha(instance, &position, pseudo_rand & 0xFFFFFFFF,
+                                ref_lane == position.lane);
+
+        /* 2 Creating a new block */
+        ref_block =
+            instance->memory + instance->lane_length * ref_lane + ref_index;
+        curr_block = instance->memory + curr_offset;
+        if (ARGON2_VERSION_10 == instance->version) {
+            /* version 1.2.1 and earlier: overwrite, not XOR */
+            fill_block(state, ref_block, curr_block, 0);
+        } else {
+            if(0 == position.pass) {
+                fill_block(state, ref_block, curr_block, 0);
+            } else {
+                fill_block(state, ref_block, curr_block, 1);
+            }
+        }
+    }
+}
+
+/* CPUID leaf 1 ECX / leaf 7 EBX feature bits and XCR0 state bits */
+#define CPUID_1_ECX_SSSE3 (1u << 9)
+#define CPUID_1_ECX_OSXSAVE (1u << 27)
+#define CPUID_1_ECX_AVX (1u << 28)
+#define CPUID_7_EBX_AVX2 (1u << 5)
+#define CPUID_1_EDX_SSE2 (1u << 26)
+#define XCR0_SSE_AVX_STATE 0x6u
+
+static void cpuid(uint32_t leaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int *)regs, (int)leaf, 0);
+#else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+                     : "=a"(eax), "=d"(edx)
+                     : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+/* Picks the widest fill_block the CPU and OS support, or NULL for ref.c */
+static fill_block_fn select_fill_block(void) {
+    uint32_t regs[4];
+    uint32_t max_leaf;
+
+    cpuid(0, regs);
+    max_leaf = regs[0];
+    if (max_leaf < 1) {
+        return NULL;
+    }
+
+    cpuid(1, regs);
+    if ((regs[2] & (CPUID_1_ECX_OSXSAVE | CPUID_1_ECX_AVX)) ==
+            (CPUID_1_ECX_OSXSAVE | CPUID_1_ECX_AVX) &&
+        (xgetbv() & XCR0_SSE_AVX_STATE) == XCR0_SSE_AVX_STATE &&
+        max_leaf >= 7) {
+        uint32_t leaf7[4];
+        cpuid(7, leaf7);
+        if (leaf7[1] & CPUID_7_EBX_AVX2) {
+            return &fill_block_avx2;
+        }
+    }
+    if (regs[2] & CPUID_1_ECX_SSSE3) {
+        return &fill_block_ssse3;
+    }
+    if (regs[3] & CPUID_1_EDX_SSE2) {
+        return &fill_block_sse2;
+    }
+    return NULL;
+}
+
+/* Resolved on first use; argon2_once publishes it to every thread */
+static argon2_once_t fill_block_once = ARGON2_ONCE_INIT;
+static fill_block_fn fill_block_impl = NULL;
+
+static void init_fill_block(void) { fill_block_impl = select_fill_block(); }
+
+void fill_segment(const argon2_instance_t *instance,
+                  argon2_position_t position) {
+    if (instance == NULL) {
+        return;
+    }
+
+    argon2_once(&fill_block_once, init_fill_block);
+
+    if (fill_block_impl == NULL) {
+        fill_segment_ref(instance, position);
+    } else {
+        fill_segment_opt(fill_block_impl, instance, position);
+    }
+}
+
+#else /* ARGON2_OPT_X86 */
+
+void fill_segment(const argon2_instance_t *instance,
+                  argon2_position_t position) {
+    fill_segment_ref(instance, position);
+}
+
+#endif /* ARGON2_OPT_X86 */
@@ -15,9 +15,13 @@
  * software. If not, they may be obtained at the above URLs.
  */
 
-#if !defined(ARGON2_NO_THREADS)
+#include <stdlib.h>
 
+#include "argon2.h"
 #include "thread.h"
+
+#if !defined(ARGON2_NO_THREADS)
+
 #if defined(_WIN32)
 #include <windows.h>
 #endif
@@ -54,4 +58,266 @@ void argon2_thread_exit(void) {
 #endif
 }
 
+int argon2_mutex_init(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    InitializeSRWLock(mutex);
+    return 0;
+#else
+    return pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void argon2_mutex_destroy(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    (void)mutex;
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void argon2_mutex_lock(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void argon2_mutex_unlock(argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+int argon2_cond_init(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    InitializeConditionVariable(cond);
+    return 0;
+#else
+    return pthread_cond_init(cond, NULL);
+#endif
+}
+
+void argon2_cond_destroy(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void argon2_cond_wait(argon2_cond_t *cond, argon2_mutex_t *mutex) {
+#if defined(_WIN32)
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void argon2_cond_broadcast(argon2_cond_t *cond) {
+#if defined(_WIN32)
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+#if defined(_WIN32)
+struct argon2_once_init {
+    void (*init)(void);
+};
+
+static BOOL CALLBACK argon2_once_callback(PINIT_ONCE once, PVOID param,
+                                          PVOID *context) {
+    (void)once;
+    (void)context;
+    ((const struct argon2_once_init *)param)->init();
+    return TRUE;
+}
+#endif
+
+void argon2_once(argon2_once_t *once, void (*init)(void)) {
+#if defined(_WIN32)
+    struct argon2_once_init param;
+    param.init = init;
+    InitOnceExecuteOnce(once, argon2_once_callback, &param, NULL);
+#else
+    pthread_once(once, init);
+#endif
+}
+
+/***************Worker pool*****************/
+
+/* Takes tasks from the current batch until none are left. Must be called with
+ * @pool->mutex held; returns with it held.
+ */
+static void pool_drain(argon2_pool *pool) {
+    while (pool->next < pool->count) {
+        argon2_pool_task_t task = pool->task;
+        void *task_data = pool->task_data;
+        uint32_t index = pool->next++;
+
+        argon2_mutex_unlock(&pool->mutex);
+        task(task_data, index);
+        argon2_mutex_lock(&pool->mutex);
+
+        if (--pool->pending == 0) {
+            argon2_cond_broadcast(&pool->done_cond);
+        }
+    }
+}
+
+#ifdef _WIN32
+static unsigned __stdcall pool_worker(void *arg)
+#else
+static void *pool_worker(void *arg)
+#endif
+{
+    argon2_pool *pool = arg;
+
+    argon2_mutex_lock(&pool->mutex);
+    while (!pool->shutdown) {
+        if (pool->next < pool->count) {
+            pool_drain(pool);
+        } else {
+            argon2_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+    }
+    argon2_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int argon2_pool_run(argon2_pool *pool, argon2_pool_task_t task,
+                    void *task_data, uint32_t count) {
+    argon2_mutex_lock(&pool->run_mutex);
+    argon2_mutex_lock(&pool->mutex);
+
+    pool->task = task;
+    pool->task_data = task_data;
+    pool->count = count;
+    pool->next = 0;
+    pool->pending = count;
+    argon2_cond_broadcast(&pool->work_cond);
+
+    /* The caller works on the batch too instead of idling at the barrier */
+    pool_drain(pool);
+    while (pool->pending != 0) {
+        argon2_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+
+    pool->task = NULL;
+    pool->task_data = NULL;
+    pool->count = 0;
+    pool->next = 0;
+
+    argon2_mutex_unlock(&pool->mutex);
+    argon2_mutex_unlock(&pool->run_mutex);
+    return 0;
+}
+
+static void pool_stop(argon2_pool *pool, uint32_t started) {
+    uint32_t i;
+
+    argon2_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    argon2_cond_broadcast(&pool->work_cond);
+    argon2_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < started; ++i) {
+        argon2_thread_join(pool->handles[i]);
+    }
+}
+
+argon2_pool *argon2_pool_create(uint32_t threads) {
+    argon2_pool *pool;
+    uint32_t workers, i;
+
+    if (ARGON2_MIN_THREADS > threads || ARGON2_MAX_THREADS < threads) {
+        return NULL;
+    }
+
+    pool = calloc(1, sizeof(argon2_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    /* The thread calling argon2_pool_run is one of the @threads workers */
+    workers = threads - 1;
+    pool->threads = threads;
+    if (workers > 0) {
+        pool->handles = calloc(workers, sizeof(argon2_thread_handle_t));
+        if (pool->handles == NULL) {
+            free(pool);
+            return NULL;
+        }
+    }
+
+    if (argon2_mutex_init(&pool->run_mutex)) {
+        goto fail_run_mutex;
+    }
+    if (argon2_mutex_init(&pool->mutex)) {
+        goto fail_mutex;
+    }
+    if (argon2_cond_init(&pool->work_cond)) {
+        goto fail_work_cond;
+    }
+    if (argon2_cond_init(&pool->done_cond)) {
+        goto fail_done_cond;
+    }
+
+    for (i = 0; i < workers; ++i) {
+        if (argon2_thread_create(&pool->handles[i], &pool_worker, pool)) {
+            pool_stop(pool, i);
+            goto fail_threads;
+        }
+    }
+    return pool;
+
+fail_threads:
+    argon2_cond_destroy(&pool->done_cond);
+fail_done_cond:
+    argon2_cond_destroy(&pool->work_cond);
+fail_work_cond:
+    argon2_mutex_destroy(&pool->mutex);
+fail_mutex:
+    argon2_mutex_destroy(&pool->run_mutex);
+fail_run_mutex:
+    free(pool->handles);
+    free(pool);
+    return NULL;
+}
+
+void argon2_pool_destroy(argon2_pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pool_stop(pool, pool->threads - 1);
+
+    argon2_cond_destroy(&pool->done_cond);
+    argon2_cond_destroy(&pool->work_cond);
+    argon2_mutex_destroy(&pool->mutex);
+    argon2_mutex_destroy(&pool->run_mutex);
+    free(pool->handles);
+    free(pool);
+}
+
+#else /* ARGON2_NO_THREADS */
+
+void argon2_once(argon2_once_t *once, void (*init)(void)) {
+    if (!*once) {
+        init();
+        *once = 1;
+    }
+}
+
+argon2_pool *argon2_pool_create(uint32_t threads) {
+    (void)threads;
+    return NULL;
+}
+
+void argon2_pool_destroy(argon2_pool *pool) { (void)pool; }
+
 #endif /* ARGON2_NO_THREADS */
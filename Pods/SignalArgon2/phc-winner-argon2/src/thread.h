@@ -31,15 +31,26 @@
         and the type of the thread handle---argon2_thread_handle_t.
 */
 #if defined(_WIN32)
+#include <windows.h>
 #include <process.h>
 typedef unsigned(__stdcall *argon2_thread_func_t)(void *);
 typedef uintptr_t argon2_thread_handle_t;
+typedef SRWLOCK argon2_mutex_t;
+typedef CONDITION_VARIABLE argon2_cond_t;
+typedef INIT_ONCE argon2_once_t;
+#define ARGON2_ONCE_INIT INIT_ONCE_STATIC_INIT
 #else
 #include <pthread.h>
 typedef void *(*argon2_thread_func_t)(void *);
 typedef pthread_t argon2_thread_handle_t;
+typedef pthread_mutex_t argon2_mutex_t;
+typedef pthread_cond_t argon2_cond_t;
+typedef pthread_once_t argon2_once_t;
+#define ARGON2_ONCE_INIT PTHREAD_ONCE_INIT
 #endif
 
+#include "argon2.h"
+
 /* Creates a thread
  * @param handle pointer to a thread handle, which is the output of this
  * function. Must not be NULL.
@@ -63,5 +74,63 @@ int argon2_thread_join(argon2_thread_handle_t handle);
 */
 void argon2_thread_exit(void);
 
+/* Mutex and condition variable wrappers used by the worker pool below. The
+ * init functions return 0 on success.
+ */
+int argon2_mutex_init(argon2_mutex_t *mutex);
+void argon2_mutex_destroy(argon2_mutex_t *mutex);
+void argon2_mutex_lock(argon2_mutex_t *mutex);
+void argon2_mutex_unlock(argon2_mutex_t *mutex);
+int argon2_cond_init(argon2_cond_t *cond);
+void argon2_cond_destroy(argon2_cond_t *cond);
+void argon2_cond_wait(argon2_cond_t *cond, argon2_mutex_t *mutex);
+void argon2_cond_broadcast(argon2_cond_t *cond);
+
+/* Task executed by the worker pool; @index runs from 0 to count - 1 */
+typedef void (*argon2_pool_task_t)(void *task_data, uint32_t index);
+
+/*
+        Persistent worker pool. The threads are created once by
+        argon2_pool_create and sleep on a condition variable between batches,
+        so a hash only pays for a wakeup per sync point instead of a thread
+        creation and join per lane and slice.
+*/
+struct Argon2_pool {
+    argon2_mutex_t run_mutex; /* serialises concurrent argon2_pool_run calls */
+    argon2_mutex_t mutex;     /* guards the batch state below */
+    argon2_cond_t work_cond;  /* signalled when a batch is posted or on exit */
+    argon2_cond_t done_cond;  /* signalled when the last task completes */
+
+    argon2_pool_task_t task;
+    void *task_data;
+    uint32_t count;   /* number of tasks in the current batch */
+    uint32_t next;    /* next task index to hand out */
+    uint32_t pending; /* tasks handed out or queued but not yet finished */
+    int shutdown;
+
+    uint32_t threads;
+    argon2_thread_handle_t *handles;
+};
+
+/* Runs @task for every index in [0, count) on the pool workers and the
+ * calling thread, and returns once all of them have completed. This is the
+ * barrier between two Argon2 sync points.
+ * @param pool Pool created with argon2_pool_create. Must not be NULL.
+ * @return 0 once every task has run.
+ */
+int argon2_pool_run(argon2_pool *pool, argon2_pool_task_t task,
+                    void *task_data, uint32_t count);
+
+#else /* ARGON2_NO_THREADS */
+
+typedef int argon2_once_t;
+#define ARGON2_ONCE_INIT 0
+
 #endif /* ARGON2_NO_THREADS */
+
+/* Runs @init once for @once, which must be initialized with
+ * ARGON2_ONCE_INIT. Concurrent callers return once @init has completed.
+ */
+void argon2_once(argon2_once_t *once, void (*init)(void));
+
 #endif
@@ -147,30 +147,209 @@ static int ALPHDecode(VP8Decoder* const dec, int row, int num_rows) {
   return 1;
 }
 
-static int AllocateAlphaPlane(VP8Decoder* const dec, const VP8Io* const io) {
+// 'io' describes the alpha plane to decode, and 'scaled_size' is the size of
+// the additional reduced-size output plane (if any).
+static int AllocateAlphaPlane(VP8Decoder* const dec, const VP8Io* const io,
+                              uint64_t scaled_size) {
   const int stride = io->width;
   const int height = io->crop_bottom;
   const uint64_t alpha_size = (uint64_t)stride * height;
   assert(dec->alpha_plane_mem_ == NULL);
   dec->alpha_plane_mem_ =
-      (uint8_t*)WebPSafeMalloc(alpha_size, sizeof(*dec->alpha_plane_));
+      (uint8_t*)WebPSafeMalloc(alpha_size + scaled_size,
+                               sizeof(*dec->alpha_plane_));
   if (dec->alpha_plane_mem_ == NULL) {
     return 0;
   }
   dec->alpha_plane_ = dec->alpha_plane_mem_;
+  dec->alpha_scaled_plane_ =
+      (scaled_size > 0) ? dec->alpha_plane_mem_ + alpha_size : NULL;
   dec->alpha_prev_line_ = NULL;
   return 1;
 }
 
 void WebPDeallocateAlphaMemory(VP8Decoder* const dec) {
   assert(dec != NULL);
+  // Stop the concurrent decoding first, it writes into the plane.
+  WebPGetWorkerInterface()->End(&dec->alpha_worker_);
   WebPSafeFree(dec->alpha_plane_mem_);
   dec->alpha_plane_mem_ = NULL;
   dec->alpha_plane_ = NULL;
+  dec->alpha_scaled_plane_ = NULL;
   ALPHDelete(dec->alph_dec_);
   dec->alph_dec_ = NULL;
 }
 
+//------------------------------------------------------------------------------
+// Reduced-size decoding: the alpha plane is decoded at full size, and averaged
+// down to the reduced size row by row.
+
+// Sets up 'full_io' to describe the full-size area covering the reduced-size
+// rows [0, io->crop_bottom) of 'io'.
+static void GetFullSizeIo(const VP8Decoder* const dec, const VP8Io* const io,
+                          VP8Io* const full_io) {
+  const int shift = dec->scale_shift_;
+  const int height = dec->pic_hdr_.height_;
+  *full_io = *io;
+  full_io->width = dec->pic_hdr_.width_;
+  full_io->height = height;
+  full_io->crop_left = 0;
+  full_io->crop_right = full_io->width;
+  full_io->crop_top = 0;
+  full_io->crop_bottom = io->crop_bottom << shift;
+  if (full_io->crop_bottom > height) full_io->crop_bottom = height;
+}
+
+// Averages the full-size rows corresponding to the reduced-size rows
+// [row, row + num_rows) into dec->alpha_scaled_plane_ of stride io->width.
+// The pixels outside of the full-size picture are ignored.
+static void ScaleDownAlphaRows(VP8Decoder* const dec, const VP8Io* const io,
+                               const VP8Io* const full_io,
+                               int row, int num_rows) {
+  const int shift = dec->scale_shift_;
+  const int full_width = full_io->width;
+  const int full_height = full_io->crop_bottom;
+  int x, y, i, j;
+  for (y = row; y < row + num_rows; ++y) {
+    const int y0 = y << shift;
+    const int y1 = (y0 + (1 << shift) < full_height) ? y0 + (1 << shift)
+                                                      : full_height;
+    uint8_t* const dst = dec->alpha_scaled_plane_ + y * io->width;
+    for (x = 0; x < io->width; ++x) {
+      const int x0 = x << shift;
+      const int x1 = (x0 + (1 << shift) < full_width) ? x0 + (1 << shift)
+                                                       : full_width;
+      const int count = (x1 - x0) * (y1 - y0);
+      int sum = count >> 1;
+      for (j = y0; j < y1; ++j) {
+        const uint8_t* const src = dec->alpha_plane_ + j * full_width;
+        for (i = x0; i < x1; ++i) sum += src[i];
+      }
+      dst[x] = (uint8_t)(sum / count);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Setup and finalization.
+
+// Allocates the alpha plane(s) and parses the alpha header. 'alpha_io'
+// describes the plane actually decoded, 'io' the output.
+static int InitAlphaDecoding(VP8Decoder* const dec, const VP8Io* const io,
+                             const VP8Io* const alpha_io) {
+  const uint64_t scaled_size =
+      (dec->scale_shift_ > 0) ? (uint64_t)io->width * io->crop_bottom : 0ULL;
+  assert(dec->alph_dec_ == NULL && dec->alpha_plane_mem_ == NULL);
+  dec->alph_dec_ = ALPHNew();
+  if (dec->alph_dec_ == NULL) return 0;
+  if (!AllocateAlphaPlane(dec, alpha_io, scaled_size)) return 0;
+  if (!ALPHInit(dec->alph_dec_, dec->alpha_data_, dec->alpha_data_size_,
+                alpha_io, dec->alpha_plane_)) {
+    return 0;
+  }
+  // if we allowed use of alpha dithering, check whether it's needed at all
+  if (dec->alph_dec_->pre_processing_ != ALPHA_PREPROCESSED_LEVELS) {
+    dec->alpha_dithering_ = 0;   // disable dithering
+  }
+  return 1;
+}
+
+// Decodes the rows [row, row + num_rows) of the alpha plane (at least), and
+// finalizes the plane once it is complete.
+static int DecodeAlphaRows(VP8Decoder* const dec, int row, int num_rows) {
+  if (!ALPHDecode(dec, row, num_rows)) return 0;
+
+  if (dec->is_alpha_decoded_) {   // finished?
+    // Note: the cropping parameters of 'alph_dec_->io_' are the ones of the
+    // decoded plane.
+    const VP8Io alpha_io = dec->alph_dec_->io_;
+    const int alpha_width = alpha_io.width;
+    ALPHDelete(dec->alph_dec_);
+    dec->alph_dec_ = NULL;
+    if (dec->alpha_dithering_ > 0) {
+      uint8_t* const alpha = dec->alpha_plane_
+                           + alpha_io.crop_top * alpha_width
+                           + alpha_io.crop_left;
+      if (!WebPDequantizeLevels(alpha,
+                                alpha_io.crop_right - alpha_io.crop_left,
+                                alpha_io.crop_bottom - alpha_io.crop_top,
+                                alpha_width, dec->alpha_dithering_)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Concurrent decoding (dec->alpha_mt_): 'alpha_worker_' decodes the plane
+// band by band, one band ahead of the rows requested for output. Only the
+// thread calling VP8DecompressAlphaRows() launches and syncs the worker, and
+// it reads the alpha state only once the worker is synced.
+
+#define ALPHA_BAND_ROWS 64   // rows of the decoded plane per band
+
+static int AlphaBandHook(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  const int row = dec->alpha_rows_done_;
+  (void)arg2;
+  return DecodeAlphaRows(dec, row, dec->alpha_band_end_ - row);
+}
+
+// Starts decoding the next band in the background, if any is left.
+static void LaunchAlphaBand(VP8Decoder* const dec) {
+  int end = dec->alpha_rows_done_ + ALPHA_BAND_ROWS;
+  // Levels dequantization needs the whole plane: decode it in one go.
+  if (end > dec->alpha_height_ || dec->alpha_dithering_ > 0) {
+    end = dec->alpha_height_;
+  }
+  if (end > dec->alpha_rows_done_) {
+    dec->alpha_band_end_ = end;
+    WebPGetWorkerInterface()->Launch(&dec->alpha_worker_);
+  }
+}
+
+// Waits until the rows [0, end) of the decoded plane are available, and keeps
+// the next band going.
+static int WaitForAlphaRows(VP8Decoder* const dec, int end) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  while (dec->alpha_rows_done_ < end) {
+    if (dec->alpha_band_end_ <= dec->alpha_rows_done_) LaunchAlphaBand(dec);
+    if (!winterface->Sync(&dec->alpha_worker_)) return 0;
+    dec->alpha_rows_done_ = dec->alpha_band_end_;
+  }
+  if (dec->alpha_band_end_ <= dec->alpha_rows_done_) LaunchAlphaBand(dec);
+  return 1;
+}
+
+int VP8StartAlphaDecoding(VP8Decoder* const dec, const VP8Io* const io) {
+  VP8Io full_io;
+  const VP8Io* alpha_io = io;
+  assert(dec != NULL && io != NULL && dec->alpha_mt_);
+  assert(dec->alpha_data_ != NULL && !dec->is_alpha_decoded_);
+  if (dec->scale_shift_ > 0) {
+    GetFullSizeIo(dec, io, &full_io);
+    alpha_io = &full_io;
+  }
+  if (!InitAlphaDecoding(dec, io, alpha_io) ||
+      !WebPGetWorkerInterface()->Reset(&dec->alpha_worker_)) {
+    // Leave it to VP8DecompressAlphaRows() to try again and report errors.
+    WebPDeallocateAlphaMemory(dec);
+    dec->alpha_mt_ = 0;
+    return 0;
+  }
+  dec->alpha_worker_.hook = AlphaBandHook;
+  dec->alpha_worker_.data1 = dec;
+  dec->alpha_worker_.data2 = NULL;
+  dec->alpha_height_ = alpha_io->crop_bottom;
+  dec->alpha_rows_done_ = 0;
+  dec->alpha_band_end_ = 0;
+  LaunchAlphaBand(dec);
+  return 1;
+}
+
+#undef ALPHA_BAND_ROWS
+
 //------------------------------------------------------------------------------
 // Main entry point.
 
@@ -179,6 +358,9 @@ const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       int row, int num_rows) {
   const int width = io->width;
   const int height = io->crop_bottom;
+  const int shift = dec->scale_shift_;
+  VP8Io full_io;
+  const VP8Io* alpha_io = io;   // describes the plane actually decoded
 
   assert(dec != NULL && io != NULL);
 
@@ -186,45 +368,46 @@ const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
     return NULL;
   }
 
-  if (!dec->is_alpha_decoded_) {
+  if (shift > 0) {
+    GetFullSizeIo(dec, io, &full_io);
+    alpha_io = &full_io;
+  }
+
+  if (dec->alpha_mt_) {
+    const int alpha_height = alpha_io->crop_bottom;
+    int alpha_end = (row + num_rows) << shift;
+    if (alpha_end > alpha_height) alpha_end = alpha_height;
+    if (!WaitForAlphaRows(dec, alpha_end)) goto Error;
+    if (shift > 0) {
+      ScaleDownAlphaRows(dec, io, alpha_io, row, num_rows);
+    }
+  } else if (!dec->is_alpha_decoded_) {
+    const int alpha_height = alpha_io->crop_bottom;
+    int alpha_row = row << shift;
+    int alpha_num_rows = ((row + num_rows) << shift) - alpha_row;
+    if (alpha_row + alpha_num_rows > alpha_height) {
+      alpha_num_rows = alpha_height - alpha_row;
+    }
     if (dec->alph_dec_ == NULL) {    // Initialize decoder.
-      dec->alph_dec_ = ALPHNew();
-      if (dec->alph_dec_ == NULL) return NULL;
-      if (!AllocateAlphaPlane(dec, io)) goto Error;
-      if (!ALPHInit(dec->alph_dec_, dec->alpha_data_, dec->alpha_data_size_,
-                    io, dec->alpha_plane_)) {
-        goto Error;
-      }
-      // if we allowed use of alpha dithering, check whether it's needed at all
-      if (dec->alph_dec_->pre_processing_ != ALPHA_PREPROCESSED_LEVELS) {
-        dec->alpha_dithering_ = 0;   // disable dithering
-      } else {
+      if (!InitAlphaDecoding(dec, io, alpha_io)) goto Error;
+      if (dec->alph_dec_->pre_processing_ == ALPHA_PREPROCESSED_LEVELS) {
         num_rows = height - row;     // decode everything in one pass
+        alpha_num_rows = alpha_height - alpha_row;
       }
     }
 
     assert(dec->alph_dec_ != NULL);
-    assert(row + num_rows <= height);
-    if (!ALPHDecode(dec, row, num_rows)) goto Error;
-
-    if (dec->is_alpha_decoded_) {   // finished?
-      ALPHDelete(dec->alph_dec_);
-      dec->alph_dec_ = NULL;
-      if (dec->alpha_dithering_ > 0) {
-        uint8_t* const alpha = dec->alpha_plane_ + io->crop_top * width
-                             + io->crop_left;
-        if (!WebPDequantizeLevels(alpha,
-                                  io->crop_right - io->crop_left,
-                                  io->crop_bottom - io->crop_top,
-                                  width, dec->alpha_dithering_)) {
-          goto Error;
-        }
-      }
+    assert(alpha_row + alpha_num_rows <= alpha_height);
+    if (!DecodeAlphaRows(dec, alpha_row, alpha_num_rows)) goto Error;
+
+    if (shift > 0) {
+      ScaleDownAlphaRows(dec, io, alpha_io, row, num_rows);
     }
   }
 
   // Return a pointer to the current decoded row.
-  return dec->alpha_plane_ + row * width;
+  return ((shift > 0) ? dec->alpha_scaled_plane_ : dec->alpha_plane_)
+       + row * width;
 
  Error:
   WebPDeallocateAlphaMemory(dec);
@@ -182,6 +182,13 @@ VP8StatusCode WebPAllocateDecBuffer(int width, int height,
     return VP8_STATUS_INVALID_PARAM;
   }
   if (options != NULL) {    // First, apply options if there is any.
+    const int scale_shift = WebPGetScaleShift(options);
+    if (scale_shift < 0) {
+      return VP8_STATUS_INVALID_PARAM;
+    }
+    // The picture is decoded at reduced size before cropping and scaling.
+    width = (width + (1 << scale_shift) - 1) >> scale_shift;
+    height = (height + (1 << scale_shift) - 1) >> scale_shift;
     if (options->use_cropping) {
       const int cw = options->crop_width;
       const int ch = options->crop_height;
@@ -68,39 +68,154 @@ static void DoUVTransform(uint32_t bits, const int16_t* const src,
   }
 }
 
-static void ReconstructRow(const VP8Decoder* const dec,
-                           const VP8ThreadContext* ctx) {
-  int j;
-  int mb_x;
-  const int mb_y = ctx->mb_y_;
-  const int cache_id = ctx->id_;
-  uint8_t* const y_dst = dec->yuv_b_ + Y_OFF;
-  uint8_t* const u_dst = dec->yuv_b_ + U_OFF;
-  uint8_t* const v_dst = dec->yuv_b_ + V_OFF;
+//------------------------------------------------------------------------------
+// Reduced-size reconstruction (scale_shift_ > 0).
+//
+// The intra predictors read the reconstructed pixels of the neighboring blocks,
+// which must hence be exact to prevent any drift: all the blocks of the
+// intra4x4 macroblocks, and the right column and bottom row of blocks of the
+// intra16x16 ones. The residuals of the other blocks are only needed for the
+// output, and are approximated at the target resolution: DC only for 1/4 and
+// 1/8, and the average over each 2x2 quadrant for 1/2. The macroblocks are then
+// averaged down to (16 >> scale_shift_) pixels wide blocks in the cache.
+
+static WEBP_INLINE uint8_t Clip8b(int v) {
+  return (!(v & ~0xff)) ? v : (v < 0) ? 0 : 255;
+}
 
-  // Initialize left-most block.
-  for (j = 0; j < 16; ++j) {
-    y_dst[j * BPS - 1] = 129;
+// Adds the average value of the inverse transform over each 2x2 quadrant.
+// Coefficients are in[4 * v + h], with 'v' and 'h' the vertical and horizontal
+// frequencies. Over one half, the basis #2 sums to zero and the bases #1 and #3
+// average to +/-cos(pi/8).sqrt(2)/2 and -/+sin(pi/8).sqrt(2)/2.
+#define MUL_K1(a) (((a) * 60547) >> 16)
+#define MUL_K3(a) (((a) * 25080) >> 16)
+static void TransformQuadrants(const int16_t* const in, uint8_t* const dst) {
+  int lo[4], hi[4];   // horizontal half averages, for each vertical frequency
+  int v, i, j;
+  for (v = 0; v < 4; ++v) {
+    const int t = MUL_K1(in[4 * v + 1]) - MUL_K3(in[4 * v + 3]);
+    lo[v] = in[4 * v] + t;
+    hi[v] = in[4 * v] - t;
   }
-  for (j = 0; j < 8; ++j) {
-    u_dst[j * BPS - 1] = 129;
-    v_dst[j * BPS - 1] = 129;
+  for (i = 0; i < 2; ++i) {
+    const int* const h = i ? hi : lo;
+    const int t = MUL_K1(h[1]) - MUL_K3(h[3]);
+    const int top = (h[0] + t + 4) >> 3;
+    const int bottom = (h[0] - t + 4) >> 3;
+    for (j = 0; j < 2; ++j) {
+      uint8_t* const d = dst + 2 * i + 2 * j * BPS;
+      const int value = j ? bottom : top;
+      d[0]       = Clip8b(d[0] + value);
+      d[1]       = Clip8b(d[1] + value);
+      d[BPS + 0] = Clip8b(d[BPS + 0] + value);
+      d[BPS + 1] = Clip8b(d[BPS + 1] + value);
+    }
   }
+}
+#undef MUL_K1
+#undef MUL_K3
+
+static WEBP_INLINE void DoReducedTransform(uint32_t bits,
+                                           const int16_t* const src,
+                                           uint8_t* const dst,
+                                           int scale_shift) {
+  if (bits >> 30) {
+    if (scale_shift == 1 && (bits >> 30) != 1) {
+      TransformQuadrants(src, dst);
+    } else {
+      VP8TransformDC(src, dst);
+    }
+  }
+}
 
-  // Init top-left sample on left column too.
-  if (mb_y > 0) {
-    y_dst[-1 - BPS] = u_dst[-1 - BPS] = v_dst[-1 - BPS] = 129;
-  } else {
-    // we only need to do this init once at block (0,0).
-    // Afterward, it remains valid for the whole topmost row.
-    memset(y_dst - BPS - 1, 127, 16 + 4 + 1);
-    memset(u_dst - BPS - 1, 127, 8 + 1);
-    memset(v_dst - BPS - 1, 127, 8 + 1);
+// Averages the 'size' x 'size' block 'src' down to 'size >> shift' pixels wide.
+static void DownscaleBlock(const uint8_t* const src, int size, int shift,
+                           uint8_t* const dst, int dst_stride) {
+  const int step = 1 << shift;
+  const int round = 1 << (2 * shift - 1);
+  int x, y, i, j;
+  for (y = 0; y < (size >> shift); ++y) {
+    for (x = 0; x < (size >> shift); ++x) {
+      const uint8_t* const s = src + (y * BPS + x) * step;
+      int sum = round;
+      for (j = 0; j < step; ++j) {
+        for (i = 0; i < step; ++i) sum += s[j * BPS + i];
+      }
+      dst[y * dst_stride + x] = (uint8_t)(sum >> (2 * shift));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Preview output.
+
+// Returns the rounded average of the 'w' x 'h' samples of 'src'.
+static int AverageBlock(const uint8_t* const src, int w, int h) {
+  const int count = w * h;
+  int sum = count >> 1;
+  int i, j;
+  for (j = 0; j < h; ++j) {
+    for (i = 0; i < w; ++i) sum += src[j * BPS + i];
   }
+  return sum / count;
+}
 
-  // Reconstruct one row.
-  for (mb_x = 0; mb_x < dec->mb_w_; ++mb_x) {
-    const VP8MBData* const block = ctx->mb_data_ + mb_x;
+// Stores the average Y, U and V values of the part of the macroblock
+// reconstructed in 'yuv_b' which lies inside the picture. The in-loop filter
+// is not applied yet, but its effect is negligible on such averages.
+static void StorePreviewMB(const VP8Decoder* const dec,
+                           const uint8_t* const yuv_b, int mb_x, int mb_y) {
+  const int w = dec->pic_hdr_.width_ - 16 * mb_x;
+  const int h = dec->pic_hdr_.height_ - 16 * mb_y;
+  const int y_w = (w < 16) ? w : 16;
+  const int y_h = (h < 16) ? h : 16;
+  uint8_t* const dst = dec->preview_ + 4 * (mb_y * dec->mb_w_ + mb_x);
+  dst[0] = AverageBlock(yuv_b + Y_OFF, y_w, y_h);
+  dst[1] = AverageBlock(yuv_b + U_OFF, (y_w + 1) >> 1, (y_h + 1) >> 1);
+  dst[2] = AverageBlock(yuv_b + V_OFF, (y_w + 1) >> 1, (y_h + 1) >> 1);
+}
+
+//------------------------------------------------------------------------------
+
+// Reconstruct macroblocks [mb_x_start, mb_x_end) of row 'mb_y' into cache row
+// 'cache_id'. 'yuv_b' holds the left samples between successive calls.
+static void ReconstructMBs(const VP8Decoder* const dec, uint8_t* const yuv_b,
+                           const VP8MBData* const mb_data, int mb_y,
+                           int cache_id, int mb_x_start, int mb_x_end) {
+  const int scale_shift = dec->scale_shift_;
+  // The preview averages the full macroblocks, so they must all be complete.
+  const int reduced_transform = (scale_shift > 0 && dec->preview_ == NULL);
+  int j;
+  int mb_x;
+  uint8_t* const y_dst = yuv_b + Y_OFF;
+  uint8_t* const u_dst = yuv_b + U_OFF;
+  uint8_t* const v_dst = yuv_b + V_OFF;
+
+  if (mb_x_start == 0) {
+    // Initialize left-most block.
+    for (j = 0; j < 16; ++j) {
+      y_dst[j * BPS - 1] = 129;
+    }
+    for (j = 0; j < 8; ++j) {
+      u_dst[j * BPS - 1] = 129;
+      v_dst[j * BPS - 1] = 129;
+    }
+
+    // Init top-left sample on left column too.
+    if (mb_y > 0) {
+      y_dst[-1 - BPS] = u_dst[-1 - BPS] = v_dst[-1 - BPS] = 129;
+    } else {
+      // we only need to do this init once at block (0,0).
+      // Afterward, it remains valid for the whole topmost row.
+      memset(y_dst - BPS - 1, 127, 16 + 4 + 1);
+      memset(u_dst - BPS - 1, 127, 8 + 1);
+      memset(v_dst - BPS - 1, 127, 8 + 1);
+    }
+  }
+
+  // Reconstruct the macroblocks.
+  for (mb_x = mb_x_start; mb_x < mb_x_end; ++mb_x) {
+    const VP8MBData* const block = mb_data + mb_x;
 
     // Rotate in the left samples from previously decoded block. We move four
     // pixels at a time for alignment reason, and because of in-loop filter.
@@ -151,7 +266,13 @@ static void ReconstructRow(const VP8Decoder* const dec,
         VP8PredLuma16[pred_func](y_dst);
         if (bits != 0) {
           for (n = 0; n < 16; ++n, bits <<= 2) {
-            DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
+            if (reduced_transform && (n & 3) != 3 && n < 12) {
+              // not on the right column or bottom row: output-only block
+              DoReducedTransform(bits, coeffs + n * 16, y_dst + kScan[n],
+                                 scale_shift);
+            } else {
+              DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
+            }
           }
         }
       }
@@ -172,8 +293,23 @@ static void ReconstructRow(const VP8Decoder* const dec,
         memcpy(top_yuv[0].v, v_dst +  7 * BPS,  8);
       }
     }
+    if (dec->preview_ != NULL) StorePreviewMB(dec, yuv_b, mb_x, mb_y);
     // Transfer reconstructed samples from yuv_b_ cache to final destination.
-    {
+    if (scale_shift > 0) {
+      const int y_size = 16 >> scale_shift;
+      const int uv_size = 8 >> scale_shift;
+      const int y_offset = cache_id * y_size * dec->cache_y_stride_;
+      const int uv_offset = cache_id * uv_size * dec->cache_uv_stride_;
+      DownscaleBlock(y_dst, 16, scale_shift,
+                     dec->cache_y_ + mb_x * y_size + y_offset,
+                     dec->cache_y_stride_);
+      DownscaleBlock(u_dst, 8, scale_shift,
+                     dec->cache_u_ + mb_x * uv_size + uv_offset,
+                     dec->cache_uv_stride_);
+      DownscaleBlock(v_dst, 8, scale_shift,
+                     dec->cache_v_ + mb_x * uv_size + uv_offset,
+                     dec->cache_uv_stride_);
+    } else {
       const int y_offset = cache_id * 16 * dec->cache_y_stride_;
       const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
       uint8_t* const y_out = dec->cache_y_ + mb_x * 16 + y_offset;
@@ -190,6 +326,12 @@ static void ReconstructRow(const VP8Decoder* const dec,
   }
 }
 
+static void ReconstructRow(const VP8Decoder* const dec,
+                           const VP8ThreadContext* ctx) {
+  ReconstructMBs(dec, dec->yuv_b_, ctx->mb_data_, ctx->mb_y_, ctx->id_,
+                 0, dec->mb_w_);
+}
+
 //------------------------------------------------------------------------------
 // Filtering
 
@@ -200,11 +342,11 @@ static void ReconstructRow(const VP8Decoder* const dec,
 //                 U/V, so it's 8 samples total (because of the 2x upsampling).
 static const uint8_t kFilterExtraRows[3] = { 0, 2, 8 };
 
-static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
-  const int cache_id = ctx->id_;
+static void DoFilter(const VP8Decoder* const dec,
+                     const VP8FInfo* const f_infos, int cache_id,
+                     int mb_x, int mb_y) {
   const int y_bps = dec->cache_y_stride_;
-  const VP8FInfo* const f_info = ctx->f_info_ + mb_x;
+  const VP8FInfo* const f_info = f_infos + mb_x;
   uint8_t* const y_dst = dec->cache_y_ + cache_id * 16 * y_bps + mb_x * 16;
   const int ilevel = f_info->f_ilevel_;
   const int limit = f_info->f_limit_;
@@ -252,10 +394,11 @@ static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
 // Filter the decoded macroblock row (if needed)
 static void FilterRow(const VP8Decoder* const dec) {
   int mb_x;
-  const int mb_y = dec->thread_ctx_.mb_y_;
-  assert(dec->thread_ctx_.filter_row_);
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  const int mb_y = ctx->mb_y_;
+  assert(ctx->filter_row_);
   for (mb_x = dec->tl_mb_x_; mb_x < dec->br_mb_x_; ++mb_x) {
-    DoFilter(dec, mb_x, mb_y);
+    DoFilter(dec, ctx->f_info_, ctx->id_, mb_x, mb_y);
   }
 }
 
@@ -396,42 +539,26 @@ static void DitherRow(VP8Decoder* const dec) {
 //  * we must clip the remaining pixels against the cropping area. The VP8Io
 //    struct must have the following fields set correctly before calling put():
 
-#define MACROBLOCK_VPOS(mb_y)  ((mb_y) * 16)    // vertical position of a MB
-
-// Finalize and transmit a complete row. Return false in case of user-abort.
-static int FinishRow(void* arg1, void* arg2) {
-  VP8Decoder* const dec = (VP8Decoder*)arg1;
-  VP8Io* const io = (VP8Io*)arg2;
+// Transmit the finalized samples of row 'mb_y', stored in cache row 'cache_id'.
+// Return false in case of user-abort.
+static int EmitRow(VP8Decoder* const dec, VP8Io* const io,
+                   int mb_y, int cache_id) {
   int ok = 1;
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
-  const int cache_id = ctx->id_;
+  const int mb_size = 16 >> dec->scale_shift_;   // vertical size of a MB
   const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
   const int ysize = extra_y_rows * dec->cache_y_stride_;
   const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride_;
-  const int y_offset = cache_id * 16 * dec->cache_y_stride_;
-  const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
+  const int y_offset = cache_id * mb_size * dec->cache_y_stride_;
+  const int uv_offset = cache_id * (mb_size / 2) * dec->cache_uv_stride_;
   uint8_t* const ydst = dec->cache_y_ - ysize + y_offset;
   uint8_t* const udst = dec->cache_u_ - uvsize + uv_offset;
   uint8_t* const vdst = dec->cache_v_ - uvsize + uv_offset;
-  const int mb_y = ctx->mb_y_;
   const int is_first_row = (mb_y == 0);
   const int is_last_row = (mb_y >= dec->br_mb_y_ - 1);
 
-  if (dec->mt_method_ == 2) {
-    ReconstructRow(dec, ctx);
-  }
-
-  if (ctx->filter_row_) {
-    FilterRow(dec);
-  }
-
-  if (dec->dither_) {
-    DitherRow(dec);
-  }
-
   if (io->put != NULL) {
-    int y_start = MACROBLOCK_VPOS(mb_y);
-    int y_end = MACROBLOCK_VPOS(mb_y + 1);
+    int y_start = mb_y * mb_size;
+    int y_end = (mb_y + 1) * mb_size;
     if (!is_first_row) {
       y_start -= extra_y_rows;
       io->y = ydst;
@@ -482,9 +609,43 @@ static int FinishRow(void* arg1, void* arg2) {
       ok = io->put(io);
     }
   }
+  return ok;
+}
+
+// Finalize and transmit a complete row. Return false in case of user-abort.
+static int FinishRow(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8Io* const io = (VP8Io*)arg2;
+  int ok;
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  const int cache_id = ctx->id_;
+  const int mb_y = ctx->mb_y_;
+
+  if (dec->mt_method_ == 2) {
+    ReconstructRow(dec, ctx);
+  }
+
+  if (ctx->filter_row_) {
+    FilterRow(dec);
+  }
+
+  if (dec->dither_) {
+    DitherRow(dec);
+  }
+
+  ok = EmitRow(dec, io, mb_y, cache_id);
+
   // rotate top samples if needed
-  if (cache_id + 1 == dec->num_caches_) {
-    if (!is_last_row) {
+  if (cache_id + 1 == dec->num_caches_ && dec->filter_type_ > 0) {
+    if (mb_y < dec->br_mb_y_ - 1) {
+      const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
+      const int ysize = extra_y_rows * dec->cache_y_stride_;
+      const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride_;
+      const int y_offset = cache_id * 16 * dec->cache_y_stride_;
+      const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
+      uint8_t* const ydst = dec->cache_y_ - ysize + y_offset;
+      uint8_t* const udst = dec->cache_u_ - uvsize + uv_offset;
+      uint8_t* const vdst = dec->cache_v_ - uvsize + uv_offset;
       memcpy(dec->cache_y_ - ysize, ydst + 16 * dec->cache_y_stride_, ysize);
       memcpy(dec->cache_u_ - uvsize, udst + 8 * dec->cache_uv_stride_, uvsize);
       memcpy(dec->cache_v_ - uvsize, vdst + 8 * dec->cache_uv_stride_, uvsize);
@@ -494,8 +655,6 @@ static int FinishRow(void* arg1, void* arg2) {
   return ok;
 }
 
-#undef MACROBLOCK_VPOS
-
 //------------------------------------------------------------------------------
 
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
@@ -543,10 +702,220 @@ int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
   return ok;
 }
 
+//------------------------------------------------------------------------------
+// Wavefront decoding (mt_method_ == 3).
+//
+// Row 'mb_y' only reads tokens from partition 'mb_y % num_parts', so there's
+// one VP8RowContext per partition, each owning every num_parts-th row. Rows are
+// processed in steps: during one step, each active row parses, reconstructs
+// and filters a chunk of macroblocks in parallel with the others. Macroblock
+// 'mb_x' of a row needs the row above to be finished up to 'mb_x + 1': the
+// top-right samples for intra4x4 prediction, and the final pixels above it for
+// the deblocking filter (including the right neighbor's horizontal filtering).
+// Hence, at the start of a step, each row is allowed to advance up to two
+// macroblocks behind the position the row above has reached. This also
+// guarantees that the rows never touch each other's top samples (yuv_t_),
+// residual context (mb_info_) or filtered pixels during the step.
+// The intra modes (partition #0) are parsed serially, and the finished rows are
+// emitted in order by dec->worker_ while the next step is being processed.
+// Rows are stored in a ring of cache rows, which must be large enough to hold
+// the rows being decoded as well as the ones not yet emitted.
+
+// Minimum number of macroblocks decoded by a row during one step.
+#define MIN_WAVEFRONT_CHUNK 4
+
+// Copy the bottom samples of the last cache row above the first cache row, in
+// the macroblock columns [mb_x, mb_x_end). This is the piecewise equivalent of
+// the rotation done in FinishRow().
+static void RotateTopSamples(const VP8Decoder* const dec,
+                             int mb_x, int mb_x_end) {
+  const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
+  const int y_bps = dec->cache_y_stride_;
+  const int uv_bps = dec->cache_uv_stride_;
+  const int y_offset = dec->num_caches_ * 16 * y_bps;
+  const int uv_offset = dec->num_caches_ * 8 * uv_bps;
+  const size_t y_len = 16 * (mb_x_end - mb_x);
+  const size_t uv_len = 8 * (mb_x_end - mb_x);
+  int j;
+  for (j = -extra_y_rows; j < 0; ++j) {
+    uint8_t* const y_dst = dec->cache_y_ + j * y_bps + 16 * mb_x;
+    memcpy(y_dst, y_dst + y_offset, y_len);
+  }
+  for (j = -extra_y_rows / 2; j < 0; ++j) {
+    uint8_t* const u_dst = dec->cache_u_ + j * uv_bps + 8 * mb_x;
+    uint8_t* const v_dst = dec->cache_v_ + j * uv_bps + 8 * mb_x;
+    memcpy(u_dst, u_dst + uv_offset, uv_len);
+    memcpy(v_dst, v_dst + uv_offset, uv_len);
+  }
+}
+
+// Parse, reconstruct and filter the current chunk of a row.
+static int DecodeRowChunk(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8RowContext* const ctx = (VP8RowContext*)arg2;
+  const int mb_y = ctx->mb_y_;
+  const int mb_x_start = ctx->mb_x_;
+  const int mb_x_end = ctx->mb_x_end_;
+  const int cache_id = mb_y % dec->num_caches_;
+  VP8BitReader* const token_br = &dec->parts_[mb_y & dec->num_parts_minus_one_];
+
+  if (!VP8DecodeMBs(dec, &ctx->left_, ctx->mb_data_, ctx->f_info_, token_br,
+                    mb_x_start, mb_x_end)) {
+    return 0;
+  }
+  ReconstructMBs(dec, ctx->yuv_b_, ctx->mb_data_, mb_y, cache_id,
+                 mb_x_start, mb_x_end);
+  if (dec->filter_type_ > 0) {
+    if (cache_id == 0 && mb_y > 0) {
+      RotateTopSamples(dec, mb_x_start, mb_x_end);
+    }
+    if (mb_y >= dec->tl_mb_y_ && mb_y <= dec->br_mb_y_) {
+      const int x_start =
+          (mb_x_start > dec->tl_mb_x_) ? mb_x_start : dec->tl_mb_x_;
+      const int x_end = (mb_x_end < dec->br_mb_x_) ? mb_x_end : dec->br_mb_x_;
+      int mb_x;
+      for (mb_x = x_start; mb_x < x_end; ++mb_x) {
+        DoFilter(dec, ctx->f_info_, cache_id, mb_x, mb_y);
+      }
+    }
+  }
+  return 1;
+}
+
+// Emit the finished rows [ctx->mb_y_, ctx->mb_y_end_).
+static int EmitRows(void* arg1, void* arg2) {
+  VP8Decoder* const dec = (VP8Decoder*)arg1;
+  VP8Io* const io = (VP8Io*)arg2;
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  int mb_y;
+  for (mb_y = ctx->mb_y_; mb_y < ctx->mb_y_end_; ++mb_y) {
+    if (!EmitRow(dec, io, mb_y, mb_y % dec->num_caches_)) return 0;
+  }
+  return 1;
+}
+
+int VP8DecodeWavefront(VP8Decoder* const dec, VP8Io* const io) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const int num_rows = (int)dec->num_parts_minus_one_ + 1;
+  const int mb_w = dec->mb_w_;
+  const int chunk = (mb_w + 7) / 8 > MIN_WAVEFRONT_CHUNK ? (mb_w + 7) / 8
+                                                         : MIN_WAVEFRONT_CHUNK;
+  VP8ThreadContext* const emit_ctx = &dec->thread_ctx_;
+  int next_row = 0;      // next row to parse the intra modes of
+  int done_rows = 0;     // rows fully decoded (in order)
+  int emitted_rows = 0;  // rows already output
+  int i;
+
+  for (i = 0; i < num_rows; ++i) dec->row_ctx_[i].mb_y_ = -1;
+  emit_ctx->io_ = *io;
+  emit_ctx->mb_y_ = emit_ctx->mb_y_end_ = 0;
+
+  while (emitted_rows < dec->br_mb_y_) {
+    VP8RowContext* jobs[MAX_NUM_PARTITIONS];
+    int num_jobs = 0;
+    int ok = 1;
+    int y;
+
+    // Wait for the previous output, so that its cache rows can be reused.
+    if (!winterface->Sync(&dec->worker_)) {
+      return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+    }
+    emitted_rows = emit_ctx->mb_y_end_;
+
+    // Start new rows, in order, as long as their partition and cache row are
+    // free. The cache row of 'next_row' is the one of row
+    // 'next_row - num_caches_', whose bottom samples are also needed to emit
+    // the row after it.
+    while (next_row < dec->br_mb_y_ &&
+           next_row + 2 <= emitted_rows + dec->num_caches_) {
+      VP8RowContext* const ctx = &dec->row_ctx_[next_row % num_rows];
+      if (ctx->mb_y_ >= 0) break;  // still busy with a previous row
+      dec->mb_data_ = ctx->mb_data_;
+      if (!VP8ParseIntraModeRow(&dec->br_, dec)) {
+        ok = VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                         "Premature end-of-partition0 encountered.");
+        break;
+      }
+      VP8InitScanline(dec);
+      ctx->mb_y_ = next_row;
+      ctx->mb_x_ = 0;
+      ctx->left_.nz_ = 0;
+      ctx->left_.nz_dc_ = 0;
+      ++next_row;
+    }
+    if (!ok) break;
+
+    // Schedule the chunks, each row trailing the one above by two macroblocks.
+    for (y = done_rows; y < next_row; ++y) {
+      VP8RowContext* const ctx = &dec->row_ctx_[y % num_rows];
+      int mb_x_end = ctx->mb_x_ + chunk;
+      if (mb_x_end > mb_w) mb_x_end = mb_w;
+      if (y > done_rows) {
+        const int limit = dec->row_ctx_[(y - 1) % num_rows].mb_x_ - 1;
+        if (mb_x_end > limit) mb_x_end = limit;
+      }
+      if (mb_x_end > ctx->mb_x_) {
+        ctx->mb_x_end_ = mb_x_end;
+        jobs[num_jobs++] = ctx;
+      }
+    }
+
+    // Output the rows finished during the previous step in the background.
+    if (done_rows > emitted_rows) {
+      emit_ctx->mb_y_ = emitted_rows;
+      emit_ctx->mb_y_end_ = done_rows;
+      winterface->Launch(&dec->worker_);
+    }
+
+    if (num_jobs > 0) {
+      for (i = 1; i < num_jobs; ++i) winterface->Launch(&jobs[i]->worker_);
+      winterface->Execute(&jobs[0]->worker_);
+      for (i = 0; i < num_jobs; ++i) {
+        ok &= winterface->Sync(&jobs[i]->worker_);
+      }
+      if (!ok) {
+        winterface->Sync(&dec->worker_);
+        VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                    "Premature end-of-file encountered.");
+        break;
+      }
+      for (i = 0; i < num_jobs; ++i) {
+        VP8RowContext* const ctx = jobs[i];
+        ctx->mb_x_ = ctx->mb_x_end_;
+        if (ctx->mb_x_ == mb_w) ctx->mb_y_ = -1;
+      }
+      while (done_rows < next_row &&
+             dec->row_ctx_[done_rows % num_rows].mb_y_ != done_rows) {
+        ++done_rows;
+      }
+    } else {
+      // Nothing to decode: we're waiting for the output to finish.
+      assert(done_rows == next_row);
+      assert(done_rows > emitted_rows || done_rows == dec->br_mb_y_);
+      if (done_rows == emitted_rows) break;
+    }
+  }
+  // Errors were recorded in dec->status_. Let any pending output finish.
+  winterface->Sync(&dec->worker_);
+  return (dec->status_ == VP8_STATUS_OK);
+}
+
+#undef MIN_WAVEFRONT_CHUNK
+
 //------------------------------------------------------------------------------
 // Finish setting up the decoding parameter once user's setup() is called.
 
 VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
+  const int scale_shift = dec->scale_shift_;
+  // At reduced size, 'io' describes the reduced picture, cropping included.
+  if (scale_shift > 0) {
+    const int round = (1 << scale_shift) - 1;
+    io->width = (dec->pic_hdr_.width_ + round) >> scale_shift;
+    io->height = (dec->pic_hdr_.height_ + round) >> scale_shift;
+    io->crop_right = io->scaled_width = io->mb_w = io->width;
+    io->crop_bottom = io->scaled_height = io->mb_h = io->height;
+  }
+
   // Call setup() first. This may trigger additional decoding features on 'io'.
   // Note: Afterward, we must call teardown() no matter what.
   if (io->setup != NULL && !io->setup(io)) {
@@ -554,10 +923,14 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
     return dec->status_;
   }
 
-  // Disable filtering per user request
-  if (io->bypass_filtering) {
+  // Disable filtering per user request, or at reduced size. The dithering
+  // works on 8x8 chroma blocks, so it's disabled too in the latter case.
+  if (io->bypass_filtering || scale_shift > 0) {
     dec->filter_type_ = 0;
   }
+  if (scale_shift > 0) {
+    dec->dither_ = 0;
+  }
 
   // Define the area where we can skip in-loop filtering, in case of cropping.
   //
@@ -579,14 +952,16 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
       // We include 'extra_pixels' on the other side of the boundary, since
       // vertical or horizontal filtering of the previous macroblock can
       // modify some abutting pixels.
-      dec->tl_mb_x_ = (io->crop_left - extra_pixels) >> 4;
-      dec->tl_mb_y_ = (io->crop_top - extra_pixels) >> 4;
+      dec->tl_mb_x_ = (io->crop_left - extra_pixels) >> (4 - scale_shift);
+      dec->tl_mb_y_ = (io->crop_top - extra_pixels) >> (4 - scale_shift);
       if (dec->tl_mb_x_ < 0) dec->tl_mb_x_ = 0;
       if (dec->tl_mb_y_ < 0) dec->tl_mb_y_ = 0;
     }
     // We need some 'extra' pixels on the right/bottom.
-    dec->br_mb_y_ = (io->crop_bottom + 15 + extra_pixels) >> 4;
-    dec->br_mb_x_ = (io->crop_right + 15 + extra_pixels) >> 4;
+    dec->br_mb_y_ = (io->crop_bottom + (15 >> scale_shift) + extra_pixels)
+                  >> (4 - scale_shift);
+    dec->br_mb_x_ = (io->crop_right + (15 >> scale_shift) + extra_pixels)
+                  >> (4 - scale_shift);
     if (dec->br_mb_x_ > dec->mb_w_) {
       dec->br_mb_x_ = dec->mb_w_;
     }
@@ -633,14 +1008,40 @@ int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
 // and output process have non-concurrent writing:
 // Decode:  [ 0..15][16..31][ 0..15][16..31][...
 // io->put:         [ 0..15][16..31][ 0..15][...
+// The wavefront method has one row in flight per partition, and the rows
+// finished during a step are output during the next one. Two more cache lines
+// per partition, plus two for the delay line, are enough to never stall.
 
 #define MT_CACHE_LINES 3
 #define ST_CACHE_LINES 1   // 1 cache row only for single-threaded case
+#define WAVEFRONT_CACHE_LINES(num_rows) (2 * (num_rows) + 2)
 
 // Initialize multi/single-thread worker
 static int InitThreadContext(VP8Decoder* const dec) {
   dec->cache_id_ = 0;
-  if (dec->mt_method_ > 0) {
+  if (dec->mt_method_ == 3) {
+    const int num_rows = (int)dec->num_parts_minus_one_ + 1;
+    WebPWorker* const worker = &dec->worker_;
+    int i;
+    if (!WebPGetWorkerInterface()->Reset(worker)) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "thread initialization failed.");
+    }
+    worker->data1 = dec;
+    worker->data2 = (void*)&dec->thread_ctx_.io_;
+    worker->hook = EmitRows;
+    for (i = 0; i < num_rows; ++i) {
+      VP8RowContext* const ctx = &dec->row_ctx_[i];
+      if (!WebPGetWorkerInterface()->Reset(&ctx->worker_)) {
+        return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                           "thread initialization failed.");
+      }
+      ctx->worker_.data1 = dec;
+      ctx->worker_.data2 = ctx;
+      ctx->worker_.hook = DecodeRowChunk;
+    }
+    dec->num_caches_ = WAVEFRONT_CACHE_LINES(num_rows);
+  } else if (dec->mt_method_ > 0) {
     WebPWorker* const worker = &dec->worker_;
     if (!WebPGetWorkerInterface()->Reset(worker)) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
@@ -666,15 +1067,18 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
   (void)headers;
   (void)width;
   (void)height;
-  assert(headers == NULL || !headers->is_lossless);
 #if defined(WEBP_USE_THREAD)
-  if (width >= MIN_WIDTH_FOR_THREADS) return 2;
+  if (width >= MIN_WIDTH_FOR_THREADS) {
+    // Lossless: [entropy decoding][transforms+output]
+    return (headers != NULL && headers->is_lossless) ? 1 : 2;
+  }
 #endif
   return 0;
 }
 
 #undef MT_CACHE_LINES
 #undef ST_CACHE_LINES
+#undef WAVEFRONT_CACHE_LINES
 
 //------------------------------------------------------------------------------
 // Memory setup
@@ -682,20 +1086,27 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
 static int AllocateMemory(VP8Decoder* const dec) {
   const int num_caches = dec->num_caches_;
   const int mb_w = dec->mb_w_;
+  // number of rows decoded concurrently, each with its own buffers
+  const int num_rows =
+      (dec->mt_method_ == 3) ? (int)dec->num_parts_minus_one_ + 1 : 1;
   // Note: we use 'size_t' when there's no overflow risk, uint64_t otherwise.
   const size_t intra_pred_mode_size = 4 * mb_w * sizeof(uint8_t);
   const size_t top_size = sizeof(VP8TopSamples) * mb_w;
   const size_t mb_info_size = (mb_w + 1) * sizeof(VP8MB);
   const size_t f_info_size =
       (dec->filter_type_ > 0) ?
-          mb_w * (dec->mt_method_ > 0 ? 2 : 1) * sizeof(VP8FInfo)
+          mb_w * (dec->mt_method_ == 3 ? num_rows :
+                  dec->mt_method_ > 0 ? 2 : 1) * sizeof(VP8FInfo)
         : 0;
-  const size_t yuv_size = YUV_SIZE * sizeof(*dec->yuv_b_);
+  const size_t yuv_size = num_rows * YUV_SIZE * sizeof(*dec->yuv_b_);
   const size_t mb_data_size =
-      (dec->mt_method_ == 2 ? 2 : 1) * mb_w * sizeof(*dec->mb_data_);
+      (dec->mt_method_ == 3 ? num_rows : dec->mt_method_ == 2 ? 2 : 1) *
+      mb_w * sizeof(*dec->mb_data_);
   const size_t cache_height = (16 * num_caches
                             + kFilterExtraRows[dec->filter_type_]) * 3 / 2;
-  const size_t cache_size = top_size * cache_height;
+  // no filtering at reduced size, the cache rows are just smaller
+  const size_t cache_size =
+      (top_size * cache_height) >> (2 * dec->scale_shift_);
   // alpha_size is the only one that scales as width x height.
   const uint64_t alpha_size = (dec->alpha_data_ != NULL) ?
       (uint64_t)dec->pic_hdr_.width_ * dec->pic_hdr_.height_ : 0ULL;
@@ -732,7 +1143,7 @@ static int AllocateMemory(VP8Decoder* const dec) {
   mem += f_info_size;
   dec->thread_ctx_.id_ = 0;
   dec->thread_ctx_.f_info_ = dec->f_info_;
-  if (dec->filter_type_ > 0 && dec->mt_method_ > 0) {
+  if (dec->filter_type_ > 0 && dec->mt_method_ > 0 && dec->mt_method_ != 3) {
     // secondary cache line. The deblocking process need to make use of the
     // filtering strength from previous macroblock row, while the new ones
     // are being decoded in parallel. We'll just swap the pointers.
@@ -751,17 +1162,29 @@ static int AllocateMemory(VP8Decoder* const dec) {
   }
   mem += mb_data_size;
 
-  dec->cache_y_stride_ = 16 * mb_w;
-  dec->cache_uv_stride_ = 8 * mb_w;
+  if (dec->mt_method_ == 3) {
+    int i;
+    for (i = 0; i < num_rows; ++i) {
+      VP8RowContext* const ctx = &dec->row_ctx_[i];
+      ctx->yuv_b_ = dec->yuv_b_ + i * YUV_SIZE;
+      ctx->mb_data_ = dec->mb_data_ + i * mb_w;
+      ctx->f_info_ = (dec->f_info_ != NULL) ? dec->f_info_ + i * mb_w : NULL;
+    }
+  }
+
+  dec->cache_y_stride_ = (16 * mb_w) >> dec->scale_shift_;
+  dec->cache_uv_stride_ = (8 * mb_w) >> dec->scale_shift_;
   {
+    const int mb_size = 16 >> dec->scale_shift_;
     const int extra_rows = kFilterExtraRows[dec->filter_type_];
     const int extra_y = extra_rows * dec->cache_y_stride_;
     const int extra_uv = (extra_rows / 2) * dec->cache_uv_stride_;
     dec->cache_y_ = mem + extra_y;
     dec->cache_u_ = dec->cache_y_
-                  + 16 * num_caches * dec->cache_y_stride_ + extra_uv;
+                  + mb_size * num_caches * dec->cache_y_stride_ + extra_uv;
     dec->cache_v_ = dec->cache_u_
-                  + 8 * num_caches * dec->cache_uv_stride_ + extra_uv;
+                  + (mb_size / 2) * num_caches * dec->cache_uv_stride_
+                  + extra_uv;
     dec->cache_id_ = 0;
   }
   mem += cache_size;
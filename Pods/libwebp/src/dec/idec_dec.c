@@ -24,6 +24,8 @@
 // Needs to be a power of 2.
 #define CHUNK_SIZE 4096
 #define MAX_MB_SIZE 4096
+// Maximum size of a raw VP8/VP8L bitstream (without chunk size information).
+#define MAX_RAW_DATA_SIZE ((1u << 31) - 1)
 
 //------------------------------------------------------------------------------
 // Data structures for memory and states
@@ -47,7 +49,8 @@ typedef enum {
 typedef enum {
   MEM_MODE_NONE = 0,
   MEM_MODE_APPEND,
-  MEM_MODE_MAP
+  MEM_MODE_MAP,
+  MEM_MODE_SEGMENTS
 } MemBufferMode;
 
 // storage for partition #0 and partial data (in a rolling fashion)
@@ -60,6 +63,18 @@ typedef struct {
 
   size_t part0_size_;         // size of partition #0
   const uint8_t* part0_buf_;  // buffer to store partition #0
+
+  // In MEM_MODE_SEGMENTS, start_ and end_ are input offsets, and the data is
+  // read in place from the caller's segments. The headers needing contiguous
+  // memory are read from a 'view' of the input, which is either one of the
+  // segments, or a copy gathered into buf_.
+  VP8InputSegments input_;    // segments received so far
+  int max_segments_;          // allocated size of input_.segments_
+  const uint8_t* view_;       // contiguous input data, from offset view_pos_
+  size_t view_pos_;
+  size_t view_size_;
+  uint8_t* hdr_buf_;          // gathered RIFF headers, kept for the alpha data
+  size_t data_end_;           // input offset of the end of the VP8/VP8L data
 } MemBuffer;
 
 struct WebPIDecoder {
@@ -92,6 +107,25 @@ static WEBP_INLINE size_t MemDataSize(const MemBuffer* mem) {
   return (mem->end_ - mem->start_);
 }
 
+// Returns the data at mem->start_. In MEM_MODE_SEGMENTS, it is only available
+// up to the end of the current view.
+static WEBP_INLINE const uint8_t* MemData(const MemBuffer* mem) {
+  if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    assert(mem->start_ >= mem->view_pos_);
+    assert(mem->start_ <= mem->view_pos_ + mem->view_size_);
+    return mem->view_ + (mem->start_ - mem->view_pos_);
+  }
+  return mem->buf_ + mem->start_;
+}
+
+// Returns the size of the contiguous data returned by MemData().
+static WEBP_INLINE size_t MemContiguousSize(const MemBuffer* mem) {
+  if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    return mem->view_pos_ + mem->view_size_ - mem->start_;
+  }
+  return MemDataSize(mem);
+}
+
 // Check if we need to preserve the compressed alpha data, as it may not have
 // been decoded yet.
 static int NeedCompressedAlpha(const WebPIDecoder* const idec) {
@@ -221,12 +255,124 @@ static int RemapMemBuffer(WebPIDecoder* const idec,
   return 1;
 }
 
+// Returns the input offset of the end of the segment holding offset 'pos'.
+static size_t SegmentEnd(const VP8InputSegments* const input, size_t pos) {
+  int i = 0;
+  while (pos >= input->segments_[i].pos_ + input->segments_[i].size_) ++i;
+  assert(i < input->num_segments_);
+  return input->segments_[i].pos_ + input->segments_[i].size_;
+}
+
+// Makes (at least) 'size' bytes of input from mem->start_ on available in
+// contiguous memory, for MemData(). They are read in place if they're all in
+// the same segment, otherwise they're gathered into mem->buf_. This is a no-op
+// except in MEM_MODE_SEGMENTS. Returns false in case of memory error.
+static int MemView(MemBuffer* const mem, size_t size) {
+  const VP8InputSegments* const input = &mem->input_;
+  const size_t pos = mem->start_;
+  size_t copied = 0;
+  int i = 0;
+  if (mem->mode_ != MEM_MODE_SEGMENTS) return 1;
+  assert(pos < mem->end_ && size <= mem->end_ - pos);
+  if (mem->view_ != NULL && pos >= mem->view_pos_ &&
+      pos + size <= mem->view_pos_ + mem->view_size_) {
+    return 1;   // already in view
+  }
+  if (mem->view_ != NULL && mem->view_ == mem->buf_ && mem->view_pos_ == pos) {
+    copied = mem->view_size_;   // extend the data gathered already
+  } else {
+    while (pos >= input->segments_[i].pos_ + input->segments_[i].size_) ++i;
+    if (pos + size <= input->segments_[i].pos_ + input->segments_[i].size_) {
+      mem->view_ = input->segments_[i].buf_;
+      mem->view_pos_ = input->segments_[i].pos_;
+      mem->view_size_ = input->segments_[i].size_;
+      return 1;
+    }
+  }
+  // The data straddles segments.
+  if (size > mem->buf_size_) {
+    const size_t new_size =
+        (size > 2 * mem->buf_size_) ? size : 2 * mem->buf_size_;
+    uint8_t* const new_buf =
+        (uint8_t*)WebPSafeMalloc(new_size, sizeof(*new_buf));
+    if (new_buf == NULL) return 0;
+    if (copied > 0) memcpy(new_buf, mem->buf_, copied);
+    WebPSafeFree(mem->buf_);
+    mem->buf_ = new_buf;
+    mem->buf_size_ = new_size;
+  }
+  while (pos + copied >= input->segments_[i].pos_ + input->segments_[i].size_) {
+    ++i;
+  }
+  for (; copied < size; ++i) {
+    const VP8InputSegment* const segment = &input->segments_[i];
+    const size_t offset = pos + copied - segment->pos_;
+    size_t len = segment->size_ - offset;
+    if (len > size - copied) len = size - copied;
+    memcpy(mem->buf_ + copied, segment->buf_ + offset, len);
+    copied += len;
+  }
+  mem->view_ = mem->buf_;
+  mem->view_pos_ = pos;
+  mem->view_size_ = size;
+  return 1;
+}
+
+// Appends the segments to the input, without copying their data.
+static int AddToMemSegments(MemBuffer* const mem,
+                            const WebPISegment* const segments,
+                            int num_segments) {
+  VP8InputSegments* const input = &mem->input_;
+  int i;
+  assert(mem->mode_ == MEM_MODE_SEGMENTS);
+  if (num_segments > mem->max_segments_ - input->num_segments_) {
+    const uint64_t needed = (uint64_t)input->num_segments_ + num_segments;
+    const uint64_t new_max =
+        (needed > 2ULL * mem->max_segments_) ? needed + 16
+                                             : 2ULL * mem->max_segments_;
+    VP8InputSegment* new_segments;
+    if (new_max > INT_MAX) return 0;
+    new_segments = (VP8InputSegment*)WebPSafeMalloc(new_max,
+                                                    sizeof(*new_segments));
+    if (new_segments == NULL) return 0;
+    if (input->num_segments_ > 0) {
+      memcpy(new_segments, input->segments_,
+             input->num_segments_ * sizeof(*new_segments));
+    }
+    WebPSafeFree(input->segments_);
+    input->segments_ = new_segments;
+    mem->max_segments_ = (int)new_max;
+  }
+  for (i = 0; i < num_segments; ++i) {
+    VP8InputSegment* segment;
+    if (segments[i].size == 0) continue;
+    if (segments[i].size > MAX_CHUNK_PAYLOAD - mem->end_) {
+      // security safeguard: more data than what the format allows.
+      return 0;
+    }
+    segment = &input->segments_[input->num_segments_++];
+    segment->buf_ = segments[i].data;
+    segment->size_ = segments[i].size;
+    segment->pos_ = mem->end_;
+    mem->end_ += segments[i].size;
+  }
+  return 1;
+}
+
 static void InitMemBuffer(MemBuffer* const mem) {
   mem->mode_       = MEM_MODE_NONE;
   mem->buf_        = NULL;
   mem->buf_size_   = 0;
   mem->part0_buf_  = NULL;
   mem->part0_size_ = 0;
+  mem->input_.segments_ = NULL;
+  mem->input_.num_segments_ = 0;
+  mem->max_segments_ = 0;
+  mem->view_ = NULL;
+  mem->view_pos_ = 0;
+  mem->view_size_ = 0;
+  mem->hdr_buf_ = NULL;
+  mem->data_end_ = 0;
 }
 
 static void ClearMemBuffer(MemBuffer* const mem) {
@@ -234,6 +380,10 @@ static void ClearMemBuffer(MemBuffer* const mem) {
   if (mem->mode_ == MEM_MODE_APPEND) {
     WebPSafeFree(mem->buf_);
     WebPSafeFree((void*)mem->part0_buf_);
+  } else if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    WebPSafeFree(mem->buf_);
+    WebPSafeFree(mem->hdr_buf_);
+    WebPSafeFree(mem->input_.segments_);
   }
 }
 
@@ -300,27 +450,52 @@ static void ChangeState(WebPIDecoder* const idec, DecState new_state,
   idec->state_ = new_state;
   mem->start_ += consumed_bytes;
   assert(mem->start_ <= mem->end_);
-  idec->io_.data = mem->buf_ + mem->start_;
+  idec->io_.data = MemData(mem);
   idec->io_.data_size = MemDataSize(mem);
 }
 
 // Headers
 static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
   MemBuffer* const mem = &idec->mem_;
-  const uint8_t* data = mem->buf_ + mem->start_;
-  size_t curr_size = MemDataSize(mem);
   VP8StatusCode status;
   WebPHeaderStructure headers;
 
-  headers.data = data;
-  headers.data_size = curr_size;
-  headers.have_all_data = 0;
-  status = WebPParseHeaders(&headers);
+  if (MemDataSize(mem) == 0) return VP8_STATUS_SUSPENDED;
+  if (!MemView(mem, 0)) return IDecError(idec, VP8_STATUS_OUT_OF_MEMORY);
+  while (1) {
+    headers.data = MemData(mem);
+    headers.data_size = MemContiguousSize(mem);
+    headers.have_all_data = 0;
+    status = WebPParseHeaders(&headers);
+    if (status != VP8_STATUS_NOT_ENOUGH_DATA ||
+        MemContiguousSize(mem) == MemDataSize(mem)) {
+      break;
+    }
+    // The headers straddle segments: extend the view to the next one.
+    assert(mem->mode_ == MEM_MODE_SEGMENTS);
+    {
+      const size_t view_end = mem->start_ + MemContiguousSize(mem);
+      const size_t size = SegmentEnd(&mem->input_, view_end) - mem->start_;
+      if (!MemView(mem, size)) {
+        return IDecError(idec, VP8_STATUS_OUT_OF_MEMORY);
+      }
+    }
+  }
   if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
     return VP8_STATUS_SUSPENDED;  // We haven't found a VP8 chunk yet.
   } else if (status != VP8_STATUS_OK) {
     return IDecError(idec, status);
   }
+  if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    if (mem->view_ == mem->buf_) {
+      // Keep the gathered headers, the alpha data might point to them.
+      mem->hdr_buf_ = mem->buf_;
+      mem->buf_ = NULL;
+      mem->buf_size_ = 0;
+    }
+    mem->data_end_ = mem->start_ + headers.offset +
+        ((headers.offset > 0) ? headers.compressed_size : MAX_RAW_DATA_SIZE);
+  }
 
   idec->chunk_size_ = headers.compressed_size;
   idec->is_lossless_ = headers.is_lossless;
@@ -345,15 +520,20 @@ static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
 }
 
 static VP8StatusCode DecodeVP8FrameHeader(WebPIDecoder* const idec) {
-  const uint8_t* data = idec->mem_.buf_ + idec->mem_.start_;
-  const size_t curr_size = MemDataSize(&idec->mem_);
+  const uint8_t* data;
+  size_t curr_size;
   int width, height;
   uint32_t bits;
 
-  if (curr_size < VP8_FRAME_HEADER_SIZE) {
+  if (MemDataSize(&idec->mem_) < VP8_FRAME_HEADER_SIZE) {
     // Not enough data bytes to extract VP8 Frame Header.
     return VP8_STATUS_SUSPENDED;
   }
+  if (!MemView(&idec->mem_, VP8_FRAME_HEADER_SIZE)) {
+    return IDecError(idec, VP8_STATUS_OUT_OF_MEMORY);
+  }
+  data = MemData(&idec->mem_);
+  curr_size = MemContiguousSize(&idec->mem_);
   if (!VP8GetInfo(data, curr_size, idec->chunk_size_, &width, &height)) {
     return IDecError(idec, VP8_STATUS_BITSTREAM_ERROR);
   }
@@ -406,6 +586,22 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
   if (MemDataSize(&idec->mem_) < idec->mem_.part0_size_) {
     return VP8_STATUS_SUSPENDED;
   }
+  if (idec->mem_.mode_ == MEM_MODE_SEGMENTS) {
+    // Partition #0 and the sizes of the token partitions must be contiguous.
+    // The token partitions are read in place.
+    MemBuffer* const mem = &idec->mem_;
+    size_t size = mem->part0_size_ + 3 * (MAX_NUM_PARTITIONS - 1);
+    if (mem->data_end_ < mem->start_ + size) {
+      size = (mem->data_end_ > mem->start_) ? mem->data_end_ - mem->start_ : 0;
+    }
+    if (MemDataSize(mem) < size) return VP8_STATUS_SUSPENDED;
+    if (!MemView(mem, size)) return IDecError(idec, VP8_STATUS_OUT_OF_MEMORY);
+    io->data = MemData(mem);
+    io->data_size = MemContiguousSize(mem);
+    dec->input_ = &mem->input_;
+    dec->input_pos_ = mem->start_;
+    dec->input_end_ = mem->data_end_;
+  }
 
   if (!VP8GetHeaders(dec, io)) {
     const VP8StatusCode status = dec->status_;
@@ -426,6 +622,7 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
   // This change must be done before calling VP8InitFrame()
   dec->mt_method_ = VP8GetThreadMethod(params->options, NULL,
                                        io->width, io->height);
+  dec->scale_shift_ = WebPGetScaleShift(params->options);
   VP8InitDithering(params->options, dec);
 
   dec->status_ = CopyParts0Data(idec);
@@ -489,7 +686,12 @@ static VP8StatusCode DecodeRemaining(WebPIDecoder* const idec) {
       }
       // Release buffer only if there is only one partition
       if (dec->num_parts_minus_one_ == 0) {
-        idec->mem_.start_ = token_br->buf_ - idec->mem_.buf_;
+        if (idec->mem_.mode_ == MEM_MODE_SEGMENTS) {
+          idec->mem_.start_ = token_br->next_pos_ -
+                              (size_t)(token_br->buf_end_ - token_br->buf_);
+        } else {
+          idec->mem_.start_ = token_br->buf_ - idec->mem_.buf_;
+        }
         assert(idec->mem_.start_ <= idec->mem_.end_);
       }
     }
@@ -531,6 +733,12 @@ static VP8StatusCode DecodeVP8LHeader(WebPIDecoder* const idec) {
     return ErrorStatusLossless(idec, dec->status_);
   }
 
+  if (idec->mem_.mode_ == MEM_MODE_SEGMENTS) {
+    // The bitstream is read in place.
+    dec->input_ = &idec->mem_.input_;
+    dec->input_pos_ = idec->mem_.start_;
+    io->data_size = idec->mem_.data_end_ - idec->mem_.start_;
+  }
   if (!VP8LDecodeHeader(dec, io)) {
     if (dec->status_ == VP8_STATUS_BITSTREAM_ERROR &&
         curr_size < idec->chunk_size_) {
@@ -820,6 +1028,35 @@ VP8StatusCode WebPIUpdate(WebPIDecoder* idec,
   return IDecode(idec);
 }
 
+VP8StatusCode WebPIAppendSegments(WebPIDecoder* idec,
+                                  const WebPISegment* segments,
+                                  int num_segments) {
+  VP8StatusCode status;
+  int i;
+  if (idec == NULL || num_segments < 0 ||
+      (segments == NULL && num_segments > 0)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  for (i = 0; i < num_segments; ++i) {
+    if (segments[i].data == NULL && segments[i].size > 0) {
+      return VP8_STATUS_INVALID_PARAM;
+    }
+  }
+  status = IDecCheckStatus(idec);
+  if (status != VP8_STATUS_SUSPENDED) {
+    return status;
+  }
+  // Check mixed calls with the other modes.
+  if (!CheckMemBufferMode(&idec->mem_, MEM_MODE_SEGMENTS)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  // Reference the segments, which are read in place.
+  if (!AddToMemSegments(&idec->mem_, segments, num_segments)) {
+    return VP8_STATUS_OUT_OF_MEMORY;
+  }
+  return IDecode(idec);
+}
+
 //------------------------------------------------------------------------------
 
 static const WebPDecBuffer* GetOutputBuffer(const WebPIDecoder* const idec) {
@@ -59,6 +59,13 @@ VP8Decoder* VP8New(void) {
   if (dec != NULL) {
     SetOk(dec);
     WebPGetWorkerInterface()->Init(&dec->worker_);
+    WebPGetWorkerInterface()->Init(&dec->alpha_worker_);
+    {
+      int i;
+      for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+        WebPGetWorkerInterface()->Init(&dec->row_ctx_[i].worker_);
+      }
+    }
     dec->ready_ = 0;
     dec->num_parts_minus_one_ = 0;
     InitGetCoeffs();
@@ -198,8 +205,10 @@ static int ParseSegmentHeader(VP8BitReader* br,
 // If we don't even have the partitions' sizes, than VP8_STATUS_NOT_ENOUGH_DATA
 // is returned, and this is an unrecoverable error.
 // If the partitions were positioned ok, VP8_STATUS_OK is returned.
+// 'buf' is at input offset 'pos', when reading from a scattered input.
 static VP8StatusCode ParsePartitions(VP8Decoder* const dec,
-                                     const uint8_t* buf, size_t size) {
+                                     const uint8_t* buf, size_t size,
+                                     size_t pos) {
   VP8BitReader* const br = &dec->br_;
   const uint8_t* sz = buf;
   const uint8_t* buf_end = buf + size;
@@ -216,6 +225,23 @@ static VP8StatusCode ParsePartitions(VP8Decoder* const dec,
   }
   part_start = buf + last_part * 3;
   size_left -= last_part * 3;
+  if (dec->input_ != NULL) {
+    // The partitions are read in place, whether they were received or not.
+    pos += last_part * 3;
+    if (pos > dec->input_end_) return VP8_STATUS_BITSTREAM_ERROR;
+    size_left = dec->input_end_ - pos;
+    for (p = 0; p < last_part; ++p) {
+      size_t psize = sz[0] | (sz[1] << 8) | (sz[2] << 16);
+      if (psize > size_left) psize = size_left;
+      VP8InitBitReaderSegments(dec->parts_ + p, dec->input_, pos, psize);
+      pos += psize;
+      size_left -= psize;
+      sz += 3;
+    }
+    VP8InitBitReaderSegments(dec->parts_ + last_part, dec->input_,
+                             pos, size_left);
+    return VP8_STATUS_OK;
+  }
   for (p = 0; p < last_part; ++p) {
     size_t psize = sz[0] | (sz[1] << 8) | (sz[2] << 16);
     if (psize > size_left) psize = size_left;
@@ -367,7 +393,8 @@ int VP8GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
     return VP8SetError(dec, VP8_STATUS_BITSTREAM_ERROR,
                        "cannot parse filter header");
   }
-  status = ParsePartitions(dec, buf, buf_size);
+  status = ParsePartitions(dec, buf, buf_size,
+                           dec->input_pos_ + (size_t)(buf - io->data));
   if (status != VP8_STATUS_OK) {
     return VP8SetError(dec, status, "cannot parse partitions");
   }
@@ -508,14 +535,14 @@ static WEBP_INLINE uint32_t NzCodeBits(uint32_t nz_coeffs, int nz, int dc_nz) {
   return nz_coeffs;
 }
 
-static int ParseResiduals(VP8Decoder* const dec,
-                          VP8MB* const mb, VP8BitReader* const token_br) {
-  const VP8BandProbas* (* const bands)[16 + 1] = dec->proba_.bands_ptr_;
+static int ParseResiduals(const VP8Decoder* const dec,
+                          VP8MB* const mb, VP8MB* const left_mb,
+                          VP8MBData* const block,
+                          VP8BitReader* const token_br) {
+  const VP8BandProbas* const (* const bands)[16 + 1] = dec->proba_.bands_ptr_;
   const VP8BandProbas* const * ac_proba;
-  VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
   const VP8QuantMatrix* const q = &dec->dqm_[block->segment_];
   int16_t* dst = block->coeffs_;
-  VP8MB* const left_mb = dec->mb_info_ - 1;
   uint8_t tnz, lnz;
   uint32_t non_zero_y = 0;
   uint32_t non_zero_uv = 0;
@@ -602,14 +629,14 @@ static int ParseResiduals(VP8Decoder* const dec,
 //------------------------------------------------------------------------------
 // Main loop
 
-int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
-  VP8MB* const left = dec->mb_info_ - 1;
-  VP8MB* const mb = dec->mb_info_ + dec->mb_x_;
-  VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
+static int DecodeMB(const VP8Decoder* const dec,
+                    VP8MB* const left, VP8MB* const mb,
+                    VP8MBData* const block, VP8FInfo* const finfo,
+                    VP8BitReader* const token_br) {
   int skip = dec->use_skip_proba_ ? block->skip_ : 0;
 
   if (!skip) {
-    skip = ParseResiduals(dec, mb, token_br);
+    skip = ParseResiduals(dec, mb, left, block, token_br);
   } else {
     left->nz_ = mb->nz_ = 0;
     if (!block->is_i4x4_) {
@@ -621,7 +648,6 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   }
 
   if (dec->filter_type_ > 0) {  // store filter info
-    VP8FInfo* const finfo = dec->f_info_ + dec->mb_x_;
     *finfo = dec->fstrengths_[block->segment_][block->is_i4x4_];
     finfo->f_inner_ |= !skip;
   }
@@ -629,6 +655,26 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   return !token_br->eof_;
 }
 
+int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
+  VP8FInfo* const finfo =
+      (dec->filter_type_ > 0) ? dec->f_info_ + dec->mb_x_ : NULL;
+  return DecodeMB(dec, dec->mb_info_ - 1, dec->mb_info_ + dec->mb_x_,
+                  dec->mb_data_ + dec->mb_x_, finfo, token_br);
+}
+
+int VP8DecodeMBs(const VP8Decoder* const dec, VP8MB* const left,
+                 VP8MBData* const mb_data, VP8FInfo* const f_info,
+                 VP8BitReader* const token_br, int mb_x, int mb_x_end) {
+  for (; mb_x < mb_x_end; ++mb_x) {
+    VP8FInfo* const finfo = (f_info != NULL) ? f_info + mb_x : NULL;
+    if (!DecodeMB(dec, left, dec->mb_info_ + mb_x, mb_data + mb_x, finfo,
+                  token_br)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 void VP8InitScanline(VP8Decoder* const dec) {
   VP8MB* const left = dec->mb_info_ - 1;
   left->nz_ = 0;
@@ -638,6 +684,9 @@ void VP8InitScanline(VP8Decoder* const dec) {
 }
 
 static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
+  if (dec->mt_method_ == 3) {
+    return VP8DecodeWavefront(dec, io);
+  }
   for (dec->mb_y_ = 0; dec->mb_y_ < dec->br_mb_y_; ++dec->mb_y_) {
     // Parse bitstream for this row.
     VP8BitReader* const token_br =
@@ -687,8 +736,19 @@ int VP8Decode(VP8Decoder* const dec, VP8Io* const io) {
   // Finish setting up the decoding parameter. Will call io->setup().
   ok = (VP8EnterCritical(dec, io) == VP8_STATUS_OK);
   if (ok) {   // good to go.
+    // Rows of different token partitions can be decoded concurrently. This is
+    // only possible when the whole frame is available (not incrementally), and
+    // without dithering which alters the samples used by the next row.
+    if (dec->mt_method_ == 2 && dec->num_parts_minus_one_ > 0 &&
+        !dec->dither_) {
+      dec->mt_method_ = 3;
+    }
+    // Likewise, the alpha plane can be decoded ahead on its own thread.
+    dec->alpha_mt_ = (dec->mt_method_ > 0 && dec->alpha_data_ != NULL &&
+                      !dec->is_alpha_decoded_);
     // Will allocate memory and prepare everything.
     if (ok) ok = VP8InitFrame(dec, io);
+    if (ok && dec->alpha_mt_) VP8StartAlphaDecoding(dec, io);
 
     // Main decoding loop
     if (ok) ok = ParseFrame(dec, io);
@@ -711,6 +771,12 @@ void VP8Clear(VP8Decoder* const dec) {
     return;
   }
   WebPGetWorkerInterface()->End(&dec->worker_);
+  {
+    int i;
+    for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+      WebPGetWorkerInterface()->End(&dec->row_ctx_[i].worker_);
+    }
+  }
   WebPDeallocateAlphaMemory(dec);
   WebPSafeFree(dec->mem_);
   dec->mem_ = NULL;
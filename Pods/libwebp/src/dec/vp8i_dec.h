@@ -169,8 +169,23 @@ typedef struct {
   VP8FInfo* f_info_;    // filter strengths (swapped with dec->f_info_)
   VP8MBData* mb_data_;  // reconstruction data (swapped with dec->mb_data_)
   VP8Io io_;            // copy of the VP8Io to pass to put()
+  int mb_y_end_;        // end of the rows to emit (wavefront mode only)
 } VP8ThreadContext;
 
+// Per-partition row decoder used by the wavefront mode (mt_method_ == 3).
+// Row 'mb_y_' only uses the token partition 'mb_y_ % num_partitions', so each
+// of these owns one partition and processes every num_partitions-th row.
+typedef struct {
+  WebPWorker worker_;   // parse + reconstruct + filter of the current chunk
+  int mb_y_;            // row being decoded, or -1 if idle
+  int mb_x_;            // next macroblock to decode in the row
+  int mb_x_end_;        // end of the chunk to decode during the current step
+  VP8MB left_;          // left residual context
+  VP8MBData* mb_data_;  // reconstruction data for the row
+  VP8FInfo* f_info_;    // filter strengths for the row
+  uint8_t* yuv_b_;      // work block for Y/U/V (size = YUV_SIZE)
+} VP8RowContext;
+
 // Saved top samples, per macroblock. Fits into a cache-line.
 typedef struct {
   uint8_t y[16], u[8], v[8];
@@ -197,9 +212,11 @@ struct VP8Decoder {
   WebPWorker worker_;
   int mt_method_;      // multi-thread method: 0=off, 1=[parse+recon][filter]
                        // 2=[parse][recon+filter]
+                       // 3=[parse+recon+filter] per partition, [output]
   int cache_id_;       // current cache row
-  int num_caches_;     // number of cached rows of 16 pixels (1, 2 or 3)
+  int num_caches_;     // number of cached rows of 16 pixels
   VP8ThreadContext thread_ctx_;  // Thread context
+  VP8RowContext row_ctx_[MAX_NUM_PARTITIONS];  // wavefront row decoders
 
   // dimension, in macroblock units.
   int mb_w_, mb_h_;
@@ -212,6 +229,19 @@ struct VP8Decoder {
   uint32_t num_parts_minus_one_;
   // per-partition boolean decoders.
   VP8BitReader parts_[MAX_NUM_PARTITIONS];
+  // Scattered input of the incremental decoder, or NULL. If set, the token
+  // partitions are read in place from it, io->data being at offset
+  // 'input_pos_' and the VP8 data ending at 'input_end_'.
+  const VP8InputSegments* input_;
+  size_t input_pos_, input_end_;
+
+  // Reduced-size decoding: macroblocks are output as (16 >> scale_shift_)
+  // pixels wide blocks, with approximate residuals and no in-loop filtering.
+  int scale_shift_;
+
+  // If not NULL, the average Y, U and V samples of each macroblock are stored
+  // there (4 bytes per macroblock, in raster order) for the preview output.
+  uint8_t* preview_;
 
   // Dithering strength, deduced from decoding options
   int dither_;                // whether to use dithering or not
@@ -262,6 +292,13 @@ struct VP8Decoder {
   uint8_t* alpha_plane_;      // output. Persistent, contains the whole data.
   const uint8_t* alpha_prev_line_;  // last decoded alpha row (or NULL)
   int alpha_dithering_;       // derived from decoding options (0=off, 100=full)
+  uint8_t* alpha_scaled_plane_;  // reduced-size output, if scale_shift_ > 0
+  // Concurrent alpha decoding, only used when the whole frame is available.
+  int alpha_mt_;              // true if alpha_worker_ decodes the alpha plane
+  WebPWorker alpha_worker_;   // decodes bands of alpha rows ahead of output
+  int alpha_height_;          // number of rows of the decoded plane
+  int alpha_rows_done_;       // rows decoded by the bands already synced
+  int alpha_band_end_;        // end of the band being decoded (if > done)
 };
 
 //------------------------------------------------------------------------------
@@ -291,7 +328,8 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io);
 // Returns false in case of error.
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io);
 // Return the multi-threading method to use (0=off), depending
-// on options and bitstream size. Only for lossy decoding.
+// on options and bitstream size. For lossless decoding, it is the
+// VP8LDecoder's mt_method_ (1=pipelined), otherwise the VP8Decoder's one.
 int VP8GetThreadMethod(const WebPDecoderOptions* const options,
                        const WebPHeaderStructure* const headers,
                        int width, int height);
@@ -300,15 +338,30 @@ void VP8InitDithering(const WebPDecoderOptions* const options,
                       VP8Decoder* const dec);
 // Process the last decoded row (filtering + output).
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io);
+// Decode the whole frame with the wavefront method (mt_method_ == 3): rows of
+// the different token partitions are parsed, reconstructed and filtered
+// concurrently, each row trailing the previous one by two macroblocks.
+int VP8DecodeWavefront(VP8Decoder* const dec, VP8Io* const io);
 // To be called at the start of a new scanline, to initialize predictors.
 void VP8InitScanline(VP8Decoder* const dec);
 // Decode one macroblock. Returns false if there is not enough data.
 int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br);
+// Decode the residuals of macroblocks [mb_x, mb_x_end) of a row whose intra
+// modes are already parsed in 'mb_data', using explicit left context and
+// filter-info storage ('f_info' is unused if filtering is off). Returns false
+// if there is not enough data.
+int VP8DecodeMBs(const VP8Decoder* const dec, VP8MB* const left,
+                 VP8MBData* const mb_data, VP8FInfo* const f_info,
+                 VP8BitReader* const token_br, int mb_x, int mb_x_end);
 
 // in alpha.c
 const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       const VP8Io* const io,
                                       int row, int num_rows);
+// Set up the alpha decoding of a frame and start decoding the first rows on
+// dec->alpha_worker_ (dec->alpha_mt_ must be set). Returns false, with
+// dec->alpha_mt_ cleared, if the plane is to be decoded inline instead.
+int VP8StartAlphaDecoding(VP8Decoder* const dec, const VP8Io* const io);
 
 //------------------------------------------------------------------------------
 
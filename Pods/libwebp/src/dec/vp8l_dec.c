@@ -779,6 +779,45 @@ static void ApplyInverseTransforms(VP8LDecoder* const dec,
   }
 }
 
+// Adds the transformed ARGB rows [row, row + num_rows) to the sums of the
+// preview blocks, and outputs the averages of each completed row of blocks.
+static void AccumulatePreview(VP8LDecoder* const dec, const uint32_t* argb,
+                              int row, int num_rows) {
+  const int width = dec->width_;
+  const int preview_width = (width + 15) >> 4;
+  uint32_t* const sums = dec->preview_sums_;
+  int x, y;
+  for (y = row; y < row + num_rows; ++y, argb += width) {
+    for (x = 0; x < preview_width; ++x) {
+      // The 16 samples of each channel are summed within 16-bit lanes.
+      const int end = (16 * x + 16 < width) ? 16 * x + 16 : width;
+      uint32_t ag = 0, rb = 0;
+      int i;
+      for (i = 16 * x; i < end; ++i) {
+        ag += (argb[i] >> 8) & 0x00ff00ffu;
+        rb += (argb[i] >> 0) & 0x00ff00ffu;
+      }
+      sums[4 * x + 0] += rb >> 16;
+      sums[4 * x + 1] += ag & 0xffff;
+      sums[4 * x + 2] += rb & 0xffff;
+      sums[4 * x + 3] += ag >> 16;
+    }
+    if ((y & 15) == 15 || y == dec->height_ - 1) {
+      uint8_t* const dst = dec->preview_ + 4 * preview_width * (y >> 4);
+      const int block_h = (y & 15) + 1;
+      for (x = 0; x < preview_width; ++x) {
+        const int block_w = (x < preview_width - 1) ? 16 : width - 16 * x;
+        const uint32_t count = (uint32_t)(block_w * block_h);
+        int c;
+        for (c = 0; c < 4; ++c) {
+          dst[4 * x + c] = (uint8_t)((sums[4 * x + c] + count / 2) / count);
+          sums[4 * x + c] = 0;
+        }
+      }
+    }
+  }
+}
+
 // Processes (transforms, scales & color-converts) the rows decoded after the
 // last call.
 static void ProcessRows(VP8LDecoder* const dec, int row) {
@@ -794,6 +833,9 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
     uint8_t* rows_data = (uint8_t*)dec->argb_cache_;
     const int in_stride = io->width * sizeof(uint32_t);  // in unit of RGBA
     ApplyInverseTransforms(dec, dec->last_row_, num_rows, rows);
+    if (dec->preview_ != NULL) {
+      AccumulatePreview(dec, dec->argb_cache_, dec->last_row_, num_rows);
+    }
     if (!SetCropWindow(io, dec->last_row_, row, &rows_data, in_stride)) {
       // Nothing to output (this time).
     } else {
@@ -826,6 +868,24 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
   assert(dec->last_row_ <= dec->height_);
 }
 
+// Multi-threaded variant: the rows are processed by dec->worker_ while the
+// entropy decoding of the next rows goes on. The worker only reads the already
+// decoded part of dec->pixels_, and owns everything downstream of it
+// (argb_cache_, rescaler, output). One batch of rows is in flight at a time.
+static int ProcessRowsHook(void* arg1, void* arg2) {
+  VP8LDecoder* const dec = (VP8LDecoder*)arg1;
+  (void)arg2;
+  ProcessRows(dec, dec->process_row_);
+  return 1;
+}
+
+static void ProcessRowsMT(VP8LDecoder* const dec, int row) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  winterface->Sync(&dec->worker_);   // wait for the previous batch
+  dec->process_row_ = row;
+  winterface->Launch(&dec->worker_);
+}
+
 // Row-processing for the special case when alpha data contains only one
 // transform (color indexing), and trivial non-green literals.
 static int Is8bOptimizable(const VP8LMetadata* const hdr) {
@@ -1373,6 +1433,7 @@ VP8LDecoder* VP8LNew(void) {
   if (dec == NULL) return NULL;
   dec->status_ = VP8_STATUS_OK;
   dec->state_ = READ_DIM;
+  WebPGetWorkerInterface()->Init(&dec->worker_);
 
   VP8LDspInit();  // Init critical function pointers.
 
@@ -1382,6 +1443,8 @@ VP8LDecoder* VP8LNew(void) {
 void VP8LClear(VP8LDecoder* const dec) {
   int i;
   if (dec == NULL) return;
+  // Stop the worker before releasing the buffers it may be using.
+  WebPGetWorkerInterface()->End(&dec->worker_);
   ClearMetadata(&dec->hdr_);
 
   WebPSafeFree(dec->pixels_);
@@ -1649,7 +1712,12 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
 
   dec->io_ = io;
   dec->status_ = VP8_STATUS_OK;
-  VP8LInitBitReader(&dec->br_, io->data, io->data_size);
+  if (dec->input_ != NULL) {
+    VP8LInitBitReaderSegments(&dec->br_, dec->input_, dec->input_pos_,
+                              io->data_size);
+  } else {
+    VP8LInitBitReader(&dec->br_, io->data, io->data_size);
+  }
   if (!ReadImageInfo(&dec->br_, &width, &height, &has_alpha)) {
     dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
     goto Error;
@@ -1687,7 +1755,16 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
     dec->output_ = params->output;
     assert(dec->output_ != NULL);
 
-    if (!WebPIoInitFromOptions(params->options, io, MODE_BGRA)) {
+    if (WebPGetScaleShift(params->options) != 0) {
+      // No reduced-size decoding: the rescaler does the downscaling.
+      WebPDecoderOptions options;
+      if (!WebPScaleDownOptions(params->options, io->width, io->height,
+                                &options) ||
+          !WebPIoInitFromOptions(&options, io, MODE_BGRA)) {
+        dec->status_ = VP8_STATUS_INVALID_PARAM;
+        goto Err;
+      }
+    } else if (!WebPIoInitFromOptions(params->options, io, MODE_BGRA)) {
       dec->status_ = VP8_STATUS_INVALID_PARAM;
       goto Err;
     }
@@ -1721,14 +1798,28 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
         }
       }
     }
+    if (dec->mt_method_ > 0) {
+      WebPWorker* const worker = &dec->worker_;
+      if (!WebPGetWorkerInterface()->Reset(worker)) {
+        dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+        goto Err;
+      }
+      worker->data1 = dec;
+      worker->data2 = NULL;
+      worker->hook = ProcessRowsHook;
+    }
     dec->state_ = READ_DATA;
   }
 
   // Decode.
   if (!DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
-                       io->crop_bottom, ProcessRows)) {
+                       io->crop_bottom,
+                       (dec->mt_method_ > 0) ? ProcessRowsMT : ProcessRows)) {
     goto Err;
   }
+  if (dec->mt_method_ > 0) {
+    WebPGetWorkerInterface()->Sync(&dec->worker_);  // wait for the last rows
+  }
 
   params->last_y = dec->last_out_row_;
   return 1;
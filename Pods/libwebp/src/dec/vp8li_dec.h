@@ -20,6 +20,7 @@
 #include "src/utils/bit_reader_utils.h"
 #include "src/utils/color_cache_utils.h"
 #include "src/utils/huffman_utils.h"
+#include "src/utils/thread_utils.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +71,10 @@ struct VP8LDecoder {
   int              incremental_;   // if true, incremental decoding is expected
   VP8LBitReader    saved_br_;      // note: could be local variables too
   int              saved_last_pixel_;
+  // Scattered input of the incremental decoder (or NULL), read in place from
+  // offset 'input_pos_' on instead of io->data.
+  const VP8InputSegments* input_;
+  size_t           input_pos_;
 
   int              width_;
   int              height_;
@@ -79,6 +84,17 @@ struct VP8LDecoder {
                                    // color-converted yet.
   int              last_out_row_;  // last row output so far.
 
+  // Worker
+  WebPWorker       worker_;        // applies the transforms and emits the rows
+  int              mt_method_;     // multi-thread method: 0=off,
+                                   // 1=[entropy decoding][transforms+output]
+  int              process_row_;   // row up to which the worker processes.
+
+  // Preview output (if not NULL): one RGBA pixel per 16x16 block, accumulated
+  // in 'preview_sums_' (4 sums per block column) as the rows are processed.
+  uint8_t*         preview_;
+  uint32_t*        preview_sums_;
+
   VP8LMetadata     hdr_;
 
   int              next_transform_;
@@ -16,6 +16,7 @@
 #include "src/dec/vp8i_dec.h"
 #include "src/dec/vp8li_dec.h"
 #include "src/dec/webpi_dec.h"
+#include "src/dsp/yuv.h"
 #include "src/utils/utils.h"
 #include "src/webp/mux_types.h"  // ALPHA_FLAG
 
@@ -440,6 +441,61 @@ void WebPResetDecParams(WebPDecParams* const params) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Preview
+
+// Allocates the preview samples for a 'width' x 'height' picture.
+static VP8StatusCode AllocatePreview(int width, int height,
+                                     WebPPreview* const preview) {
+  preview->width = (width + 15) >> 4;
+  preview->height = (height + 15) >> 4;
+  preview->rgba = (uint8_t*)WebPSafeMalloc(
+      (uint64_t)preview->width * preview->height, 4 * sizeof(*preview->rgba));
+  return (preview->rgba == NULL) ? VP8_STATUS_OUT_OF_MEMORY : VP8_STATUS_OK;
+}
+
+// Converts the per-macroblock YUV averages stored by the lossy decoder into
+// RGBA, in place. The alpha values are averaged from the decoded alpha plane.
+static void FinishVP8Preview(const VP8Decoder* const dec,
+                             WebPPreview* const preview) {
+  const int width = dec->pic_hdr_.width_;
+  const int height = dec->pic_hdr_.height_;
+  const uint8_t* const alpha =
+      (dec->alpha_data_ != NULL) ? dec->alpha_plane_ : NULL;
+  int x, y, j;
+  for (y = 0; y < preview->height; ++y) {
+    uint8_t* const dst = preview->rgba + 4 * y * preview->width;
+    for (x = 0; x < preview->width; ++x) {
+      VP8YuvToRgb(dst[4 * x + 0], dst[4 * x + 1], dst[4 * x + 2], dst + 4 * x);
+      dst[4 * x + 3] = 0xff;
+    }
+    if (alpha != NULL) {
+      const int y0 = 16 * y;
+      const int y1 = (y0 + 16 < height) ? y0 + 16 : height;
+      for (x = 0; x < preview->width; ++x) {
+        const int x0 = 16 * x;
+        const int x1 = (x0 + 16 < width) ? x0 + 16 : width;
+        const int count = (x1 - x0) * (y1 - y0);
+        int sum = count >> 1;
+        for (j = y0; j < y1; ++j) {
+          const uint8_t* const src = alpha + j * width;
+          int i;
+          for (i = x0; i < x1; ++i) sum += src[i];
+        }
+        dst[4 * x + 3] = (uint8_t)(sum / count);
+      }
+    }
+  }
+}
+
+void WebPFreePreview(WebPPreview* preview) {
+  if (preview != NULL) {
+    WebPSafeFree(preview->rgba);
+    preview->rgba = NULL;
+    preview->width = preview->height = 0;
+  }
+}
+
 //------------------------------------------------------------------------------
 // "Into" decoding variants
 
@@ -479,13 +535,20 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
       // Allocate/check output buffers.
       status = WebPAllocateDecBuffer(io.width, io.height, params->options,
                                      params->output);
+      if (status == VP8_STATUS_OK && params->preview != NULL) {
+        status = AllocatePreview(io.width, io.height, params->preview);
+        dec->preview_ = params->preview->rgba;
+      }
       if (status == VP8_STATUS_OK) {  // Decode
         // This change must be done before calling VP8Decode()
         dec->mt_method_ = VP8GetThreadMethod(params->options, &headers,
                                              io.width, io.height);
+        dec->scale_shift_ = WebPGetScaleShift(params->options);
         VP8InitDithering(params->options, dec);
         if (!VP8Decode(dec, &io)) {
           status = dec->status_;
+        } else if (params->preview != NULL) {
+          FinishVP8Preview(dec, params->preview);
         }
       }
     }
@@ -501,17 +564,32 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
       // Allocate/check output buffers.
       status = WebPAllocateDecBuffer(io.width, io.height, params->options,
                                      params->output);
+      if (status == VP8_STATUS_OK && params->preview != NULL) {
+        status = AllocatePreview(io.width, io.height, params->preview);
+        if (status == VP8_STATUS_OK) {
+          dec->preview_sums_ = (uint32_t*)WebPSafeCalloc(
+              4ULL * params->preview->width, sizeof(*dec->preview_sums_));
+          if (dec->preview_sums_ == NULL) status = VP8_STATUS_OUT_OF_MEMORY;
+        }
+        dec->preview_ = params->preview->rgba;
+      }
       if (status == VP8_STATUS_OK) {  // Decode
+        dec->mt_method_ = VP8GetThreadMethod(params->options, &headers,
+                                             io.width, io.height);
         if (!VP8LDecodeImage(dec)) {
           status = dec->status_;
         }
       }
     }
+    // The worker is done with the preview: VP8LDecodeImage() synced or ended it.
+    WebPSafeFree(dec->preview_sums_);
+    dec->preview_sums_ = NULL;
     VP8LDelete(dec);
   }
 
   if (status != VP8_STATUS_OK) {
     WebPFreeDecBuffer(params->output);
+    WebPFreePreview(params->preview);
   } else {
     if (params->options != NULL && params->options->flip) {
       // This restores the original stride values if options->flip was used
@@ -742,8 +820,9 @@ VP8StatusCode WebPGetFeaturesInternal(const uint8_t* data, size_t data_size,
   return GetFeatures(data, data_size, features);
 }
 
-VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
-                         WebPDecoderConfig* config) {
+static VP8StatusCode DecodeConfig(const uint8_t* const data, size_t data_size,
+                                  WebPDecoderConfig* const config,
+                                  WebPPreview* const preview) {
   WebPDecParams params;
   VP8StatusCode status;
 
@@ -762,6 +841,7 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   WebPResetDecParams(&params);
   params.options = &config->options;
   params.output = &config->output;
+  params.preview = preview;
   if (WebPAvoidSlowMemory(params.output, &config->input)) {
     // decoding to slow memory: use a temporary in-mem buffer to decode into.
     WebPDecBuffer in_mem_buffer;
@@ -782,6 +862,48 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   return status;
 }
 
+VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
+                         WebPDecoderConfig* config) {
+  return DecodeConfig(data, data_size, config, NULL);
+}
+
+VP8StatusCode WebPDecodeWithPreview(const uint8_t* data, size_t data_size,
+                                    WebPDecoderConfig* config,
+                                    WebPPreview* preview) {
+  if (config == NULL || preview == NULL) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  memset(preview, 0, sizeof(*preview));
+  if (config->options.use_cropping) {
+    return VP8_STATUS_INVALID_PARAM;   // the preview covers the whole picture
+  }
+  return DecodeConfig(data, data_size, config, preview);
+}
+
+VP8StatusCode WebPDecodePreview(const uint8_t* data, size_t data_size,
+                                WebPPreview* preview) {
+  WebPDecoderConfig config;
+  VP8StatusCode status;
+  if (preview == NULL || !WebPInitDecoderConfig(&config)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  status = GetFeatures(data, data_size, &config.input);
+  if (status != VP8_STATUS_OK) {
+    return (status == VP8_STATUS_NOT_ENOUGH_DATA) ? VP8_STATUS_BITSTREAM_ERROR
+                                                  : status;
+  }
+  // Lossy pictures are reconstructed at the smallest size: the preview is
+  // gathered before the downscaling. Lossless ones would go through the
+  // rescaler instead, which is slower than the plain output.
+  if (config.input.format != 2) config.options.scale_denom = 8;
+  config.options.bypass_filtering = 1;
+  config.options.no_fancy_upsampling = 1;
+  config.output.colorspace = MODE_RGBA;
+  status = WebPDecodeWithPreview(data, data_size, &config, preview);
+  WebPFreeDecBuffer(&config.output);
+  return status;
+}
+
 //------------------------------------------------------------------------------
 // Cropping and rescaling.
 
@@ -792,6 +914,64 @@ int WebPCheckCropDimensions(int image_width, int image_height,
            y >= image_height || h > image_height || h > image_height - y);
 }
 
+int WebPGetScaleShift(const WebPDecoderOptions* const options) {
+  const int denom = (options != NULL) ? options->scale_denom : 0;
+  switch (denom) {
+    case 0:
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return 3;
+    default: return -1;
+  }
+}
+
+int WebPScaleDownOptions(const WebPDecoderOptions* const options,
+                         int width, int height,
+                         WebPDecoderOptions* const scaled) {
+  const int shift = WebPGetScaleShift(options);
+  int W, H, x = 0, y = 0, w, h;
+  int out_w, out_h;
+
+  if (shift <= 0) return (shift == 0);
+  W = (width + (1 << shift) - 1) >> shift;   // reduced dimensions
+  H = (height + (1 << shift) - 1) >> shift;
+  w = W;
+  h = H;
+  *scaled = *options;
+  if (options->use_cropping) {
+    w = options->crop_width;
+    h = options->crop_height;
+    x = options->crop_left;
+    y = options->crop_top;
+    if (!WebPCheckCropDimensions(W, H, x, y, w, h)) return 0;
+  }
+  out_w = w;
+  out_h = h;
+  if (options->use_scaling) {
+    out_w = options->scaled_width;
+    out_h = options->scaled_height;
+    if (!WebPRescalerGetScaledDimensions(w, h, &out_w, &out_h)) return 0;
+  }
+  // Same area in the full-size picture, rescaled to the final dimensions.
+  scaled->use_cropping = 1;
+  scaled->crop_left = x << shift;
+  scaled->crop_top = y << shift;
+  scaled->crop_width = w << shift;
+  scaled->crop_height = h << shift;
+  if (scaled->crop_width > width - scaled->crop_left) {
+    scaled->crop_width = width - scaled->crop_left;
+  }
+  if (scaled->crop_height > height - scaled->crop_top) {
+    scaled->crop_height = height - scaled->crop_top;
+  }
+  scaled->use_scaling = 1;
+  scaled->scaled_width = out_w;
+  scaled->scaled_height = out_h;
+  scaled->scale_denom = 0;
+  return 1;
+}
+
 int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
                           VP8Io* const io, WEBP_CSP_MODE src_colorspace) {
   const int W = io->width;
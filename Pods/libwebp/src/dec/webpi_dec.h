@@ -45,6 +45,7 @@ struct WebPDecParams {
   OutputFunc emit;               // output RGB or YUV samples
   OutputAlphaFunc emit_alpha;    // output alpha channel
   OutputRowFunc emit_alpha_row;  // output one line of rescaled alpha values
+  WebPPreview* preview;          // if not NULL, low-resolution preview output
 };
 
 // Should be called first, before any use of the WebPDecParams object.
@@ -87,9 +88,23 @@ void WebPInitCustomIo(WebPDecParams* const params, VP8Io* const io);
 
 // Setup crop_xxx fields, mb_w and mb_h in io. 'src_colorspace' refers
 // to the *compressed* format, not the output one.
+// Note: options->scale_denom is not handled here. The io->width/height are
+// expected to be the reduced ones already, if the decoder supports it.
 int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
                           VP8Io* const io, WEBP_CSP_MODE src_colorspace);
 
+// Returns log2(options->scale_denom), 0 if unset or if 'options' is NULL,
+// and -1 if the value is invalid.
+int WebPGetScaleShift(const WebPDecoderOptions* const options);
+
+// For decoders that can't decode at reduced size, converts the scale_denom,
+// cropping and scaling of 'options' into equivalent cropping and scaling
+// options for the full-size 'width' x 'height' picture, stored in 'scaled'.
+// Returns false in case of invalid parameters.
+int WebPScaleDownOptions(const WebPDecoderOptions* const options,
+                         int width, int height,
+                         WebPDecoderOptions* const scaled);
+
 //------------------------------------------------------------------------------
 // Internal functions regarding WebPDecBuffer memory (in buffer.c).
 // Don't really need to be externally visible for now.
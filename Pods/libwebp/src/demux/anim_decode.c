@@ -15,14 +15,18 @@
 #endif
 
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/demux.h"
 
 #define NUM_CHANNELS 4
 
+#define MAX_DECODE_AHEAD 16
+
 // Channel extraction from a uint32_t representation of a uint8_t RGBA/BGRA
 // buffer.
 #ifdef WORDS_BIGENDIAN
@@ -37,6 +41,17 @@ static void BlendPixelRowNonPremult(uint32_t* const src,
 static void BlendPixelRowPremult(uint32_t* const src, const uint32_t* const dst,
                                  int num_pixels);
 
+// A frame decoded ahead of time on a worker thread.
+typedef struct {
+  WebPWorker worker_;
+  WebPDecoderConfig config_;       // Copy of the decoder config, with the
+                                   // output redirected to 'rgba_'.
+  WebPIterator iter_;              // Frame decoded in this slot.
+  uint8_t* rgba_;                  // Decoded frame rectangle (not the canvas).
+  int frame_num_;                  // Frame held or in flight, 0 if none.
+  int ok_;                         // True if 'frame_num_' decoded fine.
+} FrameSlot;
+
 struct WebPAnimDecoder {
   WebPDemuxer* demux_;             // Demuxer created from given WebP bitstream.
   WebPDecoderConfig config_;       // Decoder config.
@@ -51,11 +66,24 @@ struct WebPAnimDecoder {
   int prev_frame_was_keyframe_;    // True if previous frame was a keyframe.
   int next_frame_;                 // Index of the next frame to be decoded
                                    // (starting from 1).
+  // Key-frame index, built on demand by WebPAnimDecoderSeek().
+  int num_keyframes_;              // Number of entries, 0 if not built yet.
+  int* keyframes_;                 // Frame numbers of the key-frames.
+  int* keyframe_timestamps_;       // Timestamp preceding each key-frame.
+  // Decode-ahead ring. Frame 'n' is decoded in slots_[n % num_slots_].
+  int num_slots_;                  // 0 if frames are decoded in place.
+  FrameSlot* slots_;
 };
 
+#define KEYFRAME_INDEX_TAG "WKFI"
+#define KEYFRAME_INDEX_VERSION 1
+#define KEYFRAME_INDEX_HEADER_SIZE 24   // tag + version + 4 x uint32 fields
+#define KEYFRAME_INDEX_ENTRY_SIZE 8     // frame number + timestamp
+
 static void DefaultDecoderOptions(WebPAnimDecoderOptions* const dec_options) {
   dec_options->color_mode = MODE_RGBA;
   dec_options->use_threads = 0;
+  dec_options->decode_ahead = 0;
 }
 
 int WebPAnimDecoderOptionsInitInternal(WebPAnimDecoderOptions* dec_options,
@@ -87,6 +115,117 @@ static int ApplyDecoderOptions(const WebPAnimDecoderOptions* const dec_options,
   config->output.is_external_memory = 1;
   config->options.use_threads = dec_options->use_threads;
   // Note: config->output.u.RGBA is set at the time of decoding each frame.
+  if (dec_options->decode_ahead < 0 ||
+      dec_options->decode_ahead > MAX_DECODE_AHEAD) {
+    return 0;
+  }
+#ifdef WEBP_USE_THREAD
+  if (dec_options->use_threads) dec->num_slots_ = dec_options->decode_ahead;
+#endif
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Decode-ahead.
+
+static int DecodeSlotHook(void* arg1, void* arg2) {
+  FrameSlot* const slot = (FrameSlot*)arg1;
+  (void)arg2;
+  slot->ok_ = (WebPDecode(slot->iter_.fragment.bytes, slot->iter_.fragment.size,
+                          &slot->config_) == VP8_STATUS_OK);
+  return 1;   // errors are reported through 'ok_'
+}
+
+static int InitSlots(WebPAnimDecoder* const dec) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const uint64_t size = (uint64_t)dec->info_.canvas_width * NUM_CHANNELS *
+                        dec->info_.canvas_height;
+  int i;
+  if (dec->num_slots_ == 0) return 1;
+  dec->slots_ =
+      (FrameSlot*)WebPSafeCalloc(dec->num_slots_, sizeof(*dec->slots_));
+  if (dec->slots_ == NULL) return 0;
+  for (i = 0; i < dec->num_slots_; ++i) {
+    FrameSlot* const slot = &dec->slots_[i];
+    winterface->Init(&slot->worker_);
+    slot->worker_.hook = DecodeSlotHook;
+    slot->worker_.data1 = slot;
+    slot->rgba_ = (uint8_t*)WebPSafeMalloc(size, sizeof(*slot->rgba_));
+    if (slot->rgba_ == NULL || !winterface->Reset(&slot->worker_)) return 0;
+    slot->config_ = dec->config_;
+    // The frames in flight already keep the cores busy.
+    slot->config_.options.use_threads = 0;
+  }
+  return 1;
+}
+
+static void DeleteSlots(WebPAnimDecoder* const dec) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  int i;
+  if (dec->slots_ == NULL) return;
+  for (i = 0; i < dec->num_slots_; ++i) {
+    winterface->End(&dec->slots_[i].worker_);
+    WebPSafeFree(dec->slots_[i].rgba_);
+  }
+  WebPSafeFree(dec->slots_);
+  dec->slots_ = NULL;
+}
+
+// Starts decoding frame 'frame_num' in 'slot', dropping what it held.
+static int LaunchSlot(const WebPAnimDecoder* const dec, FrameSlot* const slot,
+                      int frame_num) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  WebPRGBABuffer* const buf = &slot->config_.output.u.RGBA;
+  winterface->Sync(&slot->worker_);
+  slot->frame_num_ = 0;
+  if (!WebPDemuxGetFrame(dec->demux_, frame_num, &slot->iter_)) return 0;
+  buf->rgba = slot->rgba_;
+  buf->stride = slot->iter_.width * NUM_CHANNELS;
+  buf->size = (size_t)buf->stride * slot->iter_.height;
+  slot->frame_num_ = frame_num;
+  slot->ok_ = 0;
+  winterface->Launch(&slot->worker_);
+  return 1;
+}
+
+// Equivalent of decoding 'iter' in place into the canvas, except that the
+// frame comes from the decode-ahead ring, which is then topped up.
+static int DecodeFromSlots(WebPAnimDecoder* const dec,
+                           const WebPIterator* const iter) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const int frame_count = (int)dec->info_.frame_count;
+  const int next = dec->next_frame_;
+  const size_t stride = (size_t)dec->info_.canvas_width * NUM_CHANNELS;
+  const size_t row_size = (size_t)iter->width * NUM_CHANNELS;
+  FrameSlot* slot;
+  uint8_t* dst;
+  const uint8_t* src;
+  int f, y;
+
+  for (f = next; f < next + dec->num_slots_ && f <= frame_count; ++f) {
+    slot = &dec->slots_[f % dec->num_slots_];
+    if (slot->frame_num_ != f) LaunchSlot(dec, slot, f);
+  }
+  slot = &dec->slots_[next % dec->num_slots_];
+  if (!winterface->Sync(&slot->worker_) || slot->frame_num_ != next ||
+      !slot->ok_) {
+    return 0;
+  }
+  assert(slot->iter_.width == iter->width &&
+         slot->iter_.height == iter->height);
+
+  src = slot->rgba_;
+  dst = dec->curr_frame_ + (size_t)iter->y_offset * stride +
+        (size_t)iter->x_offset * NUM_CHANNELS;
+  for (y = 0; y < iter->height; ++y) {
+    memcpy(dst, src, row_size);
+    src += row_size;
+    dst += stride;
+  }
+  // The slot is free again: queue the frame that follows the ring.
+  if (next + dec->num_slots_ <= frame_count) {
+    LaunchSlot(dec, slot, next + dec->num_slots_);
+  }
   return 1;
 }
 
@@ -135,6 +274,7 @@ WebPAnimDecoder* WebPAnimDecoderNewInternal(
   dec->prev_frame_disposed_ = (uint8_t*)WebPSafeCalloc(
       dec->info_.canvas_width * NUM_CHANNELS, dec->info_.canvas_height);
   if (dec->prev_frame_disposed_ == NULL) goto Error;
+  if (!InitSlots(dec)) goto Error;
 
   WebPAnimDecoderReset(dec);
   return dec;
@@ -359,7 +499,9 @@ int WebPAnimDecoderGetNext(WebPAnimDecoder* dec,
   }
 
   // Decode.
-  {
+  if (dec->num_slots_ > 0) {
+    if (!DecodeFromSlots(dec, &iter)) goto Error;
+  } else {
     const uint8_t* in = iter.fragment.bytes;
     const size_t in_size = iter.fragment.size;
     const uint32_t stride = width * NUM_CHANNELS;  // at most 25 + 2 bits
@@ -457,6 +599,234 @@ void WebPAnimDecoderReset(WebPAnimDecoder* dec) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Key-frame index and seeking.
+
+static void ClearKeyFrameIndex(WebPAnimDecoder* const dec) {
+  WebPSafeFree(dec->keyframes_);
+  WebPSafeFree(dec->keyframe_timestamps_);
+  dec->keyframes_ = NULL;
+  dec->keyframe_timestamps_ = NULL;
+  dec->num_keyframes_ = 0;
+}
+
+static int AllocKeyFrameIndex(WebPAnimDecoder* const dec, int num_keyframes) {
+  ClearKeyFrameIndex(dec);
+  dec->keyframes_ =
+      (int*)WebPSafeMalloc(num_keyframes, sizeof(*dec->keyframes_));
+  dec->keyframe_timestamps_ =
+      (int*)WebPSafeMalloc(num_keyframes, sizeof(*dec->keyframe_timestamps_));
+  if (dec->keyframes_ == NULL || dec->keyframe_timestamps_ == NULL) {
+    ClearKeyFrameIndex(dec);
+    return 0;
+  }
+  return 1;
+}
+
+// Walks the frame headers (nothing is decoded) and records each key-frame
+// along with the timestamp reached just before it.
+static int BuildKeyFrameIndex(WebPAnimDecoder* const dec) {
+  const int width = (int)dec->info_.canvas_width;
+  const int height = (int)dec->info_.canvas_height;
+  WebPIterator iter, prev;
+  int prev_was_keyframe = 0;
+  int timestamp = 0;
+  int num_frames = 0;
+  int num_keyframes = 0;
+
+  if (!AllocKeyFrameIndex(dec, (int)dec->info_.frame_count)) return 0;
+  memset(&prev, 0, sizeof(prev));
+  if (!WebPDemuxGetFrame(dec->demux_, 1, &iter)) goto Error;
+  do {
+    const int is_keyframe =
+        IsKeyFrame(&iter, &prev, prev_was_keyframe, width, height);
+    if (++num_frames > (int)dec->info_.frame_count) break;
+    if (is_keyframe) {
+      dec->keyframes_[num_keyframes] = iter.frame_num;
+      dec->keyframe_timestamps_[num_keyframes] = timestamp;
+      ++num_keyframes;
+    }
+    timestamp += iter.duration;
+    prev_was_keyframe = is_keyframe;
+    prev = iter;
+  } while (WebPDemuxNextFrame(&iter));
+  WebPDemuxReleaseIterator(&iter);
+  if (num_frames != (int)dec->info_.frame_count) goto Error;
+  assert(num_keyframes > 0 && dec->keyframes_[0] == 1);
+  dec->num_keyframes_ = num_keyframes;
+  return 1;
+
+ Error:
+  ClearKeyFrameIndex(dec);
+  return 0;
+}
+
+// Checks every entry of an externally supplied index against the frame
+// headers: the frame must be a key-frame and the timestamp must be the sum of
+// the durations of the frames before it, so that a stale, foreign or corrupted
+// index can't corrupt the output.
+static int VerifyKeyFrameIndex(const WebPAnimDecoder* const dec) {
+  const int width = (int)dec->info_.canvas_width;
+  const int height = (int)dec->info_.canvas_height;
+  WebPIterator iter, prev;
+  int timestamp = 0;
+  int i = 0;
+  int ok = 1;
+
+  memset(&prev, 0, sizeof(prev));
+  if (!WebPDemuxGetFrame(dec->demux_, 1, &iter)) return 0;
+  do {
+    if (iter.frame_num == dec->keyframes_[i]) {
+      if (dec->keyframe_timestamps_[i] != timestamp) {
+        ok = 0;
+      } else if (i > 0) {
+        // Same previous-frame rule as RewindToKeyFrame().
+        const int prev_was_keyframe =
+            (dec->keyframes_[i - 1] == iter.frame_num - 1);
+        ok = IsKeyFrame(&iter, &prev, prev_was_keyframe, width, height);
+      }
+      if (!ok || ++i == dec->num_keyframes_) break;
+    }
+    if (iter.duration > INT_MAX - timestamp) {
+      ok = 0;
+      break;
+    }
+    timestamp += iter.duration;
+    prev = iter;
+  } while (WebPDemuxNextFrame(&iter));
+  WebPDemuxReleaseIterator(&iter);
+  return ok && i == dec->num_keyframes_;
+}
+
+// Positions 'dec' right before the key-frame at 'index' in the key-frame index.
+static int RewindToKeyFrame(WebPAnimDecoder* const dec, int index) {
+  const int frame_num = dec->keyframes_[index];
+  WebPAnimDecoderReset(dec);
+  if (frame_num > 1) {
+    // IsKeyFrame() needs the header of the previous frame, but not its pixels.
+    if (!WebPDemuxGetFrame(dec->demux_, frame_num - 1, &dec->prev_iter_)) {
+      return 0;
+    }
+    dec->prev_frame_was_keyframe_ =
+        (index > 0 && dec->keyframes_[index - 1] == frame_num - 1);
+  }
+  dec->prev_frame_timestamp_ = dec->keyframe_timestamps_[index];
+  dec->next_frame_ = frame_num;
+  return 1;
+}
+
+int WebPAnimDecoderSeek(WebPAnimDecoder* dec, int frame_num) {
+  int lo, hi;
+  if (dec == NULL) return 0;
+  if (frame_num < 1 || frame_num > (int)dec->info_.frame_count) return 0;
+  if (dec->num_keyframes_ == 0 && !BuildKeyFrameIndex(dec)) return 0;
+
+  // Find the last key-frame at or before 'frame_num'.
+  lo = 0;
+  hi = dec->num_keyframes_ - 1;
+  while (lo < hi) {
+    const int mid = (lo + hi + 1) >> 1;
+    if (dec->keyframes_[mid] <= frame_num) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  // If the decoder already stands between that key-frame and the target,
+  // rolling forward is less work than restarting at the key-frame.
+  if (dec->next_frame_ < dec->keyframes_[lo] || dec->next_frame_ > frame_num) {
+    if (!RewindToKeyFrame(dec, lo)) goto Error;
+  }
+  while (dec->next_frame_ < frame_num) {
+    uint8_t* buf;
+    int timestamp;
+    if (!WebPAnimDecoderGetNext(dec, &buf, &timestamp)) goto Error;
+  }
+  return 1;
+
+ Error:
+  WebPAnimDecoderReset(dec);
+  return 0;
+}
+
+int WebPAnimDecoderGetKeyFrameIndex(WebPAnimDecoder* dec, WebPData* index) {
+  uint8_t* mem;
+  uint8_t* dst;
+  size_t size;
+  int i;
+  if (dec == NULL || index == NULL) return 0;
+  WebPDataInit(index);
+  if (dec->num_keyframes_ == 0 && !BuildKeyFrameIndex(dec)) return 0;
+
+  size = KEYFRAME_INDEX_HEADER_SIZE +
+         (size_t)dec->num_keyframes_ * KEYFRAME_INDEX_ENTRY_SIZE;
+  mem = (uint8_t*)WebPMalloc(size);
+  if (mem == NULL) return 0;
+  memcpy(mem, KEYFRAME_INDEX_TAG, 4);
+  PutLE32(mem + 4, KEYFRAME_INDEX_VERSION);
+  PutLE32(mem + 8, dec->info_.canvas_width);
+  PutLE32(mem + 12, dec->info_.canvas_height);
+  PutLE32(mem + 16, dec->info_.frame_count);
+  PutLE32(mem + 20, (uint32_t)dec->num_keyframes_);
+  dst = mem + KEYFRAME_INDEX_HEADER_SIZE;
+  for (i = 0; i < dec->num_keyframes_; ++i) {
+    PutLE32(dst + 0, (uint32_t)dec->keyframes_[i]);
+    PutLE32(dst + 4, (uint32_t)dec->keyframe_timestamps_[i]);
+    dst += KEYFRAME_INDEX_ENTRY_SIZE;
+  }
+  index->bytes = mem;
+  index->size = size;
+  return 1;
+}
+
+int WebPAnimDecoderSetKeyFrameIndex(WebPAnimDecoder* dec,
+                                    const WebPData* index) {
+  const uint8_t* src;
+  uint32_t num_keyframes;
+  int i;
+  if (dec == NULL || index == NULL || index->bytes == NULL) return 0;
+  src = index->bytes;
+  if (index->size < KEYFRAME_INDEX_HEADER_SIZE ||
+      memcmp(src, KEYFRAME_INDEX_TAG, 4) ||
+      GetLE32(src + 4) != KEYFRAME_INDEX_VERSION ||
+      GetLE32(src + 8) != dec->info_.canvas_width ||
+      GetLE32(src + 12) != dec->info_.canvas_height ||
+      GetLE32(src + 16) != dec->info_.frame_count) {
+    return 0;
+  }
+  num_keyframes = GetLE32(src + 20);
+  if (num_keyframes == 0 || num_keyframes > dec->info_.frame_count ||
+      index->size != KEYFRAME_INDEX_HEADER_SIZE +
+                     (size_t)num_keyframes * KEYFRAME_INDEX_ENTRY_SIZE) {
+    return 0;
+  }
+  if (!AllocKeyFrameIndex(dec, (int)num_keyframes)) return 0;
+  src += KEYFRAME_INDEX_HEADER_SIZE;
+  for (i = 0; i < (int)num_keyframes; ++i) {
+    const uint32_t frame_num = GetLE32(src + 0);
+    const uint32_t timestamp = GetLE32(src + 4);
+    // Frame numbers must start at 1 and increase; timestamps can't decrease.
+    if (frame_num > dec->info_.frame_count || timestamp > INT_MAX ||
+        (i == 0 && (frame_num != 1 || timestamp != 0)) ||
+        (i > 0 && ((int)frame_num <= dec->keyframes_[i - 1] ||
+                   (int)timestamp < dec->keyframe_timestamps_[i - 1]))) {
+      goto Error;
+    }
+    dec->keyframes_[i] = (int)frame_num;
+    dec->keyframe_timestamps_[i] = (int)timestamp;
+    src += KEYFRAME_INDEX_ENTRY_SIZE;
+  }
+  dec->num_keyframes_ = (int)num_keyframes;
+  if (!VerifyKeyFrameIndex(dec)) goto Error;
+  return 1;
+
+ Error:
+  ClearKeyFrameIndex(dec);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
 const WebPDemuxer* WebPAnimDecoderGetDemuxer(const WebPAnimDecoder* dec) {
   if (dec == NULL) return NULL;
   return dec->demux_;
@@ -464,10 +834,12 @@ const WebPDemuxer* WebPAnimDecoderGetDemuxer(const WebPAnimDecoder* dec) {
 
 void WebPAnimDecoderDelete(WebPAnimDecoder* dec) {
   if (dec != NULL) {
+    DeleteSlots(dec);
     WebPDemuxReleaseIterator(&dec->prev_iter_);
     WebPDemuxDelete(dec->demux_);
     WebPSafeFree(dec->curr_frame_);
     WebPSafeFree(dec->prev_frame_disposed_);
+    ClearKeyFrameIndex(dec);
     WebPSafeFree(dec);
   }
 }
@@ -0,0 +1,197 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Pixel comparisons between canvases, used by the animation encoder.
+
+#include <assert.h>
+#include <stdlib.h>  // for abs()
+
+#include "src/dsp/dsp.h"
+
+//------------------------------------------------------------------------------
+
+static WEBP_INLINE int PixelsAreSimilar(uint32_t src, uint32_t dst,
+                                        int max_allowed_diff) {
+  const int src_a = (src >> 24) & 0xff;
+  const int src_r = (src >> 16) & 0xff;
+  const int src_g = (src >> 8) & 0xff;
+  const int src_b = (src >> 0) & 0xff;
+  const int dst_a = (dst >> 24) & 0xff;
+  const int dst_r = (dst >> 16) & 0xff;
+  const int dst_g = (dst >> 8) & 0xff;
+  const int dst_b = (dst >> 0) & 0xff;
+
+  return (src_a == dst_a) &&
+         (abs(src_r - dst_r) * dst_a <= (max_allowed_diff * 255)) &&
+         (abs(src_g - dst_g) * dst_a <= (max_allowed_diff * 255)) &&
+         (abs(src_b - dst_b) * dst_a <= (max_allowed_diff * 255));
+}
+
+static int FindFirstDiff_C(const uint32_t* src, const uint32_t* dst,
+                           int length, int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = 0; i < length; ++i) {
+    if (src[i] != dst[i]) break;
+  }
+  return i;
+}
+
+static int FindLastDiff_C(const uint32_t* src, const uint32_t* dst,
+                          int length, int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = length - 1; i >= 0; --i) {
+    if (src[i] != dst[i]) break;
+  }
+  return i;
+}
+
+static int FindFirstDissimilar_C(const uint32_t* src, const uint32_t* dst,
+                                 int length, int max_allowed_diff) {
+  int i;
+  for (i = 0; i < length; ++i) {
+    if (!PixelsAreSimilar(src[i], dst[i], max_allowed_diff)) break;
+  }
+  return i;
+}
+
+static int FindLastDissimilar_C(const uint32_t* src, const uint32_t* dst,
+                                int length, int max_allowed_diff) {
+  int i;
+  for (i = length - 1; i >= 0; --i) {
+    if (!PixelsAreSimilar(src[i], dst[i], max_allowed_diff)) break;
+  }
+  return i;
+}
+
+static int IsLosslessBlendingPossible_C(const uint32_t* src,
+                                        const uint32_t* dst, int length,
+                                        int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = 0; i < length; ++i) {
+    // If we use blending, we can't attain the desired 'dst' value for
+    // non-opaque pixels.
+    if ((dst[i] >> 24) != 0xff && src[i] != dst[i]) return 0;
+  }
+  return 1;
+}
+
+static int IsLossyBlendingPossible_C(const uint32_t* src, const uint32_t* dst,
+                                     int length, int max_allowed_diff) {
+  int i;
+  for (i = 0; i < length; ++i) {
+    if ((dst[i] >> 24) != 0xff &&
+        !PixelsAreSimilar(src[i], dst[i], max_allowed_diff)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IncreaseTransparency_C(const uint32_t* src, uint32_t* dst,
+                                  int length) {
+  int i;
+  int modified = 0;
+  for (i = 0; i < length; ++i) {
+    if (src[i] == dst[i] && dst[i] != 0x00000000u) {
+      dst[i] = 0x00000000u;
+      modified = 1;
+    }
+  }
+  return modified;
+}
+
+static int FlattenSimilarBlock_C(const uint32_t* src, int src_stride,
+                                 uint32_t* dst, int dst_stride,
+                                 int max_allowed_diff) {
+  int x, y;
+  int avg_r = 0, avg_g = 0, avg_b = 0;
+  uint32_t color;
+  for (y = 0; y < 8; ++y) {
+    for (x = 0; x < 8; ++x) {
+      const uint32_t src_pixel = src[x + y * src_stride];
+      if ((src_pixel >> 24) != 0xff ||
+          !PixelsAreSimilar(src_pixel, dst[x + y * dst_stride],
+                            max_allowed_diff)) {
+        return 0;
+      }
+      avg_r += (src_pixel >> 16) & 0xff;
+      avg_g += (src_pixel >> 8) & 0xff;
+      avg_b += (src_pixel >> 0) & 0xff;
+    }
+  }
+  color = ((uint32_t)(avg_r >> 6) << 16) |
+          ((uint32_t)(avg_g >> 6) <<  8) |
+          ((uint32_t)(avg_b >> 6) <<  0);
+  for (y = 0; y < 8; ++y) {
+    for (x = 0; x < 8; ++x) dst[x + y * dst_stride] = color;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+WebPAnimFindDiffFunc WebPAnimFindFirstDiff;
+WebPAnimFindDiffFunc WebPAnimFindLastDiff;
+WebPAnimFindDiffFunc WebPAnimFindFirstDissimilar;
+WebPAnimFindDiffFunc WebPAnimFindLastDissimilar;
+WebPAnimBlendingPossibleFunc WebPAnimIsLosslessBlendingPossible;
+WebPAnimBlendingPossibleFunc WebPAnimIsLossyBlendingPossible;
+int (*WebPAnimIncreaseTransparency)(const uint32_t* src, uint32_t* dst,
+                                    int length);
+int (*WebPAnimFlattenSimilarBlock)(const uint32_t* src, int src_stride,
+                                   uint32_t* dst, int dst_stride,
+                                   int max_allowed_diff);
+
+extern void WebPAnimEncDspInitSSE2(void);
+extern void WebPAnimEncDspInitAVX2(void);
+extern void WebPAnimEncDspInitNEON(void);
+
+WEBP_DSP_INIT_FUNC(WebPAnimEncDspInit) {
+  WebPAnimFindFirstDiff = FindFirstDiff_C;
+  WebPAnimFindLastDiff = FindLastDiff_C;
+  WebPAnimFindFirstDissimilar = FindFirstDissimilar_C;
+  WebPAnimFindLastDissimilar = FindLastDissimilar_C;
+  WebPAnimIsLosslessBlendingPossible = IsLosslessBlendingPossible_C;
+  WebPAnimIsLossyBlendingPossible = IsLossyBlendingPossible_C;
+  WebPAnimIncreaseTransparency = IncreaseTransparency_C;
+  WebPAnimFlattenSimilarBlock = FlattenSimilarBlock_C;
+
+  // If defined, use CPUInfo() to overwrite some pointers with faster versions.
+  if (VP8GetCPUInfo != NULL) {
+#if defined(WEBP_HAVE_SSE2)
+    if (VP8GetCPUInfo(kSSE2)) {
+      WebPAnimEncDspInitSSE2();
+#if defined(WEBP_HAVE_AVX2)
+      if (VP8GetCPUInfo(kAVX2)) {
+        WebPAnimEncDspInitAVX2();
+      }
+#endif
+    }
+#endif
+  }
+
+#if defined(WEBP_HAVE_NEON)
+  if (WEBP_NEON_OMIT_C_CODE ||
+      (VP8GetCPUInfo != NULL && VP8GetCPUInfo(kNEON))) {
+    WebPAnimEncDspInitNEON();
+  }
+#endif
+
+  assert(WebPAnimFindFirstDiff != NULL);
+  assert(WebPAnimFindLastDiff != NULL);
+  assert(WebPAnimFindFirstDissimilar != NULL);
+  assert(WebPAnimFindLastDissimilar != NULL);
+  assert(WebPAnimIsLosslessBlendingPossible != NULL);
+  assert(WebPAnimIsLossyBlendingPossible != NULL);
+  assert(WebPAnimIncreaseTransparency != NULL);
+  assert(WebPAnimFlattenSimilarBlock != NULL);
+}
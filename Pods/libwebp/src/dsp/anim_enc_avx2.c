@@ -0,0 +1,239 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of the pixel comparisons used by the animation encoder.
+//
+// Same as the SSE2 version, with 8 pixels at a time.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <immintrin.h>
+#include <string.h>
+
+#include "src/utils/utils.h"
+
+// Loads 8 pixels of 'src' and 'dst' from position 'i', padding past 'length'.
+static WEBP_INLINE void Load_AVX2(const uint32_t* src, const uint32_t* dst,
+                                  int i, int length,
+                                  __m256i* const a, __m256i* const b) {
+  if (i + 8 <= length) {
+    *a = _mm256_loadu_si256((const __m256i*)&src[i]);
+    *b = _mm256_loadu_si256((const __m256i*)&dst[i]);
+  } else {
+    uint32_t s[8] = { 0 }, d[8] = { 0 };
+    memcpy(s, &src[i], (length - i) * sizeof(*s));
+    memcpy(d, &dst[i], (length - i) * sizeof(*d));
+    *a = _mm256_loadu_si256((const __m256i*)s);
+    *b = _mm256_loadu_si256((const __m256i*)d);
+  }
+}
+
+// Returns one bit per pixel set in 'm'.
+static WEBP_INLINE int PixelMask_AVX2(const __m256i m) {
+  return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+static WEBP_INLINE __m256i MaxDiff_AVX2(int max_allowed_diff) {
+  const short t = (short)(max_allowed_diff * 255);
+  return _mm256_setr_epi16(t, t, t, 0, t, t, t, 0, t, t, t, 0, t, t, t, 0);
+}
+
+// Returns all ones for the pixels of 'src' and 'dst' which are similar.
+// The unpacking and packing within 128-bit lanes keep the pixel order.
+static WEBP_INLINE __m256i AreSimilar_AVX2(const __m256i src,
+                                           const __m256i dst,
+                                           const __m256i max_diff) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i diff = _mm256_or_si256(_mm256_subs_epu8(src, dst),
+                                       _mm256_subs_epu8(dst, src));
+  const __m256i a = _mm256_srli_epi32(dst, 24);
+  const __m256i m = _mm256_or_si256(
+      _mm256_or_si256(a, _mm256_slli_epi32(a, 8)),
+      _mm256_or_si256(_mm256_slli_epi32(a, 16),
+                      _mm256_set1_epi32(0x01000000)));
+  const __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(diff, zero),
+                                        _mm256_unpacklo_epi8(m, zero));
+  const __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(diff, zero),
+                                        _mm256_unpackhi_epi8(m, zero));
+  const __m256i ok_lo =
+      _mm256_cmpeq_epi16(_mm256_subs_epu16(lo, max_diff), zero);
+  const __m256i ok_hi =
+      _mm256_cmpeq_epi16(_mm256_subs_epu16(hi, max_diff), zero);
+  return _mm256_cmpeq_epi32(_mm256_packs_epi16(ok_lo, ok_hi),
+                            _mm256_set1_epi32(-1));
+}
+
+static WEBP_INLINE __m256i IsOpaque_AVX2(const __m256i argb) {
+  const __m256i alpha_mask = _mm256_set1_epi32((int)0xff000000u);
+  return _mm256_cmpeq_epi32(_mm256_and_si256(argb, alpha_mask), alpha_mask);
+}
+
+//------------------------------------------------------------------------------
+
+static WEBP_INLINE int DiffMask_AVX2(const __m256i a, const __m256i b,
+                                     const __m256i max_diff) {
+  (void)max_diff;
+  return ~PixelMask_AVX2(_mm256_cmpeq_epi32(a, b)) & 0xff;
+}
+
+static WEBP_INLINE int DissimilarMask_AVX2(const __m256i a, const __m256i b,
+                                           const __m256i max_diff) {
+  return ~PixelMask_AVX2(AreSimilar_AVX2(a, b, max_diff)) & 0xff;
+}
+
+#define FIND_FIRST_FUNC(NAME, MASK)                                           \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const __m256i max_diff = MaxDiff_AVX2(max_allowed_diff);                    \
+  int i;                                                                      \
+  for (i = 0; i < length; i += 8) {                                           \
+    __m256i a, b;                                                             \
+    int mask;                                                                 \
+    Load_AVX2(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsCtz(mask);                                  \
+  }                                                                           \
+  return length;                                                              \
+}
+
+#define FIND_LAST_FUNC(NAME, MASK)                                            \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const __m256i max_diff = MaxDiff_AVX2(max_allowed_diff);                    \
+  int i;                                                                      \
+  for (i = (length - 1) & ~7; i >= 0; i -= 8) {                               \
+    __m256i a, b;                                                             \
+    int mask;                                                                 \
+    Load_AVX2(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsLog2Floor(mask);                            \
+  }                                                                           \
+  return -1;                                                                  \
+}
+
+FIND_FIRST_FUNC(FindFirstDiff_AVX2, DiffMask_AVX2)
+FIND_LAST_FUNC(FindLastDiff_AVX2, DiffMask_AVX2)
+FIND_FIRST_FUNC(FindFirstDissimilar_AVX2, DissimilarMask_AVX2)
+FIND_LAST_FUNC(FindLastDissimilar_AVX2, DissimilarMask_AVX2)
+
+#undef FIND_LAST_FUNC
+#undef FIND_FIRST_FUNC
+
+static int IsLosslessBlendingPossible_AVX2(const uint32_t* src,
+                                           const uint32_t* dst, int length,
+                                           int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = 0; i < length; i += 8) {
+    __m256i a, b;
+    Load_AVX2(src, dst, i, length, &a, &b);
+    if (PixelMask_AVX2(_mm256_or_si256(IsOpaque_AVX2(b),
+                                       _mm256_cmpeq_epi32(a, b))) != 0xff) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IsLossyBlendingPossible_AVX2(const uint32_t* src,
+                                        const uint32_t* dst, int length,
+                                        int max_allowed_diff) {
+  const __m256i max_diff = MaxDiff_AVX2(max_allowed_diff);
+  int i;
+  for (i = 0; i < length; i += 8) {
+    __m256i a, b;
+    Load_AVX2(src, dst, i, length, &a, &b);
+    if (PixelMask_AVX2(_mm256_or_si256(
+            IsOpaque_AVX2(b), AreSimilar_AVX2(a, b, max_diff))) != 0xff) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IncreaseTransparency_AVX2(const uint32_t* src, uint32_t* dst,
+                                     int length) {
+  const __m256i zero = _mm256_setzero_si256();
+  int i;
+  int modified = 0;
+  for (i = 0; i < length; i += 8) {
+    __m256i a, b;
+    Load_AVX2(src, dst, i, length, &a, &b);
+    {
+      const __m256i same = _mm256_cmpeq_epi32(a, b);
+      const __m256i cleared = _mm256_cmpeq_epi32(b, zero);
+      if (PixelMask_AVX2(_mm256_andnot_si256(cleared, same)) != 0) {
+        const __m256i out = _mm256_andnot_si256(same, b);
+        if (i + 8 <= length) {
+          _mm256_storeu_si256((__m256i*)&dst[i], out);
+        } else {
+          uint32_t d[8];
+          _mm256_storeu_si256((__m256i*)d, out);
+          memcpy(&dst[i], d, (length - i) * sizeof(*d));
+        }
+        modified = 1;
+      }
+    }
+  }
+  return modified;
+}
+
+static int FlattenSimilarBlock_AVX2(const uint32_t* src, int src_stride,
+                                    uint32_t* dst, int dst_stride,
+                                    int max_allowed_diff) {
+  const __m256i max_diff = MaxDiff_AVX2(max_allowed_diff);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sum = zero;   // per-channel sums of four pixel columns, in 16b
+  __m128i sum4;
+  __m256i color;
+  int y;
+  for (y = 0; y < 8; ++y) {
+    const __m256i a = _mm256_loadu_si256((const __m256i*)&src[y * src_stride]);
+    const __m256i b = _mm256_loadu_si256((const __m256i*)&dst[y * dst_stride]);
+    const __m256i ok =
+        _mm256_and_si256(IsOpaque_AVX2(a), AreSimilar_AVX2(a, b, max_diff));
+    if (PixelMask_AVX2(ok) != 0xff) return 0;
+    sum = _mm256_add_epi16(sum, _mm256_unpacklo_epi8(a, zero));
+    sum = _mm256_add_epi16(sum, _mm256_unpackhi_epi8(a, zero));
+  }
+  // Average the 64 pixels, and make the result transparent.
+  sum4 = _mm_add_epi16(_mm256_castsi256_si128(sum),
+                       _mm256_extracti128_si256(sum, 1));
+  sum4 = _mm_srli_epi16(_mm_add_epi16(sum4, _mm_srli_si128(sum4, 8)), 6);
+  color = _mm256_and_si256(
+      _mm256_broadcastd_epi32(_mm_packus_epi16(sum4, sum4)),
+      _mm256_set1_epi32(0x00ffffff));
+  for (y = 0; y < 8; ++y) {
+    _mm256_storeu_si256((__m256i*)&dst[y * dst_stride], color);
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPAnimEncDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPAnimEncDspInitAVX2(void) {
+  WebPAnimFindFirstDiff = FindFirstDiff_AVX2;
+  WebPAnimFindLastDiff = FindLastDiff_AVX2;
+  WebPAnimFindFirstDissimilar = FindFirstDissimilar_AVX2;
+  WebPAnimFindLastDissimilar = FindLastDissimilar_AVX2;
+  WebPAnimIsLosslessBlendingPossible = IsLosslessBlendingPossible_AVX2;
+  WebPAnimIsLossyBlendingPossible = IsLossyBlendingPossible_AVX2;
+  WebPAnimIncreaseTransparency = IncreaseTransparency_AVX2;
+  WebPAnimFlattenSimilarBlock = FlattenSimilarBlock_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(WebPAnimEncDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
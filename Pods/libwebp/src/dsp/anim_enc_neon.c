@@ -0,0 +1,245 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON version of the pixel comparisons used by the animation encoder.
+//
+// Rows are processed 4 pixels at a time. The last incomplete group is padded
+// with transparent black in both 'src' and 'dst', which compares as equal.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_NEON)
+
+#include <string.h>
+
+#include "src/dsp/neon.h"
+#include "src/utils/utils.h"
+
+// Loads 4 pixels of 'src' and 'dst' from position 'i', padding past 'length'.
+static WEBP_INLINE void Load_NEON(const uint32_t* src, const uint32_t* dst,
+                                  int i, int length,
+                                  uint32x4_t* const a, uint32x4_t* const b) {
+  if (i + 4 <= length) {
+    *a = vld1q_u32(&src[i]);
+    *b = vld1q_u32(&dst[i]);
+  } else {
+    uint32_t s[4] = { 0 }, d[4] = { 0 };
+    memcpy(s, &src[i], (length - i) * sizeof(*s));
+    memcpy(d, &dst[i], (length - i) * sizeof(*d));
+    *a = vld1q_u32(s);
+    *b = vld1q_u32(d);
+  }
+}
+
+// Returns one bit per pixel set in 'm'.
+static WEBP_INLINE int PixelMask_NEON(const uint32x4_t m) {
+  static const uint32_t kBits[4] = { 1, 2, 4, 8 };
+  const uint32x4_t bits = vandq_u32(m, vld1q_u32(kBits));
+  const uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+  return (int)(vget_lane_u32(sum, 0) | vget_lane_u32(sum, 1));
+}
+
+static WEBP_INLINE uint16x8_t MaxDiff_NEON(int max_allowed_diff) {
+  const uint16_t t = (uint16_t)(max_allowed_diff * 255);
+  const uint16_t max_diff[8] = { t, t, t, 0, t, t, t, 0 };
+  return vld1q_u16(max_diff);
+}
+
+// Returns all ones for the pixels of 'src' and 'dst' which are similar.
+static WEBP_INLINE uint32x4_t AreSimilar_NEON(const uint32x4_t src,
+                                              const uint32x4_t dst,
+                                              const uint16x8_t max_diff) {
+  const uint8x16_t diff =
+      vabdq_u8(vreinterpretq_u8_u32(src), vreinterpretq_u8_u32(dst));
+  // The color differences are multiplied by the alpha of 'dst', and the alpha
+  // difference by 1 so that it must be 0.
+  const uint32x4_t a = vshrq_n_u32(dst, 24);
+  const uint8x16_t m = vreinterpretq_u8_u32(
+      vorrq_u32(vmulq_n_u32(a, 0x010101u), vdupq_n_u32(0x01000000u)));
+  const uint16x8_t lo = vmull_u8(vget_low_u8(diff), vget_low_u8(m));
+  const uint16x8_t hi = vmull_u8(vget_high_u8(diff), vget_high_u8(m));
+  const uint8x16_t ok = vcombine_u8(vmovn_u16(vcleq_u16(lo, max_diff)),
+                                    vmovn_u16(vcleq_u16(hi, max_diff)));
+  return vceqq_u32(vreinterpretq_u32_u8(ok), vdupq_n_u32(0xffffffffu));
+}
+
+static WEBP_INLINE uint32x4_t IsOpaque_NEON(const uint32x4_t argb) {
+  return vcgeq_u32(argb, vdupq_n_u32(0xff000000u));
+}
+
+//------------------------------------------------------------------------------
+
+static WEBP_INLINE int DiffMask_NEON(const uint32x4_t a, const uint32x4_t b,
+                                     const uint16x8_t max_diff) {
+  (void)max_diff;
+  return ~PixelMask_NEON(vceqq_u32(a, b)) & 0xf;
+}
+
+static WEBP_INLINE int DissimilarMask_NEON(const uint32x4_t a,
+                                           const uint32x4_t b,
+                                           const uint16x8_t max_diff) {
+  return ~PixelMask_NEON(AreSimilar_NEON(a, b, max_diff)) & 0xf;
+}
+
+#define FIND_FIRST_FUNC(NAME, MASK)                                           \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const uint16x8_t max_diff = MaxDiff_NEON(max_allowed_diff);                 \
+  int i;                                                                      \
+  for (i = 0; i < length; i += 4) {                                           \
+    uint32x4_t a, b;                                                          \
+    int mask;                                                                 \
+    Load_NEON(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsCtz(mask);                                  \
+  }                                                                           \
+  return length;                                                              \
+}
+
+#define FIND_LAST_FUNC(NAME, MASK)                                            \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const uint16x8_t max_diff = MaxDiff_NEON(max_allowed_diff);                 \
+  int i;                                                                      \
+  for (i = (length - 1) & ~3; i >= 0; i -= 4) {                               \
+    uint32x4_t a, b;                                                          \
+    int mask;                                                                 \
+    Load_NEON(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsLog2Floor(mask);                            \
+  }                                                                           \
+  return -1;                                                                  \
+}
+
+FIND_FIRST_FUNC(FindFirstDiff_NEON, DiffMask_NEON)
+FIND_LAST_FUNC(FindLastDiff_NEON, DiffMask_NEON)
+FIND_FIRST_FUNC(FindFirstDissimilar_NEON, DissimilarMask_NEON)
+FIND_LAST_FUNC(FindLastDissimilar_NEON, DissimilarMask_NEON)
+
+#undef FIND_LAST_FUNC
+#undef FIND_FIRST_FUNC
+
+static int IsLosslessBlendingPossible_NEON(const uint32_t* src,
+                                           const uint32_t* dst, int length,
+                                           int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = 0; i < length; i += 4) {
+    uint32x4_t a, b;
+    Load_NEON(src, dst, i, length, &a, &b);
+    if (PixelMask_NEON(vorrq_u32(IsOpaque_NEON(b), vceqq_u32(a, b))) != 0xf) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IsLossyBlendingPossible_NEON(const uint32_t* src,
+                                        const uint32_t* dst, int length,
+                                        int max_allowed_diff) {
+  const uint16x8_t max_diff = MaxDiff_NEON(max_allowed_diff);
+  int i;
+  for (i = 0; i < length; i += 4) {
+    uint32x4_t a, b;
+    Load_NEON(src, dst, i, length, &a, &b);
+    if (PixelMask_NEON(vorrq_u32(IsOpaque_NEON(b),
+                                 AreSimilar_NEON(a, b, max_diff))) != 0xf) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IncreaseTransparency_NEON(const uint32_t* src, uint32_t* dst,
+                                     int length) {
+  int i;
+  int modified = 0;
+  for (i = 0; i < length; i += 4) {
+    uint32x4_t a, b;
+    Load_NEON(src, dst, i, length, &a, &b);
+    {
+      const uint32x4_t same = vceqq_u32(a, b);
+      const uint32x4_t not_cleared = vtstq_u32(b, b);
+      if (PixelMask_NEON(vandq_u32(same, not_cleared)) != 0) {
+        const uint32x4_t out = vbicq_u32(b, same);
+        if (i + 4 <= length) {
+          vst1q_u32(&dst[i], out);
+        } else {
+          uint32_t d[4];
+          vst1q_u32(d, out);
+          memcpy(&dst[i], d, (length - i) * sizeof(*d));
+        }
+        modified = 1;
+      }
+    }
+  }
+  return modified;
+}
+
+static int FlattenSimilarBlock_NEON(const uint32_t* src, int src_stride,
+                                    uint32_t* dst, int dst_stride,
+                                    int max_allowed_diff) {
+  const uint16x8_t max_diff = MaxDiff_NEON(max_allowed_diff);
+  uint16x8_t sum = vdupq_n_u16(0);   // per-channel sums of two pixel columns
+  uint16_t sums[8];
+  uint32_t color;
+  int y;
+  for (y = 0; y < 8; ++y) {
+    const uint32x4_t a0 = vld1q_u32(&src[y * src_stride]);
+    const uint32x4_t a1 = vld1q_u32(&src[y * src_stride + 4]);
+    const uint32x4_t b0 = vld1q_u32(&dst[y * dst_stride]);
+    const uint32x4_t b1 = vld1q_u32(&dst[y * dst_stride + 4]);
+    const uint32x4_t ok0 =
+        vandq_u32(IsOpaque_NEON(a0), AreSimilar_NEON(a0, b0, max_diff));
+    const uint32x4_t ok1 =
+        vandq_u32(IsOpaque_NEON(a1), AreSimilar_NEON(a1, b1, max_diff));
+    const uint8x16_t c0 = vreinterpretq_u8_u32(a0);
+    const uint8x16_t c1 = vreinterpretq_u8_u32(a1);
+    if (PixelMask_NEON(vandq_u32(ok0, ok1)) != 0xf) return 0;
+    sum = vaddw_u8(sum, vget_low_u8(c0));
+    sum = vaddw_u8(sum, vget_high_u8(c0));
+    sum = vaddw_u8(sum, vget_low_u8(c1));
+    sum = vaddw_u8(sum, vget_high_u8(c1));
+  }
+  // Average the 64 pixels, and make the result transparent.
+  vst1q_u16(sums, sum);
+  color = ((uint32_t)((sums[2] + sums[6]) >> 6) << 16) |
+          ((uint32_t)((sums[1] + sums[5]) >> 6) <<  8) |
+          ((uint32_t)((sums[0] + sums[4]) >> 6) <<  0);
+  {
+    const uint32x4_t out = vdupq_n_u32(color);
+    for (y = 0; y < 8; ++y) {
+      vst1q_u32(&dst[y * dst_stride], out);
+      vst1q_u32(&dst[y * dst_stride + 4], out);
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPAnimEncDspInitNEON(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPAnimEncDspInitNEON(void) {
+  WebPAnimFindFirstDiff = FindFirstDiff_NEON;
+  WebPAnimFindLastDiff = FindLastDiff_NEON;
+  WebPAnimFindFirstDissimilar = FindFirstDissimilar_NEON;
+  WebPAnimFindLastDissimilar = FindLastDissimilar_NEON;
+  WebPAnimIsLosslessBlendingPossible = IsLosslessBlendingPossible_NEON;
+  WebPAnimIsLossyBlendingPossible = IsLossyBlendingPossible_NEON;
+  WebPAnimIncreaseTransparency = IncreaseTransparency_NEON;
+  WebPAnimFlattenSimilarBlock = FlattenSimilarBlock_NEON;
+}
+
+#else  // !WEBP_USE_NEON
+
+WEBP_DSP_INIT_STUB(WebPAnimEncDspInitNEON)
+
+#endif  // WEBP_USE_NEON
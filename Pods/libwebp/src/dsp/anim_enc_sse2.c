@@ -0,0 +1,243 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 version of the pixel comparisons used by the animation encoder.
+//
+// Rows are processed 4 pixels at a time. The last incomplete group is padded
+// with transparent black in both 'src' and 'dst', which compares as equal.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_SSE2)
+#include <emmintrin.h>
+#include <string.h>
+
+#include "src/utils/utils.h"
+
+// Loads 4 pixels of 'src' and 'dst' from position 'i', padding past 'length'.
+static WEBP_INLINE void Load_SSE2(const uint32_t* src, const uint32_t* dst,
+                                  int i, int length,
+                                  __m128i* const a, __m128i* const b) {
+  if (i + 4 <= length) {
+    *a = _mm_loadu_si128((const __m128i*)&src[i]);
+    *b = _mm_loadu_si128((const __m128i*)&dst[i]);
+  } else {
+    uint32_t s[4] = { 0 }, d[4] = { 0 };
+    memcpy(s, &src[i], (length - i) * sizeof(*s));
+    memcpy(d, &dst[i], (length - i) * sizeof(*d));
+    *a = _mm_loadu_si128((const __m128i*)s);
+    *b = _mm_loadu_si128((const __m128i*)d);
+  }
+}
+
+// Returns one bit per pixel set in 'm'.
+static WEBP_INLINE int PixelMask_SSE2(const __m128i m) {
+  return _mm_movemask_ps(_mm_castsi128_ps(m));
+}
+
+// Bound on each channel difference once multiplied by alpha (see below).
+static WEBP_INLINE __m128i MaxDiff_SSE2(int max_allowed_diff) {
+  const short t = (short)(max_allowed_diff * 255);
+  return _mm_set_epi16(0, t, t, t, 0, t, t, t);
+}
+
+// Returns all ones for the pixels of 'src' and 'dst' which are similar.
+static WEBP_INLINE __m128i AreSimilar_SSE2(const __m128i src,
+                                           const __m128i dst,
+                                           const __m128i max_diff) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i diff = _mm_or_si128(_mm_subs_epu8(src, dst),
+                                    _mm_subs_epu8(dst, src));
+  // The color differences are multiplied by the alpha of 'dst', and the alpha
+  // difference by 1 so that it must be 0.
+  const __m128i a = _mm_srli_epi32(dst, 24);
+  const __m128i m = _mm_or_si128(
+      _mm_or_si128(a, _mm_slli_epi32(a, 8)),
+      _mm_or_si128(_mm_slli_epi32(a, 16), _mm_set1_epi32(0x01000000)));
+  const __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(diff, zero),
+                                     _mm_unpacklo_epi8(m, zero));
+  const __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(diff, zero),
+                                     _mm_unpackhi_epi8(m, zero));
+  const __m128i ok_lo = _mm_cmpeq_epi16(_mm_subs_epu16(lo, max_diff), zero);
+  const __m128i ok_hi = _mm_cmpeq_epi16(_mm_subs_epu16(hi, max_diff), zero);
+  return _mm_cmpeq_epi32(_mm_packs_epi16(ok_lo, ok_hi), _mm_set1_epi32(-1));
+}
+
+static WEBP_INLINE __m128i IsOpaque_SSE2(const __m128i argb) {
+  const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000u);
+  return _mm_cmpeq_epi32(_mm_and_si128(argb, alpha_mask), alpha_mask);
+}
+
+//------------------------------------------------------------------------------
+
+static WEBP_INLINE int DiffMask_SSE2(const __m128i a, const __m128i b,
+                                     const __m128i max_diff) {
+  (void)max_diff;
+  return ~PixelMask_SSE2(_mm_cmpeq_epi32(a, b)) & 0xf;
+}
+
+static WEBP_INLINE int DissimilarMask_SSE2(const __m128i a, const __m128i b,
+                                           const __m128i max_diff) {
+  return ~PixelMask_SSE2(AreSimilar_SSE2(a, b, max_diff)) & 0xf;
+}
+
+#define FIND_FIRST_FUNC(NAME, MASK)                                           \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const __m128i max_diff = MaxDiff_SSE2(max_allowed_diff);                    \
+  int i;                                                                      \
+  for (i = 0; i < length; i += 4) {                                           \
+    __m128i a, b;                                                             \
+    int mask;                                                                 \
+    Load_SSE2(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsCtz(mask);                                  \
+  }                                                                           \
+  return length;                                                              \
+}
+
+#define FIND_LAST_FUNC(NAME, MASK)                                            \
+static int NAME(const uint32_t* src, const uint32_t* dst, int length,         \
+                int max_allowed_diff) {                                       \
+  const __m128i max_diff = MaxDiff_SSE2(max_allowed_diff);                    \
+  int i;                                                                      \
+  for (i = (length - 1) & ~3; i >= 0; i -= 4) {                               \
+    __m128i a, b;                                                             \
+    int mask;                                                                 \
+    Load_SSE2(src, dst, i, length, &a, &b);                                   \
+    mask = MASK(a, b, max_diff);                                              \
+    if (mask != 0) return i + BitsLog2Floor(mask);                            \
+  }                                                                           \
+  return -1;                                                                  \
+}
+
+FIND_FIRST_FUNC(FindFirstDiff_SSE2, DiffMask_SSE2)
+FIND_LAST_FUNC(FindLastDiff_SSE2, DiffMask_SSE2)
+FIND_FIRST_FUNC(FindFirstDissimilar_SSE2, DissimilarMask_SSE2)
+FIND_LAST_FUNC(FindLastDissimilar_SSE2, DissimilarMask_SSE2)
+
+#undef FIND_LAST_FUNC
+#undef FIND_FIRST_FUNC
+
+static int IsLosslessBlendingPossible_SSE2(const uint32_t* src,
+                                           const uint32_t* dst, int length,
+                                           int max_allowed_diff) {
+  int i;
+  (void)max_allowed_diff;
+  for (i = 0; i < length; i += 4) {
+    __m128i a, b;
+    Load_SSE2(src, dst, i, length, &a, &b);
+    if (PixelMask_SSE2(_mm_or_si128(IsOpaque_SSE2(b),
+                                    _mm_cmpeq_epi32(a, b))) != 0xf) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IsLossyBlendingPossible_SSE2(const uint32_t* src,
+                                        const uint32_t* dst, int length,
+                                        int max_allowed_diff) {
+  const __m128i max_diff = MaxDiff_SSE2(max_allowed_diff);
+  int i;
+  for (i = 0; i < length; i += 4) {
+    __m128i a, b;
+    Load_SSE2(src, dst, i, length, &a, &b);
+    if (PixelMask_SSE2(_mm_or_si128(IsOpaque_SSE2(b),
+                                    AreSimilar_SSE2(a, b, max_diff))) != 0xf) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int IncreaseTransparency_SSE2(const uint32_t* src, uint32_t* dst,
+                                     int length) {
+  const __m128i zero = _mm_setzero_si128();
+  int i;
+  int modified = 0;
+  for (i = 0; i < length; i += 4) {
+    __m128i a, b;
+    Load_SSE2(src, dst, i, length, &a, &b);
+    {
+      const __m128i same = _mm_cmpeq_epi32(a, b);
+      const __m128i cleared = _mm_cmpeq_epi32(b, zero);
+      if (PixelMask_SSE2(_mm_andnot_si128(cleared, same)) != 0) {
+        const __m128i out = _mm_andnot_si128(same, b);
+        if (i + 4 <= length) {
+          _mm_storeu_si128((__m128i*)&dst[i], out);
+        } else {
+          uint32_t d[4];
+          _mm_storeu_si128((__m128i*)d, out);
+          memcpy(&dst[i], d, (length - i) * sizeof(*d));
+        }
+        modified = 1;
+      }
+    }
+  }
+  return modified;
+}
+
+static int FlattenSimilarBlock_SSE2(const uint32_t* src, int src_stride,
+                                    uint32_t* dst, int dst_stride,
+                                    int max_allowed_diff) {
+  const __m128i max_diff = MaxDiff_SSE2(max_allowed_diff);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = zero;   // per-channel sums of two pixel columns, in 16b
+  __m128i color;
+  int y;
+  for (y = 0; y < 8; ++y) {
+    const __m128i a0 = _mm_loadu_si128((const __m128i*)&src[y * src_stride]);
+    const __m128i a1 =
+        _mm_loadu_si128((const __m128i*)&src[y * src_stride + 4]);
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)&dst[y * dst_stride]);
+    const __m128i b1 =
+        _mm_loadu_si128((const __m128i*)&dst[y * dst_stride + 4]);
+    const __m128i ok0 =
+        _mm_and_si128(IsOpaque_SSE2(a0), AreSimilar_SSE2(a0, b0, max_diff));
+    const __m128i ok1 =
+        _mm_and_si128(IsOpaque_SSE2(a1), AreSimilar_SSE2(a1, b1, max_diff));
+    if (PixelMask_SSE2(_mm_and_si128(ok0, ok1)) != 0xf) return 0;
+    sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(a0, zero));
+    sum = _mm_add_epi16(sum, _mm_unpackhi_epi8(a0, zero));
+    sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(a1, zero));
+    sum = _mm_add_epi16(sum, _mm_unpackhi_epi8(a1, zero));
+  }
+  // Average the 64 pixels, and make the result transparent.
+  sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_si128(sum, 8)), 6);
+  color = _mm_and_si128(_mm_shuffle_epi32(_mm_packus_epi16(sum, sum), 0),
+                        _mm_set1_epi32(0x00ffffff));
+  for (y = 0; y < 8; ++y) {
+    _mm_storeu_si128((__m128i*)&dst[y * dst_stride], color);
+    _mm_storeu_si128((__m128i*)&dst[y * dst_stride + 4], color);
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPAnimEncDspInitSSE2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPAnimEncDspInitSSE2(void) {
+  WebPAnimFindFirstDiff = FindFirstDiff_SSE2;
+  WebPAnimFindLastDiff = FindLastDiff_SSE2;
+  WebPAnimFindFirstDissimilar = FindFirstDissimilar_SSE2;
+  WebPAnimFindLastDissimilar = FindLastDissimilar_SSE2;
+  WebPAnimIsLosslessBlendingPossible = IsLosslessBlendingPossible_SSE2;
+  WebPAnimIsLossyBlendingPossible = IsLossyBlendingPossible_SSE2;
+  WebPAnimIncreaseTransparency = IncreaseTransparency_SSE2;
+  WebPAnimFlattenSimilarBlock = FlattenSimilarBlock_SSE2;
+}
+
+#else  // !WEBP_USE_SSE2
+
+WEBP_DSP_INIT_STUB(WebPAnimEncDspInitSSE2)
+
+#endif  // WEBP_USE_SSE2
@@ -190,6 +190,46 @@ extern VP8AccumulateSSEFunc VP8AccumulateSSE;
 // must be called before using any of the above directly
 void VP8SSIMDspInit(void);
 
+//------------------------------------------------------------------------------
+// Animation encoding: comparisons between ARGB canvases
+
+// Pixels are similar if their alpha values are equal and their colors differ
+// by at most 'max_allowed_diff' per channel, once weighted by alpha / 255.
+// Functions returning the position of the first (resp. last) of 'length'
+// pixels which differ in 'src' and 'dst', or 'length' (resp. -1) if there is
+// none. 'max_allowed_diff' is in [0, 255] and only used for the *Dissimilar()
+// variants.
+typedef int (*WebPAnimFindDiffFunc)(const uint32_t* src, const uint32_t* dst,
+                                    int length, int max_allowed_diff);
+WEBP_EXTERN WebPAnimFindDiffFunc WebPAnimFindFirstDiff;
+WEBP_EXTERN WebPAnimFindDiffFunc WebPAnimFindLastDiff;
+WEBP_EXTERN WebPAnimFindDiffFunc WebPAnimFindFirstDissimilar;
+WEBP_EXTERN WebPAnimFindDiffFunc WebPAnimFindLastDissimilar;
+
+// Functions returning true if all the non-opaque pixels of 'dst' are equal
+// (resp. similar) to those of 'src', i.e. if 'dst' can be blended onto 'src'.
+typedef int (*WebPAnimBlendingPossibleFunc)(const uint32_t* src,
+                                            const uint32_t* dst, int length,
+                                            int max_allowed_diff);
+WEBP_EXTERN WebPAnimBlendingPossibleFunc WebPAnimIsLosslessBlendingPossible;
+WEBP_EXTERN WebPAnimBlendingPossibleFunc WebPAnimIsLossyBlendingPossible;
+
+// Replaces the pixels of 'dst' which are equal to those of 'src' by
+// transparent black. Returns true if at least one pixel was modified.
+WEBP_EXTERN int (*WebPAnimIncreaseTransparency)(const uint32_t* src,
+                                                uint32_t* dst, int length);
+
+// If the 8x8 block at 'src' is opaque and similar to the one at 'dst',
+// replaces the latter by a transparent block of the average color of 'src'
+// and returns true.
+WEBP_EXTERN int (*WebPAnimFlattenSimilarBlock)(const uint32_t* src,
+                                               int src_stride, uint32_t* dst,
+                                               int dst_stride,
+                                               int max_allowed_diff);
+
+// To be called first before using the above.
+WEBP_EXTERN void WebPAnimEncDspInit(void);
+
 //------------------------------------------------------------------------------
 // Decoding
 
@@ -734,6 +734,7 @@ VP8BlockCopy VP8Copy16x8;
 
 extern void VP8EncDspInitSSE2(void);
 extern void VP8EncDspInitSSE41(void);
+extern void VP8EncDspInitAVX2(void);
 extern void VP8EncDspInitNEON(void);
 extern void VP8EncDspInitMIPS32(void);
 extern void VP8EncDspInitMIPSdspR2(void);
@@ -780,6 +781,13 @@ WEBP_DSP_INIT_FUNC(VP8EncDspInit) {
       if (VP8GetCPUInfo(kSSE4_1)) {
         VP8EncDspInitSSE41();
       }
+#endif
+      // Not nested in the SSE4.1 case: WEBP_HAVE_SSE41 needs this file to be
+      // compiled with -msse4.1, while only the *_avx2.c files get -mavx2.
+#if defined(WEBP_HAVE_AVX2)
+      if (VP8GetCPUInfo(kAVX2)) {
+        VP8EncDspInitAVX2();
+      }
 #endif
     }
 #endif
@@ -0,0 +1,462 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of some encoding functions.
+//
+// Most functions process two 4x4 blocks at once, one per 128-bit lane, using
+// the same operations as the SSE2/SSE4.1 versions.
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <immintrin.h>
+#include <stdlib.h>  // for abs()
+
+#include "src/enc/vp8i_enc.h"
+
+//------------------------------------------------------------------------------
+// Transforms (Paragraph 14.4)
+
+// Same as FTransformPass1_SSE2() on each lane.
+static void FTransformPass1_AVX2(const __m256i* const in01,
+                                 const __m256i* const in23,
+                                 __m256i* const out01,
+                                 __m256i* const out32) {
+  const __m256i k937 = _mm256_set1_epi32(937);
+  const __m256i k1812 = _mm256_set1_epi32(1812);
+
+  const __m256i k88p = _mm256_set1_epi32((8 << 16) | 8);
+  const __m256i k88m = _mm256_set1_epi32((int)(((uint32_t)-8 << 16) | 8));
+  const __m256i k5352_2217p = _mm256_set1_epi32((2217 << 16) | 5352);
+  const __m256i k5352_2217m =
+      _mm256_set1_epi32((int)(((uint32_t)-5352 << 16) | 2217));
+
+  // *in01 = 00 01 10 11 02 03 12 13
+  // *in23 = 20 21 30 31 22 23 32 33
+  const __m256i shuf01_p =
+      _mm256_shufflehi_epi16(*in01, _MM_SHUFFLE(2, 3, 0, 1));
+  const __m256i shuf23_p =
+      _mm256_shufflehi_epi16(*in23, _MM_SHUFFLE(2, 3, 0, 1));
+  // 00 01 10 11 03 02 13 12
+  // 20 21 30 31 23 22 33 32
+  const __m256i s01 = _mm256_unpacklo_epi64(shuf01_p, shuf23_p);
+  const __m256i s32 = _mm256_unpackhi_epi64(shuf01_p, shuf23_p);
+  // 00 01 10 11 20 21 30 31
+  // 03 02 13 12 23 22 33 32
+  const __m256i a01 = _mm256_add_epi16(s01, s32);
+  const __m256i a32 = _mm256_sub_epi16(s01, s32);
+  // [d0 + d3 | d1 + d2 | ...] = [a0 a1 | a0' a1' | ... ]
+  // [d0 - d3 | d1 - d2 | ...] = [a3 a2 | a3' a2' | ... ]
+
+  const __m256i tmp0   = _mm256_madd_epi16(a01, k88p);
+  const __m256i tmp2   = _mm256_madd_epi16(a01, k88m);
+  const __m256i tmp1_1 = _mm256_madd_epi16(a32, k5352_2217p);
+  const __m256i tmp3_1 = _mm256_madd_epi16(a32, k5352_2217m);
+  const __m256i tmp1_2 = _mm256_add_epi32(tmp1_1, k1812);
+  const __m256i tmp3_2 = _mm256_add_epi32(tmp3_1, k937);
+  const __m256i tmp1   = _mm256_srai_epi32(tmp1_2, 9);
+  const __m256i tmp3   = _mm256_srai_epi32(tmp3_2, 9);
+  const __m256i s03    = _mm256_packs_epi32(tmp0, tmp2);
+  const __m256i s12    = _mm256_packs_epi32(tmp1, tmp3);
+  const __m256i s_lo   = _mm256_unpacklo_epi16(s03, s12);   // 0 1 0 1 0 1...
+  const __m256i s_hi   = _mm256_unpackhi_epi16(s03, s12);   // 2 3 2 3 2 3
+  const __m256i v23    = _mm256_unpackhi_epi32(s_lo, s_hi);
+  *out01 = _mm256_unpacklo_epi32(s_lo, s_hi);
+  *out32 = _mm256_shuffle_epi32(v23, _MM_SHUFFLE(1, 0, 3, 2));  // 3 2 3 2..
+}
+
+// Same as FTransformPass2_SSE2() on each lane. The low lane is stored in
+// out[0..15], the high one in out[16..31].
+static void FTransformPass2_AVX2(const __m256i* const v01,
+                                 const __m256i* const v32,
+                                 int16_t* out) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i seven = _mm256_set1_epi16(7);
+  const __m256i k5352_2217 = _mm256_set1_epi32((5352 << 16) | 2217);
+  const __m256i k2217_5352 =
+      _mm256_set1_epi32((int)((2217u << 16) | (uint16_t)-5352));
+  const __m256i k12000_plus_one = _mm256_set1_epi32(12000 + (1 << 16));
+  const __m256i k51000 = _mm256_set1_epi32(51000);
+
+  // Same operations are done on the (0,3) and (1,2) pairs.
+  // a3 = v0 - v3
+  // a2 = v1 - v2
+  const __m256i a32 = _mm256_sub_epi16(*v01, *v32);
+  const __m256i a22 = _mm256_unpackhi_epi64(a32, a32);
+
+  const __m256i b23 = _mm256_unpacklo_epi16(a22, a32);
+  const __m256i c1 = _mm256_madd_epi16(b23, k5352_2217);
+  const __m256i c3 = _mm256_madd_epi16(b23, k2217_5352);
+  const __m256i d1 = _mm256_add_epi32(c1, k12000_plus_one);
+  const __m256i d3 = _mm256_add_epi32(c3, k51000);
+  const __m256i e1 = _mm256_srai_epi32(d1, 16);
+  const __m256i e3 = _mm256_srai_epi32(d3, 16);
+  // f1 = ((b3 * 5352 + b2 * 2217 + 12000) >> 16)
+  // f3 = ((b3 * 2217 - b2 * 5352 + 51000) >> 16)
+  const __m256i f1 = _mm256_packs_epi32(e1, e1);
+  const __m256i f3 = _mm256_packs_epi32(e3, e3);
+  // g1 = f1 + (a3 != 0);
+  // The compare will return (0xffff, 0) for (==0, !=0). To turn that into the
+  // desired (0, 1), we add one earlier through k12000_plus_one.
+  // -> g1 = f1 + 1 - (a3 == 0)
+  const __m256i g1 = _mm256_add_epi16(f1, _mm256_cmpeq_epi16(a32, zero));
+
+  // a0 = v0 + v3
+  // a1 = v1 + v2
+  const __m256i a01 = _mm256_add_epi16(*v01, *v32);
+  const __m256i a01_plus_7 = _mm256_add_epi16(a01, seven);
+  const __m256i a11 = _mm256_unpackhi_epi64(a01, a01);
+  const __m256i c0 = _mm256_add_epi16(a01_plus_7, a11);
+  const __m256i c2 = _mm256_sub_epi16(a01_plus_7, a11);
+  // d0 = (a0 + a1 + 7) >> 4;
+  // d2 = (a0 - a1 + 7) >> 4;
+  const __m256i d0 = _mm256_srai_epi16(c0, 4);
+  const __m256i d2 = _mm256_srai_epi16(c2, 4);
+
+  const __m256i d0_g1 = _mm256_unpacklo_epi64(d0, g1);
+  const __m256i d2_f3 = _mm256_unpacklo_epi64(d2, f3);
+  // Gather the 16 coefficients of each block.
+  const __m256i out_0 = _mm256_permute2x128_si256(d0_g1, d2_f3, 0x20);
+  const __m256i out_1 = _mm256_permute2x128_si256(d0_g1, d2_f3, 0x31);
+  _mm256_storeu_si256((__m256i*)&out[0], out_0);
+  _mm256_storeu_si256((__m256i*)&out[16], out_1);
+}
+
+static void FTransform2_AVX2(const uint8_t* src, const uint8_t* ref,
+                             int16_t* out) {
+  // Load src and ref and convert to 16b.
+  // 00 01 02 03 00' 01' 02' 03'
+  const __m128i src0 = _mm_loadl_epi64((const __m128i*)&src[0 * BPS]);
+  const __m128i src1 = _mm_loadl_epi64((const __m128i*)&src[1 * BPS]);
+  const __m128i src2 = _mm_loadl_epi64((const __m128i*)&src[2 * BPS]);
+  const __m128i src3 = _mm_loadl_epi64((const __m128i*)&src[3 * BPS]);
+  const __m128i ref0 = _mm_loadl_epi64((const __m128i*)&ref[0 * BPS]);
+  const __m128i ref1 = _mm_loadl_epi64((const __m128i*)&ref[1 * BPS]);
+  const __m128i ref2 = _mm_loadl_epi64((const __m128i*)&ref[2 * BPS]);
+  const __m128i ref3 = _mm_loadl_epi64((const __m128i*)&ref[3 * BPS]);
+  // Two rows per register.
+  const __m256i src01 =
+      _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(src0, src1));
+  const __m256i src23 =
+      _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(src2, src3));
+  const __m256i ref01 =
+      _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(ref0, ref1));
+  const __m256i ref23 =
+      _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(ref2, ref3));
+  // Compute difference.
+  // 00 01 02 03 10 11 12 13 | 00' 01' 02' 03' 10' 11' 12' 13'
+  // 20 21 22 23 30 31 32 33 | 20' 21' 22' 23' 30' 31' 32' 33'
+  const __m256i diff01 = _mm256_sub_epi16(src01, ref01);
+  const __m256i diff23 = _mm256_sub_epi16(src23, ref23);
+  // Shuffle to 00 01 10 11 02 03 12 13, as expected by the first pass.
+  const __m256i shuf01 = _mm256_shuffle_epi32(diff01, _MM_SHUFFLE(3, 1, 2, 0));
+  const __m256i shuf23 = _mm256_shuffle_epi32(diff23, _MM_SHUFFLE(3, 1, 2, 0));
+  __m256i v01, v32;
+
+  // First pass
+  FTransformPass1_AVX2(&shuf01, &shuf23, &v01, &v32);
+
+  // Second pass
+  FTransformPass2_AVX2(&v01, &v32, out);
+}
+
+//------------------------------------------------------------------------------
+// Compute susceptibility based on DCT-coeff histograms:
+// the higher, the "easier" the macroblock is to compress.
+
+static void CollectHistogram_AVX2(const uint8_t* ref, const uint8_t* pred,
+                                  int start_block, int end_block,
+                                  VP8Histogram* const histo) {
+  const __m256i max_coeff_thresh = _mm256_set1_epi16(MAX_COEFF_THRESH);
+  int j;
+  int distribution[MAX_COEFF_THRESH + 1] = { 0 };
+  for (j = start_block; j < end_block;) {
+    int16_t out[32];
+    int k, num_coeffs = 16;
+
+    // Blocks that are side by side are transformed together.
+    if (j + 1 < end_block && VP8DspScan[j + 1] == VP8DspScan[j] + 4) {
+      FTransform2_AVX2(ref + VP8DspScan[j], pred + VP8DspScan[j], out);
+      num_coeffs = 32;
+    } else {
+      VP8FTransform(ref + VP8DspScan[j], pred + VP8DspScan[j], out);
+    }
+
+    // Convert coefficients to bin (within out[]).
+    for (k = 0; k < num_coeffs; k += 16) {
+      // v = abs(out) >> 3
+      const __m256i v = _mm256_srai_epi16(
+          _mm256_abs_epi16(_mm256_loadu_si256((const __m256i*)&out[k])), 3);
+      // bin = min(v, MAX_COEFF_THRESH)
+      const __m256i bin = _mm256_min_epi16(v, max_coeff_thresh);
+      _mm256_storeu_si256((__m256i*)&out[k], bin);
+    }
+
+    // Convert coefficients to bin.
+    for (k = 0; k < num_coeffs; ++k) {
+      ++distribution[out[k]];
+    }
+    j += num_coeffs / 16;
+  }
+  VP8SetHistogramData(distribution, histo);
+}
+
+//------------------------------------------------------------------------------
+// Metric
+
+static int SSE16x16_AVX2(const uint8_t* a, const uint8_t* b) {
+  __m256i sum = _mm256_setzero_si256();
+  __m128i sum_128;
+  int y;
+  for (y = 0; y < 16; ++y) {
+    const __m256i a0 =
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&a[y * BPS]));
+    const __m256i b0 =
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&b[y * BPS]));
+    const __m256i d0 = _mm256_sub_epi16(a0, b0);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d0, d0));
+  }
+  sum_128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                          _mm256_extracti128_si256(sum, 1));
+  sum_128 = _mm_add_epi32(sum_128, _mm_srli_si128(sum_128, 8));
+  sum_128 = _mm_add_epi32(sum_128, _mm_srli_si128(sum_128, 4));
+  return _mm_cvtsi128_si32(sum_128);
+}
+
+//------------------------------------------------------------------------------
+// Texture distortion
+//
+// We try to match the spectral content (weighted) between source and
+// reconstructed samples.
+
+// Same as TTransform_SSE41() but on the two 4x4 blocks at 'inA' / 'inB' and
+// at 'inA + 4' / 'inB + 4'. Returns the distortion of both blocks.
+static int Disto2x4x4_AVX2(const uint8_t* inA, const uint8_t* inB,
+                           const __m256i* const w_0, const __m256i* const w_8) {
+  int32_t sum[8];
+  __m256i tmp_0, tmp_1, tmp_2, tmp_3;
+
+  // Load and combine inputs.
+  {
+    const __m128i inA_0 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 0]);
+    const __m128i inA_1 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 1]);
+    const __m128i inA_2 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 2]);
+    const __m128i inA_3 = _mm_loadl_epi64((const __m128i*)&inA[BPS * 3]);
+    const __m128i inB_0 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 0]);
+    const __m128i inB_1 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 1]);
+    const __m128i inB_2 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 2]);
+    const __m128i inB_3 = _mm_loadl_epi64((const __m128i*)&inB[BPS * 3]);
+
+    // Combine inA and inB (we'll do two transforms in parallel per lane).
+    tmp_0 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_0, inB_0));
+    tmp_1 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_1, inB_1));
+    tmp_2 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_2, inB_2));
+    tmp_3 = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA_3, inB_3));
+    // a00 a01 a02 a03   b00 b01 b02 b03 | a04 ... a07   b04 ... b07
+    // a10 a11 a12 a13   b10 b11 b12 b13 | a14 ... a17   b14 ... b17
+    // a20 a21 a22 a23   b20 b21 b22 b23 | a24 ... a27   b24 ... b27
+    // a30 a31 a32 a33   b30 b31 b32 b33 | a34 ... a37   b34 ... b37
+  }
+
+  // Vertical pass first to avoid a transpose (vertical and horizontal passes
+  // are commutative because w/kWeightY is symmetric) and subsequent transpose.
+  {
+    // Calculate a and b (two 4x4 at once per lane).
+    const __m256i a0 = _mm256_add_epi16(tmp_0, tmp_2);
+    const __m256i a1 = _mm256_add_epi16(tmp_1, tmp_3);
+    const __m256i a2 = _mm256_sub_epi16(tmp_1, tmp_3);
+    const __m256i a3 = _mm256_sub_epi16(tmp_0, tmp_2);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+
+    // Transpose the two 4x4 of each lane, as in VP8Transpose_2_4x4_16b().
+    const __m256i transpose0_0 = _mm256_unpacklo_epi16(b0, b1);
+    const __m256i transpose0_1 = _mm256_unpacklo_epi16(b2, b3);
+    const __m256i transpose0_2 = _mm256_unpackhi_epi16(b0, b1);
+    const __m256i transpose0_3 = _mm256_unpackhi_epi16(b2, b3);
+    const __m256i transpose1_0 =
+        _mm256_unpacklo_epi32(transpose0_0, transpose0_1);
+    const __m256i transpose1_1 =
+        _mm256_unpacklo_epi32(transpose0_2, transpose0_3);
+    const __m256i transpose1_2 =
+        _mm256_unpackhi_epi32(transpose0_0, transpose0_1);
+    const __m256i transpose1_3 =
+        _mm256_unpackhi_epi32(transpose0_2, transpose0_3);
+    tmp_0 = _mm256_unpacklo_epi64(transpose1_0, transpose1_1);
+    tmp_1 = _mm256_unpackhi_epi64(transpose1_0, transpose1_1);
+    tmp_2 = _mm256_unpacklo_epi64(transpose1_2, transpose1_3);
+    tmp_3 = _mm256_unpackhi_epi64(transpose1_2, transpose1_3);
+  }
+
+  // Horizontal pass and difference of weighted sums.
+  {
+    // Calculate a and b (two 4x4 at once per lane).
+    const __m256i a0 = _mm256_add_epi16(tmp_0, tmp_2);
+    const __m256i a1 = _mm256_add_epi16(tmp_1, tmp_3);
+    const __m256i a2 = _mm256_sub_epi16(tmp_1, tmp_3);
+    const __m256i a3 = _mm256_sub_epi16(tmp_0, tmp_2);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+
+    // Separate the transforms of inA and inB.
+    __m256i A_b0 = _mm256_unpacklo_epi64(b0, b1);
+    __m256i A_b2 = _mm256_unpacklo_epi64(b2, b3);
+    __m256i B_b0 = _mm256_unpackhi_epi64(b0, b1);
+    __m256i B_b2 = _mm256_unpackhi_epi64(b2, b3);
+
+    A_b0 = _mm256_abs_epi16(A_b0);
+    A_b2 = _mm256_abs_epi16(A_b2);
+    B_b0 = _mm256_abs_epi16(B_b0);
+    B_b2 = _mm256_abs_epi16(B_b2);
+
+    // weighted sums
+    A_b0 = _mm256_madd_epi16(A_b0, *w_0);
+    A_b2 = _mm256_madd_epi16(A_b2, *w_8);
+    B_b0 = _mm256_madd_epi16(B_b0, *w_0);
+    B_b2 = _mm256_madd_epi16(B_b2, *w_8);
+    A_b0 = _mm256_add_epi32(A_b0, A_b2);
+    B_b0 = _mm256_add_epi32(B_b0, B_b2);
+
+    // difference of weighted sums
+    A_b2 = _mm256_sub_epi32(A_b0, B_b0);
+    _mm256_storeu_si256((__m256i*)&sum[0], A_b2);
+  }
+  return (abs(sum[0] + sum[1] + sum[2] + sum[3]) >> 5) +
+         (abs(sum[4] + sum[5] + sum[6] + sum[7]) >> 5);
+}
+
+static int Disto16x16_AVX2(const uint8_t* const a, const uint8_t* const b,
+                           const uint16_t* const w) {
+  const __m256i w_0 =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[0]));
+  const __m256i w_8 =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[8]));
+  int D = 0;
+  int x, y;
+  for (y = 0; y < 16 * BPS; y += 4 * BPS) {
+    for (x = 0; x < 16; x += 8) {
+      D += Disto2x4x4_AVX2(a + x + y, b + x + y, &w_0, &w_8);
+    }
+  }
+  return D;
+}
+
+//------------------------------------------------------------------------------
+// Quantization
+//
+
+// Same as DoQuantizeBlock_SSE41() with the 16 coefficients of the block in
+// one register. The bias is given as [0..3 8..11] and [4..7 12..15], the
+// order in which the 32b products are computed.
+static WEBP_INLINE int DoQuantizeBlock_AVX2(int16_t in[16], int16_t out[16],
+                                            const __m256i* const sharpen,
+                                            const __m256i* const iq,
+                                            const __m256i* const q,
+                                            const __m256i* const bias_lo,
+                                            const __m256i* const bias_hi) {
+  const __m256i max_coeff_2047 = _mm256_set1_epi16(MAX_LEVEL);
+  // Shuffles for the zigzag within each lane (kCst_lo/kCst_hi) and for the
+  // two entries crossing the lanes (kCst_78), applied on the swapped lanes.
+  const __m256i kCst_lohi = _mm256_setr_epi8(
+      0, 1, 2, 3, 8, 9, -1, -1, 10, 11, 4, 5, 6, 7, 12, 13,
+      2, 3, 8, 9, 10, 11, 4, 5, -1, -1, 6, 7, 12, 13, 14, 15);
+  const __m256i kCst_78 = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+  __m256i in0 = _mm256_loadu_si256((const __m256i*)in);
+  __m256i out0;
+
+  // coeff = abs(in) + sharpen
+  __m256i coeff0 = _mm256_abs_epi16(in0);
+  if (sharpen != NULL) coeff0 = _mm256_add_epi16(coeff0, *sharpen);
+
+  // out = (coeff * iQ + B) >> QFIX
+  {
+    // doing calculations with 32b precision (QFIX=17)
+    // out = (coeff * iQ)
+    const __m256i coeff_iQH = _mm256_mulhi_epu16(coeff0, *iq);
+    const __m256i coeff_iQL = _mm256_mullo_epi16(coeff0, *iq);
+    __m256i out_lo = _mm256_unpacklo_epi16(coeff_iQL, coeff_iQH);
+    __m256i out_hi = _mm256_unpackhi_epi16(coeff_iQL, coeff_iQH);
+    // out = (coeff * iQ + B)
+    out_lo = _mm256_add_epi32(out_lo, *bias_lo);
+    out_hi = _mm256_add_epi32(out_hi, *bias_hi);
+    // out = QUANTDIV(coeff, iQ, B, QFIX)
+    out_lo = _mm256_srai_epi32(out_lo, QFIX);
+    out_hi = _mm256_srai_epi32(out_hi, QFIX);
+    // pack result as 16b
+    out0 = _mm256_packs_epi32(out_lo, out_hi);
+    // if (coeff > 2047) coeff = 2047
+    out0 = _mm256_min_epi16(out0, max_coeff_2047);
+  }
+
+  // put sign back
+  out0 = _mm256_sign_epi16(out0, in0);
+
+  // in = out * Q
+  in0 = _mm256_mullo_epi16(out0, *q);
+  _mm256_storeu_si256((__m256i*)in, in0);
+
+  // zigzag the output before storing it. The re-ordering is:
+  //    0 1 2 3 4 5 6 7 | 8  9 10 11 12 13 14 15
+  // -> 0 1 4[8]5 2 3 6 | 9 12 13 10 [7]11 14 15
+  // There's only two misplaced entries ([8] and [7]) that are crossing the
+  // lanes' boundaries.
+  {
+    const __m256i swapped = _mm256_permute4x64_epi64(out0,
+                                                     _MM_SHUFFLE(1, 0, 3, 2));
+    const __m256i tmp_lohi = _mm256_shuffle_epi8(out0, kCst_lohi);
+    const __m256i tmp_78 = _mm256_shuffle_epi8(swapped, kCst_78);
+    const __m256i out_z = _mm256_or_si256(tmp_lohi, tmp_78);
+    _mm256_storeu_si256((__m256i*)out, out_z);
+  }
+
+  // detect if all 'out' values are zeroes or not
+  return !_mm256_testz_si256(out0, out0);
+}
+
+static int Quantize2Blocks_AVX2(int16_t in[32], int16_t out[32],
+                                const VP8Matrix* const mtx) {
+  const __m256i sharpen =
+      _mm256_loadu_si256((const __m256i*)&mtx->sharpen_[0]);
+  const __m256i iq = _mm256_loadu_si256((const __m256i*)&mtx->iq_[0]);
+  const __m256i q = _mm256_loadu_si256((const __m256i*)&mtx->q_[0]);
+  const __m256i bias_0 = _mm256_loadu_si256((const __m256i*)&mtx->bias_[0]);
+  const __m256i bias_8 = _mm256_loadu_si256((const __m256i*)&mtx->bias_[8]);
+  const __m256i bias_lo = _mm256_permute2x128_si256(bias_0, bias_8, 0x20);
+  const __m256i bias_hi = _mm256_permute2x128_si256(bias_0, bias_8, 0x31);
+  int nz;
+  nz  = DoQuantizeBlock_AVX2(in + 0 * 16, out + 0 * 16, &sharpen, &iq, &q,
+                             &bias_lo, &bias_hi) << 0;
+  nz |= DoQuantizeBlock_AVX2(in + 1 * 16, out + 1 * 16, &sharpen, &iq, &q,
+                             &bias_lo, &bias_hi) << 1;
+  return nz;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8EncDspInitAVX2(void);
+WEBP_TSAN_IGNORE_FUNCTION void VP8EncDspInitAVX2(void) {
+  VP8CollectHistogram = CollectHistogram_AVX2;
+  VP8EncQuantize2Blocks = Quantize2Blocks_AVX2;
+  VP8FTransform2 = FTransform2_AVX2;
+  VP8SSE16x16 = SSE16x16_AVX2;
+  VP8TDisto16x16 = Disto16x16_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8EncDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
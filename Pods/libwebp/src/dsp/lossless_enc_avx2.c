@@ -0,0 +1,177 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 variant of methods for lossless encoder
+
+#include "src/dsp/dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <immintrin.h>
+#include "src/dsp/lossless.h"
+
+// For sign-extended multiplying constants, pre-shifted by 5:
+#define CST_5b(X)  (((int16_t)((uint16_t)(X) << 8)) >> 5)
+
+//------------------------------------------------------------------------------
+// Subtract-Green Transform
+
+static void SubtractGreenFromBlueAndRed_AVX2(uint32_t* argb_data,
+                                             int num_pixels) {
+  int i;
+  const __m256i kCstShuffle = _mm256_setr_epi8(
+      1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13, -1,
+      1, -1, 1, -1, 5, -1, 5, -1, 9, -1, 9, -1, 13, -1, 13, -1);
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i in = _mm256_loadu_si256((__m256i*)&argb_data[i]);
+    const __m256i in_0g0g = _mm256_shuffle_epi8(in, kCstShuffle);
+    const __m256i out = _mm256_sub_epi8(in, in_0g0g);
+    _mm256_storeu_si256((__m256i*)&argb_data[i], out);
+  }
+  // fallthrough and finish off with plain-C
+  if (i != num_pixels) {
+    VP8LSubtractGreenFromBlueAndRed_C(argb_data + i, num_pixels - i);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Color Transform
+
+#define MK_CST_16(HI, LO) \
+  _mm256_set1_epi32((int)(((uint32_t)(HI) << 16) | ((LO) & 0xffff)))
+
+static void TransformColor_AVX2(const VP8LMultipliers* const m,
+                                uint32_t* argb_data, int num_pixels) {
+  const __m256i mults_rb = MK_CST_16(CST_5b(m->green_to_red_),
+                                     CST_5b(m->green_to_blue_));
+  const __m256i mults_b2 = MK_CST_16(CST_5b(m->red_to_blue_), 0);
+  const __m256i mask_ag = _mm256_set1_epi32(0xff00ff00);  // alpha-green masks
+  const __m256i mask_rb = _mm256_set1_epi32(0x00ff00ff);  // red-blue masks
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i in = _mm256_loadu_si256((__m256i*)&argb_data[i]); // argb
+    const __m256i A = _mm256_and_si256(in, mask_ag);    // a   0   g   0
+    const __m256i B = _mm256_shufflelo_epi16(A, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m256i C = _mm256_shufflehi_epi16(B, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m256i D = _mm256_mulhi_epi16(C, mults_rb);  // x dr  x db1
+    const __m256i E = _mm256_slli_epi16(in, 8);         // r 0   b   0
+    const __m256i F = _mm256_mulhi_epi16(E, mults_b2);  // x db2 0   0
+    const __m256i G = _mm256_srli_epi32(F, 16);         // 0 0   x db2
+    const __m256i H = _mm256_add_epi8(G, D);            // x dr  x  db
+    const __m256i I = _mm256_and_si256(H, mask_rb);     // 0 dr  0  db
+    const __m256i out = _mm256_sub_epi8(in, I);
+    _mm256_storeu_si256((__m256i*)&argb_data[i], out);
+  }
+  // fallthrough and finish off with plain-C
+  if (i != num_pixels) {
+    VP8LTransformColor_C(m, argb_data + i, num_pixels - i);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void CollectColorBlueTransforms_AVX2(const uint32_t* argb, int stride,
+                                            int tile_width, int tile_height,
+                                            int green_to_blue, int red_to_blue,
+                                            int histo[]) {
+  const __m256i mult =
+      MK_CST_16(CST_5b(red_to_blue) + 256, CST_5b(green_to_blue));
+  const __m256i perm = _mm256_setr_epi8(
+      -1, 1, -1, 2, -1, 5, -1, 6, -1, 9, -1, 10, -1, 13, -1, 14,
+      -1, 1, -1, 2, -1, 5, -1, 6, -1, 9, -1, 10, -1, 13, -1, 14);
+  if (tile_width >= 8) {
+    int y;
+    for (y = 0; y < tile_height; ++y) {
+      const uint32_t* const src = argb + y * stride;
+      int x;
+      for (x = 0; x + 8 <= tile_width; x += 8) {
+        uint8_t values[32];
+        const __m256i A = _mm256_loadu_si256((const __m256i*)(src + x));
+        const __m256i B = _mm256_shuffle_epi8(A, perm);
+        const __m256i C = _mm256_mulhi_epi16(B, mult);
+        const __m256i D = _mm256_sub_epi16(A, C);
+        const __m256i E = _mm256_add_epi16(_mm256_srli_epi32(D, 16), D);
+        _mm256_storeu_si256((__m256i*)values, E);
+        ++histo[values[0]];
+        ++histo[values[4]];
+        ++histo[values[8]];
+        ++histo[values[12]];
+        ++histo[values[16]];
+        ++histo[values[20]];
+        ++histo[values[24]];
+        ++histo[values[28]];
+      }
+    }
+  }
+  {
+    const int left_over = tile_width & 7;
+    if (left_over > 0) {
+      VP8LCollectColorBlueTransforms_C(argb + tile_width - left_over, stride,
+                                       left_over, tile_height,
+                                       green_to_blue, red_to_blue, histo);
+    }
+  }
+}
+
+static void CollectColorRedTransforms_AVX2(const uint32_t* argb, int stride,
+                                           int tile_width, int tile_height,
+                                           int green_to_red, int histo[]) {
+  const __m256i mult = MK_CST_16(0, CST_5b(green_to_red));
+  const __m256i mask_g = _mm256_set1_epi32(0x0000ff00);
+  if (tile_width >= 8) {
+    int y;
+    for (y = 0; y < tile_height; ++y) {
+      const uint32_t* const src = argb + y * stride;
+      int x;
+      for (x = 0; x + 8 <= tile_width; x += 8) {
+        uint8_t values[32];
+        const __m256i A = _mm256_loadu_si256((const __m256i*)(src + x));
+        const __m256i B = _mm256_and_si256(A, mask_g);
+        const __m256i C = _mm256_madd_epi16(B, mult);
+        const __m256i D = _mm256_sub_epi16(A, C);
+        _mm256_storeu_si256((__m256i*)values, D);
+        ++histo[values[2]];
+        ++histo[values[6]];
+        ++histo[values[10]];
+        ++histo[values[14]];
+        ++histo[values[18]];
+        ++histo[values[22]];
+        ++histo[values[26]];
+        ++histo[values[30]];
+      }
+    }
+  }
+  {
+    const int left_over = tile_width & 7;
+    if (left_over > 0) {
+      VP8LCollectColorRedTransforms_C(argb + tile_width - left_over, stride,
+                                      left_over, tile_height, green_to_red,
+                                      histo);
+    }
+  }
+}
+
+#undef MK_CST_16
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LEncDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8LEncDspInitAVX2(void) {
+  VP8LSubtractGreenFromBlueAndRed = SubtractGreenFromBlueAndRed_AVX2;
+  VP8LTransformColor = TransformColor_AVX2;
+  VP8LCollectColorBlueTransforms = CollectColorBlueTransforms_AVX2;
+  VP8LCollectColorRedTransforms = CollectColorRedTransforms_AVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8LEncDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
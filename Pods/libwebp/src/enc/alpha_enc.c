@@ -49,7 +49,8 @@
 static int EncodeLossless(const uint8_t* const data, int width, int height,
                           int effort_level,  // in [0..6] range
                           int use_quality_100, VP8LBitWriter* const bw,
-                          WebPAuxStats* const stats) {
+                          WebPAuxStats* const stats,
+                          VP8LEncoderCache* const encoders) {
   int ok = 0;
   WebPConfig config;
   WebPPicture picture;
@@ -86,7 +87,7 @@ static int EncodeLossless(const uint8_t* const data, int width, int height,
   // a decoder bug related to alpha with color cache.
   // See: https://code.google.com/p/webp/issues/detail?id=239
   // Need to re-enable this later.
-  ok = VP8LEncodeStream(&config, &picture, bw, /*use_cache=*/0);
+  ok = VP8LEncodeStream(&config, &picture, bw, /*use_cache=*/0, encoders);
   WebPPictureFree(&picture);
   ok = ok && !bw->error_;
   if (!ok) {
@@ -110,6 +111,7 @@ static int EncodeAlphaInternal(const uint8_t* const data, int width, int height,
                                int method, int filter, int reduce_levels,
                                int effort_level,  // in [0..6] range
                                uint8_t* const tmp_alpha,
+                               VP8LEncoderCache* const encoders,
                                FilterTrial* result) {
   int ok = 0;
   const uint8_t* alpha_src;
@@ -137,7 +139,8 @@ static int EncodeAlphaInternal(const uint8_t* const data, int width, int height,
   if (method != ALPHA_NO_COMPRESSION) {
     ok = VP8LBitWriterInit(&tmp_bw, data_size >> 3);
     ok = ok && EncodeLossless(alpha_src, width, height, effort_level,
-                              !reduce_levels, &tmp_bw, &result->stats);
+                              !reduce_levels, &tmp_bw, &result->stats,
+                              encoders);
     if (ok) {
       output = VP8LBitWriterFinish(&tmp_bw);
       output_size = VP8LBitWriterNumBytes(&tmp_bw);
@@ -236,7 +239,8 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
                                  int reduce_levels, int effort_level,
                                  uint8_t** const output,
                                  size_t* const output_size,
-                                 WebPAuxStats* const stats) {
+                                 WebPAuxStats* const stats,
+                                 VP8LEncoderCache* const encoders) {
   int ok = 1;
   FilterTrial best;
   uint32_t try_map =
@@ -252,7 +256,7 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
         FilterTrial trial;
         ok = EncodeAlphaInternal(alpha, width, height, method, filter,
                                  reduce_levels, effort_level, filtered_alpha,
-                                 &trial);
+                                 encoders, &trial);
         if (ok && trial.score < best.score) {
           VP8BitWriterWipeOut(&best.bw);
           best = trial;
@@ -264,7 +268,8 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
     WebPSafeFree(filtered_alpha);
   } else {
     ok = EncodeAlphaInternal(alpha, width, height, method, WEBP_FILTER_NONE,
-                             reduce_levels, effort_level, NULL, &best);
+                             reduce_levels, effort_level, NULL, encoders,
+                             &best);
   }
   if (ok) {
 #if !defined(WEBP_DISABLE_STATS)
@@ -345,7 +350,7 @@ static int EncodeAlpha(VP8Encoder* const enc,
     VP8FiltersInit();
     ok = ApplyFiltersAndEncode(quant_alpha, width, height, data_size, method,
                                filter, reduce_levels, effort_level, output,
-                               output_size, pic->stats);
+                               output_size, pic->stats, enc->alpha_encoders_);
 #if !defined(WEBP_DISABLE_STATS)
     if (pic->stats != NULL) {  // need stats?
       pic->stats->coded_size += (int)(*output_size);
@@ -129,6 +129,18 @@ void VP8LBackwardRefsInit(VP8LBackwardRefs* const refs, int block_size) {
       (block_size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : block_size;
 }
 
+void VP8LBackwardRefsReset(VP8LBackwardRefs* const refs, int block_size) {
+  assert(refs != NULL);
+  if (block_size < MIN_BLOCK_SIZE) block_size = MIN_BLOCK_SIZE;
+  if (refs->block_size_ == block_size) {
+    VP8LClearBackwardRefs(refs);   // recycle the blocks
+    refs->error_ = 0;
+  } else {
+    VP8LBackwardRefsClear(refs);
+    VP8LBackwardRefsInit(refs, block_size);
+  }
+}
+
 VP8LRefsCursor VP8LRefsCursorInit(const VP8LBackwardRefs* const refs) {
   VP8LRefsCursor c;
   c.cur_block_ = refs->refs_;
@@ -204,9 +216,10 @@ void VP8LBackwardRefsCursorAdd(VP8LBackwardRefs* const refs,
 // Hash chains
 
 int VP8LHashChainInit(VP8LHashChain* const p, int size) {
-  assert(p->size_ == 0);
-  assert(p->offset_length_ == NULL);
   assert(size > 0);
+  if (p->offset_length_ != NULL && p->size_ >= size) return 1;
+  WebPSafeFree(p->offset_length_);
+  p->size_ = 0;
   p->offset_length_ =
       (uint32_t*)WebPSafeMalloc(size, sizeof(*p->offset_length_));
   if (p->offset_length_ == NULL) return 0;
@@ -218,9 +231,11 @@ int VP8LHashChainInit(VP8LHashChain* const p, int size) {
 void VP8LHashChainClear(VP8LHashChain* const p) {
   assert(p != NULL);
   WebPSafeFree(p->offset_length_);
+  WebPSafeFree(p->hash_to_first_index_);
 
   p->size_ = 0;
   p->offset_length_ = NULL;
+  p->hash_to_first_index_ = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -280,12 +295,15 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
     return 1;
   }
 
-  hash_to_first_index =
-      (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
-  if (hash_to_first_index == NULL) {
-    WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return 0;
+  if (p->hash_to_first_index_ == NULL) {
+    p->hash_to_first_index_ =
+        (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
+    if (p->hash_to_first_index_ == NULL) {
+      WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      return 0;
+    }
   }
+  hash_to_first_index = p->hash_to_first_index_;
 
   percent_range = remaining_percent / 2;
   remaining_percent -= percent_range;
@@ -338,15 +356,12 @@ int VP8LHashChainFill(VP8LHashChain* const p, int quality,
 
     if (!WebPReportProgress(
             pic, percent_start + percent_range * pos / (size - 2), percent)) {
-      WebPSafeFree(hash_to_first_index);
       return 0;
     }
   }
   // Process the penultimate pixel.
   chain[pos] = hash_to_first_index[GetPixPairHash64(argb + pos)];
 
-  WebPSafeFree(hash_to_first_index);
-
   percent_start += percent_range;
   if (!WebPReportProgress(pic, percent_start, percent)) return 0;
   percent_range = remaining_percent;
@@ -130,9 +130,13 @@ struct VP8LHashChain {
   // This is the maximum size of the hash_chain that can be constructed.
   // Typically this is the pixel count (width x height) for a given image.
   int size_;
+  // Scratch memory of HASH_SIZE entries for VP8LHashChainFill(), allocated on
+  // first use.
+  int32_t* hash_to_first_index_;
 };
 
-// Must be called first, to set size.
+// Must be called first, to set size. The memory is kept if 'p' was already
+// initialized with a size at least as large.
 int VP8LHashChainInit(VP8LHashChain* const p, int size);
 // Pre-compute the best matches for argb. pic and percent are for progress.
 int VP8LHashChainFill(VP8LHashChain* const p, int quality,
@@ -183,6 +187,9 @@ struct VP8LBackwardRefs {
 void VP8LBackwardRefsInit(VP8LBackwardRefs* const refs, int block_size);
 // Release memory for backward references.
 void VP8LBackwardRefsClear(VP8LBackwardRefs* const refs);
+// Same as VP8LBackwardRefsInit() on an initialized (or zeroed) object, except
+// that the blocks already allocated are kept if they have the right size.
+void VP8LBackwardRefsReset(VP8LBackwardRefs* const refs, int block_size);
 
 // Cursor for iterating on references content
 typedef struct {
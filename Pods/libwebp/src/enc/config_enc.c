@@ -41,6 +41,8 @@ int WebPConfigInitInternal(WebPConfig* config,
   config->pass = 1;
   config->qmin = 0;
   config->qmax = 100;
+  config->use_tile_bands = 0;
+  config->use_rate_model = 0;
   config->show_compressed = 0;
   config->preprocessing = 0;
   config->autofilter = 0;
@@ -122,13 +124,15 @@ int WebPValidateConfig(const WebPConfig* config) {
   if (config->near_lossless < 0 || config->near_lossless > 100) return 0;
   if (config->image_hint >= WEBP_HINT_LAST) return 0;
   if (config->emulate_jpeg_size < 0 || config->emulate_jpeg_size > 1) return 0;
-  if (config->thread_level < 0 || config->thread_level > 1) return 0;
+  if (config->thread_level < 0 || config->thread_level > 64) return 0;
   if (config->low_memory < 0 || config->low_memory > 1) return 0;
   if (config->exact < 0 || config->exact > 1) return 0;
   if (config->use_delta_palette < 0 || config->use_delta_palette > 1) {
     return 0;
   }
   if (config->use_sharp_yuv < 0 || config->use_sharp_yuv > 1) return 0;
+  if (config->use_tile_bands < 0 || config->use_tile_bands > 1) return 0;
+  if (config->use_rate_model < 0 || config->use_rate_model > 1) return 0;
 
   return 1;
 }
@@ -403,6 +403,47 @@ static void RecordResiduals(VP8EncIterator* const it,
   VP8IteratorBytesToNz(it);
 }
 
+// Same as CodeResiduals, but only updates the non-zero contexts, as coding
+// the residuals would. Used when deciding macroblocks ahead of their coding.
+static void RecordNonZero(VP8EncIterator* const it,
+                          const VP8ModeScore* const rd) {
+  int x, y, ch;
+  VP8Residual res;
+  VP8Encoder* const enc = it->enc_;
+
+  VP8IteratorNzToBytes(it);
+
+  if (it->mb_->type_ == 1) {   // i16x16
+    VP8InitResidual(0, 1, enc, &res);
+    VP8SetResidualCoeffs(rd->y_dc_levels, &res);
+    it->top_nz_[8] = it->left_nz_[8] = (res.last >= 0);
+    VP8InitResidual(1, 0, enc, &res);
+  } else {
+    VP8InitResidual(0, 3, enc, &res);
+  }
+
+  // luma-AC
+  for (y = 0; y < 4; ++y) {
+    for (x = 0; x < 4; ++x) {
+      VP8SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
+      it->top_nz_[x] = it->left_nz_[y] = (res.last >= 0);
+    }
+  }
+
+  // U/V
+  VP8InitResidual(0, 2, enc, &res);
+  for (ch = 0; ch <= 2; ch += 2) {
+    for (y = 0; y < 2; ++y) {
+      for (x = 0; x < 2; ++x) {
+        VP8SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
+        it->top_nz_[4 + ch + x] = it->left_nz_[4 + ch + y] = (res.last >= 0);
+      }
+    }
+  }
+
+  VP8IteratorBytesToNz(it);
+}
+
 //------------------------------------------------------------------------------
 // Token buffer
 
@@ -477,24 +518,24 @@ static void ResetSSE(VP8Encoder* const enc) {
   enc->sse_count_ = 0;
 }
 
-static void StoreSSE(const VP8EncIterator* const it) {
-  VP8Encoder* const enc = it->enc_;
+static void StoreSSE(const VP8EncIterator* const it,
+                     uint64_t sse[3], uint64_t* const sse_count) {
   const uint8_t* const in = it->yuv_in_;
   const uint8_t* const out = it->yuv_out_;
   // Note: not totally accurate at boundary. And doesn't include in-loop filter.
-  enc->sse_[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
-  enc->sse_[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
-  enc->sse_[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
-  enc->sse_count_ += 16 * 16;
+  sse[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
+  sse[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
+  sse[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
+  *sse_count += 16 * 16;
 }
 
-static void StoreSideInfo(const VP8EncIterator* const it) {
+// Stores the macroblock's coding decisions. Doesn't need the samples.
+static void StoreModeInfo(const VP8EncIterator* const it) {
   VP8Encoder* const enc = it->enc_;
   const VP8MBInfo* const mb = it->mb_;
   WebPPicture* const pic = enc->pic_;
 
   if (pic->stats != NULL) {
-    StoreSSE(it);
     enc->block_count_[0] += (mb->type_ == 0);
     enc->block_count_[1] += (mb->type_ == 1);
     enc->block_count_[2] += (mb->skip_ != 0);
@@ -516,10 +557,18 @@ static void StoreSideInfo(const VP8EncIterator* const it) {
       default: *info = 0; break;
     }
   }
+}
+
+static void StoreSideInfo(const VP8EncIterator* const it) {
+  VP8Encoder* const enc = it->enc_;
+  if (enc->pic_->stats != NULL) {
+    StoreSSE(it, enc->sse_, &enc->sse_count_);
+  }
+  StoreModeInfo(it);
 #if SEGMENT_VISU  // visualize segments and prediction modes
-  SetBlock(it->yuv_out_ + Y_OFF_ENC, mb->segment_ * 64, 16);
+  SetBlock(it->yuv_out_ + Y_OFF_ENC, it->mb_->segment_ * 64, 16);
   SetBlock(it->yuv_out_ + U_OFF_ENC, it->preds_[0] * 64, 8);
-  SetBlock(it->yuv_out_ + V_OFF_ENC, mb->uv_mode_ * 64, 8);
+  SetBlock(it->yuv_out_ + V_OFF_ENC, it->mb_->uv_mode_ * 64, 8);
 #endif
 }
 
@@ -535,7 +584,13 @@ static void ResetSideInfo(const VP8EncIterator* const it) {
 static void ResetSSE(VP8Encoder* const enc) {
   (void)enc;
 }
-static void StoreSideInfo(const VP8EncIterator* const it) {
+static void StoreSSE(const VP8EncIterator* const it,
+                     uint64_t sse[3], uint64_t* const sse_count) {
+  (void)it;
+  (void)sse;
+  (void)sse_count;
+}
+static void StoreModeInfo(const VP8EncIterator* const it) {
   VP8Encoder* const enc = it->enc_;
   WebPPicture* const pic = enc->pic_;
   if (pic->extra_info != NULL) {
@@ -545,6 +600,9 @@ static void StoreSideInfo(const VP8EncIterator* const it) {
     }
   }
 }
+static void StoreSideInfo(const VP8EncIterator* const it) {
+  StoreModeInfo(it);
+}
 
 static void ResetSideInfo(const VP8EncIterator* const it) {
   (void)it;
@@ -555,6 +613,71 @@ static double GetPSNR(uint64_t mse, uint64_t size) {
   return (mse > 0 && size > 0) ? 10. * log10(255. * 255. * size / mse) : 99;
 }
 
+//------------------------------------------------------------------------------
+// Model-based search: the size or PSNR of the other qualities is predicted
+// from the VP8RDModel recorded during the pass, instead of being measured by
+// more passes.
+
+typedef struct {
+  const VP8Encoder* enc;
+  const VP8RDModel* model;
+  int header_weight;    // number of times the header bits count in the size
+  uint64_t pixel_count;
+  double value;         // measured value of the pass...
+  double header, rate;  // ...and the predicted bits it is made of
+} ModelSearch;
+
+static double PredictPassValue(const ModelSearch* const m, int do_size_search,
+                               float q) {
+  double header, rate, disto;
+  VP8RDModelPredict(m->enc, m->model, q, &header, &rate, &disto);
+  if (do_size_search) {
+    const double delta =
+        (rate - m->rate) + m->header_weight * (header - m->header);
+    return m->value + delta / 2048.;   // 1/256 bits -> bytes
+  }
+  return GetPSNR((uint64_t)disto, m->pixel_count);
+}
+
+// Same as ComputeNextQ(), but using the model recorded during the last pass.
+static float ComputeModelQ(const VP8Encoder* const enc,
+                           const VP8RDModel* const model, int header_weight,
+                           uint64_t pixel_count, PassStats* const s) {
+  ModelSearch m;
+  double disto;
+  float q;
+  m.enc = enc;
+  m.model = model;
+  m.header_weight = header_weight;
+  m.pixel_count = pixel_count;
+  m.value = s->value;
+  VP8RDModelPredict(enc, model, s->q, &m.header, &m.rate, &disto);
+  // The value increases with the quality: bisect for the target.
+  if (PredictPassValue(&m, s->do_size_search, s->qmax) <= s->target) {
+    q = s->qmax;
+  } else if (PredictPassValue(&m, s->do_size_search, s->qmin) >= s->target) {
+    q = s->qmin;
+  } else {
+    float qmin = s->qmin, qmax = s->qmax;
+    int i;
+    for (i = 0; i < 16; ++i) {
+      const float mid = 0.5f * (qmin + qmax);
+      if (PredictPassValue(&m, s->do_size_search, mid) > s->target) {
+        qmax = mid;
+      } else {
+        qmin = mid;
+      }
+    }
+    q = 0.5f * (qmin + qmax);
+  }
+  s->is_first = 0;
+  s->dq = q - s->q;
+  s->last_q = s->q;
+  s->last_value = s->value;
+  s->q = q;
+  return s->q;
+}
+
 //------------------------------------------------------------------------------
 //  StatLoop(): only collect statistics (number of skips, token usage, ...).
 //  This is used for deciding optimal probabilities. It also modifies the
@@ -573,7 +696,7 @@ static void SetLoopParams(VP8Encoder* const enc, float q) {
 
 static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
                             int nb_mbs, int percent_delta,
-                            PassStats* const s) {
+                            PassStats* const s, VP8RDModel* const model) {
   VP8EncIterator it;
   uint64_t size = 0;
   uint64_t size_p0 = 0;
@@ -582,6 +705,7 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
 
   VP8IteratorInit(enc, &it);
   SetLoopParams(enc, s->q);
+  if (model != NULL) VP8RDModelInit(enc, model);
   do {
     VP8ModeScore info;
     VP8IteratorImport(&it, NULL);
@@ -589,6 +713,7 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
       // Just record the number of skips and act like skip_proba is not used.
       ++enc->proba_.nb_skip_;
     }
+    if (model != NULL) VP8RDModelRecord(&it, &info, model);
     RecordResiduals(&it, &info);
     size += info.R + info.H;
     size_p0 += info.H;
@@ -615,7 +740,9 @@ static int StatLoop(VP8Encoder* const enc) {
   const int method = enc->method_;
   const int do_search = enc->do_search_;
   const int fast_probe = ((method == 0 || method == 3) && !do_search);
-  int num_pass_left = enc->config_->pass;
+  // The model needs a probe pass, and the final quality needs its own pass.
+  int num_pass_left = (enc->use_rd_model_ && enc->config_->pass < 2)
+                    ? 2 : enc->config_->pass;
   const int task_percent = 20;
   const int percent_per_pass =
       (task_percent + num_pass_left / 2) / num_pass_left;
@@ -623,7 +750,9 @@ static int StatLoop(VP8Encoder* const enc) {
   const VP8RDLevel rd_opt =
       (method >= 3 || do_search) ? RD_OPT_BASIC : RD_OPT_NONE;
   int nb_mbs = enc->mb_w_ * enc->mb_h_;
+  const uint64_t pixel_count = (uint64_t)nb_mbs * 384;
   PassStats stats;
+  VP8RDModel model;
 
   InitPassStats(enc, &stats);
   ResetTokenStats(enc);
@@ -642,7 +771,8 @@ static int StatLoop(VP8Encoder* const enc) {
                              (num_pass_left == 0) ||
                              (enc->max_i4_header_bits_ == 0);
     const uint64_t size_p0 =
-        OneStatPass(enc, rd_opt, nb_mbs, percent_per_pass, &stats);
+        OneStatPass(enc, rd_opt, nb_mbs, percent_per_pass, &stats,
+                    (enc->use_rd_model_ && !is_last_pass) ? &model : NULL);
     if (size_p0 == 0) return 0;
 #if (DEBUG_SEARCH > 0)
     printf("#%d value:%.1lf -> %.1lf   q:%.2f -> %.2f\n",
@@ -658,7 +788,12 @@ static int StatLoop(VP8Encoder* const enc) {
     }
     // If no target size: just do several pass without changing 'q'
     if (do_search) {
-      ComputeNextQ(&stats);
+      if (enc->use_rd_model_) {
+        // the header bits are counted twice in OneStatPass()'s size
+        ComputeModelQ(enc, &model, 2, pixel_count, &stats);
+      } else {
+        ComputeNextQ(&stats);
+      }
       if (fabs(stats.dq) <= DQ_LIMIT) break;
     }
   }
@@ -723,9 +858,6 @@ static int PostLoopFinalize(VP8EncIterator* const it, int ok) {
   return ok;
 }
 
-//------------------------------------------------------------------------------
-//  VP8EncLoop(): does the final bitstream coding.
-
 static void ResetAfterSkip(VP8EncIterator* const it) {
   if (it->mb_->type_ == 1) {
     *it->nz_ = 0;  // reset all predictors
@@ -735,6 +867,368 @@ static void ResetAfterSkip(VP8EncIterator* const it) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Multi-threaded mode decision.
+//
+// With thread_level > 1, the decision of the macroblocks' modes and levels
+// (VP8Decimate() and the reconstruction) is spread over several workers along
+// a wavefront: macroblock (x, y) only depends on its left neighbour and on the
+// row above, up to x + 1 (for the top-right intra4 samples). The rows are cut
+// in chunks of 'chunk_w_' macroblocks, and the chunk #k of the n-th row of a
+// range is decided during phase 'k + 2 * n', once the row above is done up to
+// chunk #k + 1. Between phases, the main thread codes the decided macroblocks
+// in raster order. Everything depending on the coding order (bit-writers,
+// token statistics, filter statistics) is updated there only, so the output
+// is the same as the single-threaded one.
+
+typedef struct {
+  VP8ModeScore info_;                 // modes and levels
+  double lf_stats_[MAX_LF_LEVELS];    // filter stats for the mb's segment
+} MBDecision;
+
+typedef struct {
+  VP8EncIterator it_;                 // iterator for the rows assigned to slot
+  LFStats lf_stats_;                  // scratch filter stats
+  int max_edge_[NUM_MB_SEGMENTS];     // max edge delta, merged after the pass
+  uint64_t sse_[3];                   // distortion, merged after the pass
+  uint64_t sse_count_;
+  VP8RDModel* rd_model_;              // rate model stats, merged after the pass
+  MBDecision* mbs_;                   // decisions for the current row (mb_w_)
+} RowSlot;
+
+typedef struct {
+  VP8Encoder* enc_;
+  WebPWorker* workers_;   // workers_[0] is executed by the main thread
+  int num_workers_;
+  int chunk_w_;           // width of the chunks, in macroblocks
+  int num_chunks_;        // number of chunks per row
+  RowSlot* slots_;        // row 'y' uses slots_[y % num_slots_]
+  int num_slots_;
+  uint32_t* nz_;          // non-zero contexts, as seen by the workers
+  VP8RDLevel rd_opt_;
+  VP8TBuffer* tokens_;    // if not NULL, tokens are recorded instead of coded
+  int use_skip_;          // true if skipped macroblocks are not coded
+  int store_info_;        // true if side info and filter stats are collected
+  int percent_delta_;     // progress for the whole pass
+  VP8RDModel* rd_model_;  // if not NULL, the rate model recorded in the pass
+  uint64_t size_p0_;      // header bits of the coded macroblocks
+  uint64_t distortion_;   // distortion of the coded macroblocks
+  int first_mb_, last_mb_;  // current range of macroblocks (in raster order)
+  int phase_;               // current phase within the range
+} EncWavefront;
+
+// Returns true if the mode decision should be spread over several threads.
+static int UseWavefront(const VP8Encoder* const enc) {
+#ifdef WEBP_USE_THREAD
+  return (enc->thread_level_ > 1) && (enc->mb_w_ > 2);
+#else
+  (void)enc;
+  return 0;
+#endif
+}
+
+// Columns [*x_start, *x_end) of row 'y' that belong to the current range.
+static void GetRowSpan(const EncWavefront* const wf, int y,
+                       int* const x_start, int* const x_end) {
+  const int mb_w = wf->enc_->mb_w_;
+  *x_start = (y == wf->first_mb_ / mb_w) ? wf->first_mb_ % mb_w : 0;
+  *x_end = (y == (wf->last_mb_ - 1) / mb_w) ? (wf->last_mb_ - 1) % mb_w + 1
+                                            : mb_w;
+}
+
+static void DecideMB(const EncWavefront* const wf, RowSlot* const slot,
+                     MBDecision* const dec) {
+  VP8EncIterator* const it = &slot->it_;
+  const WebPPicture* const pic = wf->enc_->pic_;
+  int is_skipped;
+
+  VP8IteratorImport(it, NULL);
+  is_skipped = VP8Decimate(it, &dec->info_, wf->rd_opt_);
+  if (wf->rd_model_ != NULL) {
+    VP8RDModelRecord(it, &dec->info_, slot->rd_model_);
+  }
+  if (!is_skipped || !wf->use_skip_) {
+    RecordNonZero(it, &dec->info_);
+  } else {   // reset predictors after a skip
+    ResetAfterSkip(it);
+  }
+  if (wf->store_info_) {
+    if (pic->stats != NULL) {
+      StoreSSE(it, slot->sse_, &slot->sse_count_);
+    }
+    if (it->lf_stats_ != NULL) {
+      // The stats are summed up in raster order when coding, as the
+      // single-threaded loop does, so the final filter levels are the same.
+      double* const stats = (*it->lf_stats_)[it->mb_->segment_];
+      memset(stats, 0, sizeof(dec->lf_stats_));
+      VP8StoreFilterStats(it);
+      memcpy(dec->lf_stats_, stats, sizeof(dec->lf_stats_));
+    }
+    VP8IteratorExport(it);
+  }
+  VP8IteratorSaveBoundary(it);
+  VP8IteratorNext(it);
+}
+
+// Decides the chunks of the current phase assigned to the worker.
+static int DecideChunks(void* arg1, void* arg2) {
+  EncWavefront* const wf = (EncWavefront*)arg1;
+  const int index = (int)((WebPWorker*)arg2 - wf->workers_);
+  const int mb_w = wf->enc_->mb_w_;
+  const int first_row = wf->first_mb_ / mb_w;
+  const int last_row = (wf->last_mb_ - 1) / mb_w;
+  const int p = wf->phase_;
+  int num_tasks = 0;
+  // first row whose chunk #(p - 2 * n) exists
+  int y = first_row + ((p >= wf->num_chunks_) ? (p - wf->num_chunks_ + 2) / 2
+                                              : 0);
+  for (; y <= last_row && 2 * (y - first_row) <= p; ++y) {
+    const int k = p - 2 * (y - first_row);
+    int x_start, x_end;
+    GetRowSpan(wf, y, &x_start, &x_end);
+    if (x_start < k * wf->chunk_w_) x_start = k * wf->chunk_w_;
+    if (x_end > (k + 1) * wf->chunk_w_) x_end = (k + 1) * wf->chunk_w_;
+    if (x_start >= x_end) continue;
+    if (num_tasks++ % wf->num_workers_ == index) {
+      RowSlot* const slot = &wf->slots_[y % wf->num_slots_];
+      int x;
+      if (x_start == 0) {
+        VP8IteratorSetRow(&slot->it_, y);
+        slot->it_.nz_ = wf->nz_;
+      }
+      assert(slot->it_.x_ == x_start && slot->it_.y_ == y);
+      for (x = x_start; x < x_end; ++x) {
+        DecideMB(wf, slot, &slot->mbs_[x]);
+      }
+    }
+  }
+  return 1;
+}
+
+// Codes the macroblocks decided so far, in raster order.
+static int CodeDecidedMBs(EncWavefront* const wf, VP8EncIterator* const it) {
+  VP8Encoder* const enc = wf->enc_;
+  const int first_row = wf->first_mb_ / enc->mb_w_;
+  int ok = 1;
+  while (ok && it->x_ + it->y_ * enc->mb_w_ < wf->last_mb_) {
+    const int num_decided =
+        (wf->phase_ - 2 * (it->y_ - first_row) + 1) * wf->chunk_w_;
+    const MBDecision* const dec =
+        &wf->slots_[it->y_ % wf->num_slots_].mbs_[it->x_];
+    if (it->x_ >= num_decided) break;
+    if (wf->tokens_ != NULL) {
+#if !defined(DISABLE_TOKEN_BUFFER)
+      ok = RecordTokens(it, &dec->info_, wf->tokens_);
+#endif
+      if (!ok) {
+        WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        break;
+      }
+    } else if (!it->mb_->skip_ || !wf->use_skip_) {
+      CodeResiduals(it->bw_, it, &dec->info_);
+    } else {   // reset predictors after a skip
+      ResetAfterSkip(it);
+    }
+    wf->size_p0_ += dec->info_.H;
+    wf->distortion_ += dec->info_.D;
+    if (wf->store_info_) {
+      StoreModeInfo(it);
+      if (it->lf_stats_ != NULL) {
+        double* const stats = (*it->lf_stats_)[it->mb_->segment_];
+        int i;
+        for (i = 0; i < MAX_LF_LEVELS; ++i) stats[i] += dec->lf_stats_[i];
+      }
+      ok = VP8IteratorProgress(it, wf->percent_delta_);
+    }
+    VP8IteratorNext(it);
+  }
+  return ok;
+}
+
+// Decides and codes the macroblocks [first_mb, last_mb), using 'it' for
+// coding.
+static int ProcessRange(EncWavefront* const wf, VP8EncIterator* const it,
+                        int first_mb, int last_mb) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const int mb_w = wf->enc_->mb_w_;
+  const int first_row = first_mb / mb_w;
+  const int last_row = (last_mb - 1) / mb_w;
+  int x_start, x_end, first_phase, last_phase;
+  int ok = 1;
+
+  wf->first_mb_ = first_mb;
+  wf->last_mb_ = last_mb;
+  GetRowSpan(wf, first_row, &x_start, &x_end);
+  first_phase = x_start / wf->chunk_w_;
+  GetRowSpan(wf, last_row, &x_start, &x_end);
+  last_phase = (x_end - 1) / wf->chunk_w_ + 2 * (last_row - first_row);
+  if (last_row > first_row) {
+    // The second row may start before the end of a partial first row, and
+    // the row above the last one may be the last to finish.
+    const int p = wf->num_chunks_ - 1 + 2 * (last_row - 1 - first_row);
+    if (first_phase > 2) first_phase = 2;
+    if (p > last_phase) last_phase = p;
+  }
+  for (wf->phase_ = first_phase; ok && wf->phase_ <= last_phase;
+       ++wf->phase_) {
+    int i;
+    for (i = 1; i < wf->num_workers_; ++i) {
+      worker_interface->Launch(&wf->workers_[i]);
+    }
+    worker_interface->Execute(&wf->workers_[0]);
+    for (i = 0; i < wf->num_workers_; ++i) {
+      ok &= worker_interface->Sync(&wf->workers_[i]);
+    }
+    ok = ok && CodeDecidedMBs(wf, it);
+  }
+  return ok;
+}
+
+static void StartPass(EncWavefront* const wf, int store_info,
+                      int percent_delta, VP8RDModel* const rd_model) {
+  VP8Encoder* const enc = wf->enc_;
+  int i;
+  for (i = 0; i < wf->num_slots_; ++i) {
+    RowSlot* const slot = &wf->slots_[i];
+    VP8IteratorInit(enc, &slot->it_);
+    slot->it_.lf_stats_ = (enc->lf_stats_ != NULL) ? &slot->lf_stats_ : NULL;
+    slot->it_.max_edge_ = slot->max_edge_;
+    memset(slot->max_edge_, 0, sizeof(slot->max_edge_));
+    memset(slot->sse_, 0, sizeof(slot->sse_));
+    slot->sse_count_ = 0;
+    if (rd_model != NULL) *slot->rd_model_ = *rd_model;   // empty model
+  }
+  memset(wf->nz_ - 1, 0, (enc->mb_w_ + 1) * sizeof(*wf->nz_));
+  wf->store_info_ = store_info;
+  wf->percent_delta_ = percent_delta;
+  wf->rd_model_ = rd_model;
+  wf->size_p0_ = 0;
+  wf->distortion_ = 0;
+}
+
+// Merges the order-independent stats collected by the workers.
+static void EndPass(EncWavefront* const wf) {
+  VP8Encoder* const enc = wf->enc_;
+  int i, s;
+  for (i = 0; i < wf->num_slots_; ++i) {
+    const RowSlot* const slot = &wf->slots_[i];
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      if (slot->max_edge_[s] > enc->dqm_[s].max_edge_) {
+        enc->dqm_[s].max_edge_ = slot->max_edge_[s];
+      }
+    }
+    enc->sse_[0] += slot->sse_[0];
+    enc->sse_[1] += slot->sse_[1];
+    enc->sse_[2] += slot->sse_[2];
+    enc->sse_count_ += slot->sse_count_;
+    if (wf->rd_model_ != NULL) VP8RDModelMerge(slot->rd_model_, wf->rd_model_);
+  }
+}
+
+static void ClearWavefront(EncWavefront* const wf) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  int i;
+  for (i = 1; i < wf->num_workers_; ++i) {
+    worker_interface->End(&wf->workers_[i]);
+  }
+  WebPSafeFree(wf->slots_);
+  wf->slots_ = NULL;
+}
+
+static int InitWavefront(VP8Encoder* const enc, VP8TBuffer* const tokens,
+                         EncWavefront* const wf) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  // No more workers than rows being decided at once (num_chunks / 2).
+  const int max_workers = (enc->mb_w_ + 1) / 2;
+  const int num_workers = (enc->thread_level_ < max_workers) ?
+                          enc->thread_level_ : max_workers;
+  // One chunk per worker on each of 'num_workers' active rows.
+  const int chunk_w = (enc->mb_w_ + 2 * num_workers - 1) / (2 * num_workers);
+  const int num_chunks = (enc->mb_w_ + chunk_w - 1) / chunk_w;
+  // A row must be coded before its slot is re-used 2 * num_slots phases later.
+  const int num_slots = num_chunks / 2 + 1;
+  const size_t slots_size = num_slots * sizeof(*wf->slots_);
+  const size_t mbs_size = (size_t)num_slots * enc->mb_w_ * sizeof(MBDecision);
+  const size_t models_size =
+      enc->use_rd_model_ ? num_slots * sizeof(VP8RDModel) : 0;
+  const size_t workers_size = num_workers * sizeof(*wf->workers_);
+  const size_t nz_size = (enc->mb_w_ + 1) * sizeof(*wf->nz_);
+  uint8_t* mem;
+  int i;
+  int ok = 1;
+
+  memset(wf, 0, sizeof(*wf));
+  mem = (uint8_t*)WebPSafeMalloc(1ULL, slots_size + mbs_size + models_size +
+                                           workers_size + nz_size);
+  if (mem == NULL) {
+    return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  wf->enc_ = enc;
+  wf->slots_ = (RowSlot*)mem;
+  mem += slots_size;
+  for (i = 0; i < num_slots; ++i) {
+    wf->slots_[i].mbs_ = (MBDecision*)mem;
+    mem += enc->mb_w_ * sizeof(MBDecision);
+  }
+  for (i = 0; i < num_slots; ++i) {
+    wf->slots_[i].rd_model_ = (models_size > 0) ? (VP8RDModel*)mem + i : NULL;
+  }
+  mem += models_size;
+  wf->workers_ = (WebPWorker*)mem;
+  mem += workers_size;
+  wf->nz_ = 1 + (uint32_t*)mem;
+  wf->num_slots_ = num_slots;
+  wf->num_workers_ = num_workers;
+  wf->chunk_w_ = chunk_w;
+  wf->num_chunks_ = num_chunks;
+  wf->rd_opt_ = enc->rd_opt_level_;
+  wf->tokens_ = tokens;
+  wf->use_skip_ = (tokens == NULL) && enc->proba_.use_skip_proba_;
+  for (i = 0; i < num_workers; ++i) {
+    WebPWorker* const worker = &wf->workers_[i];
+    worker_interface->Init(worker);
+    worker->hook = DecideChunks;
+    worker->data1 = wf;
+    worker->data2 = worker;
+    if (i > 0) ok &= worker_interface->Reset(worker);
+  }
+  if (!ok) {
+    ClearWavefront(wf);
+    return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  return 1;
+}
+
+#if !defined(DISABLE_TOKEN_BUFFER)
+
+// Multi-threaded equivalent of the token loop's pass: the token probas are
+// refreshed every 'max_count' macroblocks, so all the macroblocks before a
+// refresh must be decided and recorded before going on with the next ones.
+static int TokenPassMT(EncWavefront* const wf, VP8EncIterator* const it,
+                       int max_count) {
+  VP8Encoder* const enc = wf->enc_;
+  const int num_mbs = enc->mb_w_ * enc->mb_h_;
+  int first_mb = 0;
+  int last_mb = max_count;
+  int ok = 1;
+  while (ok && first_mb < num_mbs) {
+    if (last_mb > num_mbs) last_mb = num_mbs;
+    if (first_mb > 0) {
+      FinalizeTokenProbas(&enc->proba_);
+      VP8CalculateLevelCosts(&enc->proba_);  // refresh cost tables for rd-opt
+    }
+    ok = ProcessRange(wf, it, first_mb, last_mb);
+    first_mb = last_mb;
+    last_mb += max_count + 1;
+  }
+  return ok;
+}
+
+#endif    // !DISABLE_TOKEN_BUFFER
+
+//------------------------------------------------------------------------------
+//  VP8EncLoop(): does the final bitstream coding.
+
 int VP8EncLoop(VP8Encoder* const enc) {
   VP8EncIterator it;
   int ok = PreLoopInitialize(enc);
@@ -744,6 +1238,17 @@ int VP8EncLoop(VP8Encoder* const enc) {
 
   VP8IteratorInit(enc, &it);
   VP8InitFilter(&it);
+  if (UseWavefront(enc)) {
+    EncWavefront wf;
+    ok = InitWavefront(enc, NULL, &wf);
+    if (ok) {
+      StartPass(&wf, 1, 20, NULL);
+      ok = ProcessRange(&wf, &it, 0, enc->mb_w_ * enc->mb_h_);
+      EndPass(&wf);
+      ClearWavefront(&wf);
+    }
+    return PostLoopFinalize(&it, ok);
+  }
   do {
     VP8ModeScore info;
     const int dont_use_skip = !enc->proba_.use_skip_proba_;
@@ -777,19 +1282,28 @@ int VP8EncLoop(VP8Encoder* const enc) {
 int VP8EncTokenLoop(VP8Encoder* const enc) {
   // Roughly refresh the proba eight times per pass
   int max_count = (enc->mb_w_ * enc->mb_h_) >> 3;
-  int num_pass_left = enc->config_->pass;
+  // The model needs a probe pass, and the final quality needs its own pass.
+  int num_pass_left = (enc->use_rd_model_ && enc->config_->pass < 2)
+                    ? 2 : enc->config_->pass;
   int remaining_progress = 40;  // percents
   const int do_search = enc->do_search_;
   VP8EncIterator it;
   VP8EncProba* const proba = &enc->proba_;
   const VP8RDLevel rd_opt = enc->rd_opt_level_;
   const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
+  const int use_wavefront = UseWavefront(enc);
+  EncWavefront wf;
   PassStats stats;
+  VP8RDModel rd_model;
   int ok;
 
   InitPassStats(enc, &stats);
   ok = PreLoopInitialize(enc);
   if (!ok) return 0;
+  if (use_wavefront && !InitWavefront(enc, &enc->tokens_, &wf)) {
+    VP8EncFreeBitWriters(enc);
+    return 0;
+  }
 
   if (max_count < MIN_COUNT) max_count = MIN_COUNT;
 
@@ -806,40 +1320,52 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
     uint64_t size_p0 = 0;
     uint64_t distortion = 0;
     int cnt = max_count;
+    VP8RDModel* const model =
+        (enc->use_rd_model_ && !is_last_pass) ? &rd_model : NULL;
     // The final number of passes is not trivial to know in advance.
     const int pass_progress = remaining_progress / (2 + num_pass_left);
     remaining_progress -= pass_progress;
     VP8IteratorInit(enc, &it);
     SetLoopParams(enc, stats.q);
+    if (model != NULL) VP8RDModelInit(enc, model);
     if (is_last_pass) {
       ResetTokenStats(enc);
       VP8InitFilter(&it);  // don't collect stats until last pass (too costly)
     }
-    VP8TBufferClear(&enc->tokens_);
-    do {
-      VP8ModeScore info;
-      VP8IteratorImport(&it, NULL);
-      if (--cnt < 0) {
-        FinalizeTokenProbas(proba);
-        VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
-        cnt = max_count;
-      }
-      VP8Decimate(&it, &info, rd_opt);
-      ok = RecordTokens(&it, &info, &enc->tokens_);
-      if (!ok) {
-        WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
-        break;
-      }
-      size_p0 += info.H;
-      distortion += info.D;
-      if (is_last_pass) {
-        StoreSideInfo(&it);
-        VP8StoreFilterStats(&it);
-        VP8IteratorExport(&it);
-        ok = VP8IteratorProgress(&it, pass_progress);
-      }
-      VP8IteratorSaveBoundary(&it);
-    } while (ok && VP8IteratorNext(&it));
+    VP8TBufferReset(&enc->tokens_, enc->tokens_.page_size_);  // keep pages
+    if (use_wavefront) {
+      StartPass(&wf, is_last_pass, pass_progress, model);
+      ok = TokenPassMT(&wf, &it, max_count);
+      EndPass(&wf);
+      size_p0 = wf.size_p0_;
+      distortion = wf.distortion_;
+    } else {
+      do {
+        VP8ModeScore info;
+        VP8IteratorImport(&it, NULL);
+        if (--cnt < 0) {
+          FinalizeTokenProbas(proba);
+          VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+          cnt = max_count;
+        }
+        VP8Decimate(&it, &info, rd_opt);
+        if (model != NULL) VP8RDModelRecord(&it, &info, model);
+        ok = RecordTokens(&it, &info, &enc->tokens_);
+        if (!ok) {
+          WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+          break;
+        }
+        size_p0 += info.H;
+        distortion += info.D;
+        if (is_last_pass) {
+          StoreSideInfo(&it);
+          VP8StoreFilterStats(&it);
+          VP8IteratorExport(&it);
+          ok = VP8IteratorProgress(&it, pass_progress);
+        }
+        VP8IteratorSaveBoundary(&it);
+      } while (ok && VP8IteratorNext(&it));
+    }
     if (!ok) break;
 
     size_p0 += enc->segment_hdr_.size_;
@@ -872,7 +1398,11 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       break;   // done
     }
     if (do_search) {
-      ComputeNextQ(&stats);  // Adjust q
+      if (model != NULL) {
+        ComputeModelQ(enc, model, 1, pixel_count, &stats);
+      } else {
+        ComputeNextQ(&stats);  // Adjust q
+      }
     }
   }
   if (ok) {
@@ -884,6 +1414,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   }
   ok = ok && WebPReportProgress(enc->pic_, enc->percent_ + remaining_progress,
                                 &enc->percent_);
+  if (use_wavefront) ClearWavefront(&wf);
   return PostLoopFinalize(&it, ok);
 }
 
@@ -18,6 +18,8 @@
 #include "src/dsp/lossless_common.h"
 #include "src/enc/vp8i_enc.h"
 #include "src/enc/vp8li_enc.h"
+#include "src/utils/thread_utils.h"
+#include "src/utils/utils.h"
 
 #define MAX_DIFF_COST (1e30f)
 
@@ -295,9 +297,11 @@ static WEBP_INLINE void GetResidual(
 // If max_quantization > 1, assumes that near lossless processing will be
 // applied, quantizing residuals to multiples of quantization levels up to
 // max_quantization (the actual quantization level depends on smoothness near
-// the given pixel).
+// the given pixel). The modes of the tile rows before 'first_tile_y' are not
+// used as context.
 static int GetBestPredictorForTile(int width, int height,
-                                   int tile_x, int tile_y, int bits,
+                                   int tile_x, int tile_y, int first_tile_y,
+                                   int bits,
                                    int accumulated[4][256],
                                    uint32_t* const argb_scratch,
                                    const uint32_t* const argb,
@@ -322,7 +326,7 @@ static int GetBestPredictorForTile(int width, int height,
   // Prediction modes of the left and above neighbor tiles.
   const int left_mode = (tile_x > 0) ?
       (modes[tile_y * tiles_per_row + tile_x - 1] >> 8) & 0xff : 0xff;
-  const int above_mode = (tile_y > 0) ?
+  const int above_mode = (tile_y > first_tile_y) ?
       (modes[(tile_y - 1) * tiles_per_row + tile_x] >> 8) & 0xff : 0xff;
   // The width of upper_row and current_row is one pixel larger than image width
   // to allow the top right pixel to point to the leftmost pixel of the next row
@@ -469,6 +473,206 @@ static void CopyImageWithPrediction(int width, int height,
   }
 }
 
+//------------------------------------------------------------------------------
+// Threaded tile search.
+//
+// The best transform of a tile depends on the histograms accumulated over all
+// the previous tiles in raster order. With WebPConfig::use_tile_bands, the tile
+// rows are instead split in bands, each one accumulating its own histograms.
+// The bands are processed concurrently one tile row at a time, and their
+// histograms are merged after each round of rows so that every band sees the
+// statistics of the whole image done so far. The number of bands only depends
+// on the image size, and the threads share them out, so the result doesn't
+// depend on the number of threads.
+
+// Minimum number of tile rows per band.
+#define MIN_TILE_ROWS_PER_BAND 4
+// Maximum number of bands, which is also the useful number of threads.
+#define MAX_TILE_BANDS 8
+
+typedef struct {
+  // Band of tile rows [first_tile_y_, last_tile_y_), with the next one to
+  // process.
+  int first_tile_y_, last_tile_y_, tile_y_;
+  // Parameters of the transform.
+  int width_, height_, bits_;
+  uint32_t* argb_;
+  uint32_t* image_;
+  uint32_t* argb_scratch_;
+  int max_quantization_, exact_, used_subtract_green_;  // predictor
+  int quality_;                                         // cross color
+  VP8LMultipliers prev_x_;                              // cross color
+  // Accumulated histograms: 4 for the predictor, red and blue for the cross
+  // color.
+  int accumulated_[4][256];
+} TileRowBand;
+
+typedef void (*TileRowFunc)(TileRowBand* const band);
+
+// Processes the next tile row of bands 'first_band_', 'first_band_ + step_'...
+typedef struct {
+  WebPWorker worker_;
+  TileRowBand* bands_;
+  int first_band_, num_bands_, step_;
+  TileRowFunc process_row_;
+} BandWorker;
+
+static int GetNumBands(int tiles_per_col) {
+  const int num_bands = GetMin(MAX_TILE_BANDS,
+                               tiles_per_col / MIN_TILE_ROWS_PER_BAND);
+  return (num_bands > 1) ? num_bands : 1;
+}
+
+// Allocates the bands, with 'scratch_size' words of scratch memory for all
+// but the first one (which uses the caller's). Returns NULL in case of error.
+static TileRowBand* AllocateBands(int num_bands, int tiles_per_col,
+                                  size_t scratch_size) {
+  const uint64_t band_size = sizeof(TileRowBand) +
+                             scratch_size * sizeof(uint32_t);
+  TileRowBand* const bands =
+      (TileRowBand*)WebPSafeCalloc((uint64_t)num_bands, band_size);
+  uint32_t* scratch;
+  int i;
+  if (bands == NULL) return NULL;
+  scratch = (uint32_t*)&bands[num_bands];
+  for (i = 0; i < num_bands; ++i) {
+    TileRowBand* const band = &bands[i];
+    band->first_tile_y_ = i * tiles_per_col / num_bands;
+    band->last_tile_y_ = (i + 1) * tiles_per_col / num_bands;
+    band->tile_y_ = band->first_tile_y_;
+    if (i > 0) {
+      band->argb_scratch_ = scratch;
+      scratch += scratch_size;
+    }
+  }
+  return bands;
+}
+
+static int BandWorkerHook(void* arg1, void* arg2) {
+  BandWorker* const worker = (BandWorker*)arg1;
+  int i;
+  (void)arg2;
+  for (i = worker->first_band_; i < worker->num_bands_; i += worker->step_) {
+    TileRowBand* const band = &worker->bands_[i];
+    if (band->tile_y_ < band->last_tile_y_) {
+      worker->process_row_(band);
+      ++band->tile_y_;
+    }
+  }
+  return 1;
+}
+
+// Runs 'process_row' on the bands until all their tile rows are processed, one
+// row per band and per round, using up to 'num_threads' threads. Only the
+// first 'num_histos' accumulated histograms are merged.
+static int ProcessBands(TileRowBand* const bands, int num_bands,
+                        int num_threads, int num_histos,
+                        TileRowFunc process_row, const WebPPicture* const pic,
+                        int tiles_per_col, int percent_range,
+                        int* const percent) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  const int percent_start = *percent;
+  const int num_workers = GetMax(1, GetMin(num_threads, num_bands));
+  // The last band is one of the longest ones.
+  const int num_rounds = bands[num_bands - 1].last_tile_y_ -
+                         bands[num_bands - 1].first_tile_y_;
+  BandWorker workers[MAX_TILE_BANDS];
+  int accumulated[4][256];
+  int round, idx, i, j;
+  int ok = 1;
+
+  memset(accumulated, 0, sizeof(accumulated));
+  for (idx = 0; idx < num_workers; ++idx) {
+    BandWorker* const worker = &workers[idx];
+    worker_interface->Init(&worker->worker_);
+    worker->worker_.data1 = worker;
+    worker->worker_.data2 = NULL;
+    worker->worker_.hook = BandWorkerHook;
+    worker->bands_ = bands;
+    worker->first_band_ = idx;
+    worker->num_bands_ = num_bands;
+    worker->step_ = num_workers;
+    worker->process_row_ = process_row;
+  }
+  for (idx = 1; idx < num_workers; ++idx) {
+    if (!worker_interface->Reset(&workers[idx].worker_)) {
+      WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      ok = 0;
+      break;
+    }
+  }
+
+  for (round = 0; ok && round < num_rounds; ++round) {
+    int num_rows_done = 0;
+    for (idx = 1; idx < num_workers; ++idx) {
+      worker_interface->Launch(&workers[idx].worker_);
+    }
+    worker_interface->Execute(&workers[0].worker_);
+    for (idx = 0; idx < num_workers; ++idx) {
+      ok &= worker_interface->Sync(&workers[idx].worker_);
+    }
+    for (idx = 0; idx < num_bands; ++idx) {
+      num_rows_done += bands[idx].tile_y_ - bands[idx].first_tile_y_;
+    }
+    // Add what each band accumulated during this round, in band order.
+    for (i = 0; i < num_histos; ++i) {
+      for (j = 0; j < 256; ++j) {
+        int sum = accumulated[i][j];
+        for (idx = 0; idx < num_bands; ++idx) {
+          sum += bands[idx].accumulated_[i][j] - accumulated[i][j];
+        }
+        accumulated[i][j] = sum;
+      }
+    }
+    for (idx = 0; idx < num_bands; ++idx) {
+      memcpy(bands[idx].accumulated_, accumulated,
+             num_histos * sizeof(accumulated[0]));
+    }
+    if (ok && !WebPReportProgress(
+                  pic, percent_start + percent_range * num_rows_done /
+                                           tiles_per_col,
+                  percent)) {
+      ok = 0;
+    }
+  }
+
+  for (idx = 0; idx < num_workers; ++idx) {
+    worker_interface->End(&workers[idx].worker_);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Predictor search.
+
+// Finds the best predictor for each tile of the row 'tile_y'.
+static void GetBestPredictorsForTileRow(int width, int height, int tile_y,
+                                        int first_tile_y, int bits,
+                                        int accumulated[4][256],
+                                        uint32_t* const argb_scratch,
+                                        const uint32_t* const argb,
+                                        int max_quantization, int exact,
+                                        int used_subtract_green,
+                                        uint32_t* const image) {
+  const int tiles_per_row = VP8LSubSampleSize(width, bits);
+  int tile_x;
+  for (tile_x = 0; tile_x < tiles_per_row; ++tile_x) {
+    const int pred = GetBestPredictorForTile(
+        width, height, tile_x, tile_y, first_tile_y, bits, accumulated,
+        argb_scratch, argb, max_quantization, exact, used_subtract_green,
+        image);
+    image[tile_y * tiles_per_row + tile_x] = ARGB_BLACK | (pred << 8);
+  }
+}
+
+static void PredictorBandRow(TileRowBand* const band) {
+  GetBestPredictorsForTileRow(
+      band->width_, band->height_, band->tile_y_, band->first_tile_y_,
+      band->bits_, band->accumulated_, band->argb_scratch_, band->argb_,
+      band->max_quantization_, band->exact_, band->used_subtract_green_,
+      band->image_);
+}
+
 // Finds the best predictor for each tile, and converts the image to residuals
 // with respect to predictions. If near_lossless_quality < 100, applies
 // near lossless processing, shaving off more bits of residuals for lower
@@ -476,11 +680,12 @@ static void CopyImageWithPrediction(int width, int height,
 int VP8LResidualImage(int width, int height, int bits, int low_effort,
                       uint32_t* const argb, uint32_t* const argb_scratch,
                       uint32_t* const image, int near_lossless_quality,
-                      int exact, int used_subtract_green,
+                      int exact, int used_subtract_green, int num_threads,
                       const WebPPicture* const pic, int percent_range,
                       int* const percent) {
   const int tiles_per_row = VP8LSubSampleSize(width, bits);
   const int tiles_per_col = VP8LSubSampleSize(height, bits);
+  const int num_bands = (num_threads > 0) ? GetNumBands(tiles_per_col) : 1;
   int percent_start = *percent;
   int tile_y;
   int histo[4][256];
@@ -490,17 +695,38 @@ int VP8LResidualImage(int width, int height, int bits, int low_effort,
     for (i = 0; i < tiles_per_row * tiles_per_col; ++i) {
       image[i] = ARGB_BLACK | (kPredLowEffort << 8);
     }
+  } else if (num_bands > 1) {
+    // Same layout as the scratch memory allocated in vp8l_enc.c.
+    const size_t scratch_size =
+        (width + 1) * 2 + (width * 2 + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    TileRowBand* const bands =
+        AllocateBands(num_bands, tiles_per_col, scratch_size);
+    int i, ok;
+    if (bands == NULL) {
+      return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    bands[0].argb_scratch_ = argb_scratch;
+    for (i = 0; i < num_bands; ++i) {
+      TileRowBand* const band = &bands[i];
+      band->width_ = width;
+      band->height_ = height;
+      band->bits_ = bits;
+      band->argb_ = argb;
+      band->image_ = image;
+      band->max_quantization_ = max_quantization;
+      band->exact_ = exact;
+      band->used_subtract_green_ = used_subtract_green;
+    }
+    ok = ProcessBands(bands, num_bands, num_threads, 4, PredictorBandRow, pic,
+                      tiles_per_col, percent_range, percent);
+    WebPSafeFree(bands);
+    if (!ok) return 0;
   } else {
     memset(histo, 0, sizeof(histo));
     for (tile_y = 0; tile_y < tiles_per_col; ++tile_y) {
-      int tile_x;
-      for (tile_x = 0; tile_x < tiles_per_row; ++tile_x) {
-        const int pred = GetBestPredictorForTile(
-            width, height, tile_x, tile_y, bits, histo, argb_scratch, argb,
-            max_quantization, exact, used_subtract_green, image);
-        image[tile_y * tiles_per_row + tile_x] = ARGB_BLACK | (pred << 8);
-      }
-
+      GetBestPredictorsForTileRow(width, height, tile_y, 0, bits, histo,
+                                  argb_scratch, argb, max_quantization, exact,
+                                  used_subtract_green, image);
       if (!WebPReportProgress(
               pic, percent_start + percent_range * tile_y / tiles_per_col,
               percent)) {
@@ -725,63 +951,110 @@ static void CopyTileWithColorTransform(int xsize, int ysize,
   }
 }
 
-int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
-                            uint32_t* const argb, uint32_t* image,
-                            const WebPPicture* const pic, int percent_range,
-                            int* const percent) {
+// Finds the best color transform for each tile of the row 'tile_y', applies
+// it and accumulates the histograms of the transformed pixels. 'prev_x' is the
+// transform of the previous tile in raster order. The tile rows before
+// 'first_tile_y' are not used as context.
+static void GetBestColorTransformsForTileRow(
+    int width, int height, int tile_y, int first_tile_y, int bits, int quality,
+    VP8LMultipliers* const prev_x, int accumulated_red_histo[256],
+    int accumulated_blue_histo[256], uint32_t* const argb,
+    uint32_t* const image) {
   const int max_tile_size = 1 << bits;
   const int tile_xsize = VP8LSubSampleSize(width, bits);
+  // Start of the pixels that can be looked at for repetitions.
+  const int first_ix = first_tile_y * max_tile_size * width;
+  int tile_x;
+  VP8LMultipliers prev_y;
+  MultipliersClear(&prev_y);
+  for (tile_x = 0; tile_x < tile_xsize; ++tile_x) {
+    int y;
+    const int tile_x_offset = tile_x * max_tile_size;
+    const int tile_y_offset = tile_y * max_tile_size;
+    const int all_x_max = GetMin(tile_x_offset + max_tile_size, width);
+    const int all_y_max = GetMin(tile_y_offset + max_tile_size, height);
+    const int offset = tile_y * tile_xsize + tile_x;
+    if (tile_y != first_tile_y) {
+      ColorCodeToMultipliers(image[offset - tile_xsize], &prev_y);
+    }
+    *prev_x = GetBestColorTransformForTile(tile_x, tile_y, bits,
+                                           *prev_x, prev_y,
+                                           quality, width, height,
+                                           accumulated_red_histo,
+                                           accumulated_blue_histo,
+                                           argb);
+    image[offset] = MultipliersToColorCode(prev_x);
+    CopyTileWithColorTransform(width, height, tile_x_offset, tile_y_offset,
+                               max_tile_size, *prev_x, argb);
+
+    // Gather accumulated histogram data.
+    for (y = tile_y_offset; y < all_y_max; ++y) {
+      int ix = y * width + tile_x_offset;
+      const int ix_end = ix + all_x_max - tile_x_offset;
+      for (; ix < ix_end; ++ix) {
+        const uint32_t pix = argb[ix];
+        if (ix >= first_ix + 2 &&
+            pix == argb[ix - 2] &&
+            pix == argb[ix - 1]) {
+          continue;  // repeated pixels are handled by backward references
+        }
+        if (ix >= first_ix + width + 2 &&
+            argb[ix - 2] == argb[ix - width - 2] &&
+            argb[ix - 1] == argb[ix - width - 1] &&
+            pix == argb[ix - width]) {
+          continue;  // repeated pixels are handled by backward references
+        }
+        ++accumulated_red_histo[(pix >> 16) & 0xff];
+        ++accumulated_blue_histo[(pix >> 0) & 0xff];
+      }
+    }
+  }
+}
+
+static void ColorSpaceBandRow(TileRowBand* const band) {
+  GetBestColorTransformsForTileRow(
+      band->width_, band->height_, band->tile_y_, band->first_tile_y_,
+      band->bits_, band->quality_, &band->prev_x_, band->accumulated_[0],
+      band->accumulated_[1], band->argb_, band->image_);
+}
+
+int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
+                            uint32_t* const argb, uint32_t* image,
+                            int num_threads, const WebPPicture* const pic,
+                            int percent_range, int* const percent) {
   const int tile_ysize = VP8LSubSampleSize(height, bits);
+  const int num_bands = (num_threads > 0) ? GetNumBands(tile_ysize) : 1;
   int percent_start = *percent;
   int accumulated_red_histo[256] = { 0 };
   int accumulated_blue_histo[256] = { 0 };
-  int tile_x, tile_y;
-  VP8LMultipliers prev_x, prev_y;
-  MultipliersClear(&prev_y);
+  int tile_y;
+  VP8LMultipliers prev_x;
+  if (num_bands > 1) {
+    TileRowBand* const bands = AllocateBands(num_bands, tile_ysize, 0);
+    int i, ok;
+    if (bands == NULL) {
+      return WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    for (i = 0; i < num_bands; ++i) {
+      TileRowBand* const band = &bands[i];
+      band->width_ = width;
+      band->height_ = height;
+      band->bits_ = bits;
+      band->argb_ = argb;
+      band->image_ = image;
+      band->quality_ = quality;
+      MultipliersClear(&band->prev_x_);
+    }
+    ok = ProcessBands(bands, num_bands, num_threads, 2, ColorSpaceBandRow,
+                      pic, tile_ysize, percent_range, percent);
+    WebPSafeFree(bands);
+    return ok;
+  }
   MultipliersClear(&prev_x);
   for (tile_y = 0; tile_y < tile_ysize; ++tile_y) {
-    for (tile_x = 0; tile_x < tile_xsize; ++tile_x) {
-      int y;
-      const int tile_x_offset = tile_x * max_tile_size;
-      const int tile_y_offset = tile_y * max_tile_size;
-      const int all_x_max = GetMin(tile_x_offset + max_tile_size, width);
-      const int all_y_max = GetMin(tile_y_offset + max_tile_size, height);
-      const int offset = tile_y * tile_xsize + tile_x;
-      if (tile_y != 0) {
-        ColorCodeToMultipliers(image[offset - tile_xsize], &prev_y);
-      }
-      prev_x = GetBestColorTransformForTile(tile_x, tile_y, bits,
-                                            prev_x, prev_y,
-                                            quality, width, height,
-                                            accumulated_red_histo,
-                                            accumulated_blue_histo,
-                                            argb);
-      image[offset] = MultipliersToColorCode(&prev_x);
-      CopyTileWithColorTransform(width, height, tile_x_offset, tile_y_offset,
-                                 max_tile_size, prev_x, argb);
-
-      // Gather accumulated histogram data.
-      for (y = tile_y_offset; y < all_y_max; ++y) {
-        int ix = y * width + tile_x_offset;
-        const int ix_end = ix + all_x_max - tile_x_offset;
-        for (; ix < ix_end; ++ix) {
-          const uint32_t pix = argb[ix];
-          if (ix >= 2 &&
-              pix == argb[ix - 2] &&
-              pix == argb[ix - 1]) {
-            continue;  // repeated pixels are handled by backward references
-          }
-          if (ix >= width + 2 &&
-              argb[ix - 2] == argb[ix - width - 2] &&
-              argb[ix - 1] == argb[ix - width - 1] &&
-              pix == argb[ix - width]) {
-            continue;  // repeated pixels are handled by backward references
-          }
-          ++accumulated_red_histo[(pix >> 16) & 0xff];
-          ++accumulated_blue_histo[(pix >> 0) & 0xff];
-        }
-      }
-    }
+    GetBestColorTransformsForTileRow(width, height, tile_y, 0, bits, quality,
+                                     &prev_x, accumulated_red_histo,
+                                     accumulated_blue_histo, argb, image);
     if (!WebPReportProgress(
             pic, percent_start + percent_range * tile_y / tile_ysize,
             percent)) {
@@ -399,9 +399,10 @@ static void SimplifySegments(VP8Encoder* const enc) {
   }
 }
 
-void VP8SetSegmentParams(VP8Encoder* const enc, float quality) {
+// Computes the quantizer of each segment for the given 'quality'.
+static void GetSegmentQuants(const VP8Encoder* const enc, float quality,
+                             int quants[NUM_MB_SEGMENTS]) {
   int i;
-  int dq_uv_ac, dq_uv_dc;
   const int num_segments = enc->segment_hdr_.num_segments_;
   const double amp = SNS_TO_DQ * enc->config_->sns_strength / 100. / 128.;
   const double Q = quality / 100.;
@@ -415,7 +416,19 @@ void VP8SetSegmentParams(VP8Encoder* const enc, float quality) {
     const double c = pow(c_base, expn);
     const int q = (int)(127. * (1. - c));
     assert(expn > 0.);
-    enc->dqm_[i].quant_ = clip(q, 0, 127);
+    quants[i] = clip(q, 0, 127);
+  }
+}
+
+void VP8SetSegmentParams(VP8Encoder* const enc, float quality) {
+  int i;
+  int dq_uv_ac, dq_uv_dc;
+  int quants[NUM_MB_SEGMENTS];
+  const int num_segments = enc->segment_hdr_.num_segments_;
+
+  GetSegmentQuants(enc, quality, quants);
+  for (i = 0; i < num_segments; ++i) {
+    enc->dqm_[i].quant_ = quants[i];
   }
 
   // purely indicative in the bitstream (except for the 1-segment case)
@@ -972,15 +985,18 @@ static int ReconstructUV(VP8EncIterator* WEBP_RESTRICT const it,
 // RD-opt decision. Reconstruct each modes, evalue distortion and bit-cost.
 // Pick the mode is lower RD-cost = Rate + lambda * Distortion.
 
-static void StoreMaxDelta(VP8SegmentInfo* const dqm, const int16_t DCs[16]) {
+static void StoreMaxDelta(const VP8EncIterator* const it,
+                          VP8SegmentInfo* const dqm, const int16_t DCs[16]) {
   // We look at the first three AC coefficients to determine what is the average
   // delta between each sub-4x4 block.
   const int v0 = abs(DCs[1]);
   const int v1 = abs(DCs[2]);
   const int v2 = abs(DCs[4]);
   int max_v = (v1 > v0) ? v1 : v0;
+  int* const max_edge = (it->max_edge_ != NULL)
+                       ? &it->max_edge_[it->mb_->segment_] : &dqm->max_edge_;
   max_v = (v2 > max_v) ? v2 : max_v;
-  if (max_v > dqm->max_edge_) dqm->max_edge_ = max_v;
+  if (max_v > *max_edge) *max_edge = max_v;
 }
 
 static void SwapModeScore(VP8ModeScore** a, VP8ModeScore** b) {
@@ -1053,7 +1069,7 @@ static void PickBestIntra16(VP8EncIterator* WEBP_RESTRICT const it,
   // distortion, record max delta so we can later adjust the minimal filtering
   // strength needed to smooth these blocks out.
   if ((rd->nz & 0x100ffff) == 0x1000000 && rd->D > dqm->min_disto_) {
-    StoreMaxDelta(dqm, rd->y_dc_levels);
+    StoreMaxDelta(it, dqm, rd->y_dc_levels);
   }
 }
 
@@ -1396,3 +1412,306 @@ int VP8Decimate(VP8EncIterator* WEBP_RESTRICT const it,
   VP8SetSkip(it, is_skipped);
   return is_skipped;
 }
+
+//------------------------------------------------------------------------------
+// Rate-distortion model
+//
+// Each macroblock is re-quantized with the quantizers of the grid, for its
+// best intra16 mode and, if it was chosen, for its intra4 modes. The intra4
+// residuals are not kept by VP8Decimate(), but are recovered from the
+// reconstruction error and the dequantized levels. For each quantizer, the
+// alternative with the best rd-score is accumulated in the model.
+// The coefficient bits are predicted from the entropy of the token counts
+// summed over the segments, as the token probabilities are shared.
+// Distortions are stored x16, that is: x4 for the 4x4 transforms and x1 for
+// the WHT (the pixel errors are 4 and 16 times smaller).
+
+enum { RD_TOKEN_EOB = 0, RD_TOKEN_ZERO = 1 };
+
+// Approximate token costs, only used for the mode decision.
+static const uint16_t kRDTokenCosts[RD_NUM_TOKENS] = {
+  512, 384, 640, 1024, 1280, 1536, 1792
+};
+
+typedef struct {
+  uint16_t tokens_[RD_GRID_SIZE][NUM_TYPES][RD_NUM_TOKENS];
+  uint32_t level_bits_[RD_GRID_SIZE];
+  uint64_t disto_[RD_GRID_SIZE];
+  uint64_t zero_disto_[RD_GRID_SIZE + 1];   // distortion of zeroed coeffs
+} RDGridScore;
+
+static int GridQuant(int g) {
+  return (g < RD_GRID_SIZE - 1) ? 4 * g : 127;
+}
+
+static int LevelToken(int level) {
+  return (level <= 2) ? 1 + level : (level <= 4) ? 4 : (level <= 10) ? 5 : 6;
+}
+
+void VP8RDModelInit(const VP8Encoder* const enc, VP8RDModel* const model) {
+  int g, c, s;
+  memset(model, 0, sizeof(*model));
+  for (g = 0; g < RD_GRID_SIZE; ++g) {
+    const int q = GridQuant(g);
+    int q_i4, lambda;
+    model->q_[0][g] = kDcTable[clip(q + enc->dq_y1_dc_, 0, 127)];
+    model->q_[1][g] = kAcTable[clip(q,                  0, 127)];
+    model->q_[2][g] = kDcTable[ clip(q + enc->dq_y2_dc_, 0, 127)] * 2;
+    model->q_[3][g] = kAcTable2[clip(q + enc->dq_y2_ac_, 0, 127)];
+    model->q_[4][g] = kDcTable[clip(q + enc->dq_uv_dc_, 0, 117)];
+    model->q_[5][g] = kAcTable[clip(q + enc->dq_uv_ac_, 0, 127)];
+    for (c = 0; c < RD_NUM_CLASSES; ++c) {
+      model->iq_[c][g] = (1 << QFIX) / model->q_[c][g];
+    }
+    // same as the lambda_mode_ of SetupMatrices()
+    q_i4 = (model->q_[0][g] + 15 * model->q_[1][g] + 8) >> 4;
+    lambda = (q_i4 * q_i4) >> 7;
+    CheckLambdaValue(&lambda);
+    model->lambda_[g] = lambda;
+  }
+  for (c = 0; c < RD_NUM_CLASSES; ++c) {
+    model->bias_[c] = BIAS(kBiasMatrices[c >> 1][c & 1]);
+  }
+  for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+    model->pass_quant_[s] = enc->dqm_[s].quant_;
+  }
+}
+
+// Quantizes the coefficients [first..15] of a block (in zigzag order) with
+// each quantizer of the grid. Class 'c' is used for the DC coefficient, and
+// class 'c + 1' for the others.
+static void RecordBlock(const VP8RDModel* const model,
+                        const int16_t coeffs[16], int first, int c, int type,
+                        int w, RDGridScore* const score) {
+  int last[RD_GRID_SIZE], nnz[RD_GRID_SIZE];
+  int i, g;
+  for (g = 0; g < RD_GRID_SIZE; ++g) last[g] = -1, nnz[g] = 0;
+  for (i = first; i < 16; ++i) {
+    const int cl = c + (i > 0);
+    const uint32_t coeff = (uint32_t)abs(coeffs[i]);
+    for (g = 0; g < RD_GRID_SIZE; ++g) {
+      int level =
+          (int)((coeff * model->iq_[cl][g] + model->bias_[cl]) >> QFIX);
+      int err;
+      if (level == 0) break;   // and for all coarser quantizers
+      if (level > MAX_LEVEL) level = MAX_LEVEL;
+      err = (int)coeff - level * model->q_[cl][g];
+      ++score->tokens_[g][type][LevelToken(level)];
+      score->level_bits_[g] += VP8LevelFixedCosts[level];
+      score->disto_[g] += (uint64_t)w * (uint64_t)((int64_t)err * err);
+      last[g] = i;
+      ++nnz[g];
+    }
+    score->zero_disto_[g] += (uint64_t)w * coeff * coeff;
+  }
+  for (g = 0; g < RD_GRID_SIZE; ++g) {
+    uint16_t* const tokens = score->tokens_[g][type];
+    if (last[g] >= 0) tokens[RD_TOKEN_ZERO] += last[g] - first + 1 - nnz[g];
+    if (last[g] < 15) ++tokens[RD_TOKEN_EOB];
+  }
+}
+
+// Adds the distortion of the coefficients quantized to zero.
+static void FinalizeGridScore(RDGridScore* const score) {
+  uint64_t zero_disto = 0;
+  int g;
+  for (g = 0; g < RD_GRID_SIZE; ++g) {
+    zero_disto += score->zero_disto_[g];
+    score->disto_[g] += zero_disto;
+  }
+}
+
+static uint64_t GetGridRate(const RDGridScore* const score, int g) {
+  uint64_t rate = score->level_bits_[g];
+  int t, k;
+  for (t = 0; t < NUM_TYPES; ++t) {
+    for (k = 0; k < RD_NUM_TOKENS; ++k) {
+      rate += score->tokens_[g][t][k] * kRDTokenCosts[k];
+    }
+  }
+  return rate;
+}
+
+void VP8RDModelRecord(const VP8EncIterator* const it,
+                      const VP8ModeScore* const rd, VP8RDModel* const model) {
+  const VP8Encoder* const enc = it->enc_;
+  const int s = it->mb_->segment_;
+  const int is_i4 = (it->mb_->type_ == 0);
+  const uint8_t* const src = it->yuv_in_ + Y_OFF_ENC;
+  const uint64_t h_i16 =
+      VP8FixedCostsI16[rd->mode_i16] + VP8FixedCostsUV[rd->mode_uv];
+  RDGridScore i16, i4, uv;
+  int16_t tmp[16][16], dc_tmp[16], coeffs[16];
+  int n, i, g, t, k;
+
+  memset(&i16, 0, sizeof(i16));
+  memset(&uv, 0, sizeof(uv));
+  {
+    const uint8_t* const ref = it->yuv_p_ + VP8I16ModeOffsets[rd->mode_i16];
+    for (n = 0; n < 16; n += 2) {
+      VP8FTransform2(src + VP8Scan[n], ref + VP8Scan[n], tmp[n]);
+    }
+    VP8FTransformWHT(tmp[0], dc_tmp);
+    for (i = 0; i < 16; ++i) coeffs[i] = dc_tmp[kZigzag[i]];
+    RecordBlock(model, coeffs, 0, 2, TYPE_I16_DC, 1, &i16);
+    for (n = 0; n < 16; ++n) {
+      for (i = 0; i < 16; ++i) coeffs[i] = tmp[n][kZigzag[i]];
+      RecordBlock(model, coeffs, 1, 0, TYPE_I16_AC, 4, &i16);
+    }
+    FinalizeGridScore(&i16);
+  }
+  if (is_i4) {
+    const VP8Matrix* const mtx = &enc->dqm_[s].y1_;
+    const uint8_t* const out = it->yuv_out_ + Y_OFF_ENC;
+    memset(&i4, 0, sizeof(i4));
+    for (n = 0; n < 16; ++n) {
+      VP8FTransform(src + VP8Scan[n], out + VP8Scan[n], tmp[n]);
+      for (i = 0; i < 16; ++i) {
+        const int j = kZigzag[i];
+        coeffs[i] = tmp[n][j] + rd->y_ac_levels[n][i] * mtx->q_[j];
+      }
+      RecordBlock(model, coeffs, 0, 0, TYPE_I4_AC, 4, &i4);
+    }
+    FinalizeGridScore(&i4);
+  }
+  {
+    const uint8_t* const src_uv = it->yuv_in_ + U_OFF_ENC;
+    const uint8_t* const ref = it->yuv_p_ + VP8UVModeOffsets[rd->mode_uv];
+    for (n = 0; n < 8; n += 2) {
+      VP8FTransform2(src_uv + VP8ScanUV[n], ref + VP8ScanUV[n], tmp[n]);
+    }
+    for (n = 0; n < 8; ++n) {
+      for (i = 0; i < 16; ++i) coeffs[i] = tmp[n][kZigzag[i]];
+      RecordBlock(model, coeffs, 0, 4, TYPE_CHROMA_A, 4, &uv);
+    }
+    FinalizeGridScore(&uv);
+  }
+
+  for (g = 0; g < RD_GRID_SIZE; ++g) {
+    const RDGridScore* best = &i16;
+    uint64_t h = h_i16;
+    if (is_i4) {
+      // same trade-off as the final decision in PickBestIntra4(), x16
+      const uint64_t lambda = 16 * model->lambda_[g];
+      const uint64_t score_i16 = (h_i16 + GetGridRate(&i16, g)) * lambda +
+                                 RD_DISTO_MULT * i16.disto_[g];
+      const uint64_t score_i4 = ((uint64_t)rd->H + GetGridRate(&i4, g)) *
+                                lambda + RD_DISTO_MULT * i4.disto_[g];
+      if (score_i4 < score_i16) {
+        best = &i4;
+        h = (uint64_t)rd->H;
+      }
+    }
+    for (t = 0; t < NUM_TYPES; ++t) {
+      for (k = 0; k < RD_NUM_TOKENS; ++k) {
+        model->tokens_[s][g][t][k] +=
+            best->tokens_[g][t][k] + uv.tokens_[g][t][k];
+      }
+    }
+    model->level_bits_[s][g] += best->level_bits_[g] + uv.level_bits_[g];
+    model->header_[s][g] += h;
+    model->disto_[s][g] += best->disto_[g] + uv.disto_[g];
+  }
+  model->pass_header_[s] += (uint64_t)rd->H;
+  model->pass_rate_ += (uint64_t)rd->R;
+  model->pass_disto_[s] += (uint64_t)rd->D;
+}
+
+void VP8RDModelMerge(const VP8RDModel* const src, VP8RDModel* const dst) {
+  int s, g, t, k;
+  for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+    for (g = 0; g < RD_GRID_SIZE; ++g) {
+      for (t = 0; t < NUM_TYPES; ++t) {
+        for (k = 0; k < RD_NUM_TOKENS; ++k) {
+          dst->tokens_[s][g][t][k] += src->tokens_[s][g][t][k];
+        }
+      }
+      dst->level_bits_[s][g] += src->level_bits_[s][g];
+      dst->header_[s][g] += src->header_[s][g];
+      dst->disto_[s][g] += src->disto_[s][g];
+    }
+    dst->pass_header_[s] += src->pass_header_[s];
+    dst->pass_disto_[s] += src->pass_disto_[s];
+  }
+  dst->pass_rate_ += src->pass_rate_;
+}
+
+// Returns the grid interval containing quantizer 'q', and the position of 'q'
+// within it.
+static int GetGridPos(int q, double* const frac) {
+  const int g = (q < GridQuant(RD_GRID_SIZE - 2)) ? q >> 2 : RD_GRID_SIZE - 2;
+  const int q0 = GridQuant(g), q1 = GridQuant(g + 1);
+  *frac = (double)(q - q0) / (q1 - q0);
+  return g;
+}
+
+static double Interpolate(double v0, double v1, double frac) {
+  return v0 + (v1 - v0) * frac;
+}
+
+// Predicts the value for quantizer 'q', scaled so as to match the value
+// 'measured' with the quantizer of the pass.
+static double PredictSegmentValue(const uint64_t values[RD_GRID_SIZE],
+                                  uint64_t measured, int pass_q, int q) {
+  double frac, ref_frac;
+  const int g = GetGridPos(q, &frac);
+  const int ref_g = GetGridPos(pass_q, &ref_frac);
+  const double value =
+      Interpolate((double)values[g], (double)values[g + 1], frac);
+  const double ref =
+      Interpolate((double)values[ref_g], (double)values[ref_g + 1], ref_frac);
+  return (ref > 0.) ? value * (double)measured / ref : value;
+}
+
+// Returns the coefficient bits for the segment quantizers 'quants'.
+static double PredictRate(const VP8RDModel* const model, int num_segments,
+                          const int quants[NUM_MB_SEGMENTS]) {
+  double counts[NUM_TYPES][RD_NUM_TOKENS];
+  double rate = 0.;
+  int s, t, k;
+  memset(counts, 0, sizeof(counts));
+  for (s = 0; s < num_segments; ++s) {
+    double frac;
+    const int g = GetGridPos(quants[s], &frac);
+    for (t = 0; t < NUM_TYPES; ++t) {
+      for (k = 0; k < RD_NUM_TOKENS; ++k) {
+        counts[t][k] += Interpolate(model->tokens_[s][g][t][k],
+                                    model->tokens_[s][g + 1][t][k], frac);
+      }
+    }
+    rate += Interpolate((double)model->level_bits_[s][g],
+                        (double)model->level_bits_[s][g + 1], frac);
+  }
+  for (t = 0; t < NUM_TYPES; ++t) {   // entropy of the tokens
+    double total = 0.;
+    for (k = 0; k < RD_NUM_TOKENS; ++k) total += counts[t][k];
+    for (k = 0; k < RD_NUM_TOKENS; ++k) {
+      if (counts[t][k] > 0.) {
+        rate += 256. * counts[t][k] * log2(total / counts[t][k]);
+      }
+    }
+  }
+  return rate;
+}
+
+void VP8RDModelPredict(const VP8Encoder* const enc,
+                       const VP8RDModel* const model, float quality,
+                       double* const header, double* const rate,
+                       double* const disto) {
+  const int num_segments = enc->segment_hdr_.num_segments_;
+  int quants[NUM_MB_SEGMENTS];
+  double ref_rate;
+  int s;
+  GetSegmentQuants(enc, quality, quants);
+  *header = *disto = 0.;
+  for (s = 0; s < num_segments; ++s) {
+    const int pass_q = model->pass_quant_[s];
+    *header += PredictSegmentValue(model->header_[s], model->pass_header_[s],
+                                   pass_q, quants[s]);
+    *disto += PredictSegmentValue(model->disto_[s], 16 * model->pass_disto_[s],
+                                  pass_q, quants[s]) / 16.;
+  }
+  *rate = PredictRate(model, num_segments, quants);
+  ref_rate = PredictRate(model, num_segments, model->pass_quant_);
+  if (ref_rate > 0.) *rate *= (double)model->pass_rate_ / ref_rate;
+}
@@ -48,26 +48,52 @@ void VP8TBufferInit(VP8TBuffer* const b, int page_size) {
   b->last_page_ = &b->pages_;
   b->left_ = 0;
   b->page_size_ = (page_size < MIN_PAGE_SIZE) ? MIN_PAGE_SIZE : page_size;
+  b->free_pages_ = NULL;
   b->error_ = 0;
 }
 
+static void FreePages(VP8Tokens* p) {
+  while (p != NULL) {
+    VP8Tokens* const next = p->next_;
+    WebPSafeFree(p);
+    p = next;
+  }
+}
+
 void VP8TBufferClear(VP8TBuffer* const b) {
   if (b != NULL) {
-    VP8Tokens* p = b->pages_;
-    while (p != NULL) {
-      VP8Tokens* const next = p->next_;
-      WebPSafeFree(p);
-      p = next;
-    }
+    FreePages(b->pages_);
+    FreePages(b->free_pages_);
     VP8TBufferInit(b, b->page_size_);
   }
 }
 
+void VP8TBufferReset(VP8TBuffer* const b, int page_size) {
+  if (page_size < MIN_PAGE_SIZE) page_size = MIN_PAGE_SIZE;
+  if (page_size == b->page_size_) {
+    *b->last_page_ = b->free_pages_;   // recycle all pages at once
+    b->free_pages_ = b->pages_;
+    b->tokens_ = NULL;
+    b->pages_ = NULL;
+    b->last_page_ = &b->pages_;
+    b->left_ = 0;
+    b->error_ = 0;
+  } else {
+    VP8TBufferClear(b);
+    VP8TBufferInit(b, page_size);
+  }
+}
+
 static int TBufferNewPage(VP8TBuffer* const b) {
   VP8Tokens* page = NULL;
   if (!b->error_) {
-    const size_t size = sizeof(*page) + b->page_size_ * sizeof(token_t);
-    page = (VP8Tokens*)WebPSafeMalloc(1ULL, size);
+    if (b->free_pages_ != NULL) {
+      page = b->free_pages_;
+      b->free_pages_ = page->next_;
+    } else {
+      const size_t size = sizeof(*page) + b->page_size_ * sizeof(token_t);
+      page = (VP8Tokens*)WebPSafeMalloc(1ULL, size);
+    }
   }
   if (page == NULL) {
     b->error_ = 1;
@@ -215,10 +241,9 @@ int VP8EmitTokens(VP8TBuffer* const b, VP8BitWriter* const bw,
         VP8PutBit(bw, bit, probas[token & 0x3fffu]);
       }
     }
-    if (final_pass) WebPSafeFree((void*)p);
     p = next;
   }
-  if (final_pass) b->pages_ = NULL;
+  if (final_pass) VP8TBufferReset(b, b->page_size_);
   return 1;
 }
 
@@ -257,6 +282,10 @@ void VP8TBufferInit(VP8TBuffer* const b, int page_size) {
 void VP8TBufferClear(VP8TBuffer* const b) {
   (void)b;
 }
+void VP8TBufferReset(VP8TBuffer* const b, int page_size) {
+  (void)b;
+  (void)page_size;
+}
 
 #endif    // !DISABLE_TOKEN_BUFFER
 
@@ -243,6 +243,8 @@ typedef struct {
   uint64_t      luma_bits_;        // macroblock bit-cost for luma
   uint64_t      uv_bits_;          // macroblock bit-cost for chroma
   LFStats*      lf_stats_;         // filter stats (borrowed from enc_)
+  int*          max_edge_;         // per-segment max edge delta, if not NULL
+                                   // (otherwise, stored in enc_->dqm_[])
   int           do_trellis_;       // if true, perform extra level optimisation
   int           count_down_;       // number of mb still to be processed
   int           count_down0_;      // starting counter value (for progress)
@@ -316,6 +318,7 @@ typedef struct {
   uint16_t* tokens_;        // set to (*last_page_)->tokens_
   int left_;                // how many free tokens left before the page is full
   int page_size_;           // number of tokens per page
+  VP8Tokens* free_pages_;   // pages kept for reuse by VP8TBufferReset()
 #endif
   int error_;         // true in case of malloc error
 } VP8TBuffer;
@@ -323,11 +326,14 @@ typedef struct {
 // initialize an empty buffer
 void VP8TBufferInit(VP8TBuffer* const b, int page_size);
 void VP8TBufferClear(VP8TBuffer* const b);   // de-allocate pages memory
+// Empties the buffer. Its pages are kept for the next tokens if 'page_size' is
+// unchanged. Otherwise, same as VP8TBufferClear() then VP8TBufferInit().
+void VP8TBufferReset(VP8TBuffer* const b, int page_size);
 
 #if !defined(DISABLE_TOKEN_BUFFER)
 
 // Finalizes bitstream when probabilities are known.
-// Deletes the allocated token memory if final_pass is true.
+// Empties the buffer if final_pass is true (see VP8TBufferReset()).
 int VP8EmitTokens(VP8TBuffer* const b, VP8BitWriter* const bw,
                   const uint8_t* const probas, int final_pass);
 
@@ -340,6 +346,37 @@ size_t VP8EstimateTokenSize(VP8TBuffer* const b, const uint8_t* const probas);
 
 #endif  // !DISABLE_TOKEN_BUFFER
 
+//------------------------------------------------------------------------------
+// Rate-distortion model
+
+#define RD_GRID_SIZE 33   // number of modeled quantizers: 0, 4, ..., 124, 127
+#define RD_NUM_CLASSES 6  // y1-dc, y1-ac, y2-dc, y2-ac, uv-dc, uv-ac
+#define RD_NUM_TOKENS 7   // eob, zero, one, two, 3..4, 5..10, 11+
+
+// Statistics collected during a pass, from which the size and distortion at
+// other qualities are predicted: the transform coefficients of each macroblock
+// are quantized with each of the grid's quantizers, for its best intra16 mode
+// and (if chosen) its intra4 modes.
+typedef struct {
+  // quantizer steps of the grid, per coefficient class
+  uint16_t q_[RD_NUM_CLASSES][RD_GRID_SIZE];
+  uint32_t iq_[RD_NUM_CLASSES][RD_GRID_SIZE];
+  uint32_t bias_[RD_NUM_CLASSES];
+  uint32_t lambda_[RD_GRID_SIZE];       // lambda for the mode decision
+  int pass_quant_[NUM_MB_SEGMENTS];     // quantizers used during the pass
+  // Per segment, for the modes preferred with each quantizer of the grid:
+  // token counts, fixed costs of the levels and header bits (in 1/256 bits),
+  // and distortion (x16).
+  uint32_t tokens_[NUM_MB_SEGMENTS][RD_GRID_SIZE][NUM_TYPES][RD_NUM_TOKENS];
+  uint64_t level_bits_[NUM_MB_SEGMENTS][RD_GRID_SIZE];
+  uint64_t header_[NUM_MB_SEGMENTS][RD_GRID_SIZE];
+  uint64_t disto_[NUM_MB_SEGMENTS][RD_GRID_SIZE];
+  // Same, as measured during the pass.
+  uint64_t pass_header_[NUM_MB_SEGMENTS];
+  uint64_t pass_rate_;
+  uint64_t pass_disto_[NUM_MB_SEGMENTS];
+} VP8RDModel;
+
 //------------------------------------------------------------------------------
 // VP8Encoder
 
@@ -372,6 +409,8 @@ struct VP8Encoder {
   uint8_t* alpha_data_;       // non-NULL if transparency is present
   uint32_t alpha_data_size_;
   WebPWorker alpha_worker_;
+  // If not NULL, the lossless encoders are taken from and kept in there.
+  struct VP8LEncoderCache* alpha_encoders_;
 
   // quantization info (one set of DC/AC dequant factor per segment)
   VP8SegmentInfo dqm_[NUM_MB_SEGMENTS];
@@ -399,6 +438,7 @@ struct VP8Encoder {
   int mb_header_limit_;      // rough limit for header bits per MB
   int thread_level_;         // derived from config->thread_level
   int do_search_;            // derived from config->target_XXX
+  int use_rd_model_;         // if true, the search uses a VP8RDModel
   int use_tokens_;           // if true, use token buffer
 
   // Memory
@@ -473,6 +513,19 @@ void VP8SetSegmentParams(VP8Encoder* const enc, float quality);
 int VP8Decimate(VP8EncIterator* WEBP_RESTRICT const it,
                 VP8ModeScore* WEBP_RESTRICT const rd,
                 VP8RDLevel rd_opt);
+// Empties 'model' for a new pass. Must be called after VP8SetSegmentParams().
+void VP8RDModelInit(const VP8Encoder* const enc, VP8RDModel* const model);
+// Records the macroblock decided by VP8Decimate() with 'rd_opt' > RD_OPT_NONE.
+void VP8RDModelRecord(const VP8EncIterator* const it,
+                      const VP8ModeScore* const rd, VP8RDModel* const model);
+// Adds the statistics of 'src' to 'dst' (both initialized for the same pass).
+void VP8RDModelMerge(const VP8RDModel* const src, VP8RDModel* const dst);
+// Predicts the header bits, coefficient bits and distortion (sse) of the whole
+// picture, coded with 'quality'.
+void VP8RDModelPredict(const VP8Encoder* const enc,
+                       const VP8RDModel* const model, float quality,
+                       double* const header, double* const rate,
+                       double* const disto);
 
   // in alpha.c
 void VP8EncInitAlpha(VP8Encoder* const enc);    // initialize alpha compression
@@ -685,7 +685,9 @@ static int EncoderInit(VP8LEncoder* const enc) {
   int i;
   if (!VP8LHashChainInit(&enc->hash_chain_, pix_cnt)) return 0;
 
-  for (i = 0; i < 4; ++i) VP8LBackwardRefsInit(&enc->refs_[i], refs_block_size);
+  for (i = 0; i < 4; ++i) {
+    VP8LBackwardRefsReset(&enc->refs_[i], refs_block_size);
+  }
 
   return 1;
 }
@@ -1163,6 +1165,8 @@ static int EncodeImageInternal(
   }
   percent_start += percent_range;
   remaining_percent -= percent_range;
+  // Borrow the scratch memory of 'hash_chain', which is filled already.
+  hash_chain_histogram.hash_to_first_index_ = hash_chain->hash_to_first_index_;
 
   if (use_cache) {
     // If the value is different from zero, it has been set during the
@@ -1338,6 +1342,10 @@ static int EncodeImageInternal(
   WebPSafeFree(huff_tree);
   VP8LFreeHistogramSet(histogram_image);
   VP8LFreeHistogram(tmp_histo);
+  if (hash_chain_histogram.hash_to_first_index_ ==
+      hash_chain->hash_to_first_index_) {
+    hash_chain_histogram.hash_to_first_index_ = NULL;   // borrowed
+  }
   VP8LHashChainClear(&hash_chain_histogram);
   if (huffman_codes != NULL) {
     WebPSafeFree(huffman_codes->codes);
@@ -1372,7 +1380,8 @@ static int ApplyPredictFilter(const VP8LEncoder* const enc, int width,
   if (!VP8LResidualImage(
           width, height, pred_bits, low_effort, enc->argb_, enc->argb_scratch_,
           enc->transform_data_, near_lossless_strength, enc->config_->exact,
-          used_subtract_green, enc->pic_, percent_range / 2, percent)) {
+          used_subtract_green, enc->num_threads_, enc->pic_,
+          percent_range / 2, percent)) {
     return 0;
   }
   VP8LPutBits(bw, TRANSFORM_PRESENT, 1);
@@ -1395,7 +1404,8 @@ static int ApplyCrossColorFilter(const VP8LEncoder* const enc, int width,
   const int transform_height = VP8LSubSampleSize(height, ccolor_transform_bits);
 
   if (!VP8LColorSpaceTransform(width, height, ccolor_transform_bits, quality,
-                               enc->argb_, enc->transform_data_, enc->pic_,
+                               enc->argb_, enc->transform_data_,
+                               enc->num_threads_, enc->pic_,
                                percent_range / 2, percent)) {
     return 0;
   }
@@ -1731,6 +1741,7 @@ static VP8LEncoder* VP8LEncoderNew(const WebPConfig* const config,
   enc->config_ = config;
   enc->pic_ = picture;
   enc->argb_content_ = kEncoderNone;
+  enc->num_threads_ = 0;
 
   VP8LEncDspInit();
 
@@ -1747,6 +1758,56 @@ static void VP8LEncoderDelete(VP8LEncoder* enc) {
   }
 }
 
+// Same as VP8LEncoderNew(), but reuses the encoder kept at 'idx' in 'encoders'
+// (if any), with its buffers.
+static VP8LEncoder* VP8LEncoderGet(const WebPConfig* const config,
+                                   const WebPPicture* const picture,
+                                   VP8LEncoderCache* const encoders, int idx) {
+  VP8LEncoder* enc = NULL;
+  if (encoders != NULL && idx < VP8L_MAX_ENCODERS) {
+    enc = encoders->encoders_[idx];
+    encoders->encoders_[idx] = NULL;
+  }
+  if (enc == NULL) return VP8LEncoderNew(config, picture);
+  {
+    // Keep the buffers, reset everything else.
+    uint32_t* const transform_mem = enc->transform_mem_;
+    const size_t transform_mem_size = enc->transform_mem_size_;
+    const VP8LHashChain hash_chain = enc->hash_chain_;
+    VP8LBackwardRefs refs[4];
+    memcpy(refs, enc->refs_, sizeof(refs));
+    memset(enc, 0, sizeof(*enc));
+    enc->transform_mem_ = transform_mem;
+    enc->transform_mem_size_ = transform_mem_size;
+    enc->hash_chain_ = hash_chain;
+    memcpy(enc->refs_, refs, sizeof(refs));
+  }
+  enc->config_ = config;
+  enc->pic_ = picture;
+  enc->argb_content_ = kEncoderNone;
+  enc->num_threads_ = 0;
+  return enc;
+}
+
+// Keeps 'enc' at 'idx' in 'encoders' if possible, deletes it otherwise.
+static void VP8LEncoderRelease(VP8LEncoder* const enc,
+                               VP8LEncoderCache* const encoders, int idx) {
+  if (enc != NULL && encoders != NULL && idx < VP8L_MAX_ENCODERS) {
+    assert(encoders->encoders_[idx] == NULL);
+    encoders->encoders_[idx] = enc;
+  } else {
+    VP8LEncoderDelete(enc);
+  }
+}
+
+void VP8LEncoderCacheClear(VP8LEncoderCache* const encoders) {
+  int i;
+  for (i = 0; i < VP8L_MAX_ENCODERS; ++i) {
+    VP8LEncoderDelete(encoders->encoders_[i]);
+    encoders->encoders_[i] = NULL;
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Main call
 
@@ -1818,8 +1879,8 @@ static int EncodeStreamHook(void* input, void* data2) {
     }
     // Reset any parameter in the encoder that is set in the previous iteration.
     enc->cache_bits_ = 0;
-    VP8LBackwardRefsClear(&enc->refs_[0]);
-    VP8LBackwardRefsClear(&enc->refs_[1]);
+    VP8LBackwardRefsReset(&enc->refs_[0], enc->refs_[0].block_size_);
+    VP8LBackwardRefsReset(&enc->refs_[1], enc->refs_[1].block_size_);
 
 #if (WEBP_NEAR_LOSSLESS == 1)
     // Apply near-lossless preprocessing.
@@ -1950,154 +2011,170 @@ static int EncodeStreamHook(void* input, void* data2) {
 
 int VP8LEncodeStream(const WebPConfig* const config,
                      const WebPPicture* const picture,
-                     VP8LBitWriter* const bw_main, int use_cache) {
-  VP8LEncoder* const enc_main = VP8LEncoderNew(config, picture);
-  VP8LEncoder* enc_side = NULL;
+                     VP8LBitWriter* const bw_main, int use_cache,
+                     VP8LEncoderCache* const encoders) {
+  VP8LEncoder* const enc_main =
+      VP8LEncoderGet(config, picture, encoders, /*idx=*/0);
+  VP8LEncoder* enc_side[CRUNCH_CONFIGS_MAX];
   CrunchConfig crunch_configs[CRUNCH_CONFIGS_MAX];
-  int num_crunch_configs_main, num_crunch_configs_side = 0;
+  int num_crunch_configs;
+  int num_workers = 1;
+  int num_threads = 1;
   int idx;
   int red_and_blue_always_zero = 0;
-  WebPWorker worker_main, worker_side;
-  StreamEncodeContext params_main, params_side;
-  // The main thread uses picture->stats, the side thread uses stats_side.
-  WebPAuxStats stats_side;
-  VP8LBitWriter bw_side;
-  WebPPicture picture_side;
+  WebPWorker workers[CRUNCH_CONFIGS_MAX];
+  StreamEncodeContext params[CRUNCH_CONFIGS_MAX];
+  // The main thread (index 0) uses picture->stats, bw_main and enc_main, the
+  // side threads use their own copies from the *_side[] arrays below.
+  WebPAuxStats stats_side[CRUNCH_CONFIGS_MAX];
+  VP8LBitWriter bw_side[CRUNCH_CONFIGS_MAX];
+  WebPPicture picture_side[CRUNCH_CONFIGS_MAX];
   const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
-  int ok_main;
+  int ok = 1;
+
+  // Nothing to free yet.
+  memset(enc_side, 0, sizeof(enc_side));
+  memset(bw_side, 0, sizeof(bw_side));
 
-  if (enc_main == NULL || !VP8LBitWriterInit(&bw_side, 0)) {
+  if (enc_main == NULL) {
     WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    VP8LEncoderDelete(enc_main);
     return 0;
   }
 
-  // Avoid "garbage value" error from Clang's static analysis tool.
-  WebPPictureInit(&picture_side);
-
   // Analyze image (entropy, num_palettes etc)
-  if (!EncoderAnalyze(enc_main, crunch_configs, &num_crunch_configs_main,
+  if (!EncoderAnalyze(enc_main, crunch_configs, &num_crunch_configs,
                       &red_and_blue_always_zero) ||
       !EncoderInit(enc_main)) {
     WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
     goto Error;
   }
 
-  // Split the configs between the main and side threads (if any).
+  // Split the configs between the main and side threads (if any): at least
+  // two threads if threading is requested, at most one per config. The
+  // threads left over go to the banded tile searches of each config.
   if (config->thread_level > 0) {
-    num_crunch_configs_side = num_crunch_configs_main / 2;
-    for (idx = 0; idx < num_crunch_configs_side; ++idx) {
-      params_side.crunch_configs_[idx] =
-          crunch_configs[num_crunch_configs_main - num_crunch_configs_side +
-                         idx];
-    }
-    params_side.num_crunch_configs_ = num_crunch_configs_side;
-  }
-  num_crunch_configs_main -= num_crunch_configs_side;
-  for (idx = 0; idx < num_crunch_configs_main; ++idx) {
-    params_main.crunch_configs_[idx] = crunch_configs[idx];
-  }
-  params_main.num_crunch_configs_ = num_crunch_configs_main;
-
-  // Fill in the parameters for the thread workers.
-  {
-    const int params_size = (num_crunch_configs_side > 0) ? 2 : 1;
-    for (idx = 0; idx < params_size; ++idx) {
-      // Create the parameters for each worker.
-      WebPWorker* const worker = (idx == 0) ? &worker_main : &worker_side;
-      StreamEncodeContext* const param =
-          (idx == 0) ? &params_main : &params_side;
-      param->config_ = config;
-      param->use_cache_ = use_cache;
-      param->red_and_blue_always_zero_ = red_and_blue_always_zero;
-      if (idx == 0) {
-        param->picture_ = picture;
-        param->stats_ = picture->stats;
-        param->bw_ = bw_main;
-        param->enc_ = enc_main;
-      } else {
-        // Create a side picture (error_code is not thread-safe).
-        if (!WebPPictureView(picture, /*left=*/0, /*top=*/0, picture->width,
-                             picture->height, &picture_side)) {
-          assert(0);
-        }
-        picture_side.progress_hook = NULL;  // Progress hook is not thread-safe.
-        param->picture_ = &picture_side;  // No need to free a view afterwards.
-        param->stats_ = (picture->stats == NULL) ? NULL : &stats_side;
-        // Create a side bit writer.
-        if (!VP8LBitWriterClone(bw_main, &bw_side)) {
-          WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-          goto Error;
-        }
-        param->bw_ = &bw_side;
-        // Create a side encoder.
-        enc_side = VP8LEncoderNew(config, &picture_side);
-        if (enc_side == NULL || !EncoderInit(enc_side)) {
-          WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-          goto Error;
-        }
-        // Copy the values that were computed for the main encoder.
-        enc_side->histo_bits_ = enc_main->histo_bits_;
-        enc_side->transform_bits_ = enc_main->transform_bits_;
-        enc_side->palette_size_ = enc_main->palette_size_;
-        memcpy(enc_side->palette_, enc_main->palette_,
-               sizeof(enc_main->palette_));
-        memcpy(enc_side->palette_sorted_, enc_main->palette_sorted_,
-               sizeof(enc_main->palette_sorted_));
-        param->enc_ = enc_side;
+    num_threads = (config->thread_level > 2) ? config->thread_level : 2;
+    num_workers = (num_threads < num_crunch_configs) ? num_threads
+                                                     : num_crunch_configs;
+  }
+  if (config->use_tile_bands) {
+    enc_main->num_threads_ = num_threads / num_workers;
+  }
+
+  // Fill in the parameters for the thread workers. Each worker gets a
+  // contiguous range of configs, the main one getting the largest share.
+  for (idx = 0; idx < num_workers; ++idx) {
+    WebPWorker* const worker = &workers[idx];
+    StreamEncodeContext* const param = &params[idx];
+    const int first = num_crunch_configs -
+                      (num_workers - idx) * num_crunch_configs / num_workers;
+    const int last = num_crunch_configs -
+                     (num_workers - idx - 1) * num_crunch_configs / num_workers;
+    memcpy(param->crunch_configs_, &crunch_configs[first],
+           (last - first) * sizeof(*crunch_configs));
+    param->num_crunch_configs_ = last - first;
+    param->config_ = config;
+    param->use_cache_ = use_cache;
+    param->red_and_blue_always_zero_ = red_and_blue_always_zero;
+    if (idx == 0) {
+      param->picture_ = picture;
+      param->stats_ = picture->stats;
+      param->bw_ = bw_main;
+      param->enc_ = enc_main;
+    } else {
+      VP8LEncoder* enc;
+      // Create a side picture (error_code is not thread-safe).
+      if (!WebPPictureView(picture, /*left=*/0, /*top=*/0, picture->width,
+                           picture->height, &picture_side[idx])) {
+        assert(0);
       }
-      // Create the workers.
-      worker_interface->Init(worker);
-      worker->data1 = param;
-      worker->data2 = NULL;
-      worker->hook = EncodeStreamHook;
+      // Progress hook is not thread-safe.
+      picture_side[idx].progress_hook = NULL;
+      param->picture_ = &picture_side[idx];  // No need to free a view.
+      param->stats_ = (picture->stats == NULL) ? NULL : &stats_side[idx];
+      // Create a side bit writer.
+      if (!VP8LBitWriterClone(bw_main, &bw_side[idx])) {
+        WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        goto Error;
+      }
+      param->bw_ = &bw_side[idx];
+      // Create a side encoder.
+      enc = enc_side[idx] =
+          VP8LEncoderGet(config, &picture_side[idx], encoders, idx);
+      if (enc == NULL || !EncoderInit(enc)) {
+        WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        goto Error;
+      }
+      // Copy the values that were computed for the main encoder.
+      enc->histo_bits_ = enc_main->histo_bits_;
+      enc->transform_bits_ = enc_main->transform_bits_;
+      enc->num_threads_ = enc_main->num_threads_;
+      enc->palette_size_ = enc_main->palette_size_;
+      memcpy(enc->palette_, enc_main->palette_, sizeof(enc_main->palette_));
+      memcpy(enc->palette_sorted_, enc_main->palette_sorted_,
+             sizeof(enc_main->palette_sorted_));
+      param->enc_ = enc;
     }
+    // Create the workers.
+    worker_interface->Init(worker);
+    worker->data1 = param;
+    worker->data2 = NULL;
+    worker->hook = EncodeStreamHook;
   }
 
-  // Start the second thread if needed.
-  if (num_crunch_configs_side != 0) {
-    if (!worker_interface->Reset(&worker_side)) {
+  // Start the side threads if needed.
+  for (idx = 1; idx < num_workers; ++idx) {
+    if (!worker_interface->Reset(&workers[idx])) {
       WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      // Stop the threads that were already started.
+      while (--idx > 0) {
+        worker_interface->Sync(&workers[idx]);
+        worker_interface->End(&workers[idx]);
+      }
       goto Error;
     }
 #if !defined(WEBP_DISABLE_STATS)
     // This line is here and not in the param initialization above to remove a
     // Clang static analyzer warning.
     if (picture->stats != NULL) {
-      memcpy(&stats_side, picture->stats, sizeof(stats_side));
+      memcpy(&stats_side[idx], picture->stats, sizeof(stats_side[idx]));
     }
 #endif
-    worker_interface->Launch(&worker_side);
+    worker_interface->Launch(&workers[idx]);
   }
   // Execute the main thread.
-  worker_interface->Execute(&worker_main);
-  ok_main = worker_interface->Sync(&worker_main);
-  worker_interface->End(&worker_main);
-  if (num_crunch_configs_side != 0) {
-    // Wait for the second thread.
-    const int ok_side = worker_interface->Sync(&worker_side);
-    worker_interface->End(&worker_side);
-    if (!ok_main || !ok_side) {
-      if (picture->error_code == VP8_ENC_OK) {
-        assert(picture_side.error_code != VP8_ENC_OK);
-        WebPEncodingSetError(picture, picture_side.error_code);
+  worker_interface->Execute(&workers[0]);
+  ok = worker_interface->Sync(&workers[0]);
+  worker_interface->End(&workers[0]);
+  // Wait for the side threads. Configs are tried in order, so the first one
+  // giving the smallest bitstream is kept, whatever the number of threads.
+  for (idx = 1; idx < num_workers; ++idx) {
+    const int ok_side = worker_interface->Sync(&workers[idx]);
+    worker_interface->End(&workers[idx]);
+    if (!ok_side) {
+      if (ok && picture->error_code == VP8_ENC_OK) {
+        assert(picture_side[idx].error_code != VP8_ENC_OK);
+        WebPEncodingSetError(picture, picture_side[idx].error_code);
       }
-      goto Error;
+      ok = 0;
     }
-    if (VP8LBitWriterNumBytes(&bw_side) < VP8LBitWriterNumBytes(bw_main)) {
-      VP8LBitWriterSwap(bw_main, &bw_side);
+    if (ok &&
+        VP8LBitWriterNumBytes(&bw_side[idx]) < VP8LBitWriterNumBytes(bw_main)) {
+      VP8LBitWriterSwap(bw_main, &bw_side[idx]);
 #if !defined(WEBP_DISABLE_STATS)
       if (picture->stats != NULL) {
-        memcpy(picture->stats, &stats_side, sizeof(*picture->stats));
+        memcpy(picture->stats, &stats_side[idx], sizeof(*picture->stats));
       }
 #endif
     }
   }
 
  Error:
-  VP8LBitWriterWipeOut(&bw_side);
-  VP8LEncoderDelete(enc_main);
-  VP8LEncoderDelete(enc_side);
+  for (idx = 1; idx < CRUNCH_CONFIGS_MAX; ++idx) {
+    VP8LBitWriterWipeOut(&bw_side[idx]);
+    VP8LEncoderRelease(enc_side[idx], encoders, idx);
+  }
+  VP8LEncoderRelease(enc_main, encoders, /*idx=*/0);
   return (picture->error_code == VP8_ENC_OK);
 }
 
@@ -2105,7 +2182,8 @@ int VP8LEncodeStream(const WebPConfig* const config,
 #undef CRUNCH_SUBCONFIGS_MAX
 
 int VP8LEncodeImage(const WebPConfig* const config,
-                    const WebPPicture* const picture) {
+                    const WebPPicture* const picture,
+                    VP8LEncoderCache* const encoders) {
   int width, height;
   int has_alpha;
   size_t coded_size;
@@ -2163,7 +2241,9 @@ int VP8LEncodeImage(const WebPConfig* const config,
   if (!WebPReportProgress(picture, 2, &percent)) goto UserAbort;
 
   // Encode main image stream.
-  if (!VP8LEncodeStream(config, picture, &bw, 1 /*use_cache*/)) goto Error;
+  if (!VP8LEncodeStream(config, picture, &bw, 1 /*use_cache*/, encoders)) {
+    goto Error;
+  }
 
   if (!WebPReportProgress(picture, 99, &percent)) goto UserAbort;
 
@@ -56,6 +56,9 @@ typedef struct {
   size_t    transform_mem_size_;         // Currently allocated memory size.
 
   int       current_width_;       // Corresponds to packed image width.
+  int       num_threads_;         // Number of threads for the banded
+                                  // predictor and cross-color tile searches,
+                                  // 0 to search the tiles in raster order.
 
   // Encoding parameters derived from quality parameter.
   int histo_bits_;
@@ -78,21 +81,37 @@ typedef struct {
                                      // backward references.
 } VP8LEncoder;
 
+// Maximum number of encoders used for one picture (main and side threads).
+#define VP8L_MAX_ENCODERS 8
+
+// Encoders kept between pictures with their buffers, so that they don't need
+// to be reallocated (see WebPEncoderSession). Slot 0 holds the main encoder,
+// the others the encoders of the side threads.
+typedef struct VP8LEncoderCache {
+  VP8LEncoder* encoders_[VP8L_MAX_ENCODERS];
+} VP8LEncoderCache;
+
+// Deletes the encoders kept in 'encoders'.
+void VP8LEncoderCacheClear(VP8LEncoderCache* const encoders);
+
 //------------------------------------------------------------------------------
 // internal functions. Not public.
 
 // Encodes the picture.
+// If 'encoders' is not NULL, the encoders are taken from and kept in it.
 // Returns 0 if config or picture is NULL or picture doesn't have valid argb
 // input.
 int VP8LEncodeImage(const WebPConfig* const config,
-                    const WebPPicture* const picture);
+                    const WebPPicture* const picture,
+                    VP8LEncoderCache* const encoders);
 
 // Encodes the main image stream using the supplied bit writer.
 // If 'use_cache' is false, disables the use of color cache.
+// If 'encoders' is not NULL, the encoders are taken from and kept in it.
 // Returns false in case of error (stored in picture->error_code).
 int VP8LEncodeStream(const WebPConfig* const config,
                      const WebPPicture* const picture, VP8LBitWriter* const bw,
-                     int use_cache);
+                     int use_cache, VP8LEncoderCache* const encoders);
 
 #if (WEBP_NEAR_LOSSLESS == 1)
 // in near_lossless.c
@@ -104,18 +123,22 @@ int VP8ApplyNearLossless(const WebPPicture* const picture, int quality,
 //------------------------------------------------------------------------------
 // Image transforms in predictor.c.
 
+// If num_threads > 0, bands of tile rows are searched concurrently on up to
+// num_threads threads (which changes the output slightly, but not with
+// num_threads).
 // pic and percent are for progress.
 // Returns false in case of error (stored in pic->error_code).
 int VP8LResidualImage(int width, int height, int bits, int low_effort,
                       uint32_t* const argb, uint32_t* const argb_scratch,
                       uint32_t* const image, int near_lossless, int exact,
-                      int used_subtract_green, const WebPPicture* const pic,
-                      int percent_range, int* const percent);
+                      int used_subtract_green, int num_threads,
+                      const WebPPicture* const pic, int percent_range,
+                      int* const percent);
 
 int VP8LColorSpaceTransform(int width, int height, int bits, int quality,
                             uint32_t* const argb, uint32_t* image,
-                            const WebPPicture* const pic, int percent_range,
-                            int* const percent);
+                            int num_threads, const WebPPicture* const pic,
+                            int percent_range, int* const percent);
 
 //------------------------------------------------------------------------------
 
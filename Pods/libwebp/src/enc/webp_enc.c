@@ -112,6 +112,10 @@ static void MapConfigToTools(VP8Encoder* const enc) {
   enc->thread_level_ = config->thread_level;
 
   enc->do_search_ = (config->target_size > 0 || config->target_PSNR > 0);
+  // Without the rd-opt token statistics (method < 3), the model's size
+  // estimates are too coarse and the secant search is kept.
+  enc->use_rd_model_ = enc->do_search_ && config->use_rate_model &&
+                       (enc->rd_opt_level_ >= RD_OPT_BASIC);
   if (!config->low_memory) {
 #if !defined(DISABLE_TOKEN_BUFFER)
     enc->use_tokens_ = (enc->rd_opt_level_ >= RD_OPT_BASIC);  // need rd stats
@@ -141,9 +145,27 @@ static void MapConfigToTools(VP8Encoder* const enc) {
 //              LFStats: 2048
 // Picture size (yuv): 419328
 
+// Objects kept between the pictures encoded with WebPEncodeWithSession().
+struct WebPEncoderSession {
+  VP8Encoder* vp8_enc_;          // last lossy encoder, with its memory
+  uint64_t vp8_enc_size_;        // allocated size of 'vp8_enc_'
+  VP8LEncoderCache encoders_;    // lossless encoders, also used for alpha
+};
+
+static void FreeVP8Encoder(VP8Encoder* const enc) {
+  if (enc != NULL) {
+    VP8TBufferClear(&enc->tokens_);
+    WebPSafeFree(enc);
+  }
+}
+
+// If 'session' is not NULL, the encoder is allocated in (or reuses) its memory.
 static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
-                                  WebPPicture* const picture) {
+                                  WebPPicture* const picture,
+                                  WebPEncoderSession* const session) {
   VP8Encoder* enc;
+  VP8TBuffer tokens;   // token pages of the reused encoder
+  int reuse_tokens = 0;
   const int use_filter =
       (config->filter_strength > 0) || (config->autofilter > 0);
   const int mb_w = (picture->width + 15) >> 4;
@@ -198,10 +220,22 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
          mb_w * mb_h * 384 * sizeof(uint8_t));
   printf("===================================\n");
 #endif
-  mem = (uint8_t*)WebPSafeMalloc(size, sizeof(*mem));
-  if (mem == NULL) {
-    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
-    return NULL;
+  if (session != NULL && session->vp8_enc_ != NULL &&
+      session->vp8_enc_size_ >= size) {
+    mem = (uint8_t*)session->vp8_enc_;
+    tokens = session->vp8_enc_->tokens_;
+    reuse_tokens = 1;
+  } else {
+    mem = (uint8_t*)WebPSafeMalloc(size, sizeof(*mem));
+    if (mem == NULL) {
+      WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+      return NULL;
+    }
+    if (session != NULL) {
+      FreeVP8Encoder(session->vp8_enc_);
+      session->vp8_enc_ = (VP8Encoder*)mem;
+      session->vp8_enc_size_ = size;
+    }
   }
   enc = (VP8Encoder*)mem;
   mem = (uint8_t*)WEBP_ALIGN(mem + sizeof(*enc));
@@ -232,6 +266,7 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
   enc->profile_ = use_filter ? ((config->filter_type == 1) ? 0 : 1) : 2;
   enc->pic_ = picture;
   enc->percent_ = 0;
+  enc->alpha_encoders_ = (session != NULL) ? &session->encoders_ : NULL;
 
   MapConfigToTools(enc);
   VP8EncDspInit();
@@ -246,17 +281,24 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
   // size based on quality. This is just a crude 1rst-order prediction.
   {
     const float scale = 1.f + config->quality * 5.f / 100.f;  // in [1,6]
-    VP8TBufferInit(&enc->tokens_, (int)(mb_w * mb_h * 4 * scale));
+    const int page_size = (int)(mb_w * mb_h * 4 * scale);
+    if (reuse_tokens) {
+      enc->tokens_ = tokens;
+      VP8TBufferReset(&enc->tokens_, page_size);
+    } else {
+      VP8TBufferInit(&enc->tokens_, page_size);
+    }
   }
   return enc;
 }
 
-static int DeleteVP8Encoder(VP8Encoder* enc) {
+// The encoder memory is kept in 'session' if not NULL.
+static int DeleteVP8Encoder(VP8Encoder* enc,
+                            WebPEncoderSession* const session) {
   int ok = 1;
   if (enc != NULL) {
     ok = VP8EncDeleteAlpha(enc);
-    VP8TBufferClear(&enc->tokens_);
-    WebPSafeFree(enc);
+    if (session == NULL) FreeVP8Encoder(enc);
   }
   return ok;
 }
@@ -325,7 +367,8 @@ int WebPReportProgress(const WebPPicture* const pic,
 }
 //------------------------------------------------------------------------------
 
-int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+static int Encode(WebPEncoderSession* const session,
+                  const WebPConfig* config, WebPPicture* pic) {
   int ok = 0;
   if (pic == NULL) return 0;
 
@@ -371,7 +414,7 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPCleanupTransparentArea(pic);
     }
 
-    enc = InitVP8Encoder(config, pic);
+    enc = InitVP8Encoder(config, pic, session);
     if (enc == NULL) return 0;  // pic->error is already set.
     // Note: each of the tasks below account for 20% in the progress report.
     ok = VP8EncAnalyze(enc);
@@ -390,7 +433,7 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
     if (!ok) {
       VP8EncFreeBitWriters(enc);
     }
-    ok &= DeleteVP8Encoder(enc);  // must always be called, even if !ok
+    ok &= DeleteVP8Encoder(enc, session);  // must always be called, even if !ok
   } else {
     // Make sure we have ARGB samples.
     if (pic->argb == NULL && !WebPPictureYUVAToARGB(pic)) {
@@ -401,8 +444,44 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPReplaceTransparentPixels(pic, 0x000000);
     }
 
-    ok = VP8LEncodeImage(config, pic);  // Sets pic->error in case of problem.
+    // Sets pic->error in case of problem.
+    ok = VP8LEncodeImage(config, pic,
+                         (session != NULL) ? &session->encoders_ : NULL);
   }
 
   return ok;
 }
+
+int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+  return Encode(NULL, config, pic);
+}
+
+//------------------------------------------------------------------------------
+// Encoder session
+
+WebPEncoderSession* WebPNewEncoderSession(void) {
+  return (WebPEncoderSession*)WebPSafeCalloc(1ULL,
+                                             sizeof(WebPEncoderSession));
+}
+
+int WebPEncodeWithSession(WebPEncoderSession* session,
+                          const WebPConfig* config, WebPPicture* pic) {
+  if (pic == NULL) return 0;
+  if (session == NULL) {
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_NULL_PARAMETER);
+  }
+  return Encode(session, config, pic);
+}
+
+void WebPResetEncoderSession(WebPEncoderSession* session) {
+  if (session != NULL) {
+    FreeVP8Encoder(session->vp8_enc_);
+    VP8LEncoderCacheClear(&session->encoders_);
+    memset(session, 0, sizeof(*session));
+  }
+}
+
+void WebPDeleteEncoderSession(WebPEncoderSession* session) {
+  WebPResetEncoderSession(session);
+  WebPSafeFree(session);
+}
@@ -14,9 +14,11 @@
 #include <limits.h>
 #include <math.h>    // for pow()
 #include <stdio.h>
-#include <stdlib.h>  // for abs()
+#include <stdlib.h>
 
+#include "src/dsp/dsp.h"
 #include "src/mux/animi.h"
+#include "src/utils/thread_utils.h"
 #include "src/utils/utils.h"
 #include "src/webp/decode.h"
 #include "src/webp/encode.h"
@@ -45,6 +47,15 @@ typedef struct {
   int is_key_frame_;            // True if 'key_frame' has been chosen.
 } EncodedFrame;
 
+// Candidates tried for each frame.
+enum {
+  LL_DISP_NONE = 0,
+  LL_DISP_BG,
+  LOSSY_DISP_NONE,
+  LOSSY_DISP_BG,
+  CANDIDATE_COUNT
+};
+
 struct WebPAnimEncoder {
   const int canvas_width_;                  // Canvas width.
   const int canvas_height_;                 // Canvas height.
@@ -96,6 +107,24 @@ struct WebPAnimEncoder {
   size_t out_frame_count_;  // Number of frames added to mux so far. This may be
                             // different from 'in_frame_count_' due to merging.
 
+  // Workers encoding the candidates concurrently. The last pending candidate
+  // is always encoded by the calling thread.
+  WebPWorker candidate_workers_[CANDIDATE_COUNT - 1];
+  // Encoder buffers kept from one frame to the next, one session per
+  // candidate as they may be encoded concurrently.
+  WebPEncoderSession* sessions_[CANDIDATE_COUNT];
+
+  // Asynchronous frame addition (if 'options_.use_threads'): see
+  // AddFrameAsync().
+  WebPWorker add_worker_;             // Encodes the frames, one at a time.
+  WebPPicture add_frame_;             // Copy of the frame being encoded.
+  int add_timestamp_;                 // Its timestamp,
+  WebPConfig add_config_;             // config,
+  FrameRectangle add_rects_[2];       // and change-rectangles.
+  int add_ok_;                        // False once a frame failed to be added.
+  WebPPicture ref_frame_;             // Last frame added and not skipped.
+  size_t analyzed_count_;             // Number of frames analyzed so far.
+
   WebPMux* mux_;        // Muxer to assemble the WebP bitstream.
   char error_str_[ERROR_STR_MAX_LENGTH];  // Error string. Empty if no error.
 };
@@ -178,6 +207,7 @@ static void DefaultEncoderOptions(WebPAnimEncoderOptions* const enc_options) {
   DisableKeyframes(enc_options);
   enc_options->allow_mixed = 0;
   enc_options->verbose = 0;
+  enc_options->use_threads = 0;
 }
 
 int WebPAnimEncoderOptionsInitInternal(WebPAnimEncoderOptions* enc_options,
@@ -246,9 +276,17 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
     return NULL;
   }
 
+  WebPAnimEncDspInit();
   enc = (WebPAnimEncoder*)WebPSafeCalloc(1, sizeof(*enc));
   if (enc == NULL) return NULL;
   MarkNoError(enc);
+  {
+    int i;
+    for (i = 0; i < CANDIDATE_COUNT - 1; ++i) {
+      WebPGetWorkerInterface()->Init(&enc->candidate_workers_[i]);
+    }
+    WebPGetWorkerInterface()->Init(&enc->add_worker_);
+  }
 
   // Dimensions and options.
   *(int*)&enc->canvas_width_ = width;
@@ -263,7 +301,9 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
   // Canvas buffers.
   if (!WebPPictureInit(&enc->curr_canvas_copy_) ||
       !WebPPictureInit(&enc->prev_canvas_) ||
-      !WebPPictureInit(&enc->prev_canvas_disposed_)) {
+      !WebPPictureInit(&enc->prev_canvas_disposed_) ||
+      !WebPPictureInit(&enc->add_frame_) ||
+      !WebPPictureInit(&enc->ref_frame_)) {
     goto Err;
   }
   enc->curr_canvas_copy_.width = width;
@@ -276,6 +316,28 @@ WebPAnimEncoder* WebPAnimEncoderNewInternal(
   }
   WebPUtilClearPic(&enc->prev_canvas_, NULL);
   enc->curr_canvas_copy_modified_ = 1;
+  enc->add_ok_ = 1;
+  {
+    int i;
+    for (i = 0; i < CANDIDATE_COUNT; ++i) {
+      enc->sessions_[i] = WebPNewEncoderSession();
+      if (enc->sessions_[i] == NULL) goto Err;
+    }
+  }
+#ifdef WEBP_USE_THREAD
+  if (enc->options_.use_threads) {
+    // The frames will be added asynchronously if a worker thread is available.
+    if (!WebPPictureCopy(&enc->prev_canvas_, &enc->add_frame_) ||
+        !WebPPictureCopy(&enc->prev_canvas_, &enc->ref_frame_)) {
+      goto Err;
+    }
+    if (!WebPGetWorkerInterface()->Reset(&enc->add_worker_)) {
+      // Fall back to synchronous mode.
+      WebPPictureFree(&enc->add_frame_);
+      WebPPictureFree(&enc->ref_frame_);
+    }
+  }
+#endif
 
   // Encoded frames.
   ResetCounters(enc);
@@ -316,11 +378,21 @@ static void FrameRelease(EncodedFrame* const encoded_frame) {
 
 void WebPAnimEncoderDelete(WebPAnimEncoder* enc) {
   if (enc != NULL) {
+    size_t i;
+    // Stop the frame addition first, as it uses the candidate workers.
+    WebPGetWorkerInterface()->End(&enc->add_worker_);
+    for (i = 0; i < CANDIDATE_COUNT - 1; ++i) {
+      WebPGetWorkerInterface()->End(&enc->candidate_workers_[i]);
+    }
+    for (i = 0; i < CANDIDATE_COUNT; ++i) {
+      WebPDeleteEncoderSession(enc->sessions_[i]);
+    }
+    WebPPictureFree(&enc->add_frame_);
+    WebPPictureFree(&enc->ref_frame_);
     WebPPictureFree(&enc->curr_canvas_copy_);
     WebPPictureFree(&enc->prev_canvas_);
     WebPPictureFree(&enc->prev_canvas_disposed_);
     if (enc->encoded_frames_ != NULL) {
-      size_t i;
       for (i = 0; i < enc->size_; ++i) {
         FrameRelease(&enc->encoded_frames_[i]);
       }
@@ -341,157 +413,85 @@ static EncodedFrame* GetFrame(const WebPAnimEncoder* const enc,
   return &enc->encoded_frames_[enc->start_ + position];
 }
 
-typedef int (*ComparePixelsFunc)(const uint32_t*, int, const uint32_t*, int,
-                                 int, int);
-
-// Returns true if 'length' number of pixels in 'src' and 'dst' are equal,
-// assuming the given step sizes between pixels.
-// 'max_allowed_diff' is unused and only there to allow function pointer use.
-static WEBP_INLINE int ComparePixelsLossless(const uint32_t* src, int src_step,
-                                             const uint32_t* dst, int dst_step,
-                                             int length, int max_allowed_diff) {
-  (void)max_allowed_diff;
-  assert(length > 0);
-  while (length-- > 0) {
-    if (*src != *dst) {
-      return 0;
-    }
-    src += src_step;
-    dst += dst_step;
-  }
-  return 1;
-}
-
-// Helper to check if each channel in 'src' and 'dst' is at most off by
-// 'max_allowed_diff'.
-static WEBP_INLINE int PixelsAreSimilar(uint32_t src, uint32_t dst,
-                                        int max_allowed_diff) {
-  const int src_a = (src >> 24) & 0xff;
-  const int src_r = (src >> 16) & 0xff;
-  const int src_g = (src >> 8) & 0xff;
-  const int src_b = (src >> 0) & 0xff;
-  const int dst_a = (dst >> 24) & 0xff;
-  const int dst_r = (dst >> 16) & 0xff;
-  const int dst_g = (dst >> 8) & 0xff;
-  const int dst_b = (dst >> 0) & 0xff;
-
-  return (src_a == dst_a) &&
-         (abs(src_r - dst_r) * dst_a <= (max_allowed_diff * 255)) &&
-         (abs(src_g - dst_g) * dst_a <= (max_allowed_diff * 255)) &&
-         (abs(src_b - dst_b) * dst_a <= (max_allowed_diff * 255));
-}
-
-// Returns true if 'length' number of pixels in 'src' and 'dst' are within an
-// error bound, assuming the given step sizes between pixels.
-static WEBP_INLINE int ComparePixelsLossy(const uint32_t* src, int src_step,
-                                          const uint32_t* dst, int dst_step,
-                                          int length, int max_allowed_diff) {
-  assert(length > 0);
-  while (length-- > 0) {
-    if (!PixelsAreSimilar(*src, *dst, max_allowed_diff)) {
-      return 0;
-    }
-    src += src_step;
-    dst += dst_step;
-  }
-  return 1;
-}
-
 static int IsEmptyRect(const FrameRectangle* const rect) {
   return (rect->width_ == 0) || (rect->height_ == 0);
 }
 
 static int QualityToMaxDiff(float quality) {
-  const double val = pow(quality / 100., 0.5);
+  const double q = (quality < 0.f) ? 0. :
+                   (quality > 100.f) ? 1. : quality / 100.;
+  const double val = pow(q, 0.5);
   const double max_diff = 31 * (1 - val) + 1 * val;
   return (int)(max_diff + 0.5);
 }
 
 // Assumes that an initial valid guess of change rectangle 'rect' is passed.
+// The result is the bounding box of the pixels which differ within 'rect'.
 static void MinimizeChangeRectangle(const WebPPicture* const src,
                                     const WebPPicture* const dst,
                                     FrameRectangle* const rect,
                                     int is_lossless, float quality) {
-  int i, j;
-  const ComparePixelsFunc compare_pixels =
-      is_lossless ? ComparePixelsLossless : ComparePixelsLossy;
-  const int max_allowed_diff_lossy = QualityToMaxDiff(quality);
-  const int max_allowed_diff = is_lossless ? 0 : max_allowed_diff_lossy;
+  const WebPAnimFindDiffFunc find_first =
+      is_lossless ? WebPAnimFindFirstDiff : WebPAnimFindFirstDissimilar;
+  const WebPAnimFindDiffFunc find_last =
+      is_lossless ? WebPAnimFindLastDiff : WebPAnimFindLastDissimilar;
+  const int max_allowed_diff = is_lossless ? 0 : QualityToMaxDiff(quality);
+  const int width = rect->width_;
+  const uint32_t* const src_argb = src->argb + rect->x_offset_;
+  const uint32_t* const dst_argb = dst->argb + rect->x_offset_;
+  int top, bottom, left, right, y;
 
   // Assumption/correctness checks.
   assert(src->width == dst->width && src->height == dst->height);
   assert(rect->x_offset_ + rect->width_ <= dst->width);
   assert(rect->y_offset_ + rect->height_ <= dst->height);
 
-  // Left boundary.
-  for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
-    const uint32_t* const src_argb =
-        &src->argb[rect->y_offset_ * src->argb_stride + i];
-    const uint32_t* const dst_argb =
-        &dst->argb[rect->y_offset_ * dst->argb_stride + i];
-    if (compare_pixels(src_argb, src->argb_stride, dst_argb, dst->argb_stride,
-                       rect->height_, max_allowed_diff)) {
-      --rect->width_;  // Redundant column.
-      ++rect->x_offset_;
-    } else {
-      break;
+  // Top boundary, which also gives a first guess of the left one.
+  left = width;
+  for (top = rect->y_offset_; top < rect->y_offset_ + rect->height_; ++top) {
+    left = find_first(src_argb + top * src->argb_stride,
+                      dst_argb + top * dst->argb_stride, width,
+                      max_allowed_diff);
+    if (left < width) break;
+  }
+  if (left == width) goto NoChange;
+
+  // Bottom boundary, which also gives a first guess of the right one.
+  right = -1;
+  for (bottom = rect->y_offset_ + rect->height_ - 1; bottom > top; --bottom) {
+    right = find_last(src_argb + bottom * src->argb_stride,
+                      dst_argb + bottom * dst->argb_stride, width,
+                      max_allowed_diff);
+    if (right >= 0) break;
+  }
+
+  // Left and right boundaries: only the pixels outside of the current guesses
+  // need to be looked at.
+  for (y = top; y <= bottom; ++y) {
+    const uint32_t* const src_row = src_argb + y * src->argb_stride;
+    const uint32_t* const dst_row = dst_argb + y * dst->argb_stride;
+    if (left > 0) {
+      left = find_first(src_row, dst_row, left, max_allowed_diff);
     }
-  }
-  if (rect->width_ == 0) goto NoChange;
-
-  // Right boundary.
-  for (i = rect->x_offset_ + rect->width_ - 1; i >= rect->x_offset_; --i) {
-    const uint32_t* const src_argb =
-        &src->argb[rect->y_offset_ * src->argb_stride + i];
-    const uint32_t* const dst_argb =
-        &dst->argb[rect->y_offset_ * dst->argb_stride + i];
-    if (compare_pixels(src_argb, src->argb_stride, dst_argb, dst->argb_stride,
-                       rect->height_, max_allowed_diff)) {
-      --rect->width_;  // Redundant column.
-    } else {
-      break;
+    if (right < width - 1) {
+      const int last = find_last(src_row + right + 1, dst_row + right + 1,
+                                 width - right - 1, max_allowed_diff);
+      if (last >= 0) right += last + 1;
     }
   }
-  if (rect->width_ == 0) goto NoChange;
 
-  // Top boundary.
-  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-      ++rect->y_offset_;
-    } else {
-      break;
-    }
-  }
-  if (rect->height_ == 0) goto NoChange;
-
-  // Bottom boundary.
-  for (j = rect->y_offset_ + rect->height_ - 1; j >= rect->y_offset_; --j) {
-    const uint32_t* const src_argb =
-        &src->argb[j * src->argb_stride + rect->x_offset_];
-    const uint32_t* const dst_argb =
-        &dst->argb[j * dst->argb_stride + rect->x_offset_];
-    if (compare_pixels(src_argb, 1, dst_argb, 1, rect->width_,
-                       max_allowed_diff)) {
-      --rect->height_;  // Redundant row.
-    } else {
-      break;
-    }
-  }
-  if (rect->height_ == 0) goto NoChange;
+  assert(left <= right);
+  rect->x_offset_ += left;
+  rect->width_ = right - left + 1;
+  rect->y_offset_ = top;
+  rect->height_ = bottom - top + 1;
+  return;
 
-  if (IsEmptyRect(rect)) {
  NoChange:
-    rect->x_offset_ = 0;
-    rect->y_offset_ = 0;
-    rect->width_ = 0;
-    rect->height_ = 0;
-  }
+  rect->x_offset_ = 0;
+  rect->y_offset_ = 0;
+  rect->width_ = 0;
+  rect->height_ = 0;
 }
 
 // Snap rectangle to even offsets (and adjust dimensions if needed).
@@ -532,12 +532,11 @@ static void SubFrameParamsFree(SubFrameParams* const params) {
 // Given previous and current canvas, picks the optimal rectangle for the
 // current frame based on 'is_lossless' and other parameters. Assumes that the
 // initial guess 'rect' is valid.
-static int GetSubRect(const WebPPicture* const prev_canvas,
-                      const WebPPicture* const curr_canvas, int is_key_frame,
-                      int is_first_frame, int empty_rect_allowed,
-                      int is_lossless, float quality,
-                      FrameRectangle* const rect,
-                      WebPPicture* const sub_frame) {
+static void ComputeSubRect(const WebPPicture* const prev_canvas,
+                           const WebPPicture* const curr_canvas,
+                           int is_key_frame, int is_first_frame,
+                           int empty_rect_allowed, int is_lossless,
+                           float quality, FrameRectangle* const rect) {
   if (!is_key_frame || is_first_frame) {  // Optimize frame rectangle.
     // Note: This behaves as expected for first frame, as 'prev_canvas' is
     // initialized to a fully transparent canvas in the beginning.
@@ -546,8 +545,8 @@ static int GetSubRect(const WebPPicture* const prev_canvas,
   }
 
   if (IsEmptyRect(rect)) {
-    if (empty_rect_allowed) {  // No need to get 'sub_frame'.
-      return 1;
+    if (empty_rect_allowed) {  // No need to get a sub-frame.
+      return;
     } else {                   // Force a 1x1 rectangle.
       rect->width_ = 1;
       rect->height_ = 1;
@@ -557,31 +556,57 @@ static int GetSubRect(const WebPPicture* const prev_canvas,
   }
 
   SnapToEvenOffsets(rect);
+}
+
+// Picks optimal frame rectangles 'rects[0]' for lossless and 'rects[1]' for
+// lossy compression. The initial guess will be the full canvas.
+static void ComputeSubRects(const WebPPicture* const prev_canvas,
+                            const WebPPicture* const curr_canvas,
+                            int is_key_frame, int is_first_frame,
+                            int empty_rect_allowed, float quality,
+                            FrameRectangle rects[2]) {
+  // Lossless frame rectangle.
+  rects[0].x_offset_ = 0;
+  rects[0].y_offset_ = 0;
+  rects[0].width_ = curr_canvas->width;
+  rects[0].height_ = curr_canvas->height;
+  ComputeSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
+                 empty_rect_allowed, 1, quality, &rects[0]);
+  // Lossy frame rectangle.
+  rects[1] = rects[0];  // seed with lossless rect.
+  ComputeSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
+                 empty_rect_allowed, 0, quality, &rects[1]);
+}
+
+static int GetSubFrame(const WebPPicture* const curr_canvas,
+                       const FrameRectangle* const rect,
+                       WebPPicture* const sub_frame) {
+  if (IsEmptyRect(rect)) return 1;  // No need to get 'sub_frame'.
   return WebPPictureView(curr_canvas, rect->x_offset_, rect->y_offset_,
                          rect->width_, rect->height_, sub_frame);
 }
 
-// Picks optimal frame rectangle for both lossless and lossy compression. The
-// initial guess for frame rectangles will be the full canvas.
+// Picks optimal frame rectangle for both lossless and lossy compression, and
+// sets up the corresponding sub-frames. If not NULL, 'rects' holds the result
+// of ComputeSubRects() done beforehand.
 static int GetSubRects(const WebPPicture* const prev_canvas,
                        const WebPPicture* const curr_canvas, int is_key_frame,
                        int is_first_frame, float quality,
+                       const FrameRectangle* const rects,
                        SubFrameParams* const params) {
-  // Lossless frame rectangle.
-  params->rect_ll_.x_offset_ = 0;
-  params->rect_ll_.y_offset_ = 0;
-  params->rect_ll_.width_ = curr_canvas->width;
-  params->rect_ll_.height_ = curr_canvas->height;
-  if (!GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                  params->empty_rect_allowed_, 1, quality,
-                  &params->rect_ll_, &params->sub_frame_ll_)) {
-    return 0;
-  }
-  // Lossy frame rectangle.
-  params->rect_lossy_ = params->rect_ll_;  // seed with lossless rect.
-  return GetSubRect(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                    params->empty_rect_allowed_, 0, quality,
-                    &params->rect_lossy_, &params->sub_frame_lossy_);
+  FrameRectangle sub_rects[2];
+  if (rects != NULL) {
+    sub_rects[0] = rects[0];
+    sub_rects[1] = rects[1];
+  } else {
+    ComputeSubRects(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
+                    params->empty_rect_allowed_, quality, sub_rects);
+  }
+  params->rect_ll_ = sub_rects[0];
+  params->rect_lossy_ = sub_rects[1];
+  return GetSubFrame(curr_canvas, &params->rect_ll_, &params->sub_frame_ll_) &&
+         GetSubFrame(curr_canvas, &params->rect_lossy_,
+                     &params->sub_frame_lossy_);
 }
 
 static WEBP_INLINE int clip(int v, int min_v, int max_v) {
@@ -607,6 +632,7 @@ int WebPAnimEncoderRefineRect(
   rect.y_offset_ = top;
   rect.width_ = clip(right - left, 0, curr_canvas->width - rect.x_offset_);
   rect.height_ = clip(bottom - top, 0, curr_canvas->height - rect.y_offset_);
+  WebPAnimEncDspInit();
   MinimizeChangeRectangle(prev_canvas, curr_canvas, &rect, is_lossless,
                           quality);
   SnapToEvenOffsets(&rect);
@@ -633,20 +659,16 @@ static uint32_t RectArea(const FrameRectangle* const rect) {
 static int IsLosslessBlendingPossible(const WebPPicture* const src,
                                       const WebPPicture* const dst,
                                       const FrameRectangle* const rect) {
-  int i, j;
+  int j;
   assert(src->width == dst->width && src->height == dst->height);
   assert(rect->x_offset_ + rect->width_ <= dst->width);
   assert(rect->y_offset_ + rect->height_ <= dst->height);
   for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
-      const uint32_t src_pixel = src->argb[j * src->argb_stride + i];
-      const uint32_t dst_pixel = dst->argb[j * dst->argb_stride + i];
-      const uint32_t dst_alpha = dst_pixel >> 24;
-      if (dst_alpha != 0xff && src_pixel != dst_pixel) {
-        // In this case, if we use blending, we can't attain the desired
-        // 'dst_pixel' value for this pixel. So, blending is not possible.
-        return 0;
-      }
+    if (!WebPAnimIsLosslessBlendingPossible(
+            &src->argb[j * src->argb_stride + rect->x_offset_],
+            &dst->argb[j * dst->argb_stride + rect->x_offset_], rect->width_,
+            0)) {
+      return 0;
     }
   }
   return 1;
@@ -657,21 +679,16 @@ static int IsLossyBlendingPossible(const WebPPicture* const src,
                                    const FrameRectangle* const rect,
                                    float quality) {
   const int max_allowed_diff_lossy = QualityToMaxDiff(quality);
-  int i, j;
+  int j;
   assert(src->width == dst->width && src->height == dst->height);
   assert(rect->x_offset_ + rect->width_ <= dst->width);
   assert(rect->y_offset_ + rect->height_ <= dst->height);
   for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
-      const uint32_t src_pixel = src->argb[j * src->argb_stride + i];
-      const uint32_t dst_pixel = dst->argb[j * dst->argb_stride + i];
-      const uint32_t dst_alpha = dst_pixel >> 24;
-      if (dst_alpha != 0xff &&
-          !PixelsAreSimilar(src_pixel, dst_pixel, max_allowed_diff_lossy)) {
-        // In this case, if we use blending, we can't attain the desired
-        // 'dst_pixel' value for this pixel. So, blending is not possible.
-        return 0;
-      }
+    if (!WebPAnimIsLossyBlendingPossible(
+            &src->argb[j * src->argb_stride + rect->x_offset_],
+            &dst->argb[j * dst->argb_stride + rect->x_offset_], rect->width_,
+            max_allowed_diff_lossy)) {
+      return 0;
     }
   }
   return 1;
@@ -683,19 +700,14 @@ static int IsLossyBlendingPossible(const WebPPicture* const src,
 static int IncreaseTransparency(const WebPPicture* const src,
                                 const FrameRectangle* const rect,
                                 WebPPicture* const dst) {
-  int i, j;
+  int j;
   int modified = 0;
   assert(src != NULL && dst != NULL && rect != NULL);
   assert(src->width == dst->width && src->height == dst->height);
   for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
-    const uint32_t* const psrc = src->argb + j * src->argb_stride;
-    uint32_t* const pdst = dst->argb + j * dst->argb_stride;
-    for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
-      if (psrc[i] == pdst[i] && pdst[i] != TRANSPARENT_COLOR) {
-        pdst[i] = TRANSPARENT_COLOR;
-        modified = 1;
-      }
-    }
+    modified |= WebPAnimIncreaseTransparency(
+        &src->argb[j * src->argb_stride + rect->x_offset_],
+        &dst->argb[j * dst->argb_stride + rect->x_offset_], rect->width_);
   }
   return modified;
 }
@@ -712,7 +724,7 @@ static int FlattenSimilarBlocks(const WebPPicture* const src,
   const int max_allowed_diff_lossy = QualityToMaxDiff(quality);
   int i, j;
   int modified = 0;
-  const int block_size = 8;
+  const int block_size = 8;   // as processed by WebPAnimFlattenSimilarBlock()
   const int y_start = (rect->y_offset_ + block_size) & ~(block_size - 1);
   const int y_end = (rect->y_offset_ + rect->height_) & ~(block_size - 1);
   const int x_start = (rect->x_offset_ + block_size) & ~(block_size - 1);
@@ -720,53 +732,27 @@ static int FlattenSimilarBlocks(const WebPPicture* const src,
   assert(src != NULL && dst != NULL && rect != NULL);
   assert(src->width == dst->width && src->height == dst->height);
   assert((block_size & (block_size - 1)) == 0);  // must be a power of 2
-  // Iterate over each block and count similar pixels.
+  // Iterate over each block.
   for (j = y_start; j < y_end; j += block_size) {
     for (i = x_start; i < x_end; i += block_size) {
-      int cnt = 0;
-      int avg_r = 0, avg_g = 0, avg_b = 0;
-      int x, y;
-      const uint32_t* const psrc = src->argb + j * src->argb_stride + i;
-      uint32_t* const pdst = dst->argb + j * dst->argb_stride + i;
-      for (y = 0; y < block_size; ++y) {
-        for (x = 0; x < block_size; ++x) {
-          const uint32_t src_pixel = psrc[x + y * src->argb_stride];
-          const int alpha = src_pixel >> 24;
-          if (alpha == 0xff &&
-              PixelsAreSimilar(src_pixel, pdst[x + y * dst->argb_stride],
-                               max_allowed_diff_lossy)) {
-            ++cnt;
-            avg_r += (src_pixel >> 16) & 0xff;
-            avg_g += (src_pixel >> 8) & 0xff;
-            avg_b += (src_pixel >> 0) & 0xff;
-          }
-        }
-      }
       // If we have a fully similar block, we replace it with an
       // average transparent block. This compresses better in lossy mode.
-      if (cnt == block_size * block_size) {
-        const uint32_t color = (0x00          << 24) |
-                               ((avg_r / cnt) << 16) |
-                               ((avg_g / cnt) <<  8) |
-                               ((avg_b / cnt) <<  0);
-        for (y = 0; y < block_size; ++y) {
-          for (x = 0; x < block_size; ++x) {
-            pdst[x + y * dst->argb_stride] = color;
-          }
-        }
-        modified = 1;
-      }
+      modified |= WebPAnimFlattenSimilarBlock(
+          src->argb + j * src->argb_stride + i, src->argb_stride,
+          dst->argb + j * dst->argb_stride + i, dst->argb_stride,
+          max_allowed_diff_lossy);
     }
   }
   return modified;
 }
 
 static int EncodeFrame(const WebPConfig* const config, WebPPicture* const pic,
+                       WebPEncoderSession* const session,
                        WebPMemoryWriter* const memory) {
   pic->use_argb = 1;
   pic->writer = WebPMemoryWrite;
   pic->custom_ptr = memory;
-  if (!WebPEncode(config, pic)) {
+  if (!WebPEncodeWithSession(session, config, pic)) {
     return 0;
   }
   return 1;
@@ -778,16 +764,21 @@ typedef struct {
   WebPMuxFrameInfo  info_;
   FrameRectangle    rect_;
   int               evaluate_;  // True if this candidate should be evaluated.
+
+  // Encoding job, possibly run on a worker thread.
+  int               pending_;   // True if 'sub_frame_' is yet to be encoded.
+  WebPPicture       sub_frame_;   // Own copy of the sub-frame pixels.
+  WebPConfig        config_;
+  WebPEncodingError error_code_;
 } Candidate;
 
-// Generates a candidate encoded frame given a picture and metadata.
-static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
-                                         const FrameRectangle* const rect,
-                                         const WebPConfig* const encoder_config,
-                                         int use_blending,
-                                         Candidate* const candidate) {
-  WebPConfig config = *encoder_config;
-  WebPEncodingError error_code = VP8_ENC_OK;
+// Sets up a candidate given a picture and metadata. The pixels of 'sub_frame'
+// are copied, so that the canvas can be modified for the next candidates
+// before this one is encoded by EncodeCandidate().
+static WebPEncodingError PrepareCandidate(
+    const WebPPicture* const sub_frame, const FrameRectangle* const rect,
+    const WebPConfig* const encoder_config, int use_blending,
+    Candidate* const candidate) {
   assert(candidate != NULL);
   memset(candidate, 0, sizeof(*candidate));
 
@@ -801,26 +792,92 @@ static WebPEncodingError EncodeCandidate(WebPPicture* const sub_frame,
       use_blending ? WEBP_MUX_BLEND : WEBP_MUX_NO_BLEND;
   candidate->info_.duration = 0;  // Set in next call to WebPAnimEncoderAdd().
 
-  // Encode picture.
-  WebPMemoryWriterInit(&candidate->mem_);
-
-  if (!config.lossless && use_blending) {
+  candidate->config_ = *encoder_config;
+  if (!candidate->config_.lossless && use_blending) {
     // Disable filtering to avoid blockiness in reconstructed frames at the
     // time of decoding.
-    config.autofilter = 0;
-    config.filter_strength = 0;
+    candidate->config_.autofilter = 0;
+    candidate->config_.filter_strength = 0;
   }
-  if (!EncodeFrame(&config, sub_frame, &candidate->mem_)) {
-    error_code = sub_frame->error_code;
-    goto Err;
+  if (!WebPPictureCopy(sub_frame, &candidate->sub_frame_)) {
+    return VP8_ENC_ERROR_OUT_OF_MEMORY;
   }
+  candidate->pending_ = 1;
+  return VP8_ENC_OK;
+}
 
-  candidate->evaluate_ = 1;
-  return error_code;
+// Generates the candidate encoded frame set up by PrepareCandidate().
+static void EncodeCandidate(Candidate* const candidate,
+                            WebPEncoderSession* const session) {
+  assert(candidate->pending_);
+  WebPMemoryWriterInit(&candidate->mem_);
+  if (EncodeFrame(&candidate->config_, &candidate->sub_frame_, session,
+                  &candidate->mem_)) {
+    candidate->error_code_ = VP8_ENC_OK;
+    candidate->evaluate_ = 1;
+  } else {
+    candidate->error_code_ = candidate->sub_frame_.error_code;
+    WebPMemoryWriterClear(&candidate->mem_);
+  }
+  WebPPictureFree(&candidate->sub_frame_);
+  candidate->pending_ = 0;
+}
 
- Err:
-  WebPMemoryWriterClear(&candidate->mem_);
-  return error_code;
+static int EncodeCandidateHook(void* arg1, void* arg2) {
+  EncodeCandidate((Candidate*)arg1, (WebPEncoderSession*)arg2);
+  return 1;   // errors are reported through 'error_code_'
+}
+
+// Encodes all the pending candidates, concurrently if 'use_threads' is true.
+// Returns the first error, in the order the candidates were generated.
+static WebPEncodingError EncodeCandidates(WebPAnimEncoder* const enc,
+                                          Candidate candidates[CANDIDATE_COUNT],
+                                          int use_threads) {
+  static const int kOrder[CANDIDATE_COUNT] = {
+    LL_DISP_NONE, LOSSY_DISP_NONE, LL_DISP_BG, LOSSY_DISP_BG
+  };
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  int num_pending = 0;
+  int num_workers = 0;
+  int i;
+  for (i = 0; i < CANDIDATE_COUNT; ++i) num_pending += candidates[i].pending_;
+  for (i = 0; i < CANDIDATE_COUNT; ++i) {
+    Candidate* const candidate = &candidates[i];
+    if (!candidate->pending_) continue;
+    if (use_threads && --num_pending > 0) {
+      WebPWorker* const worker = &enc->candidate_workers_[num_workers];
+      if (winterface->Reset(worker)) {
+        worker->hook = EncodeCandidateHook;
+        worker->data1 = candidate;
+        worker->data2 = enc->sessions_[i];
+        winterface->Launch(worker);
+        ++num_workers;
+        continue;
+      }
+    }
+    EncodeCandidate(candidate, enc->sessions_[i]);
+  }
+  for (i = 0; i < num_workers; ++i) {
+    winterface->Sync(&enc->candidate_workers_[i]);
+  }
+  for (i = 0; i < CANDIDATE_COUNT; ++i) {
+    const Candidate* const candidate = &candidates[kOrder[i]];
+    if (candidate->error_code_ != VP8_ENC_OK) return candidate->error_code_;
+  }
+  return VP8_ENC_OK;
+}
+
+// Makes the fully transparent pixels of 'rect' transparent black, as the
+// lossless encoder does on its input when 'exact' is off.
+static void ReplaceTransparentPixels(const FrameRectangle* const rect,
+                                     WebPPicture* const pic) {
+  int i, j;
+  for (j = rect->y_offset_; j < rect->y_offset_ + rect->height_; ++j) {
+    uint32_t* const argb = pic->argb + j * pic->argb_stride;
+    for (i = rect->x_offset_; i < rect->x_offset_ + rect->width_; ++i) {
+      if ((argb[i] >> 24) == 0) argb[i] = 0;
+    }
+  }
 }
 
 static void CopyCurrentCanvas(WebPAnimEncoder* const enc) {
@@ -832,19 +889,11 @@ static void CopyCurrentCanvas(WebPAnimEncoder* const enc) {
   }
 }
 
-enum {
-  LL_DISP_NONE = 0,
-  LL_DISP_BG,
-  LOSSY_DISP_NONE,
-  LOSSY_DISP_BG,
-  CANDIDATE_COUNT
-};
-
 #define MIN_COLORS_LOSSY     31  // Don't try lossy below this threshold.
 #define MAX_COLORS_LOSSLESS 194  // Don't try lossless above this threshold.
 
-// Generates candidates for a given dispose method given pre-filled sub-frame
-// 'params'.
+// Sets up the candidates for a given dispose method given pre-filled sub-frame
+// 'params'. They're encoded afterward by EncodeCandidates().
 static WebPEncodingError GenerateCandidates(
     WebPAnimEncoder* const enc, Candidate candidates[CANDIDATE_COUNT],
     WebPMuxAnimDispose dispose_method, int is_lossless, int is_key_frame,
@@ -892,9 +941,13 @@ static WebPEncodingError GenerateCandidates(
       enc->curr_canvas_copy_modified_ =
           IncreaseTransparency(prev_canvas, &params->rect_ll_, curr_canvas);
     }
-    error_code = EncodeCandidate(&params->sub_frame_ll_, &params->rect_ll_,
-                                 config_ll, use_blending_ll, candidate_ll);
+    error_code = PrepareCandidate(&params->sub_frame_ll_, &params->rect_ll_,
+                                  config_ll, use_blending_ll, candidate_ll);
     if (error_code != VP8_ENC_OK) return error_code;
+    // The next candidates used to see the canvas as left by the encoder.
+    if (!config_ll->exact) {
+      ReplaceTransparentPixels(&params->rect_ll_, curr_canvas);
+    }
   }
   if (evaluate_lossy) {
     CopyCurrentCanvas(enc);
@@ -904,8 +957,8 @@ static WebPEncodingError GenerateCandidates(
                                config_lossy->quality);
     }
     error_code =
-        EncodeCandidate(&params->sub_frame_lossy_, &params->rect_lossy_,
-                        config_lossy, use_blending_lossy, candidate_lossy);
+        PrepareCandidate(&params->sub_frame_lossy_, &params->rect_lossy_,
+                         config_lossy, use_blending_lossy, candidate_lossy);
     if (error_code != VP8_ENC_OK) return error_code;
     enc->curr_canvas_copy_modified_ = 1;
   }
@@ -1053,9 +1106,12 @@ static void PickBestCandidate(WebPAnimEncoder* const enc,
 // (lossy/lossless), dispose methods, blending methods etc to encode the current
 // frame and outputs the best one in 'encoded_frame'.
 // 'frame_skipped' will be set to true if this frame should actually be skipped.
+// If not NULL, 'rects' are the frame rectangles assuming the previous frame was
+// DISPOSE_NONE, computed beforehand.
 static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
                                   const WebPConfig* const config,
                                   int is_key_frame,
+                                  const FrameRectangle* const rects,
                                   EncodedFrame* const encoded_frame,
                                   int* const frame_skipped) {
   int i;
@@ -1067,6 +1123,14 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
   const int consider_lossless = is_lossless || enc->options_.allow_mixed;
   const int consider_lossy = !is_lossless || enc->options_.allow_mixed;
   const int is_first_frame = enc->is_first_frame_;
+  // The candidates are encoded concurrently unless the progress hook, which
+  // may not expect to be called from several threads at once, is set.
+#ifdef WEBP_USE_THREAD
+  const int use_threads =
+      (config->thread_level > 0 && curr_canvas->progress_hook == NULL);
+#else
+  const int use_threads = 0;
+#endif
 
   // First frame cannot be skipped as there is no 'previous frame' to merge it
   // to. So, empty rectangle is not allowed for the first frame.
@@ -1107,7 +1171,7 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
 
   // Change-rectangle assuming previous frame was DISPOSE_NONE.
   if (!GetSubRects(prev_canvas, curr_canvas, is_key_frame, is_first_frame,
-                   config_lossy.quality, &dispose_none_params)) {
+                   config_lossy.quality, rects, &dispose_none_params)) {
     error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
     goto Err;
   }
@@ -1129,7 +1193,7 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
                           prev_canvas_disposed);
 
     if (!GetSubRects(prev_canvas_disposed, curr_canvas, is_key_frame,
-                     is_first_frame, config_lossy.quality,
+                     is_first_frame, config_lossy.quality, NULL,
                      &dispose_bg_params)) {
       error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
       goto Err;
@@ -1167,12 +1231,18 @@ static WebPEncodingError SetFrame(WebPAnimEncoder* const enc,
     if (error_code != VP8_ENC_OK) goto Err;
   }
 
+  error_code = EncodeCandidates(enc, candidates, use_threads);
+  if (error_code != VP8_ENC_OK) goto Err;
+
   PickBestCandidate(enc, candidates, is_key_frame, encoded_frame);
 
   goto End;
 
  Err:
   for (i = 0; i < CANDIDATE_COUNT; ++i) {
+    if (candidates[i].pending_) {
+      WebPPictureFree(&candidates[i].sub_frame_);
+    }
     if (candidates[i].evaluate_) {
       WebPMemoryWriterClear(&candidates[i].mem_);
     }
@@ -1191,8 +1261,10 @@ static int64_t KeyFramePenalty(const EncodedFrame* const encoded_frame) {
           encoded_frame->sub_frame_.bitstream.size);
 }
 
+// 'rects' (if not NULL) are passed to the first call to SetFrame().
 static int CacheFrame(WebPAnimEncoder* const enc,
-                      const WebPConfig* const config) {
+                      const WebPConfig* const config,
+                      const FrameRectangle* const rects) {
   int ok = 0;
   int frame_skipped = 0;
   WebPEncodingError error_code = VP8_ENC_OK;
@@ -1202,7 +1274,8 @@ static int CacheFrame(WebPAnimEncoder* const enc,
   ++enc->count_;
 
   if (enc->is_first_frame_) {  // Add this as a key-frame.
-    error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
+    error_code =
+        SetFrame(enc, config, 1, rects, encoded_frame, &frame_skipped);
     if (error_code != VP8_ENC_OK) goto End;
     assert(frame_skipped == 0);  // First frame can't be skipped, even if empty.
     assert(position == 0 && enc->count_ == 1);
@@ -1214,7 +1287,8 @@ static int CacheFrame(WebPAnimEncoder* const enc,
     ++enc->count_since_key_frame_;
     if (enc->count_since_key_frame_ <= enc->options_.kmin) {
       // Add this as a frame rectangle.
-      error_code = SetFrame(enc, config, 0, encoded_frame, &frame_skipped);
+      error_code =
+          SetFrame(enc, config, 0, rects, encoded_frame, &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       if (frame_skipped) goto Skip;
       encoded_frame->is_key_frame_ = 0;
@@ -1225,14 +1299,16 @@ static int CacheFrame(WebPAnimEncoder* const enc,
       FrameRectangle prev_rect_key, prev_rect_sub;
 
       // Add this as a frame rectangle to enc.
-      error_code = SetFrame(enc, config, 0, encoded_frame, &frame_skipped);
+      error_code =
+          SetFrame(enc, config, 0, rects, encoded_frame, &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       if (frame_skipped) goto Skip;
       prev_rect_sub = enc->prev_rect_;
 
 
       // Add this as a key-frame to enc, too.
-      error_code = SetFrame(enc, config, 1, encoded_frame, &frame_skipped);
+      error_code =
+          SetFrame(enc, config, 1, NULL, encoded_frame, &frame_skipped);
       if (error_code != VP8_ENC_OK) goto End;
       assert(frame_skipped == 0);  // Key-frame cannot be an empty rectangle.
       prev_rect_key = enc->prev_rect_;
@@ -1332,16 +1408,10 @@ static int FlushFrames(WebPAnimEncoder* const enc) {
 #undef DELTA_INFINITY
 #undef KEYFRAME_NONE
 
-int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
-                       const WebPConfig* encoder_config) {
-  WebPConfig config;
-  int ok;
-
-  if (enc == NULL) {
-    return 0;
-  }
-  MarkNoError(enc);
-
+// Checks the timestamp of the frame being added (NULL for the last call), and
+// sets the duration of the previous frame accordingly.
+static int AddTimestamp(WebPAnimEncoder* const enc, WebPPicture* const frame,
+                        int timestamp) {
   if (!enc->is_first_frame_) {
     // Make sure timestamps are non-decreasing (integer wrap-around is OK).
     const uint32_t prev_frame_duration =
@@ -1365,13 +1435,28 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
   } else {
     enc->first_timestamp_ = timestamp;
   }
+  return 1;
+}
 
-  if (frame == NULL) {  // Special: last call.
-    enc->got_null_frame_ = 1;
-    enc->prev_timestamp_ = timestamp;
-    return 1;
+// Sets 'config' from 'encoder_config', or to the defaults if it's NULL.
+// Returns false if 'encoder_config' is invalid.
+static int GetFrameConfig(const WebPConfig* const encoder_config,
+                          WebPConfig* const config) {
+  if (encoder_config != NULL) {
+    if (!WebPValidateConfig(encoder_config)) return 0;
+    *config = *encoder_config;
+  } else {
+    WebPConfigInit(config);
+    config->lossless = 1;
   }
+  return 1;
+}
 
+// Checks 'frame' and converts it to ARGB if needed. Sets 'config' as
+// GetFrameConfig() does.
+static int PrepareFrame(WebPAnimEncoder* const enc, WebPPicture* const frame,
+                        const WebPConfig* const encoder_config,
+                        WebPConfig* const config) {
   if (frame->width != enc->canvas_width_ ||
       frame->height != enc->canvas_height_) {
     frame->error_code = VP8_ENC_ERROR_INVALID_CONFIGURATION;
@@ -1390,22 +1475,24 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
     }
   }
 
-  if (encoder_config != NULL) {
-    if (!WebPValidateConfig(encoder_config)) {
-      MarkError(enc, "ERROR adding frame: Invalid WebPConfig");
-      return 0;
-    }
-    config = *encoder_config;
-  } else {
-    WebPConfigInit(&config);
-    config.lossless = 1;
+  if (!GetFrameConfig(encoder_config, config)) {
+    MarkError(enc, "ERROR adding frame: Invalid WebPConfig");
+    return 0;
   }
+  return 1;
+}
+
+// Encodes the prepared 'frame' and flushes the frames that are final.
+static int AddFrame(WebPAnimEncoder* const enc, WebPPicture* const frame,
+                    int timestamp, const WebPConfig* const config,
+                    const FrameRectangle* const rects) {
+  int ok;
   assert(enc->curr_canvas_ == NULL);
   enc->curr_canvas_ = frame;  // Store reference.
   assert(enc->curr_canvas_copy_modified_ == 1);
   CopyCurrentCanvas(enc);
 
-  ok = CacheFrame(enc, &config) && FlushFrames(enc);
+  ok = CacheFrame(enc, config, rects) && FlushFrames(enc);
 
   enc->curr_canvas_ = NULL;
   enc->curr_canvas_copy_modified_ = 1;
@@ -1415,6 +1502,137 @@ int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
   return ok;
 }
 
+//------------------------------------------------------------------------------
+// Asynchronous frame addition (options_.use_threads).
+//
+// The frames are encoded in order on 'add_worker_', from a copy. Meanwhile,
+// WebPAnimEncoderAdd() computes the change-rectangles of the next frame against
+// 'ref_frame_', the last frame which wasn't skipped: this is exactly what
+// SetFrame() would compute first against 'prev_canvas_'.
+
+// Returns true if the frames can be handed over to the worker.
+static int UseAsyncAdd(const WebPAnimEncoder* const enc) {
+  return (enc->add_frame_.argb != NULL);
+}
+
+static int AddFrameHook(void* arg1, void* arg2) {
+  WebPAnimEncoder* const enc = (WebPAnimEncoder*)arg1;
+  (void)arg2;
+  enc->add_ok_ = AddFrame(enc, &enc->add_frame_, enc->add_timestamp_,
+                          &enc->add_config_, enc->add_rects_);
+  return 1;   // errors are reported through 'add_ok_'
+}
+
+// Waits for the frame being encoded. Returns false if it failed, or if any
+// previous one did: the frames analyzed since then don't match the state of
+// the encoder anymore.
+static int SyncAddFrame(WebPAnimEncoder* const enc) {
+  if (UseAsyncAdd(enc)) {
+    WebPGetWorkerInterface()->Sync(&enc->add_worker_);
+  }
+  return enc->add_ok_;
+}
+
+// Computes the change-rectangles of 'frame' for the first call to SetFrame().
+// The first frame is a key-frame, which can't be skipped.
+static void AnalyzeFrame(const WebPAnimEncoder* const enc,
+                         const WebPPicture* const frame,
+                         const WebPConfig* const config,
+                         FrameRectangle rects[2]) {
+  const int is_first_frame = (enc->analyzed_count_ == 0);
+  ComputeSubRects(&enc->ref_frame_, frame, is_first_frame, is_first_frame,
+                  !is_first_frame, config->quality, rects);
+}
+
+// Updates 'ref_frame_' once 'frame' is added, unless SetFrame() will skip it.
+static void UpdateRefFrame(WebPAnimEncoder* const enc,
+                           const WebPPicture* const frame,
+                           const WebPConfig* const config,
+                           const FrameRectangle rects[2]) {
+  const int consider_lossless = config->lossless || enc->options_.allow_mixed;
+  const int consider_lossy = !config->lossless || enc->options_.allow_mixed;
+  if (enc->analyzed_count_ == 0 ||
+      !((consider_lossless && IsEmptyRect(&rects[0])) ||
+        (consider_lossy && IsEmptyRect(&rects[1])))) {
+    WebPCopyPixels(frame, &enc->ref_frame_);
+  }
+  ++enc->analyzed_count_;
+}
+
+static int AddFrameAsync(WebPAnimEncoder* const enc, WebPPicture* const frame,
+                         int timestamp,
+                         const WebPConfig* const encoder_config) {
+  WebPConfig config;
+  FrameRectangle rects[2];
+  int can_analyze;
+
+  if (frame == NULL) {  // Special: last call.
+    if (!SyncAddFrame(enc)) return 0;
+    MarkNoError(enc);
+    if (!AddTimestamp(enc, NULL, timestamp)) return 0;
+    enc->got_null_frame_ = 1;
+    enc->prev_timestamp_ = timestamp;
+    return 1;
+  }
+
+  // Analyze the frame while the previous one is being encoded, if it's known
+  // to be valid without reporting any error (which would need the worker).
+  can_analyze = (frame->width == enc->canvas_width_ &&
+                 frame->height == enc->canvas_height_ && frame->use_argb &&
+                 GetFrameConfig(encoder_config, &config));
+  if (can_analyze) AnalyzeFrame(enc, frame, &config, rects);
+
+  if (!SyncAddFrame(enc)) {
+    frame->error_code = enc->add_frame_.error_code;
+    return 0;
+  }
+  MarkNoError(enc);
+  if (!AddTimestamp(enc, frame, timestamp)) return 0;
+  if (!PrepareFrame(enc, frame, encoder_config, &config)) return 0;
+  if (!can_analyze) AnalyzeFrame(enc, frame, &config, rects);
+  UpdateRefFrame(enc, frame, &config, rects);
+
+  // Encode the frame from our copy. Its errors are reported by the next call.
+  frame->error_code = VP8_ENC_OK;
+  WebPCopyPixels(frame, &enc->add_frame_);
+  enc->add_timestamp_ = timestamp;
+  enc->add_config_ = config;
+  enc->add_rects_[0] = rects[0];
+  enc->add_rects_[1] = rects[1];
+  enc->add_worker_.hook = AddFrameHook;
+  enc->add_worker_.data1 = enc;
+  WebPGetWorkerInterface()->Launch(&enc->add_worker_);
+  return 1;
+}
+
+int WebPAnimEncoderAdd(WebPAnimEncoder* enc, WebPPicture* frame, int timestamp,
+                       const WebPConfig* encoder_config) {
+  WebPConfig config;
+
+  if (enc == NULL) {
+    return 0;
+  }
+  if (UseAsyncAdd(enc)) {
+    return AddFrameAsync(enc, frame, timestamp, encoder_config);
+  }
+  MarkNoError(enc);
+
+  if (!AddTimestamp(enc, frame, timestamp)) {
+    return 0;
+  }
+
+  if (frame == NULL) {  // Special: last call.
+    enc->got_null_frame_ = 1;
+    enc->prev_timestamp_ = timestamp;
+    return 1;
+  }
+
+  if (!PrepareFrame(enc, frame, encoder_config, &config)) {
+    return 0;
+  }
+  return AddFrame(enc, frame, timestamp, &config, NULL);
+}
+
 // -----------------------------------------------------------------------------
 // Bitstream assembly.
 
@@ -1449,16 +1667,21 @@ static int FrameToFullCanvas(WebPAnimEncoder* const enc,
                              const WebPMuxFrameInfo* const frame,
                              WebPData* const full_image) {
   WebPPicture* const canvas_buf = &enc->curr_canvas_copy_;
+  // No candidate is being encoded at this point.
+  WebPEncoderSession* const session = enc->sessions_[0];
   WebPMemoryWriter mem1, mem2;
   WebPMemoryWriterInit(&mem1);
   WebPMemoryWriterInit(&mem2);
 
   if (!DecodeFrameOntoCanvas(frame, canvas_buf)) goto Err;
-  if (!EncodeFrame(&enc->last_config_, canvas_buf, &mem1)) goto Err;
+  if (!EncodeFrame(&enc->last_config_, canvas_buf, session, &mem1)) goto Err;
   GetEncodedData(&mem1, full_image);
 
   if (enc->options_.allow_mixed) {
-    if (!EncodeFrame(&enc->last_config_reversed_, canvas_buf, &mem2)) goto Err;
+    if (!EncodeFrame(&enc->last_config_reversed_, canvas_buf, session,
+                     &mem2)) {
+      goto Err;
+    }
     if (mem2.size < mem1.size) {
       GetEncodedData(&mem2, full_image);
       WebPMemoryWriterClear(&mem1);
@@ -1526,6 +1749,9 @@ int WebPAnimEncoderAssemble(WebPAnimEncoder* enc, WebPData* webp_data) {
   if (enc == NULL) {
     return 0;
   }
+  if (!SyncAddFrame(enc)) {
+    return 0;
+  }
   MarkNoError(enc);
 
   if (webp_data == NULL) {
@@ -1579,6 +1805,7 @@ int WebPAnimEncoderAssemble(WebPAnimEncoder* enc, WebPData* webp_data) {
 
 const char* WebPAnimEncoderGetError(WebPAnimEncoder* enc) {
   if (enc == NULL) return NULL;
+  SyncAddFrame(enc);   // the error may come from the frame being encoded
   return enc->error_str_;
 }
 
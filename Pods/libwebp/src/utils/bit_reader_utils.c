@@ -18,6 +18,34 @@
 #include "src/utils/bit_reader_inl_utils.h"
 #include "src/utils/utils.h"
 
+//------------------------------------------------------------------------------
+// Scattered input
+
+// Finds the data of 'input' from offset 'pos' on, up to 'end_pos' (excluded),
+// within the segment '*seg' or the following ones. Returns false if this data
+// wasn't received yet, or if 'pos' is past 'end_pos'.
+static int FindSegmentData(const VP8InputSegments* const input, int* const seg,
+                           size_t pos, size_t end_pos,
+                           const uint8_t** const data, size_t* const size) {
+  int i;
+  if (pos >= end_pos) return 0;
+  for (i = *seg; i < input->num_segments_; ++i) {
+    const VP8InputSegment* const s = &input->segments_[i];
+    const size_t s_end = s->pos_ + s->size_;
+    if (pos < s_end) {
+      assert(pos >= s->pos_);   // segments are contiguous in the input
+      *seg = i;
+      *data = s->buf_ + (pos - s->pos_);
+      *size = ((s_end < end_pos) ? s_end : end_pos) - pos;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Buffer of the bit-readers waiting for their first segment.
+static const uint8_t kNoData[1] = { 0 };
+
 //------------------------------------------------------------------------------
 // VP8BitReader
 
@@ -40,10 +68,39 @@ void VP8InitBitReader(VP8BitReader* const br,
   br->value_   = 0;
   br->bits_    = -8;   // to load the very first 8bits
   br->eof_     = 0;
+  br->input_   = NULL;
   VP8BitReaderSetBuffer(br, start, size);
   VP8LoadNewBytes(br);
 }
 
+void VP8InitBitReaderSegments(VP8BitReader* const br,
+                              const VP8InputSegments* const input,
+                              size_t pos, size_t size) {
+  assert(br != NULL);
+  assert(input != NULL);
+  assert(size < (1u << 31));   // limit ensured by format and upstream checks
+  br->range_    = 255 - 1;
+  br->value_    = 0;
+  br->bits_     = -8;   // the first 8bits will be loaded by the first read
+  br->eof_      = 0;
+  br->input_    = input;
+  br->seg_      = 0;
+  br->next_pos_ = pos;
+  br->end_pos_  = pos + size;
+  VP8BitReaderSetBuffer(br, kNoData, 0);
+}
+
+// Moves to the next part of the scattered input, if it was received.
+static void NextSegment(VP8BitReader* const br) {
+  const uint8_t* data;
+  size_t size;
+  if (FindSegmentData(br->input_, &br->seg_, br->next_pos_, br->end_pos_,
+                      &data, &size)) {
+    VP8BitReaderSetBuffer(br, data, size);
+    br->next_pos_ += size;
+  }
+}
+
 void VP8RemapBitReader(VP8BitReader* const br, ptrdiff_t offset) {
   if (br->buf_ != NULL) {
     br->buf_ += offset;
@@ -86,6 +143,9 @@ const uint8_t kVP8NewRange[128] = {
 
 void VP8LoadFinalBytes(VP8BitReader* const br) {
   assert(br != NULL && br->buf_ != NULL);
+  if (br->buf_ == br->buf_end_ && br->input_ != NULL) {
+    NextSegment(br);
+  }
   // Only read 8bits at a time
   if (br->buf_ < br->buf_end_) {
     br->bits_ += 8;
@@ -159,6 +219,7 @@ void VP8LInitBitReader(VP8LBitReader* const br, const uint8_t* const start,
   br->val_ = value;
   br->pos_ = length;
   br->buf_ = start;
+  br->input_ = NULL;
 }
 
 void VP8LBitReaderSetBuffer(VP8LBitReader* const br,
@@ -177,9 +238,25 @@ static void VP8LSetEndOfStream(VP8LBitReader* const br) {
   br->bit_pos_ = 0;  // To avoid undefined behaviour with shifts.
 }
 
+// Moves to the next part of the scattered input, if it was received.
+static int NextLSegment(VP8LBitReader* const br) {
+  const uint8_t* data;
+  size_t size;
+  if (br->input_ == NULL ||
+      !FindSegmentData(br->input_, &br->seg_, br->next_pos_, br->end_pos_,
+                       &data, &size)) {
+    return 0;
+  }
+  br->buf_ = data;
+  br->len_ = size;
+  br->pos_ = 0;
+  br->next_pos_ += size;
+  return 1;
+}
+
 // If not at EOS, reload up to VP8L_LBITS byte-by-byte
 static void ShiftBytes(VP8LBitReader* const br) {
-  while (br->bit_pos_ >= 8 && br->pos_ < br->len_) {
+  while (br->bit_pos_ >= 8 && (br->pos_ < br->len_ || NextLSegment(br))) {
     br->val_ >>= 8;
     br->val_ |= ((vp8l_val_t)br->buf_[br->pos_]) << (VP8L_LBITS - 8);
     ++br->pos_;
@@ -190,6 +267,25 @@ static void ShiftBytes(VP8LBitReader* const br) {
   }
 }
 
+void VP8LInitBitReaderSegments(VP8LBitReader* const br,
+                               const VP8InputSegments* const input,
+                               size_t pos, size_t length) {
+  assert(br != NULL);
+  assert(input != NULL);
+  assert(length < 0xfffffff8u);   // can't happen with a RIFF chunk.
+  br->val_ = 0;
+  br->buf_ = kNoData;
+  br->len_ = 0;
+  br->pos_ = 0;
+  br->bit_pos_ = VP8L_LBITS;   // nothing pre-fetched yet
+  br->eos_ = 0;
+  br->input_ = input;
+  br->seg_ = 0;
+  br->next_pos_ = pos;
+  br->end_pos_ = pos + length;
+  ShiftBytes(br);
+}
+
 void VP8LDoFillBitWindow(VP8LBitReader* const br) {
   assert(br->bit_pos_ >= VP8L_WBITS);
 #if defined(VP8L_USE_FAST_LOAD)
@@ -85,6 +85,24 @@ typedef uint32_t bit_t;
 
 typedef uint32_t range_t;
 
+//------------------------------------------------------------------------------
+// Scattered input
+//
+// The input can be made of several segments of memory, which the bit-readers
+// then read in place: when the current segment is exhausted, they continue
+// with the one holding the next byte, if it was received already.
+
+typedef struct {
+  const uint8_t* buf_;        // segment data
+  size_t size_;               // segment size (not 0)
+  size_t pos_;                // offset of the segment within the input
+} VP8InputSegment;
+
+typedef struct {
+  VP8InputSegment* segments_;   // the segments received, in input order
+  int num_segments_;
+} VP8InputSegments;
+
 //------------------------------------------------------------------------------
 // Bitreader
 
@@ -99,11 +117,22 @@ struct VP8BitReader {
   const uint8_t* buf_end_;    // end of read buffer
   const uint8_t* buf_max_;    // max packed-read position on buffer
   int eof_;                   // true if input is exhausted
+  // scattered input (NULL if reading a single buffer)
+  const VP8InputSegments* input_;
+  int seg_;                   // segment holding the read buffer
+  size_t next_pos_;           // input offset of buf_end_
+  size_t end_pos_;            // input offset where reading stops
 };
 
 // Initialize the bit reader and the boolean decoder.
 void VP8InitBitReader(VP8BitReader* const br,
                       const uint8_t* const start, size_t size);
+
+// Same, to read the 'size' bytes at offset 'pos' of the scattered 'input',
+// which don't need to be received yet.
+void VP8InitBitReaderSegments(VP8BitReader* const br,
+                              const VP8InputSegments* const input,
+                              size_t pos, size_t size);
 // Sets the working read buffer.
 void VP8BitReaderSetBuffer(VP8BitReader* const br,
                            const uint8_t* const start, size_t size);
@@ -144,12 +173,23 @@ typedef struct {
   size_t         pos_;        // byte position in buf_
   int            bit_pos_;    // current bit-reading position in val_
   int            eos_;        // true if a bit was read past the end of buffer
+  // scattered input (NULL if reading a single buffer)
+  const VP8InputSegments* input_;
+  int            seg_;        // segment holding buf_
+  size_t         next_pos_;   // input offset of buf_ + len_
+  size_t         end_pos_;    // input offset where reading stops
 } VP8LBitReader;
 
 void VP8LInitBitReader(VP8LBitReader* const br,
                        const uint8_t* const start,
                        size_t length);
 
+// Same, to read the 'length' bytes at offset 'pos' of the scattered 'input',
+// which don't need to be received yet.
+void VP8LInitBitReaderSegments(VP8LBitReader* const br,
+                               const VP8InputSegments* const input,
+                               size_t pos, size_t length);
+
 //  Sets a new data buffer.
 void VP8LBitReaderSetBuffer(VP8LBitReader* const br,
                             const uint8_t* const buffer, size_t length);
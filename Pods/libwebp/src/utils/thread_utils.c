@@ -54,6 +54,7 @@ typedef struct {
   pthread_mutex_t mutex_;
   pthread_cond_t  condition_;
   pthread_t       thread_;
+  WebPMemoryArena* arena_;   // arena of the thread launching the work
 } WebPWorkerImpl;
 
 #if defined(_WIN32)
@@ -211,7 +212,9 @@ static THREADFN ThreadLoop(void* ptr) {
       pthread_cond_wait(&impl->condition_, &impl->mutex_);
     }
     if (worker->status_ == WORK) {
+      WebPMemoryArena* const arena = WebPMemoryArenaUse(impl->arena_);
       WebPGetWorkerInterface()->Execute(worker);
+      WebPMemoryArenaUse(arena);
       worker->status_ = OK;
     } else if (worker->status_ == NOT_OK) {   // finish the worker
       done = 1;
@@ -243,6 +246,7 @@ static void ChangeState(WebPWorker* const worker, WebPWorkerStatus new_status) {
     }
     // assign new status and release the working thread if needed
     if (new_status != OK) {
+      if (new_status == WORK) impl->arena_ = WebPMemoryArenaGetCurrent();
       worker->status_ = new_status;
       // Note the associated mutex does not need to be held when signaling the
       // condition. Unlocking the mutex first may improve performance in some
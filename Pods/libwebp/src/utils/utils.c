@@ -191,32 +191,292 @@ static int CheckSizeArgumentsOverflow(uint64_t nmemb, size_t size) {
   return 1;
 }
 
-void* WebPSafeMalloc(uint64_t nmemb, size_t size) {
+//------------------------------------------------------------------------------
+// Memory interface
+
+static void* DefaultMalloc(size_t size, void* opaque) {
+  (void)opaque;
+  return malloc(size);
+}
+
+static void* DefaultCalloc(size_t nmemb, size_t size, void* opaque) {
+  (void)opaque;
+  return calloc(nmemb, size);
+}
+
+static void DefaultFree(void* ptr, void* opaque) {
+  (void)opaque;
+  free(ptr);
+}
+
+static WebPMemoryInterface g_memory_interface = {
+  DefaultMalloc, DefaultCalloc, DefaultFree, NULL
+};
+
+int WebPSetMemoryInterface(const WebPMemoryInterface* const minterface) {
+  if (minterface == NULL ||
+      minterface->Malloc == NULL || minterface->Free == NULL) {
+    return 0;
+  }
+  g_memory_interface = *minterface;
+  return 1;
+}
+
+const WebPMemoryInterface* WebPGetMemoryInterface(void) {
+  return &g_memory_interface;
+}
+
+static void* InterfaceAlloc(size_t size, int clear) {
+  const WebPMemoryInterface* const mi = &g_memory_interface;
+  void* ptr;
+  if (clear && mi->Calloc != NULL) return mi->Calloc(1, size, mi->opaque);
+  ptr = mi->Malloc(size, mi->opaque);
+  if (clear && ptr != NULL) memset(ptr, 0, size);
+  return ptr;
+}
+
+static void InterfaceFree(void* const ptr) {
+  g_memory_interface.Free(ptr, g_memory_interface.opaque);
+}
+
+//------------------------------------------------------------------------------
+// Memory arena
+
+#if defined(_MSC_VER)
+#define WEBP_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define WEBP_THREAD_LOCAL __thread
+#else
+#define WEBP_THREAD_LOCAL   // no support: the arena is shared by all threads
+#endif
+
+#ifdef WEBP_USE_THREAD
+#if defined(_WIN32)
+#include <windows.h>
+typedef CRITICAL_SECTION ArenaMutex;
+#define ARENA_MUTEX_INIT(m)    (InitializeCriticalSection(m), 1)
+#define ARENA_MUTEX_DESTROY(m) DeleteCriticalSection(m)
+#define ARENA_LOCK(m)          EnterCriticalSection((ArenaMutex*)(m))
+#define ARENA_UNLOCK(m)        LeaveCriticalSection((ArenaMutex*)(m))
+#else
+#include <pthread.h>
+typedef pthread_mutex_t ArenaMutex;
+#define ARENA_MUTEX_INIT(m)    (pthread_mutex_init(m, NULL) == 0)
+#define ARENA_MUTEX_DESTROY(m) pthread_mutex_destroy(m)
+#define ARENA_LOCK(m)          pthread_mutex_lock((ArenaMutex*)(m))
+#define ARENA_UNLOCK(m)        pthread_mutex_unlock((ArenaMutex*)(m))
+#endif
+#else   // !WEBP_USE_THREAD
+typedef int ArenaMutex;
+#define ARENA_MUTEX_INIT(m)    1
+#define ARENA_MUTEX_DESTROY(m) (void)(m)
+#define ARENA_LOCK(m)          (void)(m)
+#define ARENA_UNLOCK(m)        (void)(m)
+#endif  // WEBP_USE_THREAD
+
+#define ARENA_ALIGN      16            // alignment of the returned blocks
+#define ARENA_MIN_CHUNK  (64 << 10)    // size of the first chunk
+#define ARENA_MAX_CHUNK  (16 << 20)    // maximum size of the growing chunks
+#define ARENA_ROUND(s)   (((s) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Each block is preceded by its size, padded to keep the alignment.
+typedef union {
+  size_t size_;
+  uint8_t pad_[ARENA_ALIGN];
+} ArenaBlock;
+
+typedef struct ArenaChunk ArenaChunk;
+struct ArenaChunk {
+  ArenaChunk* next_;   // previous (smaller) chunk
+  uint8_t* start_;     // first usable byte, aligned
+  size_t size_;        // usable size
+  size_t used_;        // bytes in use, from start_
+};
+
+struct WebPMemoryArena {
+  ArenaChunk* chunks_;          // current chunk, followed by the older ones
+  size_t max_bytes_;            // limit for stats_.chunk_bytes (0 = none)
+  WebPMemoryArenaStats stats_;
+  ArenaMutex mutex_;            // for the allocations of the worker threads
+};
+
+static WEBP_THREAD_LOCAL WebPMemoryArena* g_current_arena = NULL;
+
+static ArenaChunk* NewArenaChunk(size_t size) {
+  const size_t header_size = ARENA_ROUND(sizeof(ArenaChunk));
+  ArenaChunk* const chunk = (ArenaChunk*)InterfaceAlloc(header_size + size, 0);
+  if (chunk == NULL) return NULL;
+  chunk->start_ = (uint8_t*)chunk + header_size;
+  chunk->size_ = size;
+  chunk->used_ = 0;
+  return chunk;
+}
+
+// Returns NULL if the allocation is denied or fails.
+static void* ArenaAlloc(WebPMemoryArena* const arena, size_t size, int clear) {
+  const size_t block_size = sizeof(ArenaBlock) + ARENA_ROUND(size);
+  WebPMemoryArenaStats* const stats = &arena->stats_;
+  ArenaChunk* chunk;
+  ArenaBlock* block = NULL;
+  ARENA_LOCK(&arena->mutex_);
+  chunk = arena->chunks_;
+  if (chunk == NULL || chunk->used_ + block_size > chunk->size_) {
+    size_t chunk_size = (chunk == NULL) ? ARENA_MIN_CHUNK : 2 * chunk->size_;
+    if (chunk_size > ARENA_MAX_CHUNK) chunk_size = ARENA_MAX_CHUNK;
+    if (chunk_size < block_size) chunk_size = block_size;
+    if (arena->max_bytes_ > 0 &&
+        stats->chunk_bytes + chunk_size > arena->max_bytes_) {
+      // Try to fit the limit, before denying the allocation.
+      chunk_size = arena->max_bytes_ - stats->chunk_bytes;
+      if (stats->chunk_bytes >= arena->max_bytes_ || chunk_size < block_size) {
+        ++stats->num_denied;
+        goto End;
+      }
+    }
+    chunk = NewArenaChunk(chunk_size);
+    if (chunk == NULL) goto End;
+    chunk->next_ = arena->chunks_;
+    arena->chunks_ = chunk;
+    stats->chunk_bytes += chunk_size;
+  }
+  block = (ArenaBlock*)(chunk->start_ + chunk->used_);
+  block->size_ = block_size;
+  chunk->used_ += block_size;
+  stats->current_bytes += block_size - sizeof(*block);
+  if (stats->current_bytes > stats->peak_bytes) {
+    stats->peak_bytes = stats->current_bytes;
+  }
+  ++stats->num_allocs;
+ End:
+  ARENA_UNLOCK(&arena->mutex_);
+  if (block == NULL) return NULL;
+  if (clear) memset(block + 1, 0, size);
+  return block + 1;
+}
+
+// Returns false if 'ptr' doesn't belong to the arena.
+static int ArenaFree(WebPMemoryArena* const arena, void* const ptr) {
+  const uint8_t* const p = (const uint8_t*)ptr;
+  ArenaChunk* chunk;
+  int found = 0;
+  ARENA_LOCK(&arena->mutex_);
+  for (chunk = arena->chunks_; chunk != NULL; chunk = chunk->next_) {
+    if (p > chunk->start_ && p < chunk->start_ + chunk->used_) {
+      ArenaBlock* const block = (ArenaBlock*)ptr - 1;
+      const size_t block_size = block->size_;
+      arena->stats_.current_bytes -= block_size - sizeof(*block);
+      // Only the last block of the current chunk can be reclaimed.
+      if (chunk == arena->chunks_ &&
+          (uint8_t*)block + block_size == chunk->start_ + chunk->used_) {
+        chunk->used_ -= block_size;
+      }
+      found = 1;
+      break;
+    }
+  }
+  ARENA_UNLOCK(&arena->mutex_);
+  return found;
+}
+
+WebPMemoryArena* WebPMemoryArenaNew(size_t max_bytes) {
+  WebPMemoryArena* const arena =
+      (WebPMemoryArena*)InterfaceAlloc(sizeof(*arena), 1);
+  if (arena == NULL) return NULL;
+  if (!ARENA_MUTEX_INIT(&arena->mutex_)) {
+    InterfaceFree(arena);
+    return NULL;
+  }
+  arena->max_bytes_ = max_bytes;
+  return arena;
+}
+
+void WebPMemoryArenaReset(WebPMemoryArena* const arena) {
+  if (arena == NULL) return;
+  assert(arena != g_current_arena);
+  if (arena->chunks_ != NULL) {
+    // Keep the largest chunk. It is usually the current one, but not after an
+    // oversized allocation or when max_bytes_ trimmed the last chunk.
+    ArenaChunk* largest = arena->chunks_;
+    ArenaChunk* chunk;
+    for (chunk = largest->next_; chunk != NULL; chunk = chunk->next_) {
+      if (chunk->size_ > largest->size_) largest = chunk;
+    }
+    chunk = arena->chunks_;
+    while (chunk != NULL) {
+      ArenaChunk* const next = chunk->next_;
+      if (chunk != largest) InterfaceFree(chunk);
+      chunk = next;
+    }
+    largest->next_ = NULL;
+    largest->used_ = 0;
+    arena->chunks_ = largest;
+  }
+  memset(&arena->stats_, 0, sizeof(arena->stats_));
+  if (arena->chunks_ != NULL) arena->stats_.chunk_bytes = arena->chunks_->size_;
+}
+
+void WebPMemoryArenaDelete(WebPMemoryArena* const arena) {
+  if (arena == NULL) return;
+  WebPMemoryArenaReset(arena);
+  if (arena->chunks_ != NULL) InterfaceFree(arena->chunks_);
+  ARENA_MUTEX_DESTROY(&arena->mutex_);
+  InterfaceFree(arena);
+}
+
+WebPMemoryArena* WebPMemoryArenaUse(WebPMemoryArena* const arena) {
+  WebPMemoryArena* const previous = g_current_arena;
+  g_current_arena = arena;
+  return previous;
+}
+
+WebPMemoryArena* WebPMemoryArenaGetCurrent(void) {
+  return g_current_arena;
+}
+
+void WebPMemoryArenaGetStats(const WebPMemoryArena* const arena,
+                             WebPMemoryArenaStats* const stats) {
+  if (arena == NULL || stats == NULL) return;
+  ARENA_LOCK(&arena->mutex_);
+  *stats = arena->stats_;
+  ARENA_UNLOCK(&arena->mutex_);
+}
+
+//------------------------------------------------------------------------------
+
+static void* Alloc(uint64_t nmemb, size_t size, int clear) {
+  const size_t total_size = (size_t)(nmemb * size);
   void* ptr;
+  assert(total_size > 0);
+  if (g_current_arena != NULL) {
+    return ArenaAlloc(g_current_arena, total_size, clear);
+  }
+  if (g_memory_interface.Malloc == DefaultMalloc) {
+    ptr = clear ? calloc((size_t)nmemb, size) : malloc(total_size);
+  } else {
+    ptr = InterfaceAlloc(total_size, clear);
+  }
+  AddMem(ptr, total_size);
+  return ptr;
+}
+
+void* WebPSafeMalloc(uint64_t nmemb, size_t size) {
   Increment(&num_malloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
-  assert(nmemb * size > 0);
-  ptr = malloc((size_t)(nmemb * size));
-  AddMem(ptr, (size_t)(nmemb * size));
-  return ptr;
+  return Alloc(nmemb, size, 0);
 }
 
 void* WebPSafeCalloc(uint64_t nmemb, size_t size) {
-  void* ptr;
   Increment(&num_calloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
-  assert(nmemb * size > 0);
-  ptr = calloc((size_t)nmemb, size);
-  AddMem(ptr, (size_t)(nmemb * size));
-  return ptr;
+  return Alloc(nmemb, size, 1);
 }
 
 void WebPSafeFree(void* const ptr) {
-  if (ptr != NULL) {
-    Increment(&num_free_calls);
-    SubMem(ptr);
-  }
-  free(ptr);
+  if (ptr == NULL) return;
+  Increment(&num_free_calls);
+  if (g_current_arena != NULL && ArenaFree(g_current_arena, ptr)) return;
+  SubMem(ptr);
+  InterfaceFree(ptr);
 }
 
 // Public API functions.
@@ -60,6 +60,95 @@ WEBP_EXTERN void* WebPSafeCalloc(uint64_t nmemb, size_t size);
 // Companion deallocation function to the above allocations.
 WEBP_EXTERN void WebPSafeFree(void* const ptr);
 
+//------------------------------------------------------------------------------
+// Memory allocator interface
+
+// The functions used by the allocations above (and WebPMalloc()/WebPFree()),
+// hence by all of libwebp.
+typedef struct {
+  // Returns 'size' bytes (never 0), or NULL in case of error.
+  void* (*Malloc)(size_t size, void* opaque);
+  // Same with the memory cleared. Can be NULL, in which case Malloc() and
+  // memset() are used instead.
+  void* (*Calloc)(size_t nmemb, size_t size, void* opaque);
+  // Releases memory returned by the functions above. 'ptr' is never NULL.
+  void (*Free)(void* ptr, void* opaque);
+  void* opaque;   // user data passed to the functions above
+} WebPMemoryInterface;
+
+// Install a new memory allocator, overriding the default malloc(), calloc()
+// and free(). This should be done before any memory is allocated by libwebp,
+// i.e., before any encoding or decoding takes place, and the memory returned
+// by libwebp must then be released using WebPFree(). The contents of the
+// interface struct are copied, it is safe to free the corresponding memory
+// after this call. This function is not thread-safe. Return false in case of
+// invalid pointer or methods.
+WEBP_EXTERN int WebPSetMemoryInterface(
+    const WebPMemoryInterface* const minterface);
+
+// Retrieve the currently set memory allocator.
+WEBP_EXTERN const WebPMemoryInterface* WebPGetMemoryInterface(void);
+
+//------------------------------------------------------------------------------
+// Memory arena
+//
+// While in use by a thread, an arena serves all the allocations made by this
+// thread, and by the worker threads it launches, out of a few large chunks
+// obtained from the memory interface. Freed blocks are only reclaimed when
+// they are the last allocated one; the memory is otherwise released all at
+// once by WebPMemoryArenaReset() or WebPMemoryArenaDelete(). This bounds the
+// memory used by an encoding or decoding call, measures it, and avoids
+// fragmenting the heap of long-running processes.
+// The memory allocated from an arena must not be passed to WebPFree() after
+// the thread stopped using it: results needed beyond that point should be
+// copied, or decoded into external memory (see WebPDecBuffer).
+// For the same reason, a WebPEncoderSession used while an arena is in use
+// keeps buffers from that arena: it must not outlive the arena scope, i.e. it
+// must be deleted before WebPMemoryArenaUse() switches back, and before the
+// arena is reset or deleted.
+//
+// Example code:
+//
+//   WebPMemoryArena* const arena = WebPMemoryArenaNew(64 << 20);
+//   WebPMemoryArena* const previous = WebPMemoryArenaUse(arena);
+//   ... decode into external memory, or encode and copy the bitstream ...
+//   WebPMemoryArenaUse(previous);
+//   WebPMemoryArenaGetStats(arena, &stats);
+//   WebPMemoryArenaReset(arena);    // or WebPMemoryArenaDelete(arena)
+
+typedef struct WebPMemoryArena WebPMemoryArena;
+
+typedef struct {
+  size_t current_bytes;  // bytes currently allocated from the arena
+  size_t peak_bytes;     // maximum of current_bytes
+  size_t chunk_bytes;    // total size of the chunks held by the arena
+  uint32_t num_allocs;   // number of allocations
+  uint32_t num_denied;   // number of allocations denied because of max_bytes
+} WebPMemoryArenaStats;
+
+// Creates a new arena, whose chunks can't total more than 'max_bytes' (0 means
+// no limit). Allocations beyond this limit fail, as if out of memory.
+// Returns NULL in case of memory error.
+WEBP_EXTERN WebPMemoryArena* WebPMemoryArenaNew(size_t max_bytes);
+
+// Releases all the memory allocated from 'arena' and resets its statistics,
+// keeping its largest chunk for reuse. The arena must not be in use.
+WEBP_EXTERN void WebPMemoryArenaReset(WebPMemoryArena* const arena);
+
+// Releases 'arena' and all its memory. The arena must not be in use.
+WEBP_EXTERN void WebPMemoryArenaDelete(WebPMemoryArena* const arena);
+
+// Makes the calling thread allocate from 'arena', or from the memory interface
+// if 'arena' is NULL. Returns the arena previously used by the thread.
+WEBP_EXTERN WebPMemoryArena* WebPMemoryArenaUse(WebPMemoryArena* const arena);
+
+// Returns the arena used by the calling thread (or NULL).
+WEBP_EXTERN WebPMemoryArena* WebPMemoryArenaGetCurrent(void);
+
+// Retrieves the statistics of 'arena' since its creation or last reset.
+WEBP_EXTERN void WebPMemoryArenaGetStats(const WebPMemoryArena* const arena,
+                                         WebPMemoryArenaStats* const stats);
+
 //------------------------------------------------------------------------------
 // Alignment
 
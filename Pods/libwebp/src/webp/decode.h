@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DECODER_ABI_VERSION 0x0209    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DECODER_ABI_VERSION 0x020a    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -30,9 +30,11 @@ typedef struct WebPRGBABuffer WebPRGBABuffer;
 typedef struct WebPYUVABuffer WebPYUVABuffer;
 typedef struct WebPDecBuffer WebPDecBuffer;
 typedef struct WebPIDecoder WebPIDecoder;
+typedef struct WebPISegment WebPISegment;
 typedef struct WebPBitstreamFeatures WebPBitstreamFeatures;
 typedef struct WebPDecoderOptions WebPDecoderOptions;
 typedef struct WebPDecoderConfig WebPDecoderConfig;
+typedef struct WebPPreview WebPPreview;
 
 // Return the decoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -338,6 +340,24 @@ WEBP_EXTERN VP8StatusCode WebPIAppend(
 WEBP_EXTERN VP8StatusCode WebPIUpdate(
     WebPIDecoder* idec, const uint8_t* data, size_t data_size);
 
+// A segment of data, for WebPIAppendSegments().
+struct WebPISegment {
+  const uint8_t* data;   // segment bytes
+  size_t size;           // number of bytes (can be 0)
+};
+
+// A variant of WebPIAppend() to be used when the data arrives in separate
+// memory segments (as with scatter-gather I/O). The 'num_segments' segments
+// are appended in order to the data received so far, without being copied:
+// the decoder reads them in place, only gathering the headers and partition #0
+// of lossy pictures when these straddle several segments. Hence the memory of
+// all the segments passed must remain valid and unchanged until the decoding
+// is complete or WebPIDelete() is called.
+// This function can't be mixed with WebPIAppend() and WebPIUpdate() on the
+// same decoder. Return values are the same as for WebPIAppend().
+WEBP_EXTERN VP8StatusCode WebPIAppendSegments(
+    WebPIDecoder* idec, const WebPISegment* segments, int num_segments);
+
 // Returns the RGB/A image decoded so far. Returns NULL if output params
 // are not initialized yet. The RGB/A output type corresponds to the colorspace
 // specified during call to WebPINewDecoder() or WebPINewRGB().
@@ -455,8 +475,17 @@ struct WebPDecoderOptions {
   int dithering_strength;             // dithering strength (0=Off, 100=full)
   int flip;                           // if true, flip output vertically
   int alpha_dithering_strength;       // alpha dithering strength in [0..100]
-
-  uint32_t pad[5];                    // padding for later use
+  int scale_denom;                    // if 2, 4 or 8, decode the picture at
+                                      // 1/scale_denom of its size (rounded
+                                      // up), before cropping and scaling.
+                                      // Lossy pictures are then reconstructed
+                                      // directly at that size, approximately
+                                      // and without in-loop filtering. This
+                                      // mostly saves memory: all coefficients
+                                      // are still entropy-decoded, so it is
+                                      // only 10-15% faster than a full decode.
+
+  uint32_t pad[4];                    // padding for later use
 };
 
 // Main object storing the configuration for advanced decoding.
@@ -496,6 +525,39 @@ WEBP_EXTERN WebPIDecoder* WebPIDecode(const uint8_t* data, size_t data_size,
 WEBP_EXTERN VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
                                      WebPDecoderConfig* config);
 
+//------------------------------------------------------------------------------
+// Low-resolution preview
+//
+// A preview is a tiny version of the picture, with one pixel per 16x16 block:
+// the average color of the macroblocks for lossy pictures, and a box-filtered
+// reduction for lossless ones. It is meant for placeholders (blurred thumbnails,
+// BlurHash, dominant color...) and is cheap to produce alongside the normal
+// output.
+
+struct WebPPreview {
+  int width, height;   // (picture_width + 15) / 16 x (picture_height + 15) / 16
+  uint8_t* rgba;       // non-premultiplied RGBA samples, stride is 4 * width
+  uint32_t pad[4];     // padding for later use
+};
+
+// Same as WebPDecode(), but also fills 'preview' during the same pass. The
+// preview covers the whole picture: cropping isn't supported and returns
+// VP8_STATUS_INVALID_PARAM, while scaling options don't affect the preview.
+// Upon success, 'preview->rgba' must be released using WebPFreePreview().
+WEBP_EXTERN VP8StatusCode WebPDecodeWithPreview(const uint8_t* data,
+                                                size_t data_size,
+                                                WebPDecoderConfig* config,
+                                                WebPPreview* preview);
+
+// Only produces the preview, decoding the picture at reduced size (1/8) which
+// is the fastest path. The coded data still has to be entropy-decoded.
+WEBP_EXTERN VP8StatusCode WebPDecodePreview(const uint8_t* data,
+                                            size_t data_size,
+                                            WebPPreview* preview);
+
+// Releases the memory held by 'preview'.
+WEBP_EXTERN void WebPFreePreview(WebPPreview* preview);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
@@ -55,7 +55,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DEMUX_ABI_VERSION 0x0107    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DEMUX_ABI_VERSION 0x0108    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -253,7 +253,12 @@ struct WebPAnimDecoderOptions {
   // MODE_RGBA, MODE_BGRA, MODE_rgbA and MODE_bgrA.
   WEBP_CSP_MODE color_mode;
   int use_threads;           // If true, use multi-threaded decoding.
-  uint32_t padding[7];       // Padding for later use.
+  int decode_ahead;          // With 'use_threads', number of upcoming frames
+                             // decoded in parallel on worker threads while
+                             // blending stays in order. Each one holds a
+                             // canvas-sized buffer. 0 (default) decodes each
+                             // frame in turn. Range: [0, 16].
+  uint32_t padding[6];       // Padding for later use.
 };
 
 // Internal, version-checked, entry point.
@@ -340,6 +345,48 @@ WEBP_EXTERN int WebPAnimDecoderHasMoreFrames(const WebPAnimDecoder* dec);
 //   dec - (in/out) decoder instance to be reset
 WEBP_EXTERN void WebPAnimDecoderReset(WebPAnimDecoder* dec);
 
+// Positions 'dec' so that the next call to WebPAnimDecoderGetNext() returns
+// frame 'frame_num' (1-based, as in WebPIterator::frame_num), with the same
+// canvas and timestamp as sequential decoding would give. Decoding restarts at
+// the closest key-frame at or before 'frame_num' (or continues from the
+// current position when that is closer), so scrubbing does not re-decode the
+// animation from the first frame. The key-frame index is computed from the
+// frame headers on first use, unless set with
+// WebPAnimDecoderSetKeyFrameIndex().
+// Parameters:
+//   dec - (in/out) decoder instance to be positioned.
+//   frame_num - (in) number of the frame to be returned next.
+// Returns:
+//   False if 'dec' is NULL, 'frame_num' is out of range, or in case of memory,
+//   parsing or decoding error; 'dec' is then reset to the first frame.
+//   Otherwise, returns true.
+WEBP_EXTERN int WebPAnimDecoderSeek(WebPAnimDecoder* dec, int frame_num);
+
+// Serializes the key-frame index of 'dec' (computing it if needed), so that it
+// can be stored next to the animation and restored with
+// WebPAnimDecoderSetKeyFrameIndex().
+// Parameters:
+//   dec - (in/out) decoder instance.
+//   index - (out) serialized index. Its content is allocated using
+//                 WebPMalloc() and should be released with WebPDataClear().
+// Returns:
+//   True on success.
+WEBP_EXTERN int WebPAnimDecoderGetKeyFrameIndex(WebPAnimDecoder* dec,
+                                                WebPData* index);
+
+// Installs a key-frame index previously produced by
+// WebPAnimDecoderGetKeyFrameIndex() for the same animation. The index is
+// rejected if it does not match the canvas size and frame count of 'dec', if
+// any entry is not a key-frame of this animation, or if its timestamp is not
+// the sum of the durations of the preceding frames.
+// Parameters:
+//   dec - (in/out) decoder instance.
+//   index - (in) serialized index; it is copied and can be released afterwards.
+// Returns:
+//   True on success. On failure, the index will be recomputed when needed.
+WEBP_EXTERN int WebPAnimDecoderSetKeyFrameIndex(WebPAnimDecoder* dec,
+                                                const WebPData* index);
+
 // Grab the internal demuxer object.
 // Getting the demuxer object can be useful if one wants to use operations only
 // available through demuxer; e.g. to get XMP/EXIF/ICC metadata. The returned
@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_ENCODER_ABI_VERSION 0x020f    // MAJOR(8b) + MINOR(8b)
+#define WEBP_ENCODER_ABI_VERSION 0x0211    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -32,6 +32,7 @@ typedef struct WebPConfig WebPConfig;
 typedef struct WebPPicture WebPPicture;   // main structure for I/O
 typedef struct WebPAuxStats WebPAuxStats;
 typedef struct WebPMemoryWriter WebPMemoryWriter;
+typedef struct WebPEncoderSession WebPEncoderSession;
 
 // Return the encoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -136,6 +137,8 @@ struct WebPConfig {
                           // JPEG compression. Generally, the output size will
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
+                          // Values above 1 (up to 64) also spread the lossy
+                          // macroblock decisions over that many threads.
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
 
   int near_lossless;      // Near lossless encoding [0 = max loss .. 100 = off
@@ -150,6 +153,15 @@ struct WebPConfig {
 
   int qmin;               // minimum permissible quality factor
   int qmax;               // maximum permissible quality factor
+  int use_tile_bands;     // if true, the lossless predictor and cross-color
+                          // searches process bands of tile rows in parallel
+                          // (using the thread_level threads). This changes
+                          // the output slightly, but not with thread_level.
+  int use_rate_model;     // if true, target_size and target_PSNR are reached
+                          // by predicting the quality from a rate-distortion
+                          // model of the first pass instead of searching it
+                          // over 'pass' passes. At least 2 passes are done.
+                          // Ignored for method < 3.
 };
 
 // Enumerate some predefined settings for WebPConfig, depending on the type
@@ -543,6 +555,45 @@ WEBP_EXTERN void WebPBlendAlpha(WebPPicture* picture, uint32_t background_rgb);
 // another is provided but they both incur some loss.
 WEBP_EXTERN int WebPEncode(const WebPConfig* config, WebPPicture* picture);
 
+//------------------------------------------------------------------------------
+// Encoder session
+//
+// A WebPEncoderSession keeps the internal encoder objects and their memory
+// buffers (lossy encoder state and token pages, lossless transform buffers,
+// hash chains and backward references) alive between calls to
+// WebPEncodeWithSession(), so that encoding many pictures of similar
+// dimensions (animation frames, batches of thumbnails, ...) doesn't reallocate
+// them each time. Buffers are only reallocated when they're too small for the
+// new picture. The output is the same as with WebPEncode().
+// A session must not be used by several threads at the same time.
+//
+// Example code:
+//
+//   WebPEncoderSession* const session = WebPNewEncoderSession();
+//   CHECK(session != NULL);
+//   for (each picture) {
+//     ... set up 'config' and 'picture' as for WebPEncode() ...
+//     ok = WebPEncodeWithSession(session, &config, &picture);
+//     ... use the output, WebPPictureFree(&picture) ...
+//   }
+//   WebPDeleteEncoderSession(session);
+
+// Creates a new, empty, encoder session. Returns NULL in case of memory error.
+WEBP_EXTERN WebPEncoderSession* WebPNewEncoderSession(void);
+
+// Same as WebPEncode(), but using (and keeping) the encoder objects and buffers
+// of 'session'.
+WEBP_EXTERN int WebPEncodeWithSession(WebPEncoderSession* session,
+                                      const WebPConfig* config,
+                                      WebPPicture* picture);
+
+// Releases the encoder objects and buffers kept by 'session', which returns to
+// its initial state and can still be used afterward.
+WEBP_EXTERN void WebPResetEncoderSession(WebPEncoderSession* session);
+
+// Releases 'session' and everything it holds.
+WEBP_EXTERN void WebPDeleteEncoderSession(WebPEncoderSession* session);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
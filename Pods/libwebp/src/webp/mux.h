@@ -21,7 +21,7 @@
 extern "C" {
 #endif
 
-#define WEBP_MUX_ABI_VERSION 0x0108        // MAJOR(8b) + MINOR(8b)
+#define WEBP_MUX_ABI_VERSION 0x0109        // MAJOR(8b) + MINOR(8b)
 
 //------------------------------------------------------------------------------
 // Mux API
@@ -437,8 +437,13 @@ struct WebPAnimEncoderOptions {
   int allow_mixed;      // If true, use mixed compression mode; may choose
                         // either lossy and lossless for each frame.
   int verbose;          // If true, print info and warning messages to stderr.
+  int use_threads;      // If true, WebPAnimEncoderAdd() returns as soon as the
+                        // frame is copied, and encodes it on a worker thread
+                        // while the caller prepares the next one. The output
+                        // is the same. Errors are then reported by the next
+                        // calls, and progress hooks are not called.
 
-  uint32_t padding[4];  // Padding for later use.
+  uint32_t padding[3];  // Padding for later use.
 };
 
 // Internal, version-checked, entry point.
@@ -486,7 +491,10 @@ static WEBP_INLINE WebPAnimEncoder* WebPAnimEncoderNew(
 //                       "timestamp of next frame - timestamp of this frame".
 //                       Hence, timestamps should be in non-decreasing order.
 //   config - (in) encoding options; can be passed NULL to pick
-//            reasonable defaults.
+//            reasonable defaults. If 'config->thread_level' is non-zero and
+//            no progress hook is set on 'frame', the candidate encodings
+//            of the frame (lossy/lossless, dispose methods) are run
+//            concurrently. The output is the same either way.
 // Returns:
 //   On error, returns false and frame->error_code is set appropriately.
 //   Otherwise, returns true.
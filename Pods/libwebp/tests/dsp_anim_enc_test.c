@@ -0,0 +1,212 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Checks that the animation encoder comparisons selected by
+// WebPAnimEncDspInit() (SSE2, AVX2 or NEON) give the same results as the
+// plain C ones. Not part of the pod. Built and run by 'make -C tests check'
+// from the libwebp directory, see tests/Makefile.
+// Without an ARM target, the NEON functions are still checked on the host with
+// -DWEBP_TEST_NEON_EMULATION: anim_enc_neon.c is then compiled against the
+// plain C stand-in for <arm_neon.h> in tests/neon, with its init function
+// renamed WebPAnimEncDspInitNEONEmulated().
+//
+// Returns 0 on success, 1 on mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/dsp/dsp.h"
+
+#define NUM_TESTS 100000
+#define MAX_LENGTH 300
+#define BLOCK_STRIDE 13
+
+typedef struct {
+  WebPAnimFindDiffFunc find_first_diff;
+  WebPAnimFindDiffFunc find_last_diff;
+  WebPAnimFindDiffFunc find_first_dissimilar;
+  WebPAnimFindDiffFunc find_last_dissimilar;
+  WebPAnimBlendingPossibleFunc is_lossless_blending_possible;
+  WebPAnimBlendingPossibleFunc is_lossy_blending_possible;
+  int (*increase_transparency)(const uint32_t*, uint32_t*, int);
+  int (*flatten_similar_block)(const uint32_t*, int, uint32_t*, int, int);
+} AnimFuncs;
+
+static int num_failures = 0;
+
+static void Fail(const char* const name, const char* const level) {
+  if (num_failures++ < 10) fprintf(stderr, "%s mismatch (%s)\n", name, level);
+}
+
+static int NoCPUInfo(CPUFeature feature) {
+  (void)feature;
+  return 0;
+}
+
+static VP8CPUInfo cpu_info;
+static int NoAVX2CPUInfo(CPUFeature feature) {
+  return (feature != kAVX2) && cpu_info(feature);
+}
+
+static void CopyFuncs(AnimFuncs* const funcs) {
+  funcs->find_first_diff = WebPAnimFindFirstDiff;
+  funcs->find_last_diff = WebPAnimFindLastDiff;
+  funcs->find_first_dissimilar = WebPAnimFindFirstDissimilar;
+  funcs->find_last_dissimilar = WebPAnimFindLastDissimilar;
+  funcs->is_lossless_blending_possible = WebPAnimIsLosslessBlendingPossible;
+  funcs->is_lossy_blending_possible = WebPAnimIsLossyBlendingPossible;
+  funcs->increase_transparency = WebPAnimIncreaseTransparency;
+  funcs->flatten_similar_block = WebPAnimFlattenSimilarBlock;
+}
+
+// WebPAnimEncDspInit() runs again whenever VP8GetCPUInfo changes.
+static void GetFuncs(VP8CPUInfo info, AnimFuncs* const funcs) {
+  VP8GetCPUInfo = info;
+  WebPAnimEncDspInit();
+  CopyFuncs(funcs);
+}
+
+#if defined(WEBP_TEST_NEON_EMULATION)
+extern void WebPAnimEncDspInitNEONEmulated(void);
+
+static void GetEmulatedNEONFuncs(AnimFuncs* const funcs) {
+  WebPAnimEncDspInitNEONEmulated();
+  CopyFuncs(funcs);
+}
+#endif
+
+static uint32_t RandomPixel(int mode) {
+  static const uint32_t kAlpha[4] = { 0x00, 0xff, 0xff, 0x80 };
+  const uint32_t alpha = (mode & 1) ? kAlpha[rand() & 3] : (rand() & 0xff);
+  return (alpha << 24) | ((uint32_t)rand() & 0xffffff);
+}
+
+// Returns 'pixel' with each color channel changed by at most 'amplitude',
+// or another alpha once in a while.
+static uint32_t Perturb(uint32_t pixel, int amplitude) {
+  int shift;
+  if (rand() % 16 == 0) return pixel ^ ((uint32_t)(1 + rand() % 255) << 24);
+  for (shift = 0; shift < 24; shift += 8) {
+    int c = (int)((pixel >> shift) & 0xff) + rand() % (2 * amplitude + 1) -
+            amplitude;
+    c = (c < 0) ? 0 : (c > 0xff) ? 0xff : c;
+    pixel = (pixel & ~(0xffu << shift)) | ((uint32_t)c << shift);
+  }
+  return pixel;
+}
+
+// 'dst' is a copy of 'src' with a few differences, either none, at the
+// ends, or anywhere, small enough for the pixels to be similar or not.
+static void FillPixels(uint32_t* const src, uint32_t* const dst, int size,
+                       int mode) {
+  const int amplitude = (mode & 2) ? 3 : 40;
+  const int num_changes = (mode % 5 == 0) ? 0 : 1 + rand() % 8;
+  int i;
+  for (i = 0; i < size; ++i) {
+    // Flat opaque areas or random pixels.
+    src[i] = (i > 0 && (mode & 4) && (rand() & 7))
+                 ? (src[i - 1] | 0xff000000u) : RandomPixel(mode);
+    dst[i] = src[i];
+  }
+  for (i = 0; i < num_changes; ++i) {
+    const int pos = (rand() & 1) ? rand() % size
+                                 : (rand() & 1) ? rand() % 4
+                                                : size - 1 - rand() % 4;
+    if (pos >= 0 && pos < size) dst[pos] = Perturb(dst[pos], amplitude);
+  }
+  if (mode % 7 == 0) {  // Similar everywhere.
+    for (i = 0; i < size; ++i) dst[i] = Perturb(src[i], amplitude);
+  }
+}
+
+static void Test(const AnimFuncs* const c, const AnimFuncs* const simd,
+                 const char* const level, int mode) {
+  uint32_t src[MAX_LENGTH + 8], dst[MAX_LENGTH + 8];
+  uint32_t dst_c[MAX_LENGTH + 8], dst_simd[MAX_LENGTH + 8];
+  const int offset = rand() % 8;  // Unaligned rows.
+  const int length = rand() % (MAX_LENGTH + 1);
+  const int max_allowed_diff = (rand() & 1) ? rand() % 8 : rand() % 256;
+  const uint32_t* const s = src + offset;
+  const uint32_t* const d = dst + offset;
+  FillPixels(src, dst, MAX_LENGTH + 8, mode);
+
+#define CHECK(FUNC, NAME)                                         \
+  if (c->FUNC(s, d, length, max_allowed_diff) !=                  \
+      simd->FUNC(s, d, length, max_allowed_diff)) {               \
+    Fail(NAME, level);                                            \
+  }
+  CHECK(find_first_diff, "FindFirstDiff")
+  CHECK(find_last_diff, "FindLastDiff")
+  CHECK(find_first_dissimilar, "FindFirstDissimilar")
+  CHECK(find_last_dissimilar, "FindLastDissimilar")
+  CHECK(is_lossless_blending_possible, "IsLosslessBlendingPossible")
+  CHECK(is_lossy_blending_possible, "IsLossyBlendingPossible")
+#undef CHECK
+
+  memcpy(dst_c, dst, sizeof(dst));
+  memcpy(dst_simd, dst, sizeof(dst));
+  if (c->increase_transparency(s, dst_c + offset, length) !=
+          simd->increase_transparency(s, dst_simd + offset, length) ||
+      memcmp(dst_c, dst_simd, sizeof(dst))) {
+    Fail("IncreaseTransparency", level);
+  }
+
+  // 8x8 blocks, taken from the rows with a stride.
+  if (offset + 7 * BLOCK_STRIDE + 8 <= MAX_LENGTH + 8) {
+    memcpy(dst_c, dst, sizeof(dst));
+    memcpy(dst_simd, dst, sizeof(dst));
+    if (c->flatten_similar_block(s, BLOCK_STRIDE, dst_c + offset,
+                                 BLOCK_STRIDE, max_allowed_diff) !=
+            simd->flatten_similar_block(s, BLOCK_STRIDE, dst_simd + offset,
+                                        BLOCK_STRIDE, max_allowed_diff) ||
+        memcmp(dst_c, dst_simd, sizeof(dst))) {
+      Fail("FlattenSimilarBlock", level);
+    }
+  }
+}
+
+int main(void) {
+  AnimFuncs c, no_avx2, all;
+  int i;
+
+  cpu_info = VP8GetCPUInfo;
+  GetFuncs(NoCPUInfo, &c);
+#if defined(WEBP_TEST_NEON_EMULATION)
+  {
+    AnimFuncs neon;
+    GetEmulatedNEONFuncs(&neon);
+    srand(1);
+    for (i = 0; i < NUM_TESTS; ++i) Test(&c, &neon, "emulated NEON", i);
+    printf("emulated NEON: %d failures\n", num_failures);
+  }
+#endif
+  if (cpu_info == NULL) {
+    printf("no CPU detection, skipped\n");
+    return (num_failures != 0);
+  }
+  GetFuncs(NoAVX2CPUInfo, &no_avx2);
+  GetFuncs(cpu_info, &all);
+  if (!memcmp(&c, &all, sizeof(c))) {
+    printf("no SIMD version for this CPU, skipped\n");
+    return (num_failures != 0);
+  }
+  if (cpu_info(kAVX2) && !memcmp(&no_avx2, &all, sizeof(all))) {
+    fprintf(stderr, "AVX2 functions not selected by the dispatch\n");
+    return 1;
+  }
+
+  srand(1);
+  for (i = 0; i < NUM_TESTS; ++i) {
+    Test(&c, &all, cpu_info(kAVX2) ? "AVX2" : "SIMD", i);
+    if (cpu_info(kAVX2)) Test(&c, &no_avx2, "without AVX2", i);
+  }
+  printf("%d failures\n", num_failures);
+  return (num_failures != 0);
+}
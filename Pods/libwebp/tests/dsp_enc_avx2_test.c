@@ -0,0 +1,221 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Checks that the AVX2 encoder functions (enc_avx2.c, lossless_enc_avx2.c)
+// give the same results as the plain C ones, on random and edge-case input.
+// Not part of the pod. Built and run by 'make -C tests check' from the libwebp
+// directory, see tests/Makefile.
+//
+// Returns 0 on success (or if the CPU has no AVX2), 1 on mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/dsp/dsp.h"
+#include "src/dsp/lossless.h"
+#include "src/enc/vp8i_enc.h"
+
+extern void VP8EncDspInitAVX2(void);
+extern void VP8LEncDspInitAVX2(void);
+
+#define NUM_LOSSY_TESTS 200000
+#define NUM_LOSSLESS_TESTS 20000
+
+typedef struct {
+  VP8Fdct ftransform2;
+  VP8Metric sse16x16;
+  VP8WMetric tdisto16x16;
+  VP8CHisto collect_histogram;
+  VP8Quantize2Blocks quantize2_blocks;
+  VP8LProcessEncBlueAndRedFunc subtract_green;
+  VP8LTransformColorFunc transform_color;
+  VP8LCollectColorBlueTransformsFunc collect_blue;
+  VP8LCollectColorRedTransformsFunc collect_red;
+} EncFuncs;
+
+static int num_failures = 0;
+
+static void Fail(const char* const name) {
+  if (num_failures++ < 10) fprintf(stderr, "%s mismatch\n", name);
+}
+
+static int NoCPUInfo(CPUFeature feature) {
+  (void)feature;
+  return 0;
+}
+
+static void GetFuncs(EncFuncs* const funcs) {
+  funcs->ftransform2 = VP8FTransform2;
+  funcs->sse16x16 = VP8SSE16x16;
+  funcs->tdisto16x16 = VP8TDisto16x16;
+  funcs->collect_histogram = VP8CollectHistogram;
+  funcs->quantize2_blocks = VP8EncQuantize2Blocks;
+  funcs->subtract_green = VP8LSubtractGreenFromBlueAndRed;
+  funcs->transform_color = VP8LTransformColor;
+  funcs->collect_blue = VP8LCollectColorBlueTransforms;
+  funcs->collect_red = VP8LCollectColorRedTransforms;
+}
+
+// Fills 'a' and 'b' with random, saturated, flat or identical samples.
+static void FillSamples(uint8_t* const a, uint8_t* const b, int size,
+                        int mode) {
+  int i;
+  for (i = 0; i < size; ++i) {
+    switch (mode) {
+      case 0: a[i] = rand(); b[i] = rand(); break;
+      case 1: a[i] = (rand() & 1) ? 255 : 0; b[i] = (rand() & 1) ? 255 : 0;
+              break;
+      case 2: a[i] = 128 + rand() % 5; b[i] = 128 + rand() % 5; break;
+      default: a[i] = (rand() % 3) ? 255 : 0; b[i] = a[i]; break;
+    }
+  }
+}
+
+static void FillMatrix(VP8Matrix* const m) {
+  int i;
+  for (i = 0; i < 16; ++i) {
+    m->q_[i] = 4 + rand() % 400;
+    m->iq_[i] = (1 << QFIX) / m->q_[i];
+    m->bias_[i] = (rand() % 128) << (QFIX - 8);
+    m->zthresh_[i] = ((1 << QFIX) - 1 - m->bias_[i]) / m->iq_[i];
+    m->sharpen_[i] = ((rand() % 25) * m->q_[i]) >> 11;
+  }
+}
+
+static void TestLossy(const EncFuncs* const c, const EncFuncs* const avx2,
+                      int mode) {
+  uint8_t a[BPS * 20], b[BPS * 20];
+  int i;
+  FillSamples(a, b, (int)sizeof(a), mode);
+  {
+    int16_t out_c[32], out_avx2[32];
+    c->ftransform2(a, b, out_c);
+    avx2->ftransform2(a, b, out_avx2);
+    if (memcmp(out_c, out_avx2, sizeof(out_c))) Fail("FTransform2");
+  }
+  if (c->sse16x16(a, b) != avx2->sse16x16(a, b)) Fail("SSE16x16");
+  {
+    // The weights are symmetric (kWeightY, kWeightTrellis), which the SIMD
+    // versions rely on as they work on transposed blocks.
+    uint16_t w[16];
+    for (i = 0; i < 16; ++i) {
+      w[i] = ((i & 3) < (i >> 2)) ? w[(i & 3) * 4 + (i >> 2)] : rand() % 40;
+    }
+    if (c->tdisto16x16(a, b, w) != avx2->tdisto16x16(a, b, w)) {
+      Fail("TDisto16x16");
+    }
+  }
+  {
+    // Luma (0..16) or chroma (16..24) ranges, possibly shortened.
+    const int start = ((mode & 1) ? 16 : 0) + (rand() % 3 == 2);
+    const int end = ((mode & 1) ? 24 : 16) - (rand() % 5 == 4);
+    VP8Histogram h_c, h_avx2;
+    c->collect_histogram(a, b, start, end, &h_c);
+    avx2->collect_histogram(a, b, start, end, &h_avx2);
+    if (memcmp(&h_c, &h_avx2, sizeof(h_c))) Fail("CollectHistogram");
+  }
+  {
+    VP8Matrix m;
+    int16_t in_c[32], in_avx2[32], out_c[32], out_avx2[32];
+    int nz_c, nz_avx2;
+    FillMatrix(&m);
+    for (i = 0; i < 32; ++i) {
+      in_c[i] = (mode == 3) ? (int16_t)(rand() % 7 - 3)
+                            : (int16_t)(rand() % 8192 - 4096);
+      if (mode == 2 && (rand() & 3)) in_c[i] = 0;
+    }
+    memcpy(in_avx2, in_c, sizeof(in_c));
+    nz_c = c->quantize2_blocks(in_c, out_c, &m);
+    nz_avx2 = avx2->quantize2_blocks(in_avx2, out_avx2, &m);
+    if (nz_c != nz_avx2 || memcmp(in_c, in_avx2, sizeof(in_c)) ||
+        memcmp(out_c, out_avx2, sizeof(out_c))) {
+      Fail("Quantize2Blocks");
+    }
+  }
+}
+
+static void TestLossless(const EncFuncs* const c, const EncFuncs* const avx2,
+                         int random_pixels) {
+  enum { kStride = 80, kMaxHeight = 70 };
+  uint32_t argb_c[kStride * kMaxHeight], argb_avx2[kStride * kMaxHeight];
+  int histo_c[256] = { 0 }, histo_avx2[256] = { 0 };
+  const int num_pixels = 1 + rand() % 300;
+  const int width = 1 + rand() % 70, height = 1 + rand() % 64;
+  VP8LMultipliers m;
+  int i;
+  for (i = 0; i < kStride * kMaxHeight; ++i) {
+    argb_c[i] = random_pixels ? (uint32_t)rand() * 2654435761u
+                              : (uint32_t)(rand() % 4) * 0x01010101u;
+  }
+  memcpy(argb_avx2, argb_c, sizeof(argb_c));
+  c->subtract_green(argb_c, num_pixels);
+  avx2->subtract_green(argb_avx2, num_pixels);
+  if (memcmp(argb_c, argb_avx2, sizeof(argb_c))) Fail("SubtractGreen");
+
+  m.green_to_red_ = rand() & 0xff;
+  m.green_to_blue_ = rand() & 0xff;
+  m.red_to_blue_ = rand() & 0xff;
+  c->transform_color(&m, argb_c, num_pixels);
+  avx2->transform_color(&m, argb_avx2, num_pixels);
+  if (memcmp(argb_c, argb_avx2, sizeof(argb_c))) Fail("TransformColor");
+
+  c->collect_blue(argb_c, kStride, width, height, m.green_to_blue_,
+                  m.red_to_blue_, histo_c);
+  avx2->collect_blue(argb_c, kStride, width, height, m.green_to_blue_,
+                     m.red_to_blue_, histo_avx2);
+  if (memcmp(histo_c, histo_avx2, sizeof(histo_c))) {
+    Fail("CollectColorBlueTransforms");
+  }
+  memset(histo_c, 0, sizeof(histo_c));
+  memset(histo_avx2, 0, sizeof(histo_avx2));
+  c->collect_red(argb_c, kStride, width, height, m.green_to_red_, histo_c);
+  avx2->collect_red(argb_c, kStride, width, height, m.green_to_red_,
+                    histo_avx2);
+  if (memcmp(histo_c, histo_avx2, sizeof(histo_c))) {
+    Fail("CollectColorRedTransforms");
+  }
+}
+
+int main(void) {
+  const VP8CPUInfo cpu_info = VP8GetCPUInfo;
+  EncFuncs c, avx2;
+  int i;
+
+  if (cpu_info == NULL || !cpu_info(kAVX2)) {
+    printf("AVX2 not available, skipped\n");
+    return 0;
+  }
+  VP8GetCPUInfo = NoCPUInfo;
+  VP8EncDspInit();
+  VP8LEncDspInit();
+  GetFuncs(&c);
+  // Going through the regular dispatch also checks that the build selects
+  // the AVX2 versions.
+  VP8GetCPUInfo = cpu_info;
+  VP8EncDspInit();
+  VP8LEncDspInit();
+  GetFuncs(&avx2);
+  {
+    EncFuncs direct;
+    VP8EncDspInitAVX2();
+    VP8LEncDspInitAVX2();
+    GetFuncs(&direct);
+    if (memcmp(&avx2, &direct, sizeof(direct))) {
+      fprintf(stderr, "AVX2 functions not selected by the dispatch\n");
+      return 1;
+    }
+  }
+
+  srand(1);
+  for (i = 0; i < NUM_LOSSY_TESTS; ++i) TestLossy(&c, &avx2, i & 3);
+  for (i = 0; i < NUM_LOSSLESS_TESTS; ++i) TestLossless(&c, &avx2, i & 1);
+  printf("%d failures\n", num_failures);
+  return (num_failures != 0);
+}
@@ -0,0 +1,171 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Checks that the AVX2 YUV->RGB samplers, fancy upsamplers and YUV444
+// converters (yuv_avx2.c, upsampling_avx2.c) give the same output as the
+// plain C ones. With -bench, also times them against the functions selected
+// without AVX2. Not part of the pod. Built and run by 'make -C tests check'
+// (and 'make -C tests bench' with -bench), see tests/Makefile.
+//
+// Returns 0 on success (or if the CPU has no AVX2), 1 on mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/dsp/dsp.h"
+#include "src/webp/decode.h"
+
+#define NUM_TESTS 20000
+#define MAX_WIDTH 300
+#define BENCH_WIDTH 1024
+#define BENCH_ROWS 100000
+
+typedef struct {
+  WebPSamplerRowFunc samplers[MODE_LAST];
+  WebPUpsampleLinePairFunc upsamplers[MODE_LAST];
+  WebPYUV444Converter converters[MODE_LAST];
+} YUVFuncs;
+
+static int num_failures = 0;
+
+static void Fail(const char* const name, int mode, int width) {
+  if (num_failures++ < 10) {
+    fprintf(stderr, "%s mismatch, mode %d width %d\n", name, mode, width);
+  }
+}
+
+static int NoCPUInfo(CPUFeature feature) {
+  (void)feature;
+  return 0;
+}
+
+static VP8CPUInfo cpu_info;
+static int NoAVX2CPUInfo(CPUFeature feature) {
+  return (feature != kAVX2) && cpu_info(feature);
+}
+
+// The init functions run again whenever VP8GetCPUInfo changes.
+static void GetFuncs(VP8CPUInfo info, YUVFuncs* const funcs) {
+  VP8GetCPUInfo = info;
+  WebPInitSamplers();
+  WebPInitUpsamplers();
+  WebPInitYUV444Converters();
+  memcpy(funcs->samplers, WebPSamplers, sizeof(funcs->samplers));
+  memcpy(funcs->upsamplers, WebPUpsamplers, sizeof(funcs->upsamplers));
+  memcpy(funcs->converters, WebPYUV444Converters, sizeof(funcs->converters));
+}
+
+static void Test(const YUVFuncs* const c, const YUVFuncs* const avx2,
+                 int iteration) {
+  // Padded, as the SIMD versions may read past the end of the rows.
+  uint8_t y[2][MAX_WIDTH + 64], u[2][MAX_WIDTH + 64], v[2][MAX_WIDTH + 64];
+  uint8_t out_c[2][MAX_WIDTH * 4 + 64], out_avx2[2][MAX_WIDTH * 4 + 64];
+  const int width = 1 + rand() % MAX_WIDTH;
+  const int has_bottom = (iteration & 2) != 0;
+  int i, j, mode;
+  for (j = 0; j < 2; ++j) {
+    for (i = 0; i < MAX_WIDTH + 64; ++i) {
+      // Gradients, random and saturated chroma.
+      y[j][i] = (iteration & 1) ? rand() : (i * 7 + iteration) & 0xff;
+      u[j][i] = rand();
+      v[j][i] = (iteration % 3) ? rand() : 0xff * (rand() & 1);
+    }
+  }
+  for (mode = 0; mode < MODE_YUV; ++mode) {
+    memset(out_c, 0, sizeof(out_c));
+    memset(out_avx2, 0, sizeof(out_avx2));
+    c->samplers[mode](y[0], u[0], v[0], out_c[0], width);
+    avx2->samplers[mode](y[0], u[0], v[0], out_avx2[0], width);
+    if (memcmp(out_c, out_avx2, sizeof(out_c))) {
+      Fail("Sampler", mode, width);
+    }
+    c->converters[mode](y[0], u[0], v[0], out_c[0], width);
+    avx2->converters[mode](y[0], u[0], v[0], out_avx2[0], width);
+    if (memcmp(out_c, out_avx2, sizeof(out_c))) {
+      Fail("YUV444Converter", mode, width);
+    }
+    c->upsamplers[mode](y[0], has_bottom ? y[1] : NULL, u[0], v[0], u[1], v[1],
+                        out_c[0], has_bottom ? out_c[1] : NULL, width);
+    avx2->upsamplers[mode](y[0], has_bottom ? y[1] : NULL, u[0], v[0], u[1],
+                           v[1], out_avx2[0], has_bottom ? out_avx2[1] : NULL,
+                           width);
+    if (memcmp(out_c, out_avx2, sizeof(out_c))) {
+      Fail("Upsampler", mode, width);
+    }
+  }
+}
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Prints the ns per output pixel of the samplers and upsamplers.
+static void Bench(const YUVFuncs* const funcs, const char* const name,
+                  WEBP_CSP_MODE mode) {
+  static uint8_t y[BENCH_WIDTH + 64], u[BENCH_WIDTH + 64], v[BENCH_WIDTH + 64];
+  static uint8_t out[2][BENCH_WIDTH * 4];
+  double start, sampler_time, upsampler_time;
+  int i;
+  for (i = 0; i < BENCH_WIDTH + 64; ++i) {
+    y[i] = rand();
+    u[i] = rand();
+    v[i] = rand();
+  }
+  start = Now();
+  for (i = 0; i < BENCH_ROWS; ++i) {
+    funcs->samplers[mode](y, u, v, out[0], BENCH_WIDTH);
+  }
+  sampler_time = Now() - start;
+  start = Now();
+  for (i = 0; i < BENCH_ROWS / 2; ++i) {
+    funcs->upsamplers[mode](y, y, u, v, u + 1, v + 1, out[0], out[1],
+                            BENCH_WIDTH);
+  }
+  upsampler_time = Now() - start;
+  printf("mode %2d %-8s sampler %.3f ns/px  upsampler %.3f ns/px\n", mode,
+         name, sampler_time * 1e9 / ((double)BENCH_ROWS * BENCH_WIDTH),
+         upsampler_time * 1e9 / ((double)BENCH_ROWS * BENCH_WIDTH));
+}
+
+int main(int argc, const char* argv[]) {
+  YUVFuncs c, no_avx2, avx2;
+  int i;
+
+  cpu_info = VP8GetCPUInfo;
+  if (cpu_info == NULL || !cpu_info(kAVX2)) {
+    printf("AVX2 not available, skipped\n");
+    return 0;
+  }
+  GetFuncs(NoCPUInfo, &c);
+  GetFuncs(NoAVX2CPUInfo, &no_avx2);
+  GetFuncs(cpu_info, &avx2);
+  if (avx2.samplers[MODE_RGBA] == no_avx2.samplers[MODE_RGBA] ||
+      avx2.upsamplers[MODE_RGBA] == no_avx2.upsamplers[MODE_RGBA] ||
+      avx2.converters[MODE_RGBA] == no_avx2.converters[MODE_RGBA]) {
+    fprintf(stderr, "AVX2 functions not selected by the dispatch\n");
+    return 1;
+  }
+
+  srand(1);
+  for (i = 0; i < NUM_TESTS; ++i) Test(&c, &avx2, i);
+  printf("%d failures\n", num_failures);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    const WEBP_CSP_MODE modes[] = { MODE_RGBA, MODE_BGRA, MODE_RGB, MODE_rgbA };
+    for (i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); ++i) {
+      Bench(&no_avx2, "no AVX2", modes[i]);
+      Bench(&avx2, "AVX2", modes[i]);
+    }
+  }
+  return (num_failures != 0);
+}
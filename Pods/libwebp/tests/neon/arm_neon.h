@@ -0,0 +1,164 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Plain C stand-in for <arm_neon.h>, so that the NEON code can be compiled and
+// checked on a host without an ARM compiler or emulator. Only the intrinsics
+// used by anim_enc_neon.c and neon.h are defined, following the ARM
+// definitions on a little-endian target. This checks the logic of the NEON
+// functions, not the code generated for ARM. Not part of the pod, see
+// tests/Makefile.
+
+#ifndef WEBP_TESTS_NEON_ARM_NEON_H_
+#define WEBP_TESTS_NEON_ARM_NEON_H_
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct { uint8_t v[8]; } uint8x8_t;
+typedef struct { uint8_t v[16]; } uint8x16_t;
+typedef struct { uint16_t v[8]; } uint16x8_t;
+typedef struct { uint32_t v[2]; } uint32x2_t;
+typedef struct { uint32_t v[4]; } uint32x4_t;
+typedef struct { int32_t v[4]; } int32x4_t;
+typedef struct { uint64_t v[1]; } uint64x1_t;
+typedef struct { uint64_t v[2]; } uint64x2_t;
+typedef struct { int32x4_t val[2]; } int32x4x2_t;
+typedef struct { int32x4_t val[4]; } int32x4x4_t;
+typedef struct { uint64x2_t val[2]; } uint64x2x2_t;
+
+#define NEON_UNARY(NAME, TYPE_R, TYPE_A, N, EXPR) \
+static inline TYPE_R NAME(const TYPE_A a) {       \
+  TYPE_R r;                                       \
+  int i;                                          \
+  for (i = 0; i < (N); ++i) r.v[i] = (EXPR);      \
+  return r;                                       \
+}
+
+#define NEON_BINARY(NAME, TYPE_R, TYPE_A, TYPE_B, N, EXPR) \
+static inline TYPE_R NAME(const TYPE_A a, const TYPE_B b) { \
+  TYPE_R r;                                                 \
+  int i;                                                    \
+  for (i = 0; i < (N); ++i) r.v[i] = (EXPR);                \
+  return r;                                                 \
+}
+
+// Same bits, another lane type.
+#define NEON_REINTERPRET(NAME, TYPE_R, TYPE_A) \
+static inline TYPE_R NAME(const TYPE_A a) {    \
+  TYPE_R r;                                    \
+  memcpy(&r, &a, sizeof(r));                   \
+  return r;                                    \
+}
+
+// Loads, stores, lanes.
+static inline uint16x8_t vld1q_u16(const uint16_t* p) {
+  uint16x8_t r;
+  memcpy(r.v, p, sizeof(r.v));
+  return r;
+}
+static inline uint32x4_t vld1q_u32(const uint32_t* p) {
+  uint32x4_t r;
+  memcpy(r.v, p, sizeof(r.v));
+  return r;
+}
+static inline void vst1q_u16(uint16_t* p, const uint16x8_t a) {
+  memcpy(p, a.v, sizeof(a.v));
+}
+static inline void vst1q_u32(uint32_t* p, const uint32x4_t a) {
+  memcpy(p, a.v, sizeof(a.v));
+}
+static inline uint16x8_t vdupq_n_u16(uint16_t x) {
+  uint16x8_t r;
+  int i;
+  for (i = 0; i < 8; ++i) r.v[i] = x;
+  return r;
+}
+static inline uint32x4_t vdupq_n_u32(uint32_t x) {
+  uint32x4_t r;
+  int i;
+  for (i = 0; i < 4; ++i) r.v[i] = x;
+  return r;
+}
+static inline uint32_t vget_lane_u32(const uint32x2_t a, int lane) {
+  return a.v[lane];
+}
+
+NEON_UNARY(vget_low_u8, uint8x8_t, uint8x16_t, 8, a.v[i])
+NEON_UNARY(vget_high_u8, uint8x8_t, uint8x16_t, 8, a.v[i + 8])
+NEON_UNARY(vget_low_u32, uint32x2_t, uint32x4_t, 2, a.v[i])
+NEON_UNARY(vget_high_u32, uint32x2_t, uint32x4_t, 2, a.v[i + 2])
+NEON_UNARY(vget_low_u64, uint64x1_t, uint64x2_t, 1, a.v[i])
+NEON_UNARY(vget_high_u64, uint64x1_t, uint64x2_t, 1, a.v[i + 1])
+NEON_BINARY(vcombine_u8, uint8x16_t, uint8x8_t, uint8x8_t, 16,
+            (i < 8) ? a.v[i] : b.v[i - 8])
+NEON_BINARY(vcombine_u64, uint64x2_t, uint64x1_t, uint64x1_t, 2,
+            (i < 1) ? a.v[i] : b.v[i - 1])
+
+NEON_REINTERPRET(vreinterpretq_u8_u32, uint8x16_t, uint32x4_t)
+NEON_REINTERPRET(vreinterpretq_u32_u8, uint32x4_t, uint8x16_t)
+NEON_REINTERPRET(vreinterpretq_u64_s32, uint64x2_t, int32x4_t)
+NEON_REINTERPRET(vreinterpretq_s32_u64, int32x4_t, uint64x2_t)
+
+// Arithmetic. Narrowing keeps the low half, wrapping as on ARM.
+NEON_BINARY(vabdq_u8, uint8x16_t, uint8x16_t, uint8x16_t, 16,
+            (uint8_t)((a.v[i] > b.v[i]) ? a.v[i] - b.v[i] : b.v[i] - a.v[i]))
+NEON_BINARY(vaddw_u8, uint16x8_t, uint16x8_t, uint8x8_t, 8,
+            (uint16_t)(a.v[i] + b.v[i]))
+NEON_BINARY(vmull_u8, uint16x8_t, uint8x8_t, uint8x8_t, 8,
+            (uint16_t)(a.v[i] * b.v[i]))
+NEON_BINARY(vpadd_u32, uint32x2_t, uint32x2_t, uint32x2_t, 2,
+            (i == 0) ? a.v[0] + a.v[1] : b.v[0] + b.v[1])
+NEON_UNARY(vmovn_u16, uint8x8_t, uint16x8_t, 8, (uint8_t)a.v[i])
+
+static inline uint32x4_t vmulq_n_u32(const uint32x4_t a, uint32_t x) {
+  uint32x4_t r;
+  int i;
+  for (i = 0; i < 4; ++i) r.v[i] = a.v[i] * x;
+  return r;
+}
+static inline uint32x4_t vshrq_n_u32(const uint32x4_t a, int n) {
+  uint32x4_t r;
+  int i;
+  for (i = 0; i < 4; ++i) r.v[i] = a.v[i] >> n;
+  return r;
+}
+
+// Bitwise operations.
+NEON_BINARY(vandq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4, a.v[i] & b.v[i])
+NEON_BINARY(vorrq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4, a.v[i] | b.v[i])
+NEON_BINARY(vbicq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4, a.v[i] & ~b.v[i])
+
+// Comparisons return all ones or all zeros per lane.
+NEON_BINARY(vceqq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4,
+            (a.v[i] == b.v[i]) ? 0xffffffffu : 0u)
+NEON_BINARY(vcgeq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4,
+            (a.v[i] >= b.v[i]) ? 0xffffffffu : 0u)
+NEON_BINARY(vtstq_u32, uint32x4_t, uint32x4_t, uint32x4_t, 4,
+            (a.v[i] & b.v[i]) ? 0xffffffffu : 0u)
+NEON_BINARY(vcleq_u16, uint16x8_t, uint16x8_t, uint16x8_t, 8,
+            (a.v[i] <= b.v[i]) ? 0xffff : 0)
+
+// Transposes the 2x2 blocks of lanes of 'a' and 'b'.
+static inline int32x4x2_t vtrnq_s32(const int32x4_t a, const int32x4_t b) {
+  int32x4x2_t r;
+  int i;
+  for (i = 0; i < 4; i += 2) {
+    r.val[0].v[i] = a.v[i];
+    r.val[0].v[i + 1] = b.v[i];
+    r.val[1].v[i] = a.v[i + 1];
+    r.val[1].v[i + 1] = b.v[i + 1];
+  }
+  return r;
+}
+
+#undef NEON_REINTERPRET
+#undef NEON_BINARY
+#undef NEON_UNARY
+
+#endif  // WEBP_TESTS_NEON_ARM_NEON_H_
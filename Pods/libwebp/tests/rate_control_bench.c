@@ -0,0 +1,381 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Measures how closely target_size / target_PSNR are reached, with the secant
+// search (use_rate_model = 0) and with the rate model (use_rate_model = 1),
+// for several numbers of passes.
+// Each picture is first encoded at quality 30, 50, 75 and 90. The resulting
+// size (or PSNR) is then used as the target, starting from quality 75. Five
+// synthetic pictures are generated: photo, text and noise at 640x480, and a
+// flat-shaded icon at 1024x1024 and 180x180. Binary PPM (P6) files can be
+// added on the command line. Not part of the pod. Built and run by
+// 'make -C tests bench' from the libwebp directory, see tests/Makefile. Usage:
+//
+//   tests/build/rate_control_bench [-psnr] [-mt] [-m method] [-v] [file.ppm]...
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/webp/encode.h"
+
+#define MAX_PICTURES 16
+
+typedef struct {
+  const char* name;
+  int width, height;
+  uint8_t* rgba;
+} Picture;
+
+typedef struct {
+  int use_rate_model;
+  int pass;
+} RateMode;
+
+static const RateMode kModes[] = {
+  { 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 }, { 0, 6 }, { 0, 10 },
+  { 1, 1 }, { 1, 2 }, { 1, 3 },
+};
+#define NUM_MODES ((int)(sizeof(kModes) / sizeof(kModes[0])))
+
+static const float kQualities[] = { 30.f, 50.f, 75.f, 90.f };
+#define NUM_QUALITIES ((int)(sizeof(kQualities) / sizeof(kQualities[0])))
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//------------------------------------------------------------------------------
+// Synthetic pictures
+
+static uint32_t random_state;
+
+static int Random(void) {
+  random_state = random_state * 1103515245u + 12345u;
+  return (random_state >> 16) & 0x7fff;
+}
+
+static float Hash(int x, int y, uint32_t seed) {
+  const uint32_t h =
+      ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ seed;
+  return (float)((h * 2654435761u >> 8) & 0xffff) / 65535.f;
+}
+
+// Smoothly interpolated value noise, in [0, 1].
+static float ValueNoise(int x, int y, int cell, uint32_t seed) {
+  const int cx = x / cell, cy = y / cell;
+  float fx = (float)(x % cell) / cell, fy = (float)(y % cell) / cell;
+  const float v00 = Hash(cx, cy, seed), v10 = Hash(cx + 1, cy, seed);
+  const float v01 = Hash(cx, cy + 1, seed), v11 = Hash(cx + 1, cy + 1, seed);
+  fx = fx * fx * (3 - 2 * fx);
+  fy = fy * fy * (3 - 2 * fy);
+  return (v00 * (1 - fx) + v10 * fx) * (1 - fy) +
+         (v01 * (1 - fx) + v11 * fx) * fy;
+}
+
+static uint8_t Clip8(float v) {
+  return (v < 0.f) ? 0 : (v > 255.f) ? 255 : (uint8_t)v;
+}
+
+// Coverage in [0, 1] of the pixel at 'd' from the edge of a shape, negative
+// inside.
+static float Coverage(float d) {
+  return (d <= -0.5f) ? 1.f : (d >= 0.5f) ? 0.f : 0.5f - d;
+}
+
+// An app icon: vertical gradient, a ring, a rounded bar and a soft shadow,
+// with anti-aliased edges. Drawn in units of the icon size.
+static void IconPixel(int x, int y, int size, float* r, float* g, float* b) {
+  const float s = (float)size;
+  const float u = (x + 0.5f) / s, v = (y + 0.5f) / s;
+  const float dist = sqrtf((u - 0.5f) * (u - 0.5f) + (v - 0.45f) * (v - 0.45f));
+  const float ring = fabsf(dist - 0.27f) - 0.06f;
+  const float bar_x = fabsf(u - 0.5f) - 0.22f, bar_y = fabsf(v - 0.8f) - 0.03f;
+  const float bar = sqrtf((bar_x > 0 ? bar_x * bar_x : 0) +
+                          (bar_y > 0 ? bar_y * bar_y : 0)) - 0.03f;
+  const float shadow = (dist < 0.36f) ? 0.25f * (0.36f - dist) / 0.36f : 0.f;
+  float a;
+  *r = 30 + 60 * v;
+  *g = 110 + 80 * v;
+  *b = 230 - 40 * v;
+  *r *= 1.f - shadow;
+  *g *= 1.f - shadow;
+  *b *= 1.f - shadow;
+  a = Coverage(ring * s);
+  *r += a * (250 - *r);
+  *g += a * (250 - *g);
+  *b += a * (250 - *b);
+  a = Coverage(bar * s);
+  *r += a * (255 - *r);
+  *g += a * (200 - *g);
+  *b += a * (40 - *b);
+}
+
+// "photo": multi-octave noise with a disc and some grain. "text": glyph-like
+// dark dots on a light background, with a gradient box. "noise": gradients
+// with strong noise. "icon-*": see IconPixel().
+static int MakeSynthetic(const char* const name, int width, int height,
+                         Picture* const picture) {
+  int x, y;
+  picture->name = name;
+  picture->width = width;
+  picture->height = height;
+  picture->rgba = (uint8_t*)malloc((size_t)width * height * 4);
+  if (picture->rgba == NULL) return 0;
+  random_state = 7;
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      uint8_t* const p = picture->rgba + 4 * (y * width + x);
+      float r, g, b;
+      if (!strcmp(name, "photo")) {
+        float n = 0.f, amplitude = 1.f;
+        int cell, octave = 0;
+        for (cell = 128; cell >= 2; cell >>= 1, amplitude *= 0.55f, ++octave) {
+          n += amplitude * ValueNoise(x, y, cell, octave * 977);
+        }
+        n = n * 120 + (x + y) * 0.1f;
+        r = n + 30 * ValueNoise(x, y, 64, 5);
+        g = n * 0.9f + 20;
+        b = n * 0.7f + 40 * ValueNoise(x, y, 32, 9);
+        if ((x - 400) * (x - 400) + (y - 200) * (y - 200) < 90 * 90) {
+          r = 220 - n * 0.2f;
+          g = 60;
+          b = 40;
+        }
+        r += (Random() % 9) - 4;
+        g += (Random() % 9) - 4;
+        b += (Random() % 9) - 4;
+      } else if (!strcmp(name, "text")) {
+        r = g = b = 245;
+        if (((x / 7) * 31 + (y / 11) * 17) % 5 < 2 && (x % 7) < 5 &&
+            (y % 11) < 8 && ((x * 3 + y * 5 + x * y) % 7) < 3) {
+          r = g = b = 20;
+        }
+        if (y > 300 && y < 420 && x > 40 && x < 600) {
+          r = 40 + x / 4;
+          g = 120;
+          b = 200 - y / 4;
+        }
+      } else if (!strncmp(name, "icon", 4)) {
+        IconPixel(x, y, width, &r, &g, &b);
+      } else {
+        r = 100 + x * 0.2f + (Random() % 61) - 30;
+        g = 80 + y * 0.2f + (Random() % 41) - 20;
+        b = 128 + (Random() % 81) - 40;
+      }
+      p[0] = Clip8(r);
+      p[1] = Clip8(g);
+      p[2] = Clip8(b);
+      p[3] = 0xff;
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Binary PPM (P6) reader, 8-bit only.
+
+// Skips whitespace and comments, then reads a decimal value. Returns -1 on
+// error.
+static int ReadPPMValue(FILE* const file) {
+  int ch, value = 0, num_digits = 0;
+  do {
+    ch = getc(file);
+    if (ch == '#') {
+      while (ch != '\n' && ch != EOF) ch = getc(file);
+    }
+  } while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+  while (ch >= '0' && ch <= '9' && value < 100000) {
+    value = value * 10 + (ch - '0');
+    ++num_digits;
+    ch = getc(file);
+  }
+  // The single whitespace after the value is consumed.
+  return (num_digits > 0) ? value : -1;
+}
+
+static int ReadPPM(const char* const file_name, Picture* const picture) {
+  FILE* const file = fopen(file_name, "rb");
+  int width, height, max_value, i, ok = 0;
+  picture->rgba = NULL;
+  if (file == NULL) return 0;
+  if (getc(file) == 'P' && getc(file) == '6') {
+    width = ReadPPMValue(file);
+    height = ReadPPMValue(file);
+    max_value = ReadPPMValue(file);
+    if (width > 0 && height > 0 && width <= 16384 && height <= 16384 &&
+        max_value == 255) {
+      const size_t num_pixels = (size_t)width * height;
+      picture->rgba = (uint8_t*)malloc(num_pixels * 4);
+      if (picture->rgba != NULL &&
+          fread(picture->rgba, 3, num_pixels, file) == num_pixels) {
+        // RGB to RGBA in place, from the end. The targets are for opaque
+        // pictures.
+        for (i = (int)num_pixels - 1; i >= 0; --i) {
+          picture->rgba[4 * i + 3] = 0xff;
+          picture->rgba[4 * i + 2] = picture->rgba[3 * i + 2];
+          picture->rgba[4 * i + 1] = picture->rgba[3 * i + 1];
+          picture->rgba[4 * i + 0] = picture->rgba[3 * i + 0];
+        }
+        picture->name = file_name;
+        picture->width = width;
+        picture->height = height;
+        ok = 1;
+      }
+    }
+  }
+  fclose(file);
+  if (!ok) {
+    free(picture->rgba);
+    picture->rgba = NULL;
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
+// Returns the encoded size, adds the encoding time to '*time' and sets
+// '*psnr' to the overall PSNR.
+static size_t Encode(const Picture* const picture,
+                     const WebPConfig* const config, double* const time,
+                     float* const psnr) {
+  WebPPicture pic;
+  WebPMemoryWriter writer;
+  WebPAuxStats stats;
+  size_t size;
+  double start;
+  if (!WebPPictureInit(&pic)) exit(1);
+  pic.width = picture->width;
+  pic.height = picture->height;
+  if (!WebPPictureImportRGBA(&pic, picture->rgba, 4 * picture->width)) exit(1);
+  WebPMemoryWriterInit(&writer);
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = &writer;
+  pic.stats = &stats;
+  start = Now();
+  if (!WebPEncode(config, &pic)) {
+    fprintf(stderr, "%s: encoding error %d\n", picture->name, pic.error_code);
+    exit(1);
+  }
+  *time += Now() - start;
+  *psnr = stats.PSNR[3];
+  size = writer.size;
+  WebPMemoryWriterClear(&writer);
+  WebPPictureFree(&pic);
+  return size;
+}
+
+static void Help(void) {
+  printf("Usage: rate_control_bench [-psnr] [-mt] [-m method] [-v] "
+         "[file.ppm ...]\n"
+         "  -psnr ..... target the PSNR instead of the size\n"
+         "  -mt ....... use multi-threading\n"
+         "  -m <int> .. only this method (default: 2, 4 and 6)\n"
+         "  -v ........ print every encoding\n");
+}
+
+int main(int argc, const char* argv[]) {
+  static const struct {
+    const char* name;
+    int width, height;
+  } kSynthetic[] = {
+    { "photo", 640, 480 }, { "text", 640, 480 }, { "noise", 640, 480 },
+    { "icon-1024", 1024, 1024 }, { "icon-180", 180, 180 },
+  };
+  const int kMethods[] = { 2, 4, 6 };
+  Picture pictures[MAX_PICTURES];
+  int num_pictures = 0;
+  int target_psnr = 0, use_threads = 0, verbose = 0, only_method = -1;
+  int i, m, q, k;
+
+  for (i = 0; i < (int)(sizeof(kSynthetic) / sizeof(kSynthetic[0])); ++i) {
+    if (!MakeSynthetic(kSynthetic[i].name, kSynthetic[i].width,
+                       kSynthetic[i].height, &pictures[num_pictures++])) {
+      return 1;
+    }
+  }
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-psnr")) {
+      target_psnr = 1;
+    } else if (!strcmp(argv[i], "-mt")) {
+      use_threads = 1;
+    } else if (!strcmp(argv[i], "-v")) {
+      verbose = 1;
+    } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+      only_method = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || num_pictures == MAX_PICTURES) {
+      Help();
+      return (strcmp(argv[i], "-h") != 0);
+    } else if (!ReadPPM(argv[i], &pictures[num_pictures++])) {
+      fprintf(stderr, "cannot read %s (8-bit binary PPM only)\n", argv[i]);
+      return 1;
+    }
+  }
+
+  for (m = 0; m < (int)(sizeof(kMethods) / sizeof(kMethods[0])); ++m) {
+    double error_sum[NUM_MODES] = { 0. }, error_max[NUM_MODES] = { 0. };
+    double time[NUM_MODES] = { 0. };
+    int num_cases = 0;
+    if (only_method >= 0 && kMethods[m] != only_method) continue;
+    for (i = 0; i < num_pictures; ++i) {
+      for (q = 0; q < NUM_QUALITIES; ++q) {
+        WebPConfig config;
+        double unused_time = 0.;
+        float psnr;
+        size_t size;
+        if (!WebPConfigInit(&config)) return 1;
+        config.method = kMethods[m];
+        config.low_memory = (kMethods[m] == 2);
+        config.thread_level = use_threads;
+        config.quality = kQualities[q];
+        size = Encode(&pictures[i], &config, &unused_time, &psnr);
+        for (k = 0; k < NUM_MODES; ++k) {
+          WebPConfig target_config = config;
+          float got_psnr;
+          size_t got_size;
+          double error;
+          target_config.quality = 75.f;
+          if (target_psnr) {
+            target_config.target_PSNR = psnr;
+          } else {
+            target_config.target_size = (int)size;
+          }
+          target_config.pass = kModes[k].pass;
+          target_config.use_rate_model = kModes[k].use_rate_model;
+          got_size = Encode(&pictures[i], &target_config, &time[k], &got_psnr);
+          error = target_psnr ? fabs(got_psnr - psnr)
+                : fabs((double)got_size - size) * 100. / size;
+          error_sum[k] += error;
+          if (error > error_max[k]) error_max[k] = error;
+          if (verbose) {
+            printf("%s m%d q%.0f %s pass=%d: target %.2f, got %.2f\n",
+                   pictures[i].name, kMethods[m], kQualities[q],
+                   kModes[k].use_rate_model ? "model" : "secant",
+                   kModes[k].pass, target_psnr ? psnr : (double)size,
+                   target_psnr ? got_psnr : (double)got_size);
+          }
+        }
+        ++num_cases;
+      }
+    }
+    printf("method %d, %d cases, |%s error| mean/max, time:\n", kMethods[m],
+           num_cases, target_psnr ? "PSNR dB" : "size %");
+    for (k = 0; k < NUM_MODES; ++k) {
+      printf("  %-6s pass=%-2d  %6.2f %7.2f  %6.2fs\n",
+             kModes[k].use_rate_model ? "model" : "secant", kModes[k].pass,
+             error_sum[k] / num_cases, error_max[k], time[k]);
+    }
+  }
+  for (i = 0; i < num_pictures; ++i) free(pictures[i].rgba);
+  return 0;
+}